@@ -0,0 +1,72 @@
+#include "BootTimeline.h"
+
+static const char *const phaseNames[BOOT_PHASE_COUNT] = {
+  "bus", "recovery", "imu", "calibration", "ootx"
+};
+
+volatile uint8_t BootTimeline::state[BOOT_PHASE_COUNT];
+volatile uint32_t BootTimeline::startMicros[BOOT_PHASE_COUNT];
+volatile uint32_t BootTimeline::stopMicros[BOOT_PHASE_COUNT];
+uint32_t BootTimeline::firstPoseMicros = 0;
+
+void BootTimeline::start(BootPhase phase) {
+
+  if (state[phase] == idle) {
+    startMicros[phase] = micros();
+    state[phase] = running;
+  }
+
+}
+
+void BootTimeline::stop(BootPhase phase) {
+
+  if (state[phase] == running) {
+    stopMicros[phase] = micros();
+    state[phase] = stopped;
+  }
+
+}
+
+bool BootTimeline::firstPose() {
+
+  if (firstPoseMicros != 0) {
+    return false;
+  }
+  // 0 is "not yet", a pose in the first us of power up is not a concern
+  firstPoseMicros = micros() | 1;
+  return true;
+
+}
+
+uint32_t BootTimeline::phaseMicros(BootPhase phase) {
+  return done(phase) ? stopMicros[phase] - startMicros[phase] : 0;
+}
+
+void BootTimeline::print() {
+
+  Serial.printf("BT");
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+    Serial.printf(" %s ", phaseNames[i]);
+    if (state[i] == stopped) {
+      Serial.printf("%.1f", phaseMicros(BootPhase(i)) * 1e-3);
+    } else {
+      Serial.printf(state[i] == running ? "..." : "-");
+    }
+  }
+  Serial.printf(" pose ");
+  if (firstPoseMicros != 0) {
+    Serial.printf("%.1f\n", firstPoseMicros * 1e-3);
+  } else {
+    Serial.printf("...\n");
+  }
+
+}
+
+void BootTimeline::reset() {
+
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+    state[i] = idle;
+  }
+  firstPoseMicros = 0;
+
+}
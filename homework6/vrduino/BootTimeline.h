@@ -0,0 +1,73 @@
+/**
+ * @class BootTimeline
+ * Time spent in each phase of the boot, to track the cold start time.
+ *
+ * Each phase records the micros() since power up when it first starts and
+ * first stops, later runs are not recorded, e.g. the bias measured again
+ * with 'b'. The phases are, in order:
+ * - bus, choosing and starting the imu bus, including the recovery
+ * - recovery, clocking a stuck I2C bus free, only when the imu does not
+ *   answer, see ImuBusI2c::begin()
+ * - imu, configuring the MPU9250
+ * - calibration, loading or measuring the imu calibration
+ * - ootx, from power up to the first complete OOTX frame of a base
+ *   station, only with a real lighthouse
+ * and the first pose, when vrduino.ino first prints an orientation.
+ *
+ * print() writes them in ms as a "BT" line, e.g.
+ *   BT bus 2.1 recovery - imu 0.4 calibration 1000.2 ootx ... pose 1003.0
+ * with "-" for a phase that did not run and "..." for one still running.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+enum BootPhase {
+  BOOT_BUS,
+  BOOT_BUS_RECOVERY,
+  BOOT_IMU_CONFIG,
+  BOOT_CALIBRATION,
+  BOOT_OOTX,
+  BOOT_PHASE_COUNT
+};
+
+class BootTimeline {
+
+  public:
+
+    /** records the start of phase, the first time only */
+    static void start(BootPhase phase);
+
+    /** records the end of phase, the first time after its start only. Safe from an ISR */
+    static void stop(BootPhase phase);
+
+    /** records the first pose, @returns true the first time */
+    static bool firstPose();
+
+    /** @returns true once phase has started and stopped */
+    static bool done(BootPhase phase) { return state[phase] == stopped; }
+
+    /** @returns us from the start to the stop of a done phase, else 0 */
+    static uint32_t phaseMicros(BootPhase phase);
+
+    /** @returns us from power up to the first pose, 0 before it */
+    static uint32_t poseMicros() { return firstPoseMicros; }
+
+    /** writes the "BT" line to Serial */
+    static void print();
+
+    /** forgets all phases, e.g. for a boot run again on the host */
+    static void reset();
+
+  private:
+
+    static const uint8_t idle = 0;
+    static const uint8_t running = 1;
+    static const uint8_t stopped = 2;
+
+    static volatile uint8_t state[BOOT_PHASE_COUNT];
+    static volatile uint32_t startMicros[BOOT_PHASE_COUNT];
+    static volatile uint32_t stopMicros[BOOT_PHASE_COUNT];
+    static uint32_t firstPoseMicros;
+
+};
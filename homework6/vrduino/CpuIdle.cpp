@@ -0,0 +1,40 @@
+#include "CpuIdle.h"
+#include "TickClock.h"
+
+uint64_t CpuIdle::sleptTicks = 0;
+uint32_t CpuIdle::sleepCount = 0;
+
+void CpuIdle::sleep() {
+
+  uint64_t start = TickClock::now();
+#if defined(__arm__)
+  asm volatile("wfi");
+#else
+  hostWaitForInterrupt();
+#endif
+  sleptTicks += TickClock::now() - start;
+  sleepCount++;
+
+}
+
+bool CpuIdle::sleepUnless(bool (*pending)()) {
+
+  // an interrupt after the check stays pending and wakes the wfi at once
+  __disable_irq();
+  bool idle = !pending();
+  if (idle) {
+    sleep();
+  }
+  __enable_irq();
+  return idle;
+
+}
+
+uint64_t CpuIdle::sleptMicros() {
+  return sleptTicks / TickClock::ticksPerMicro;
+}
+
+void CpuIdle::reset() {
+  sleptTicks = 0;
+  sleepCount = 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * @class CpuIdle
+ * Sleeps the core between events instead of spinning in delay().
+ *
+ * sleep() halts the Cortex-M4 with WFI until the next interrupt: the
+ * SysTick of millis() every 1 ms at the latest, the FTM0 edge captures of
+ * the lighthouse, the imu data ready pin of ImuCapture, the I2C interrupt
+ * of a background read, or USB serial. The clocks and peripherals keep
+ * running, only the core stops, so nothing is missed, and the caller
+ * goes on within the ISR of the event that woke it.
+ *
+ * An interrupt that comes between a caller's check for work and sleep()
+ * is only seen at the next one, up to 1 ms late. sleepUnless() closes
+ * that gap: it checks with interrupts masked and sleeps in the same
+ * masked section, as WFI still wakes on an interrupt pending while
+ * PRIMASK is set, which then runs once they are unmasked. sleep() alone
+ * is for waits that check again after every wake anyway.
+ *
+ * The time asleep is counted in TickClock ticks, see sleptMicros(): the
+ * share of the time the core was idle, the ISRs that ran meanwhile
+ * included.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+class CpuIdle {
+
+  public:
+
+    /** halts the core until the next interrupt */
+    static void sleep();
+
+    /**
+     * halts the core until the next interrupt unless pending() returns
+     * true, called with interrupts masked, so it must not wait on one
+     * @returns true if it slept
+     */
+    static bool sleepUnless(bool (*pending)());
+
+    /** @returns us asleep and the number of sleeps since reset() */
+    static uint64_t sleptMicros();
+    static uint32_t sleeps() { return sleepCount; }
+
+    /** forgets the time asleep */
+    static void reset();
+
+  private:
+
+    static uint64_t sleptTicks;
+    static uint32_t sleepCount;
+
+};
@@ -0,0 +1,142 @@
+#include "FixedPoint.h"
+
+/* tan(pi/8), the split point of the arctangent range reduction */
+#define Q30_TAN_PI_8 444758426
+
+/* pi/4 in Q1.30 */
+#define Q30_PI_4 843314857
+
+
+uint32_t isqrt64(uint64_t x) {
+
+  // digit-by-digit, two bits of x per result bit
+  uint64_t res = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > x) {
+    bit >>= 2;
+  }
+
+  while (bit != 0) {
+    if (x >= res + bit) {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return (uint32_t)res;
+
+}
+
+
+/**
+ * Taylor series of sin and cos for |x| <= pi/4 in nested form,
+ * sin = x (1 - x^2/(2*3) (1 - x^2/(4*5) (1 - ...))), up to x^11 and x^12.
+ * The first omitted terms are below 6e-12.
+ */
+static void sinCosPi4(q30_t x, q30_t& s, q30_t& c) {
+
+  // 1 / (k (k+1)) for k = 1 ... 11
+  static const q30_t inv[11] = {
+    536870912, 178956971, 89478485, 53687091, 35791394, 25565282,
+    19173961, 14913081, 11930465, 9761289, 8134408
+  };
+
+  q30_t x2 = q30Mul(x, x);
+
+  q30_t ts = Q30_ONE;
+  for (int i = 9; i >= 1; i -= 2) {
+    ts = Q30_ONE - q30Mul(q30Mul(x2, inv[i]), ts);
+  }
+  s = q30Mul(x, ts);
+
+  q30_t tc = Q30_ONE;
+  for (int i = 10; i >= 0; i -= 2) {
+    tc = Q30_ONE - q30Mul(q30Mul(x2, inv[i]), tc);
+  }
+  c = tc;
+
+}
+
+
+void q30SinCos(q30_t x, q30_t& s, q30_t& c) {
+
+  if (x > Q30_PI_4 || x < -Q30_PI_4) {
+    // sin(x) = +-cos(pi/2 - |x|), cos(x) = sin(pi/2 - |x|)
+    q30_t y = 2 * Q30_PI_4 - (x > 0 ? x : -x);
+    q30_t sy, cy;
+    sinCosPi4(y, sy, cy);
+    s = (x > 0) ? cy : -cy;
+    c = sy;
+  } else {
+    sinCosPi4(x, s, c);
+  }
+
+}
+
+
+/**
+ * atan(u) for |u| <= tan(pi/8) in Q1.30 radians, Taylor series up to
+ * u^19. The first omitted term is below 1e-9.
+ */
+static q30_t atanPi8(q30_t u) {
+
+  // 1 / (2k+1) for k = 0 ... 9
+  static const q30_t inv[10] = {
+    1073741824, 357913941, 214748365, 153391689, 119304647,
+    97612893, 82595525, 71582788, 63161284, 56512728
+  };
+
+  q30_t u2 = q30Mul(u, u);
+
+  q30_t t = inv[9];
+  for (int k = 8; k >= 0; k--) {
+    t = inv[k] - q30Mul(u2, t);
+  }
+  return q30Mul(u, t);
+
+}
+
+
+bam_t fixedAtan2(int32_t y, int32_t x) {
+
+  uint32_t ax = (x < 0) ? -(uint32_t)x : (uint32_t)x;
+  uint32_t ay = (y < 0) ? -(uint32_t)y : (uint32_t)y;
+  if (ax == 0 && ay == 0) {
+    return 0;
+  }
+
+  // reduce to the first octant, t = min/max in [0, 1]
+  bool swap = ay > ax;
+  uint32_t num = swap ? ax : ay;
+  uint32_t den = swap ? ay : ax;
+  q30_t t = (q30_t)(((uint64_t)num << 30) / den);
+
+  // and further to |u| <= tan(pi/8), atan(t) = pi/4 + atan((t-1)/(t+1))
+  q30_t r;
+  if (t > Q30_TAN_PI_8) {
+    q30_t u = (q30_t)(((int64_t)(t - Q30_ONE) << 30) / ((int64_t)t + Q30_ONE));
+    r = Q30_PI_4 + atanPi8(u);
+  } else {
+    r = atanPi8(t);
+  }
+
+  // radians to binary angle, a = r * 2/pi with 2/pi in Q1.31
+  int64_t a = ((int64_t)r * 1367130551LL) >> 31;
+
+  if (swap) {
+    a = BAM_HALF_PI - a;
+  }
+  if (x < 0) {
+    a = 2 * (int64_t)BAM_HALF_PI - a;
+  }
+  if (y < 0) {
+    a = -a;
+  }
+
+  // +pi wraps to -pi
+  return (bam_t)(uint32_t)a;
+
+}
@@ -0,0 +1,88 @@
+/**
+ * @file
+ * fixed-point formats and math kernels for the FPU-less orientation
+ * pipeline in OrientationMathFixed.h
+ *
+ * All formats are stored in int32_t:
+ * - q30_t: Q1.30, range [-2, 2), resolution 9.3e-10.
+ *   quaternion components and angles in radians
+ * - bam_t: binary angle, the angle as a Q1.31 fraction of pi, i.e.
+ *   [-180, 180) degrees with 8.4e-8 degree resolution. Sums wrap around
+ *   like angles do, as long as they are done in uint32_t.
+ *   roll, pitch and atan2 results
+ *
+ * Products are formed in 64 bit, which is a single SMULL on the Cortex-M4.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+typedef int32_t q30_t;
+typedef int32_t bam_t;
+
+#define Q30_ONE ((q30_t)1 << 30)
+
+/* pi/2 as binary angle */
+#define BAM_HALF_PI ((bam_t)1 << 30)
+
+
+/* floating point to Q1.30, for constants and tests */
+inline q30_t toQ30(double x) { return (q30_t)lround(x * Q30_ONE); }
+
+/* Q1.30 to floating point */
+inline double fromQ30(q30_t x) { return x / double(Q30_ONE); }
+
+/* binary angle to degrees */
+inline double bamToDeg(bam_t a) { return a * (180.0 / 2147483648.0); }
+
+/* a + b, wrapped */
+inline bam_t bamAdd(bam_t a, bam_t b) { return (bam_t)((uint32_t)a + (uint32_t)b); }
+
+/* a - b, wrapped */
+inline bam_t bamSub(bam_t a, bam_t b) { return (bam_t)((uint32_t)a - (uint32_t)b); }
+
+
+/**
+ * product of a Q1.30 value and a value in any Q format, rounded,
+ * in the format of b
+ */
+inline int32_t q30Mul(q30_t a, int32_t b) {
+  return (int32_t)(((int64_t)a * b + (1 << 29)) >> 30);
+}
+
+/* binary angle to Q1.30 radians, |a| must be below 2 rad (114 degrees) */
+inline q30_t bamToRadQ30(bam_t a) {
+  // pi * 2^30
+  return (q30_t)(((int64_t)a * 3373259426LL) >> 31);
+}
+
+
+/**
+ * integer square root
+ * @returns floor(sqrt(x))
+ */
+uint32_t isqrt64(uint64_t x);
+
+
+/* square root of a non-negative Q1.30 value */
+inline q30_t q30Sqrt(q30_t x) {
+  return (q30_t)isqrt64((uint64_t)x << 30);
+}
+
+
+/**
+ * sine and cosine of an angle in radians, max error 2e-9
+ * @param [in] x - Q1.30 angle in radians, |x| <= pi/2
+ * @param [out] s - Q1.30 sin(x)
+ * @param [out] c - Q1.30 cos(x)
+ */
+void q30SinCos(q30_t x, q30_t& s, q30_t& c);
+
+
+/**
+ * four-quadrant arctangent, max error 2e-7 degrees
+ * @param [in] y, x - values in any common scale, not both 0
+ * @returns atan2(y, x) as binary angle. An angle of +180 degrees is
+ *   returned as -180 degrees
+ */
+bam_t fixedAtan2(int32_t y, int32_t x);
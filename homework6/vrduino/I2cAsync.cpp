@@ -0,0 +1,147 @@
+#include "I2cAsync.h"
+
+I2cAsync *I2cAsync::running = nullptr;
+
+I2cAsync::I2cAsync() :
+  address(0),
+  reg(0),
+  data(nullptr),
+  n(0),
+  index(0),
+  callback(nullptr),
+  state(ADDRESS_WRITE),
+  busy(false),
+  ok(false)
+{
+}
+
+bool I2cAsync::startRead(uint8_t addressIn, uint8_t regIn, uint8_t *dataIn,
+  uint8_t nIn, Callback callbackIn) {
+
+  if (busy || nIn == 0 || (I2C0_S & I2C_S_BUSY)) {
+    return false;
+  }
+
+  address = addressIn;
+  reg = regIn;
+  data = dataIn;
+  n = nIn;
+  index = 0;
+  callback = callbackIn;
+  ok = false;
+  busy = true;
+  state = ADDRESS_WRITE;
+
+  // the vector is shared with the slave mode of Wire, claim it per transfer
+  running = this;
+  attachInterruptVector(IRQ_I2C0, isr);
+  NVIC_ENABLE_IRQ(IRQ_I2C0);
+
+  // START, then the address, the ISR takes over from there
+  I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+  I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+  I2C0_D = address << 1;
+
+  return true;
+
+}
+
+void I2cAsync::abort() {
+
+  if (running != this) {
+    return;
+  }
+  running = nullptr;
+  if (busy) {
+    I2C0_C1 = I2C_C1_IICEN;
+    ok = false;
+    busy = false;
+  }
+
+}
+
+void I2cAsync::isr() {
+
+  if (running != nullptr) {
+    running->transfer();
+  } else {
+    I2C0_S = I2C_S_IICIF;
+  }
+
+}
+
+void I2cAsync::transfer() {
+
+  uint8_t status = I2C0_S;
+  I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+
+  if (status & I2C_S_ARBL) {
+    finish(false);
+    return;
+  }
+
+  switch (state) {
+
+    case ADDRESS_WRITE:
+      if (status & I2C_S_RXAK) {
+        finish(false);
+        return;
+      }
+      state = REGISTER;
+      I2C0_D = reg;
+      break;
+
+    case REGISTER:
+      if (status & I2C_S_RXAK) {
+        finish(false);
+        return;
+      }
+      state = ADDRESS_READ;
+      I2C0_C1 |= I2C_C1_RSTA;
+      I2C0_D = (address << 1) | 1;
+      break;
+
+    case ADDRESS_READ: {
+      if (status & I2C_S_RXAK) {
+        finish(false);
+        return;
+      }
+      // receive, NACK right away if there is a single byte, and start
+      // the first byte with a dummy read of D
+      state = DATA;
+      uint8_t c1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST;
+      I2C0_C1 = (n == 1) ? (c1 | I2C_C1_TXAK) : c1;
+      (void)(uint8_t)I2C0_D;
+      break;
+    }
+
+    case DATA:
+      if (index == n - 1) {
+        // STOP before reading D, so no further byte is clocked in
+        I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE;
+        data[index++] = I2C0_D;
+        finish(true);
+        return;
+      }
+      if (index == n - 2) {
+        // NACK the last byte
+        I2C0_C1 |= I2C_C1_TXAK;
+      }
+      data[index++] = I2C0_D;
+      break;
+
+  }
+
+}
+
+void I2cAsync::finish(bool success) {
+
+  // STOP if it is not sent yet, and back to the polled mode of Wire
+  I2C0_C1 = I2C_C1_IICEN;
+  ok = success;
+  busy = false;
+  if (callback != nullptr) {
+    callback(success);
+  }
+
+}
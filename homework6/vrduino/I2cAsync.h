@@ -0,0 +1,88 @@
+/**
+ * @class I2cAsync
+ * Interrupt-driven register reads on the I2C0 bus of the Teensy 3.
+ *
+ * Wire on the Teensy 3 waits for every byte in a busy loop, so a 15 byte
+ * read at 400 kHz keeps the CPU for ~0.4 ms. startRead() here only sends
+ * the START and the address, and returns. The I2C0 interrupt then runs the
+ * rest of the transfer, one byte per interrupt:
+ *
+ *   START, address+W, register, repeated START, address+R, n data bytes,
+ *   the last one NACKed, STOP
+ *
+ * while loop() goes on with other work. isBusy() polls for the end of the
+ * transfer, the callback, if any, is called from the ISR at its end.
+ *
+ * The bus must have been set up by Wire.begin() and Wire.setClock(), and
+ * Wire must not be used while a transfer runs. A NACK or a lost
+ * arbitration ends the transfer with succeeded() false.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+class I2cAsync {
+
+  public:
+
+    /** called from the ISR at the end of a transfer */
+    typedef void (*Callback)(bool ok);
+
+    I2cAsync();
+
+    ~I2cAsync() { abort(); }
+
+    /**
+     * starts reading n bytes from register reg of a device on I2C0
+     * @param [in] address - 7 bit device address
+     * @param [in] reg - first register, the device increments it
+     * @param [out] data - n bytes, valid once the transfer has ended
+     * @param [in] n - at least 1
+     * @param [in] callback - called at the end of the transfer, may be nullptr
+     * @returns false if a transfer is still running, or the bus is busy
+     */
+    bool startRead(uint8_t address, uint8_t reg, uint8_t *data, uint8_t n,
+      Callback callback = nullptr);
+
+    /** ends a running transfer with a STOP, without calling back */
+    void abort();
+
+    /** @returns true while a transfer runs */
+    bool isBusy() const { return busy; }
+
+    /** @returns true if the last transfer got all its bytes */
+    bool succeeded() const { return ok; }
+
+  protected:
+
+    enum State {
+      ADDRESS_WRITE,
+      REGISTER,
+      ADDRESS_READ,
+      DATA
+    };
+
+    /** ISR body: one byte of the transfer is done */
+    void transfer();
+
+    /** sends the STOP and releases the bus */
+    void finish(bool success);
+
+    /** I2C0 ISR, forwards to the running instance */
+    static void isr();
+
+    /* instance served by isr(), there is one I2C0 */
+    static I2cAsync *running;
+
+    uint8_t address;
+    uint8_t reg;
+    uint8_t *data;
+    uint8_t n;
+    uint8_t index;
+    Callback callback;
+
+    volatile State state;
+    volatile bool busy;
+    volatile bool ok;
+
+};
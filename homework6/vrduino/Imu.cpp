@@ -7,9 +7,8 @@
  */
 
 #include "Imu.h"
-
-// turn magnetometer off by default, often creates trouble reading other values
-#define USE_MAGNETOMETER false
+#include "BootTimeline.h"
+#include "Profiler.h"
 
 /* address of gyro & accelerometer */
 #define MPU9250_ADDRESS 0x68
@@ -23,6 +22,13 @@
 /*  address of magnetometer (separate chip) */
 #define MAG_ADDRESS 0x0C
 
+/* AK8963 registers, and its WIA value */
+#define AK8963_WIA       0x00
+#define AK8963_ST1       0x02
+#define AK8963_CNTL1     0x0A
+#define AK8963_ASAX      0x10
+#define AK8963_KNOWN_VAL 0x48
+
 /***
  * gyro maximum angular velocity range (in degrees per second)
  * note: smaller range makes the measurements more precise with the 16 bit ADC,
@@ -53,110 +59,142 @@
 #define INT_PIN_CFG      0x37
 #define INT_ENABLE       0x38
 #define INT_STATUS       0x3A
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// this is a utility function to help clear the I2C bus so as to avoid it getting stuck
-
-/**
- * This routine turns off the I2C bus and clears it
- * on return SCA and SCL pins are tri-state inputs.
- * You need to call Wire.begin() after this to re-enable I2C
- * This routine does NOT use the Wire library at all.
- *
- * returns 0 if bus cleared
- *         1 if SCL held low.
- *         2 if SDA held low by slave clock stretch for > 2sec
- *         3 if SDA held low after 20 clocks.
- */
-int I2C_ClearBus() {
-#if defined(TWCR) && defined(TWEN)
-  TWCR &= ~(_BV(TWEN)); //Disable the Atmel 2-Wire interface so we can control the SDA and SCL pins directly
+#define TEMP_OUT_H       0x41
+#define FIFO_EN          0x23
+#define I2C_MST_CTRL     0x24
+#define I2C_SLV0_ADDR    0x25
+#define I2C_SLV0_REG     0x26
+#define I2C_SLV0_CTRL    0x27
+#define I2C_SLV4_ADDR    0x31
+#define I2C_SLV4_REG     0x32
+#define I2C_SLV4_DO      0x33
+#define I2C_SLV4_CTRL    0x34
+#define I2C_SLV4_DI      0x35
+#define I2C_MST_STATUS   0x36
+#define USER_CTRL        0x6A
+#define FIFO_COUNTH      0x72
+#define FIFO_R_W         0x74
+
+/* the links to the imu, see ImuBus.h */
+static ImuBusI2c i2cBus(MPU9250_ADDRESS);
+#if defined(IMU_SPI_CS_PIN)
+static ImuBusSpi spiBus(IMU_SPI_CS_PIN);
 #endif
 
-  pinMode(SDA, INPUT_PULLUP); // Make SDA (data) and SCL (clock) pins Inputs with pullup.
-  pinMode(SCL, INPUT_PULLUP);
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// initialize the connection to the IMU
 
-  delay(2500);  // Wait 2.5 secs. This is strictly only necessary on the first power
-  // up of the DS3231 module to allow it to initialize properly,
-  // but is also assists in reliable programming of FioV3 boards as it gives the
-  // IDE a chance to start uploaded the program
-  // before existing sketch confuses the IDE by sending Serial data.
+Imu::Imu() :
+  gyrX(0), gyrY(0), gyrZ(0),
+  accX(0), accY(0), accZ(0),
+  magX(0), magY(0), magZ(0),
+  temperature(0),
+  gyrRaw{0, 0, 0},
+  accRaw{0, 0, 0},
+  magRaw{0, 0, 0},
+  tempRaw(0),
+  samplePeriodMicros(0),
+  samplePeriodTicks(0),
+  fifoOverflows(0),
+  readSamples(0),
+  readTicks(0),
+  fifoTicks(0),
+  fifoTicksValid(false),
+  fifoTemp(0),
+  fifoTempTicks(0),
+  fifoTempValid(false),
+  bus(nullptr),
+  statusBurst(true),
+  burstMissed(false),
+  pollMissed(false),
+  asyncBuf(),
+  asyncTicks(0),
+  magnetometer(false)
+{
 
-  boolean SCL_LOW = (digitalRead(SCL) == LOW); // Check is SCL is Low.
-  if (SCL_LOW) { //If it is held low Arduno cannot become the I2C master.
-    return 1; //I2C bus error. Could not clear SCL clock line held low
+  for (int i = 0; i < 3; i++) {
+    magScale[i] = Scalar(4912.0 / 32767.0);
   }
+  setConfig(config);
 
-  boolean SDA_LOW = (digitalRead(SDA) == LOW);  // vi. Check SDA input.
-  int clockCount = 20; // > 2x9 clock
-
-  while (SDA_LOW && (clockCount > 0)) { //  vii. If SDA is Low,
-    clockCount--;
-  // Note: I2C bus is open collector so do NOT drive SCL or SDA high.
-    pinMode(SCL, INPUT); // release SCL pullup so that when made output it will be LOW
-    pinMode(SCL, OUTPUT); // then clock SCL Low
-    delayMicroseconds(10); //  for >5uS
-    pinMode(SCL, INPUT); // release SCL LOW
-    pinMode(SCL, INPUT_PULLUP); // turn on pullup resistors again
-    // do not force high as slave may be holding it low for clock stretching.
-    delayMicroseconds(10); //  for >5uS
-    // The >5uS is so that even the slowest I2C devices are handled.
-    SCL_LOW = (digitalRead(SCL) == LOW); // Check if SCL is Low.
-    int counter = 20;
-    while (SCL_LOW && (counter > 0)) {  //  loop waiting for SCL to become High only wait 2sec.
-      counter--;
-      delay(100);
-      SCL_LOW = (digitalRead(SCL) == LOW);
-    }
-    if (SCL_LOW) { // still low after 2 sec error
-      return 2; // I2C bus error. Could not clear. SCL clock line held low by slave clock stretch for >2sec
-    }
-    SDA_LOW = (digitalRead(SDA) == LOW); //   and check SDA input again and loop
+}
+
+void Imu::setConfig(const ImuConfig& configIn) {
+
+  // a copy, configIn may be config
+  ImuConfig asked = configIn;
+  config = asked;
+
+  // FS_SEL, the largest supported range up to the one asked for
+  config.gyrFullScaleDps = 250;
+  while (config.gyrFullScaleDps < 2000 && 2 * config.gyrFullScaleDps <= asked.gyrFullScaleDps) {
+    config.gyrFullScaleDps *= 2;
+  }
+  config.accFullScaleG = 2;
+  while (config.accFullScaleG < 16 && 2 * config.accFullScaleG <= asked.accFullScaleG) {
+    config.accFullScaleG *= 2;
   }
-  if (SDA_LOW) { // still low
-    return 3; // I2C bus error. Could not clear. SDA data line held low
+
+  // all measurements are converted to 16 bits by the IMU-internal ADC
+  for (int i = 0; i < 3; i++) {
+    gyrScale[i] = Scalar(double(config.gyrFullScaleDps) / 32767.0);
+    accScale[i] = Scalar(9.80665 * config.accFullScaleG / 32767.0);
   }
 
-  // else pull SDA line low for Start or Repeated Start
-  pinMode(SDA, INPUT); // remove pullup.
-  pinMode(SDA, OUTPUT);  // and then make it LOW i.e. send an I2C Start or Repeated start control.
-  // When there is only one I2C master a Start or Repeat Start has the same function as a Stop and clears the bus.
-  /// A Repeat Start is a Start occurring after a Start with no intervening Stop.
-  delayMicroseconds(10); // wait >5uS
-  pinMode(SDA, INPUT); // remove output low
-  pinMode(SDA, INPUT_PULLUP); // and make SDA high i.e. send I2C STOP control.
-  delayMicroseconds(10); // x. wait >5uS
-  pinMode(SDA, INPUT); // and reset pins as tri-state inputs which is the default state on reset
-  pinMode(SCL, INPUT);
-  return 0; // all ok
+  samplePeriodMicros = config.samplePeriodMicros();
+  samplePeriodTicks = samplePeriodMicros * TickClock::ticksPerMicro;
+
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////////////////////////////////
-// initialize the connection to the IMU
+Imu::~Imu() {
+  if (bus != nullptr && bus->isReadBusy()) {
+    bus->abortRead();
+  }
+}
+
+void Imu::setSampleRateDivider(uint8_t divider) {
+
+  config.sampleRateDivider = divider;
+  samplePeriodMicros = config.samplePeriodMicros();
+  samplePeriodTicks = samplePeriodMicros * TickClock::ticksPerMicro;
+
+  bus->writeRegister(SMPLRT_DIV, divider);
+
+  // the FIFO frames of the old rate do not continue the sample clock
+  fifoTicksValid = false;
+
+}
 
 void Imu::init()
 {
 
-  // Clearing the bus is necessary due to a common I2C problem: when restarting the program several times
-  // in a row, soemtimes the slave (i.e., IMU) waits for a package by the master (Arduino) and keeps the
-  // SDA line low. There is no way for the master to release it other than clearing the bus this way.
-  int rtn = I2C_ClearBus(); // clear the I2C bus first before calling Wire.begin()
-  if (rtn != 0) {
-    Serial.println("WARNING: I2C problem, try unplugging your VRduino and plugging it back in!");
+  BootTimeline::start(BOOT_BUS);
+  if (bus == nullptr) {
+#if defined(IMU_SPI_CS_PIN)
+    // SPI if the imu answers there, it is 20-50x faster per sample
+    spiBus.begin();
+    if (spiBus.readRegister(WHO_AM_I_MPU9250) == MPU9250_KNOWN_VAL) {
+      bus = &spiBus;
+    }
+#endif
+    if (bus == nullptr) {
+      bus = &i2cBus;
+    }
   }
-  delay(250);
+  bus->begin();
+  BootTimeline::stop(BOOT_BUS);
+
+  BootTimeline::start(BOOT_IMU_CONFIG);
 
-  // initialize I2C contnection to IMU with Arduino being the master
-  Wire.begin();
-  Wire.setClock(400000L); // set clock rate to 400 kHz for faster data transfer
+  // the timebase of the sample stamps
+  TickClock::begin();
 
   /*
   // We can ping the IMU first thing and read out the WHO_AM_I_MPU9250 register. The returned value should
   // be 0x71. If it's not, there may be a connection problem
 
-  byte c = I2CreadByte(MPU9250_ADDRESS, WHO_AM_I_MPU9250);  // Read WHO_AM_I register for MPU-9250
+  byte c = bus->readRegister(WHO_AM_I_MPU9250);  // Read WHO_AM_I register for MPU-9250
   Serial.print("MPU9250 ");
   Serial.print("I AM ");
   Serial.print(c, HEX);
@@ -167,39 +205,149 @@ void Imu::init()
   }
   */
 
-  //choose LPF bandwidth (184 Hz) and sampling Freq (1 kHz) for gyro
-  this->I2CwriteByte(MPU9250_ADDRESS, CONFIG, 0x01);
+  // keep the imu off I2C while on SPI, the magnetometer starts off
+  magnetometer = false;
+  bus->writeRegister(USER_CTRL, userCtrlBits());
 
-  //choose LPF bandwidth (184 Hz) and sampling Freq (1 kHz) for acc
-  this->I2CwriteByte(MPU9250_ADDRESS, ACCEL_CONFIG2, 0x01);
+  // LPF bandwidth and sampling rate of the gyro, 184 Hz and 1 kHz by
+  // default, and the output rate divider of the 1 kHz ones
+  bus->writeRegister(CONFIG, config.gyrDlpf);
+  bus->writeRegister(SMPLRT_DIV, config.sampleRateDivider);
 
-  // Configure gyroscope range (use maximum range)
-  this->I2CwriteByte(MPU9250_ADDRESS, 27, GYRO_FULL_SCALE_2000_DPS);
+  // LPF bandwidth of the acc, 218 Hz by default
+  bus->writeRegister(ACCEL_CONFIG2, config.accDlpf);
 
-  // Configure accelerometers range (use maximum range)
-  this->I2CwriteByte(MPU9250_ADDRESS, 28, ACC_FULL_SCALE_16_G);
+  // ranges, FS_SEL in bits 4:3, 250 deg/s and 2 g times 2^FS_SEL, the
+  // maximum by default. FCHOICE_B stays 0, the DLPF setting applies
+  uint8_t gyrRange = GYRO_FULL_SCALE_250_DPS;
+  for (int dps = 250; dps < config.gyrFullScaleDps; dps *= 2) {
+    gyrRange += GYRO_FULL_SCALE_500_DPS;
+  }
+  uint8_t accRange = ACC_FULL_SCALE_2_G;
+  for (int g = 2; g < config.accFullScaleG; g *= 2) {
+    accRange += ACC_FULL_SCALE_4_G;
+  }
+  bus->writeRegister(GYRO_CONFIG, gyrRange);
+  bus->writeRegister(ACCEL_CONFIG, accRange);
 
-  // Set bypass mode for the magnetometer, so we can read values directly
-  this->I2CwriteByte(MPU9250_ADDRESS, 0x37, 0x02);
+  // Set bypass mode for the magnetometer, until enableMagnetometer()
+  bus->writeRegister(0x37, 0x02);
 
-  if(USE_MAGNETOMETER) {
+  // a sample taken at the ranges before is still flagged ready, e.g. at
+  // 250 deg/s after a reset. Reading INT_STATUS clears it, the next one
+  // is in the ranges above
+  bus->readRegister(INT_STATUS);
 
-    // read adjument value
-    uint8_t buf[3];
-    this->I2Cread(MAG_ADDRESS, 0x10, 3, buf);
+  BootTimeline::stop(BOOT_IMU_CONFIG);
 
-    this->_magnetometerAdjustmentScaleX = 0.5 * (double(buf[0]) - 128) / 128 + 1;
-    this->_magnetometerAdjustmentScaleY = 0.5 * (double(buf[1]) - 128) / 128 + 1;
-    this->_magnetometerAdjustmentScaleZ = 0.5 * (double(buf[2]) - 128) / 128 + 1;
+}
+
+/***
+ *  AK8963 behind the auxiliary I2C master, see Imu.h
+ */
+bool Imu::enableMagnetometer(bool enable) {
+
+  if (!enable) {
+    if (magnetometer) {
+      // stop mirroring, and power the AK8963 down
+      bus->writeRegister(I2C_SLV0_CTRL, 0x00);
+      writeMagRegister(AK8963_CNTL1, 0x00);
+    }
+    magnetometer = false;
+    bus->writeRegister(USER_CTRL, userCtrlBits());
+    bus->writeRegister(INT_PIN_CFG, 0x02);
+    return true;
+  }
 
-    // Request first magnetometer single 16 bit measurement
-    this->I2CwriteByte(MAG_ADDRESS, 0x0A, B00010001);
+  // the bypass and the master exclude each other. The master runs at
+  // 400 kHz, and data ready waits for its reads (WAIT_FOR_ES)
+  bus->writeRegister(INT_PIN_CFG, 0x00);
+  bus->writeRegister(I2C_MST_CTRL, 0x4D);
+  magnetometer = true;
+  bus->writeRegister(USER_CTRL, userCtrlBits());
+
+  // the sensitivity adjustment is in the fuse ROM, then continuous
+  // measurement mode 2, 100 Hz, in 16 bit
+  uint8_t whoAmI = 0;
+  uint8_t asa[3] = {128, 128, 128};
+  bool ok = readMagRegister(AK8963_WIA, whoAmI) && whoAmI == AK8963_KNOWN_VAL &&
+    writeMagRegister(AK8963_CNTL1, 0x00) &&
+    writeMagRegister(AK8963_CNTL1, 0x0F) &&
+    readMagRegister(AK8963_ASAX, asa[0]) &&
+    readMagRegister(AK8963_ASAX + 1, asa[1]) &&
+    readMagRegister(AK8963_ASAX + 2, asa[2]) &&
+    writeMagRegister(AK8963_CNTL1, 0x00) &&
+    writeMagRegister(AK8963_CNTL1, 0x16);
+
+  if (!ok) {
+    magnetometer = false;
+    bus->writeRegister(USER_CTRL, userCtrlBits());
+    bus->writeRegister(INT_PIN_CFG, 0x02);
+    return false;
+  }
 
-    //  uint8_t cntl_reg;
-    //  I2Cread(MAG_ADDRESS,0x0A,1,&cntl_reg);
-    //  Serial.println (cntl_reg, BIN);
+  // imu x is AK8963 y and imu y is AK8963 x, see decodeSample()
+  static const int akAxis[3] = {1, 0, 2};
+  for (int i = 0; i < 3; i++) {
+    double adjustment = (double(asa[akAxis[i]]) - 128) / 256 + 1;
+    magScale[i] = Scalar(4912.0 / 32767.0 * adjustment);
   }
 
+  // mirror ST1, HXL to HZH and ST2 into EXT_SENS_DATA_00 to 07
+  bus->writeRegister(I2C_SLV0_ADDR, 0x80 | MAG_ADDRESS);
+  bus->writeRegister(I2C_SLV0_REG, AK8963_ST1);
+  bus->writeRegister(I2C_SLV0_CTRL, 0x80 | 8);
+
+  return true;
+
+}
+
+bool Imu::readMagRegister(uint8_t reg, uint8_t& value) {
+
+  if (!transferMagRegister(0x80 | MAG_ADDRESS, reg)) {
+    return false;
+  }
+  value = bus->readRegister(I2C_SLV4_DI);
+  return true;
+
+}
+
+bool Imu::writeMagRegister(uint8_t reg, uint8_t value) {
+
+  bus->writeRegister(I2C_SLV4_DO, value);
+  return transferMagRegister(MAG_ADDRESS, reg);
+
+}
+
+bool Imu::transferMagRegister(uint8_t address, uint8_t reg) {
+
+  // reading I2C_MST_STATUS clears it, start from a clear one
+  bus->readRegister(I2C_MST_STATUS);
+  bus->writeRegister(I2C_SLV4_ADDR, address);
+  bus->writeRegister(I2C_SLV4_REG, reg);
+  bus->writeRegister(I2C_SLV4_CTRL, 0x80);
+
+  // the master runs once per sample period
+  uint32_t start = micros();
+  while (micros() - start < 10 * samplePeriodMicros) {
+    uint8_t status = bus->readRegister(I2C_MST_STATUS);
+    if (status & 0x10) {
+      // SLV4_NACK
+      return false;
+    }
+    if (status & 0x40) {
+      // SLV4_DONE
+      return true;
+    }
+    yield();
+  }
+  return false;
+
+}
+
+uint8_t Imu::userCtrlBits() const {
+  // I2C_MST_EN with the magnetometer
+  return bus->userCtrlBits() | (magnetometer ? 0x20 : 0x00);
 }
 
 /***
@@ -209,152 +357,308 @@ void Imu::init()
  */
 bool Imu::read() {
 
+  ImuSample sample;
+  if (!readRaw(sample)) {
+    return false;
+  }
+  setSample(sample);
+
+  return true;
+}
+
+/***
+ *  new sample in raw counts, see Imu.h
+ */
+bool Imu::readRaw(ImuSample& sample) {
+
+  if (statusBurst && !burstMissed) {
+
+    PROFILE_SCOPE(PROFILE_IMU_READ);
+
+    // INT_STATUS sits right before the data registers at 0x3B, read them
+    // in one go and only keep the data if it is new
+    uint64_t now = TickClock::now();
+    uint8_t Buf[23];
+    bus->readRegisters(INT_STATUS, Buf, 1 + sampleBytes());
+    readTicks += TickClock::now() - now;
+    if ((Buf[0] & 0x01) == 0) {
+      // polled before the sample, wait for it on INT_STATUS alone
+      burstMissed = true;
+      pollMissed = true;
+      return false;
+    }
+    sample.ticks = now;
+    decodeSample(&Buf[1], sample);
+    readSamples++;
+    pollMissed = false;
+    return true;
+
+  }
+
   // query this register to see if new values are available
-  uint8_t int_status = this->I2CreadByte(MPU9250_ADDRESS, INT_STATUS);
+  uint64_t start = TickClock::now();
+  uint8_t int_status = bus->readRegister(INT_STATUS);
+  readTicks += TickClock::now() - start;
   if ((int_status & 0x01) == false ) {
+    pollMissed = true;
     return false;
   }
 
-  // all measurements are converted to 16 bits by the IMU-internal ADC
-  double max16BitValue = 32767.0;
+  sample.ticks = TickClock::now();
+  readSample(sample);
 
-  uint8_t Buf[14];
+  // back to the burst once a sample waits for the first poll after the
+  // one before, i.e. the polls come at most at the output data rate
+  burstMissed = pollMissed;
+  pollMissed = false;
+  return true;
 
-  this->I2Cread(MPU9250_ADDRESS, 0x3B, 14, Buf);
+}
 
-  /////////////////////////////////////////////////////////////////////////////
-  // Read accelerometer
+/***
+ *  read the accelerometer and gyroscope data registers, 0x3B to 0x48, in one go,
+ *  and the magnetometer in EXT_SENS_DATA right after them
+ */
+void Imu::readSample(ImuSample& sample) {
 
-  /* 16 bit accelerometer data */
-  int16_t ax = Buf[0] << 8 | Buf[1];
-  int16_t ay = Buf[2] << 8 | Buf[3];
-  int16_t az = Buf[4] << 8 | Buf[5];
+  PROFILE_SCOPE(PROFILE_IMU_READ);
 
-  /* scale to get metric data in m/s^2 */
+  uint8_t Buf[22];
 
-  // float maxAccRange   = 2.0; // in g
-  double maxAccRange = 16.0;                             // max range (in g)
-                                                         // as set in setup()
-                                                         // function
-  double g2ms2    = 9.80665;
-  double accScale = g2ms2 * maxAccRange / max16BitValue; // convert 16 bit to
-                                                         // float
+  uint64_t start = TickClock::now();
+  bus->readRegisters(0x3B, Buf, sampleBytes());
+  readTicks += TickClock::now() - start;
+  readSamples++;
+  decodeSample(Buf, sample);
+
+}
 
-  /* convert 16 bit raw measurement to metric float */
-  //accX = - double(ax) * accScale;
-  //accY =   double(ay) * accScale;
-  //accZ = - double(az) * accScale;
+void Imu::decodeSample(const uint8_t *Buf, ImuSample& sample) const {
 
-  accX = double(ax) * accScale;
-  accY = double(ay) * accScale;
-  accZ = double(az) * accScale;
+  /* 16 bit accelerometer data */
+  sample.acc[0] = Buf[0] << 8 | Buf[1];
+  sample.acc[1] = Buf[2] << 8 | Buf[3];
+  sample.acc[2] = Buf[4] << 8 | Buf[5];
 
-  /////////////////////////////////////////////////////////////////////////////
-  // Read gyroscope
+  /* 16 bit die temperature, kept for the gyro bias model */
+  sample.temp = Buf[6] << 8 | Buf[7];
 
   /* 16 bit gyroscope raw data */
-  int16_t gx = Buf[8]  << 8 | Buf[9];
-  int16_t gy = Buf[10] << 8 | Buf[11];
-  int16_t gz = Buf[12] << 8 | Buf[13];
-
-  double maxGyrRange = 2000.0;                   // max range (in deg per sec)
-                                                 // as set in setup() function
-  double gyrScale = maxGyrRange / max16BitValue; // convert 16 bit to float
-
-  /* convert 16 bit raw measurement to metric float */
-  //gyrX = - double(gx) * gyrScale;
-  //gyrY =   double(gy) * gyrScale;
-  //gyrZ = - double(gz) * gyrScale;
-
-  gyrX = double(gx) * gyrScale;
-  gyrY = double(gy) * gyrScale;
-  gyrZ = double(gz) * gyrScale;
-
-  /////////////////////////////////////////////////////////////////////////////
-
-  if (USE_MAGNETOMETER) {
-
-    // Read magnetometer
-    uint8_t ST1;
-    I2Cread(MAG_ADDRESS, 0x02, 1, &ST1);
-
-    // new measurement available (otherwise just move on)
-    if (ST1 & 0x01) {
-      // Read magnetometer data
-      uint8_t m[6];
-      I2Cread(MAG_ADDRESS, 0x03, 6, m);
-
-       //  see datatsheet:
-       //  - byte order is reverse from other sensors
-       //  - x and y are flipped
-       //  - z axis is reverse
-      int16_t mmy =  m[1] << 8 | m[0];
-      int16_t mmx =  m[3] << 8 | m[2];
-      int16_t mmz =  -m[5] << 8 | m[4];
-
-      // convert 16 bit raw measurement to metric float
-      double magScale = 4912.0 / max16BitValue;
-      this->magX = double(mmx) * magScale * this->_magnetometerAdjustmentScaleX;
-      this->magY = double(mmy) * magScale * this->_magnetometerAdjustmentScaleY;
-      this->magZ = double(mmz) * magScale * this->_magnetometerAdjustmentScaleZ;
-
-      // request next reading on magnetometer
-      I2CwriteByte(MAG_ADDRESS, 0x0A, B00010001);
+  sample.gyr[0] = Buf[8]  << 8 | Buf[9];
+  sample.gyr[1] = Buf[10] << 8 | Buf[11];
+  sample.gyr[2] = Buf[12] << 8 | Buf[13];
+
+  if (!magnetometer) {
+    sample.mag[0] = sample.mag[1] = sample.mag[2] = 0;
+    sample.magReady = false;
+    return;
+  }
+
+  //  ST1, the field and ST2 of the AK8963, see the datasheet:
+  //  - byte order is reverse from other sensors
+  //  - x and y are flipped
+  //  - z axis is reverse
+  const uint8_t *m = &Buf[14];
+  int16_t mmx = m[2] << 8 | m[1];
+  int16_t mmy = m[4] << 8 | m[3];
+  int16_t mmz = m[6] << 8 | m[5];
+  sample.mag[0] = mmy;
+  sample.mag[1] = mmx;
+  sample.mag[2] = -mmz;
+
+  // DRDY in ST1 is only set in the first copy after a measurement, and
+  // HOFL in ST2 marks an overflowed one
+  sample.magReady = (m[0] & 0x01) != 0 && (m[7] & 0x08) == 0;
+
+}
+
+/***
+ *  convert raw counts into metric units
+ */
+void Imu::setSample(const ImuSample& sample) {
+
+  // the scales fold the full scale ranges set in init() and the unit
+  // conversion, see the constructor
+  for (int i = 0; i < 3; i++) {
+    accRaw[i] = sample.acc[i];
+    gyrRaw[i] = sample.gyr[i];
+  }
+  tempRaw = sample.temp;
+  temperature = Scalar(tempCelsius(tempRaw));
+
+  /* convert 16 bit raw measurement to metric float, m/s^2 and deg/s */
+  accX = Scalar(accRaw[0]) * accScale[0];
+  accY = Scalar(accRaw[1]) * accScale[1];
+  accZ = Scalar(accRaw[2]) * accScale[2];
+
+  gyrX = Scalar(gyrRaw[0]) * gyrScale[0];
+  gyrY = Scalar(gyrRaw[1]) * gyrScale[1];
+  gyrZ = Scalar(gyrRaw[2]) * gyrScale[2];
+
+  /* uT, with the sensitivity adjustment */
+  if (sample.magReady) {
+    for (int i = 0; i < 3; i++) {
+      magRaw[i] = sample.mag[i];
     }
+    magX = Scalar(magRaw[0]) * magScale[0];
+    magY = Scalar(magRaw[1]) * magScale[1];
+    magZ = Scalar(magRaw[2]) * magScale[2];
   }
 
-  return true;
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////
-// general I2C communication routine
+/***
+ *  data ready interrupt on the INT pin, see Imu.h
+ */
+void Imu::enableDataReadyInterrupt(bool enable) {
+
+  // keep the magnetometer bypass unless the master reads it, and clear
+  // the status on any read (INT_ANYRD_2CLEAR). The pin is active high,
+  // push-pull, with a 50 us pulse per sample
+  uint8_t bypass = magnetometer ? 0x00 : 0x02;
+  bus->writeRegister(INT_PIN_CFG, enable ? (0x10 | bypass) : bypass);
+
+  // RAW_RDY_EN
+  bus->writeRegister(INT_ENABLE, enable ? 0x01 : 0x00);
 
-uint8_t Imu::I2CreadByte(uint8_t address, uint8_t readRegister)
-{
-  uint8_t data;                          // `data` will store the register data
-
-  Wire.beginTransmission(address);       // Initialize the Tx buffer
-  Wire.write(readRegister);              // Put slave register address in Tx buffer
-  Wire.endTransmission(false);           // Send the Tx buffer, but send a restart to keep connection alive
-  Wire.requestFrom(address, (uint8_t)1);  // Read one byte from slave register
-  data = Wire.read();                     // Fill Rx buffer with result
-  return data;                            // Return data read from slave register
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////
-// general I2C communication routine
+/***
+ *  FIFO of acc and gyro frames, see Imu.h
+ */
+void Imu::enableFifo(bool enable) {
+
+  // stop writing, then clear
+  bus->writeRegister(FIFO_EN, 0x00);
+  bus->writeRegister(USER_CTRL, userCtrlBits());
+  resetFifo();
+  fifoOverflows = 0;
+
+  if (enable) {
+    // FIFO_EN for the gyro x, y, z and the acc, no temperature, so a
+    // frame is the 12 bytes acc x, y, z, gyro x, y, z
+    bus->writeRegister(USER_CTRL, 0x40 | userCtrlBits());
+    bus->writeRegister(FIFO_EN, 0x78);
+  }
 
-/* Write a byte (Data) in device (Address) at register (Register) */
-void Imu::I2CwriteByte(uint8_t Address, uint8_t Register, uint8_t Data)
-{
-  // Set register address
-  Wire.beginTransmission(Address);
-  Wire.write(Register);
-  Wire.write(Data);
-  Wire.endTransmission();
+}
+
+void Imu::resetFifo() {
+
+  // FIFO_RST clears itself, FIFO_EN stays as it was
+  uint8_t userCtrl = bus->readRegister(USER_CTRL);
+  bus->writeRegister(USER_CTRL, userCtrl | 0x04);
+  fifoTicksValid = false;
 
-//  delay(70);
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////
-// general I2C communication routine
+int Imu::readFifo(ImuSample *samples, int maxSamples) {
+
+  PROFILE_SCOPE(PROFILE_IMU_READ);
+
+  // the newest frame counted arrived less than a period before the
+  // count read started, and before it ended
+  uint64_t before = TickClock::now();
+  uint8_t countBuf[2];
+  bus->readRegisters(FIFO_COUNTH, countBuf, 2);
+  int count = (countBuf[0] & 0x1F) << 8 | countBuf[1];
+  uint64_t after = TickClock::now();
+
+  if (count >= fifoBytes || count % fifoFrameBytes != 0) {
+    // full, the oldest frames are overwritten mid-frame
+    resetFifo();
+    fifoOverflows++;
+    readTicks += TickClock::now() - before;
+    return 0;
+  }
+
+  int available = count / fifoFrameBytes;
+  int n = (available < maxSamples) ? available : maxSamples;
+  if (n == 0) {
+    readTicks += after - before;
+    return 0;
+  }
+
+  // FIFO_R_W does not increment, the whole burst pops the FIFO
+  uint8_t Buf[fifoMaxFrames * fifoFrameBytes];
+  bus->readRegisters(FIFO_R_W, Buf, n * fifoFrameBytes);
+
+  // the frames are without temperature, it changes over seconds: one
+  // more read of TEMP_OUT every 100 ms
+  if (!fifoTempValid || before - fifoTempTicks >= 100 * 1000 * TickClock::ticksPerMicro) {
+    uint8_t tempBuf[2];
+    bus->readRegisters(TEMP_OUT_H, tempBuf, 2);
+    fifoTemp = tempBuf[0] << 8 | tempBuf[1];
+    fifoTempTicks = before;
+    fifoTempValid = true;
+  }
+
+  for (int f = 0; f < n; f++) {
+    const uint8_t *b = &Buf[f * fifoFrameBytes];
+    ImuSample& sample = samples[f];
+    sample.acc[0] = b[0] << 8 | b[1];
+    sample.acc[1] = b[2] << 8 | b[3];
+    sample.acc[2] = b[4] << 8 | b[5];
+    sample.gyr[0] = b[6] << 8 | b[7];
+    sample.gyr[1] = b[8] << 8 | b[9];
+    sample.gyr[2] = b[10] << 8 | b[11];
+    sample.temp = fifoTemp;
+    sample.mag[0] = sample.mag[1] = sample.mag[2] = 0;
+    sample.magReady = false;
+  }
+
+  // time of the newest frame counted, continuing the sample clock of the
+  // previous batch. Both it and a new anchor at 'before' are only known to
+  // within a period and the count read, so re-anchor only beyond that,
+  // e.g. after a reset or when the imu clock drifted
+  uint64_t newestCounted = before;
+  if (fifoTicksValid) {
+    uint64_t predicted = fifoTicks + uint32_t(available) * samplePeriodTicks;
+    int64_t offset = int64_t(predicted - before);
+    int64_t window = int64_t(samplePeriodTicks + (after - before));
+    if (offset > -window && offset < window) {
+      newestCounted = predicted;
+    }
+  }
+  uint64_t newest = newestCounted - uint32_t(available - n) * samplePeriodTicks;
+  for (int i = 0; i < n; i++) {
+    samples[i].ticks = newest - uint32_t(n - 1 - i) * samplePeriodTicks;
+  }
+  fifoTicks = newest;
+  fifoTicksValid = true;
+
+  readTicks += TickClock::now() - before;
+  readSamples += n;
+
+  return n;
+
+}
 
 /***
- * This function reads Nbytes bytes from I2C device at address Address.
- * Put read bytes starting at register Register in the Data array.
+ *  background read of INT_STATUS and the data registers, see Imu.h
  */
-void Imu::I2Cread(uint8_t Address, uint8_t Register, uint8_t Nbytes,
-                  uint8_t *Data)
-{
-  // Set register address
-  Wire.beginTransmission(Address);
-  Wire.write(Register);
-  Wire.endTransmission();
+bool Imu::startReadAsync(I2cAsync::Callback callback) {
+
+  if (bus->isReadBusy()) {
+    return false;
+  }
+  asyncTicks = TickClock::now();
+  // INT_STATUS is right before the data registers at 0x3B
+  return bus->startReadRegisters(INT_STATUS, asyncBuf, 1 + sampleBytes(), callback);
 
-  // Read Nbytes
-  Wire.requestFrom(Address, Nbytes);
-  uint8_t index = 0;
+}
+
+bool Imu::finishReadAsync(ImuSample& sample) {
+
+  if (bus->isReadBusy() || !bus->readSucceeded() || (asyncBuf[0] & 0x01) == 0) {
+    return false;
+  }
+
+  sample.ticks = asyncTicks;
+  decodeSample(&asyncBuf[1], sample);
+
+  // taken once
+  asyncBuf[0] = 0;
+  return true;
 
-  while (Wire.available())
-    Data[index++] = Wire.read();
 }
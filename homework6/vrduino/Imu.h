@@ -14,44 +14,339 @@
 /* for I2C and serial communication */
 #include <Wire.h>
 
+#include "ImuBus.h"
+#include "Scalar.h"
+#include "TickClock.h"
+
+/**
+ * gyro and temperature low pass, DLPF_CFG, by bandwidth. The 250 Hz and
+ * 3600 Hz ones sample at 8 kHz, the last nearly without a filter, the
+ * others at 1 kHz
+ */
+enum ImuGyrDlpf {
+  IMU_GYR_DLPF_250HZ_8KHZ,
+  IMU_GYR_DLPF_184HZ,
+  IMU_GYR_DLPF_92HZ,
+  IMU_GYR_DLPF_41HZ,
+  IMU_GYR_DLPF_20HZ,
+  IMU_GYR_DLPF_10HZ,
+  IMU_GYR_DLPF_5HZ,
+  IMU_GYR_DLPF_3600HZ_8KHZ
+};
+
+/* acc low pass, A_DLPF_CFG, by bandwidth, at 1 kHz */
+enum ImuAccDlpf {
+  IMU_ACC_DLPF_218HZ = 1,
+  IMU_ACC_DLPF_99HZ,
+  IMU_ACC_DLPF_45HZ,
+  IMU_ACC_DLPF_21HZ,
+  IMU_ACC_DLPF_10HZ,
+  IMU_ACC_DLPF_5HZ,
+  IMU_ACC_DLPF_420HZ
+};
+
+/**
+ * output data rate, low pass filters and full scale ranges of the imu,
+ * see Imu::setConfig(). The default is what init() always set: 1 kHz,
+ * 184 Hz gyro and 218 Hz acc bandwidth, 2000 deg/s and 16 g.
+ * - the output rate is 1 kHz / (1 + sampleRateDivider), or 8 kHz with the
+ *   8 kHz gyro filters, the divider does not apply there. The acc stays
+ *   at 1 kHz, each of its samples repeats 8 times. At 8 kHz a sample
+ *   read takes longer over I2C than a period: read it over SPI, with the
+ *   FIFO or the interrupt capture, and keep the magnetometer off, the
+ *   auxiliary I2C master runs once per sample
+ * - a lower range resolves finer, 250 deg/s to 0.0076 deg/s per count,
+ *   but clips a fast turn of the head, which reaches 1000 deg/s
+ */
+struct ImuConfig {
+  ImuGyrDlpf gyrDlpf = IMU_GYR_DLPF_184HZ;
+  ImuAccDlpf accDlpf = IMU_ACC_DLPF_218HZ;
+  uint8_t sampleRateDivider = 0;
+
+  /* 250, 500, 1000 or 2000, and 2, 4, 8 or 16 */
+  uint16_t gyrFullScaleDps = 2000;
+  uint8_t accFullScaleG = 16;
+
+  /* us between samples */
+  uint32_t samplePeriodMicros() const {
+    bool fast = gyrDlpf == IMU_GYR_DLPF_250HZ_8KHZ || gyrDlpf == IMU_GYR_DLPF_3600HZ_8KHZ;
+    return fast ? 125 : 1000 * (1 + uint32_t(sampleRateDivider));
+  }
+};
+
+/**
+ * one gyro and acc reading in raw 16 bit counts, order x, y, z, with the
+ * TickClock time it was taken, and the die temperature, see
+ * Imu::tempCelsius(). With the magnetometer on, also its latest counts
+ * along the imu axes, and whether they are a new measurement
+ */
+struct ImuSample {
+  uint64_t ticks;
+  int16_t acc[3];
+  int16_t gyr[3];
+  int16_t temp;
+  int16_t mag[3];
+  bool magReady;
+};
+
 class Imu {
 public:
 
-  double gyrX, gyrY, gyrZ;
-  double accX, accY, accZ;
-  double magX, magY, magZ;
+  Scalar gyrX, gyrY, gyrZ;
+  Scalar accX, accY, accZ;
+  Scalar magX, magY, magZ;
+
+  /* die temperature of the last read(), degrees C */
+  Scalar temperature;
+
+  /* raw 16 bit counts of the last read(), order x, y, z */
+  int16_t gyrRaw[3];
+  int16_t accRaw[3];
+  int16_t magRaw[3];
+  int16_t tempRaw;
+
+  /**
+   * deg/s and m/s^2 per count, the full scale range and unit conversion
+   * folded into one factor per axis, so a per-axis scale calibration can
+   * go in. Set from the full scale ranges of setConfig()
+   */
+  Scalar gyrScale[3];
+  Scalar accScale[3];
+
+  /**
+   * uT per magnetometer count, with the factory sensitivity adjustment
+   * of the AK8963 read by enableMagnetometer()
+   */
+  Scalar magScale[3];
+
+  /* degrees C of a TEMP_OUT count, 333.87 counts per degree from 21 */
+  static double tempCelsius(double count) { return count / 333.87 + 21.0; }
+
+  /* sampling period of setConfig(), 1 ms by default */
+  uint32_t samplePeriodMicros;
+  uint32_t samplePeriodTicks;
+
+  /* FIFO size and frame of acc and gyro counts, see readFifo() */
+  static const int fifoBytes = 512;
+  static const int fifoFrameBytes = 12;
+  static const int fifoMaxFrames = fifoBytes / fifoFrameBytes;
+
+  /* FIFO overflows since enableFifo(), each loses an unknown number of samples */
+  uint32_t fifoOverflows;
+
+  /**
+   * samples read by readRaw(), readSample() and readFifo(), and the
+   * TickClock ticks all their bus transfers took, the polls that found no
+   * sample included, to tell the bus time. Not the background reads, they
+   * do not hold the cpu
+   */
+  uint32_t readSamples;
+  uint64_t readTicks;
+
+  Imu();
+
+  /* ends a background read still running into this imu */
+  ~Imu();
+
+  /**
+   * sets the link to the imu, call before init(). By default init() takes
+   * SPI if IMU_SPI_CS_PIN is defined and the imu answers there, else I2C,
+   * see ImuBus.h
+   */
+  void setBus(ImuBus *busIn) { bus = busIn; }
+
+  /* link to the imu, nullptr before init() */
+  ImuBus *getBus() const { return bus; }
+
+  /**
+   * sets the output data rate, the low pass filters and the full scale
+   * ranges init() configures, call before it. Sets the scales and the
+   * sample period. A range between the supported ones is rounded down
+   */
+  void setConfig(const ImuConfig& configIn);
+
+  /* the configuration of setConfig(), with the ranges as supported */
+  const ImuConfig& getConfig() const { return config; }
+
+  /**
+   * changes the output rate divider of the running imu with one register
+   * write, e.g. to sample slower while it is still, and the sample
+   * period. No effect on the rate of the 8 kHz modes. While the
+   * ImuCapture ISR reads the imu, mask it around the call, see
+   * ImuCapture::mask(). Must not run during a background read. The
+   * frames still in the FIFO are stamped at the new period
+   */
+  void setSampleRateDivider(uint8_t divider);
 
   /* initialize imu */
+  /* also starts the TickClock the samples are stamped with */
   void init();
 
   // read imu data
   //  returns true if data is different from last time read() was called and false otherwise
   bool read();
 
+  /**
+   * reads a new sample in raw counts, without converting it, stamped with
+   * TickClock::now() when the imu reported it ready. With the status burst on, the
+   * default, INT_STATUS and the data registers come in one 15 byte read,
+   * 23 with the magnetometer, else INT_STATUS is read alone first and
+   * the data only if it is set
+   * @returns false if there is no new sample
+   */
+  bool readRaw(ImuSample& sample);
+
+  /**
+   * selects how read() and readRaw() poll. The burst takes one
+   * transaction per poll instead of two per sample, but also moves the 14
+   * data bytes when there is no new sample. So it adapts: after a burst
+   * found no sample, the polls read INT_STATUS alone, and the data once
+   * it is set, until a sample is ready already at the first poll after
+   * the one before. Polled at most at the output data rate, as loop()
+   * does, every poll is a burst, in a tight loop every empty poll is 1
+   * byte
+   */
+  void setStatusBurst(bool enable) {
+    statusBurst = enable;
+    burstMissed = false;
+  }
+
+  /**
+   * reads the latest gyro and acc counts in one burst, without checking
+   * for new data, with the magnetometer counts if it is on. Leaves
+   * sample.ticks as is
+   */
+  void readSample(ImuSample& sample);
+
+  /* converts the counts of a sample into gyrX/Y/Z, accX/Y/Z with gyrScale
+   * and accScale, and copies them to the raw arrays. magX/Y/Z only change
+   * with a new magnetometer measurement */
+  void setSample(const ImuSample& sample);
+
+  /**
+   * turns the AK8963 magnetometer on or off, call after init() and
+   * before the interrupt or the FIFO are enabled. The auxiliary I2C
+   * master of the MPU9250 reads ST1, the field and ST2 from the AK8963
+   * at 100 Hz in 16 bit into EXT_SENS_DATA, right after the gyro and acc
+   * registers, so every read of a sample takes the magnetometer in the
+   * same burst: 8 more bytes, no more transactions, and on SPI as well.
+   * The FIFO frames stay without it.
+   * The AK8963 is set up through SLV4, one register per sample period.
+   * Turns the I2C bypass off, the AK8963 is no longer on the bus of
+   * the Teensy
+   * @returns false if the AK8963 does not answer, it is then left off
+   */
+  bool enableMagnetometer(bool enable);
+
+  /* @returns true if enableMagnetometer() turned it on */
+  bool hasMagnetometer() const { return magnetometer; }
+
+  /**
+   * enables or disables the data ready interrupt. When enabled, the INT pin
+   * pulses high for each new sample, and reading the data clears the
+   * status, so a burst read is all the ISR needs to do
+   */
+  void enableDataReadyInterrupt(bool enable);
+
+  /**
+   * enables or disables the FIFO. When enabled, the imu appends every
+   * sample, acc then gyro counts, to its 512 byte FIFO, and readFifo()
+   * collects them. Do not mix with read() or the data ready interrupt
+   */
+  void enableFifo(bool enable);
+
+  /**
+   * reads all complete frames in the FIFO, up to maxSamples, oldest
+   * first: the FIFO count, then the frames in one burst, in as many
+   * transactions as the bus needs. The FIFO holds no times, so the sample times
+   * are reconstructed from samplePeriodTicks, continuing from the
+   * previous batch and re-anchored to TickClock::now() when they fall behind or
+   * run ahead by more than a period.
+   * If the FIFO overflowed, it is reset, fifoOverflows is counted, and
+   * nothing is returned, as the frames are no longer aligned.
+   * @param [out] samples - at least maxSamples samples
+   * @param [in] maxSamples - capacity of samples
+   * @returns number of samples read
+   */
+  int readFifo(ImuSample *samples, int maxSamples);
+
+  /**
+   * starts reading INT_STATUS and the acc and gyro counts in one 15 byte
+   * burst, 23 with the magnetometer, in the background on I2C with
+   * I2cAsync, right away on a bus without background reads, and stamps
+   * the sample with TickClock::now(). Do not use other reads, or Wire, until it
+   * has ended
+   * @param [in] callback - called at the end, from the I2C ISR, may be nullptr
+   * @returns false if a read is still running
+   */
+  bool startReadAsync(I2cAsync::Callback callback = nullptr);
+
+  /** @returns true while the read started by startReadAsync() runs */
+  bool isReadAsyncBusy() const { return bus != nullptr && bus->isReadBusy(); }
+
+  /**
+   * takes the result of the ended startReadAsync()
+   * @param [out] sample - counts and ticks at the start of the read
+   * @returns true if the read succeeded and the sample is new, as told by
+   *   the data ready bit of INT_STATUS
+   */
+  bool finishReadAsync(ImuSample& sample);
+
 private:
 
   void initMPU9250(void);
 
-  void I2Cread(
-    uint8_t  Address,
-    uint8_t  Register,
-    uint8_t  Nbytes,
-    uint8_t *Data);
+  /**
+   * one AK8963 register over SLV4, waiting for SLV4_DONE
+   * @returns false if the transfer did not end within 10 sample periods,
+   *   or was not acknowledged
+   */
+  bool readMagRegister(uint8_t reg, uint8_t& value);
+  bool writeMagRegister(uint8_t reg, uint8_t value);
+  bool transferMagRegister(uint8_t address, uint8_t reg);
+
+  /* USER_CTRL bits to keep set: those of the bus and I2C_MST_EN */
+  uint8_t userCtrlBits() const;
+
+  /* data bytes from 0x3B: gyro and acc, and EXT_SENS_DATA if mag is on */
+  int sampleBytes() const { return magnetometer ? 22 : 14; }
+
+  /* counts from the sampleBytes() data bytes at 0x3B */
+  void decodeSample(const uint8_t *data, ImuSample& sample) const;
+
+  /* clears the FIFO, and the sample time of the last frame */
+  void resetFifo();
+
+  /* time of the newest frame read by readFifo(), valid after the first */
+  uint64_t fifoTicks;
+  bool fifoTicksValid;
+
+  /* TEMP_OUT for the FIFO frames, and when it was read, see readFifo() */
+  int16_t fifoTemp;
+  uint64_t fifoTempTicks;
+  bool fifoTempValid;
+
+  /* link to the imu */
+  ImuBus *bus;
 
+  /* output data rate, filters and ranges, see setConfig() */
+  ImuConfig config;
 
-  void I2CwriteByte(
-    uint8_t Address,
-    uint8_t Register,
-    uint8_t Data);
+  /**
+   * INT_STATUS and data in one read, see setStatusBurst(), polling
+   * INT_STATUS alone since a burst found no sample, and a poll found no
+   * sample since the last one
+   */
+  bool statusBurst;
+  bool burstMissed;
+  bool pollMissed;
 
-  uint8_t I2CreadByte(
-    uint8_t address,
-    uint8_t readRegister);
+  /* INT_STATUS and data bytes of startReadAsync() */
+  uint8_t asyncBuf[23];
+  uint64_t asyncTicks;
 
-  /* adjustment value for magnetometer */
-  double _magnetometerAdjustmentScaleX,
-         _magnetometerAdjustmentScaleY,
-         _magnetometerAdjustmentScaleZ;
+  /* AK8963 mirrored into EXT_SENS_DATA, see enableMagnetometer() */
+  bool magnetometer;
 
 };
 
@@ -0,0 +1,230 @@
+#include "ImuBus.h"
+#include "BootTimeline.h"
+
+/* for I2C and SPI communication */
+#include <SPI.h>
+#include <Wire.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// this is a utility function to help clear the I2C bus so as to avoid it getting stuck
+
+/**
+ * This routine turns off the I2C bus and clears it
+ * on return SCA and SCL pins are tri-state inputs.
+ * You need to call Wire.begin() after this to re-enable I2C
+ * This routine does NOT use the Wire library at all.
+ *
+ * returns 0 if bus cleared
+ *         1 if SCL held low.
+ *         2 if SDA held low by slave clock stretch for > 2sec
+ *         3 if SDA held low after 20 clocks.
+ */
+int I2C_ClearBus() {
+#if defined(TWCR) && defined(TWEN)
+  TWCR &= ~(_BV(TWEN)); //Disable the Atmel 2-Wire interface so we can control the SDA and SCL pins directly
+#endif
+
+  pinMode(SDA, INPUT_PULLUP); // Make SDA (data) and SCL (clock) pins Inputs with pullup.
+  pinMode(SCL, INPUT_PULLUP);
+
+  // The 2.5 s wait here was for the power up of a DS3231 module, not on
+  // this board. The imu had its 100 ms to start in ImuBusI2c::probe()
+  delayMicroseconds(10);
+
+  boolean SCL_LOW = (digitalRead(SCL) == LOW); // Check is SCL is Low.
+  if (SCL_LOW) { //If it is held low Arduno cannot become the I2C master.
+    return 1; //I2C bus error. Could not clear SCL clock line held low
+  }
+
+  boolean SDA_LOW = (digitalRead(SDA) == LOW);  // vi. Check SDA input.
+  int clockCount = 20; // > 2x9 clock
+
+  while (SDA_LOW && (clockCount > 0)) { //  vii. If SDA is Low,
+    clockCount--;
+  // Note: I2C bus is open collector so do NOT drive SCL or SDA high.
+    pinMode(SCL, INPUT); // release SCL pullup so that when made output it will be LOW
+    pinMode(SCL, OUTPUT); // then clock SCL Low
+    delayMicroseconds(10); //  for >5uS
+    pinMode(SCL, INPUT); // release SCL LOW
+    pinMode(SCL, INPUT_PULLUP); // turn on pullup resistors again
+    // do not force high as slave may be holding it low for clock stretching.
+    delayMicroseconds(10); //  for >5uS
+    // The >5uS is so that even the slowest I2C devices are handled.
+    SCL_LOW = (digitalRead(SCL) == LOW); // Check if SCL is Low.
+    int counter = 20;
+    while (SCL_LOW && (counter > 0)) {  //  loop waiting for SCL to become High only wait 2sec.
+      counter--;
+      delay(100);
+      SCL_LOW = (digitalRead(SCL) == LOW);
+    }
+    if (SCL_LOW) { // still low after 2 sec error
+      return 2; // I2C bus error. Could not clear. SCL clock line held low by slave clock stretch for >2sec
+    }
+    SDA_LOW = (digitalRead(SDA) == LOW); //   and check SDA input again and loop
+  }
+  if (SDA_LOW) { // still low
+    return 3; // I2C bus error. Could not clear. SDA data line held low
+  }
+
+  // else pull SDA line low for Start or Repeated Start
+  pinMode(SDA, INPUT); // remove pullup.
+  pinMode(SDA, OUTPUT);  // and then make it LOW i.e. send an I2C Start or Repeated start control.
+  // When there is only one I2C master a Start or Repeat Start has the same function as a Stop and clears the bus.
+  /// A Repeat Start is a Start occurring after a Start with no intervening Stop.
+  delayMicroseconds(10); // wait >5uS
+  pinMode(SDA, INPUT); // remove output low
+  pinMode(SDA, INPUT_PULLUP); // and make SDA high i.e. send I2C STOP control.
+  delayMicroseconds(10); // x. wait >5uS
+  pinMode(SDA, INPUT); // and reset pins as tri-state inputs which is the default state on reset
+  pinMode(SCL, INPUT);
+  return 0; // all ok
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// base
+
+bool ImuBus::startReadRegisters(uint8_t reg, uint8_t *data, int n,
+  I2cAsync::Callback callback) {
+
+  readRegisters(reg, data, n);
+  if (callback != nullptr) {
+    callback(true);
+  }
+  return true;
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// I2C
+
+void ImuBusI2c::begin() {
+
+  // both lines idle high and the imu answers: nothing to clear, and the
+  // boot does not wait for it
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+  delayMicroseconds(10);
+  bool idle = digitalRead(SDA) == HIGH && digitalRead(SCL) == HIGH;
+
+  // initialize I2C contnection to IMU with Arduino being the master
+  Wire.begin();
+  Wire.setClock(400000L); // set clock rate to 400 kHz for faster data transfer
+
+  recovered = !idle || !probe();
+  if (!recovered) {
+    return;
+  }
+
+  // Clearing the bus is necessary due to a common I2C problem: when restarting the program several times
+  // in a row, soemtimes the slave (i.e., IMU) waits for a package by the master (Arduino) and keeps the
+  // SDA line low. There is no way for the master to release it other than clearing the bus this way.
+  BootTimeline::start(BOOT_BUS_RECOVERY);
+  int rtn = I2C_ClearBus();
+  Wire.begin();
+  Wire.setClock(400000L);
+  if (rtn != 0 || !probe()) {
+    Serial.println("WARNING: I2C problem, try unplugging your VRduino and plugging it back in!");
+  }
+  BootTimeline::stop(BOOT_BUS_RECOVERY);
+
+}
+
+bool ImuBusI2c::probe() {
+
+  // the imu takes up to 100 ms from power up to answer
+  uint32_t start = millis();
+  do {
+    Wire.beginTransmission(address);
+    Wire.write(0x75); // WHO_AM_I
+    if (Wire.endTransmission() == 0 && Wire.requestFrom(address, (uint8_t)1) == 1) {
+      Wire.read();
+      return true;
+    }
+    delay(1);
+  } while (millis() - start <= 100);
+  return false;
+
+}
+
+void ImuBusI2c::readRegisters(uint8_t reg, uint8_t *data, int n) {
+
+  // Set register address
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.endTransmission();
+
+  // plain reads continue at the register pointer of the imu
+  const int bufferLength = 32;
+  for (int first = 0; first < n; first += bufferLength) {
+    int count = (n - first < bufferLength) ? n - first : bufferLength;
+    Wire.requestFrom(address, (uint8_t)count);
+    for (int i = 0; i < count; i++) {
+      data[first + i] = Wire.read();
+    }
+  }
+
+}
+
+void ImuBusI2c::writeRegister(uint8_t reg, uint8_t value) {
+
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  Wire.write(value);
+  Wire.endTransmission();
+
+}
+
+bool ImuBusI2c::startReadRegisters(uint8_t reg, uint8_t *data, int n,
+  I2cAsync::Callback callback) {
+
+  return async.startRead(address, reg, data, n, callback);
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SPI
+
+/* the MPU9250 reads its sensor, interrupt and FIFO registers at up to
+ * 20 MHz, everything else at up to 1 MHz. Mode 3, MSB first */
+static const SPISettings spiFast(20000000, MSBFIRST, SPI_MODE3);
+static const SPISettings spiSlow(1000000, MSBFIRST, SPI_MODE3);
+
+/* INT_STATUS to EXT_SENS_DATA_23, and FIFO_COUNTH to FIFO_R_W */
+static bool isFastRegister(uint8_t reg) {
+  return (reg >= 0x3A && reg <= 0x60) || (reg >= 0x72 && reg <= 0x74);
+}
+
+void ImuBusSpi::begin() {
+
+  pinMode(csPin, OUTPUT);
+  digitalWrite(csPin, HIGH);
+  SPI.begin();
+
+}
+
+void ImuBusSpi::readRegisters(uint8_t reg, uint8_t *data, int n) {
+
+  SPI.beginTransaction(isFastRegister(reg) ? spiFast : spiSlow);
+  digitalWrite(csPin, LOW);
+  SPI.transfer(reg | 0x80);
+  memset(data, 0, n);
+  SPI.transfer(data, n);
+  digitalWrite(csPin, HIGH);
+  SPI.endTransaction();
+
+}
+
+void ImuBusSpi::writeRegister(uint8_t reg, uint8_t value) {
+
+  SPI.beginTransaction(spiSlow);
+  digitalWrite(csPin, LOW);
+  SPI.transfer(reg & 0x7F);
+  SPI.transfer(value);
+  digitalWrite(csPin, HIGH);
+  SPI.endTransaction();
+
+}
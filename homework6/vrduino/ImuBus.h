@@ -0,0 +1,143 @@
+/**
+ * @class ImuBus
+ * Register access to the MPU9250, independent of the link.
+ *
+ * Imu only reads and writes registers, through an ImuBus:
+ * - ImuBusI2c, Wire at 400 kHz, how the VRduino board wires the imu.
+ *   ~0.4 ms for the 14 data bytes
+ * - ImuBusSpi, SPI at 1 MHz for the configuration registers and 20 MHz
+ *   for the sensor, interrupt and FIFO registers, if the imu is wired to
+ *   the SPI pins with its nCS at a Teensy pin. ~7 us for the 14 data
+ *   bytes. The AK8963 magnetometer is read by the auxiliary I2C master
+ *   of the MPU9250 on either link, see Imu::enableMagnetometer()
+ *
+ * and on the host also straight on a register model, see
+ * host/HostImuBus.h. Imu::init() takes the fastest link that answers, see
+ * IMU_SPI_CS_PIN.
+ *
+ * readRegisters() of any length continues at the register pointer of the
+ * imu, so reads of FIFO_R_W, which does not increment, pop the FIFO.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "I2cAsync.h"
+
+/**
+ * Teensy pin wired to the MPU9250 nCS. Define it, e.g. as 10 for the
+ * default SPI pins, to try SPI first. The VRduino board wires the imu for
+ * I2C only
+ */
+// #define IMU_SPI_CS_PIN 10
+
+class ImuBus {
+
+  public:
+
+    virtual ~ImuBus() {}
+
+    /** sets the link up, once, before any register access */
+    virtual void begin() = 0;
+
+    /** reads n registers, incrementing from reg */
+    virtual void readRegisters(uint8_t reg, uint8_t *data, int n) = 0;
+
+    virtual void writeRegister(uint8_t reg, uint8_t value) = 0;
+
+    uint8_t readRegister(uint8_t reg) {
+      uint8_t value = 0;
+      readRegisters(reg, &value, 1);
+      return value;
+    }
+
+    /**
+     * starts reading n registers in the background, see I2cAsync. Links
+     * without one read right away, and call back before returning
+     * @returns false if a read is still running
+     */
+    virtual bool startReadRegisters(uint8_t reg, uint8_t *data, int n,
+      I2cAsync::Callback callback);
+
+    /** @returns true while the read started by startReadRegisters() runs */
+    virtual bool isReadBusy() const { return false; }
+
+    /** ends the read started by startReadRegisters(), without calling back */
+    virtual void abortRead() {}
+
+    /** @returns true if the read started by startReadRegisters() succeeded */
+    virtual bool readSucceeded() const { return true; }
+
+    /**
+     * bits to keep set in USER_CTRL, I2C_IF_DIS on SPI, so the imu does
+     * not take SPI traffic for I2C
+     */
+    virtual uint8_t userCtrlBits() const { return 0; }
+
+};
+
+
+class ImuBusI2c : public ImuBus {
+
+  public:
+
+    /** @param [in] address - 7 bit address of the imu */
+    explicit ImuBusI2c(uint8_t address) : address(address), recovered(false) {}
+
+    /**
+     * starts Wire at 400 kHz. Clears the bus first only if it is stuck:
+     * SDA or SCL held low, or the imu not answering WHO_AM_I within its
+     * 100 ms start-up time
+     */
+    virtual void begin();
+
+    /** @returns true if begin() had to clear the bus */
+    bool wasRecovered() const { return recovered; }
+
+    /** reads in transactions of up to the 32 bytes of the Wire buffer */
+    virtual void readRegisters(uint8_t reg, uint8_t *data, int n);
+
+    virtual void writeRegister(uint8_t reg, uint8_t value);
+
+    virtual bool startReadRegisters(uint8_t reg, uint8_t *data, int n,
+      I2cAsync::Callback callback);
+
+    virtual bool isReadBusy() const { return async.isBusy(); }
+
+    virtual void abortRead() { async.abort(); }
+
+    virtual bool readSucceeded() const { return async.succeeded(); }
+
+  protected:
+
+    /** @returns true if the imu acks its address and returns WHO_AM_I */
+    bool probe();
+
+    uint8_t address;
+    bool recovered;
+    I2cAsync async;
+
+};
+
+
+class ImuBusSpi : public ImuBus {
+
+  public:
+
+    /** @param [in] csPin - Teensy pin wired to the imu nCS */
+    explicit ImuBusSpi(uint8_t csPin) : csPin(csPin) {}
+
+    virtual void begin();
+
+    /** reads at 20 MHz from the sensor, interrupt and FIFO registers */
+    virtual void readRegisters(uint8_t reg, uint8_t *data, int n);
+
+    /** writes at 1 MHz */
+    virtual void writeRegister(uint8_t reg, uint8_t value);
+
+    virtual uint8_t userCtrlBits() const { return 0x10; }
+
+  protected:
+
+    uint8_t csPin;
+
+};
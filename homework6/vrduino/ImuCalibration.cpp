@@ -0,0 +1,254 @@
+#include "ImuCalibration.h"
+#include <EEPROM.h>
+
+/* "VRIC", little endian */
+static const uint32_t recordMagic = 0x43495256;
+
+static const int payloadBytes = 24 * sizeof(float);
+
+ImuCalibration::ImuCalibration() :
+  gyrBias{0, 0, 0},
+  gyrVariance{0, 0, 0},
+  accBias{0, 0, 0},
+  accVariance{0, 0, 0},
+  gyrScale{0, 0, 0},
+  accScale{0, 0, 0},
+  gyrTempSlope{0, 0, 0},
+  gyrTempCelsius(0),
+  gyrTempVariance(0),
+  gyrTempWindows(0)
+{
+  static_assert(sizeof(ImuCalibration) == payloadBytes, "fields are the payload");
+}
+
+bool ImuCalibration::load() {
+
+  uint8_t record[recordBytes];
+  for (int i = 0; i < recordBytes; i++) {
+    record[i] = EEPROM.read(IMU_CALIBRATION_EEPROM_ADDRESS + i);
+  }
+
+  uint32_t magic;
+  uint16_t recordVersion;
+  uint16_t length;
+  uint32_t crc;
+  memcpy(&magic, &record[0], 4);
+  memcpy(&recordVersion, &record[4], 2);
+  memcpy(&length, &record[6], 2);
+  memcpy(&crc, &record[recordBytes - 4], 4);
+  if (magic != recordMagic || recordVersion != version || length != payloadBytes ||
+      crc != crc32(record, recordBytes - 4)) {
+    return false;
+  }
+
+  memcpy((void *)this, &record[8], payloadBytes);
+  return true;
+
+}
+
+void ImuCalibration::save() const {
+
+  uint8_t record[recordBytes];
+  uint16_t recordVersion = version;
+  uint16_t length = payloadBytes;
+  memcpy(&record[0], &recordMagic, 4);
+  memcpy(&record[4], &recordVersion, 2);
+  memcpy(&record[6], &length, 2);
+  memcpy(&record[8], (const void *)this, payloadBytes);
+  uint32_t crc = crc32(record, recordBytes - 4);
+  memcpy(&record[recordBytes - 4], &crc, 4);
+
+  for (int i = 0; i < recordBytes; i++) {
+    EEPROM.update(IMU_CALIBRATION_EEPROM_ADDRESS + i, record[i]);
+  }
+
+}
+
+uint32_t ImuCalibration::crc32(const uint8_t *data, int n, uint32_t crc) {
+
+  // bitwise, the record is read once at boot
+  crc = ~crc;
+  for (int i = 0; i < n; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+
+}
+
+void Welford::merge(const Welford& other) {
+  merge(other.n, other.mean, other.m2);
+}
+
+void Welford::merge(int count, double otherMean, double otherM2) {
+
+  // Chan et al., the pairwise update of Welford's
+  if (count == 0) {
+    return;
+  }
+  int total = n + count;
+  double delta = otherMean - mean;
+  mean += delta * count / total;
+  m2 += otherM2 + delta * delta * (double(n) * count / total);
+  n = total;
+
+}
+
+void Welford::limit(int maxCount) {
+
+  if (n > maxCount) {
+    m2 *= double(maxCount) / n;
+    n = maxCount;
+  }
+
+}
+
+void ImuMoments::reset() {
+
+  for (int i = 0; i < 3; i++) {
+    gyr[i].reset();
+    acc[i].reset();
+  }
+  temp.reset();
+
+}
+
+void ImuMoments::add(const ImuSample& sample) {
+
+  for (int i = 0; i < 3; i++) {
+    gyr[i].add(sample.gyr[i]);
+    acc[i].add(sample.acc[i]);
+  }
+  temp.add(sample.temp);
+
+}
+
+void ImuMoments::merge(const ImuMoments& other) {
+
+  for (int i = 0; i < 3; i++) {
+    gyr[i].merge(other.gyr[i]);
+    acc[i].merge(other.acc[i]);
+  }
+  temp.merge(other.temp);
+
+}
+
+void ImuMoments::merge(const ImuWindowSums& window) {
+
+  for (int i = 0; i < 3; i++) {
+    ImuWindowSums::mergeInto(gyr[i], window.n, window.gyrSum[i], window.gyrSquares[i]);
+    ImuWindowSums::mergeInto(acc[i], window.n, window.accSum[i], window.accSquares[i]);
+  }
+  ImuWindowSums::mergeInto(temp, window.n, window.tempSum, window.tempSquares);
+
+}
+
+void ImuMoments::limit(int maxCount) {
+
+  for (int i = 0; i < 3; i++) {
+    gyr[i].limit(maxCount);
+    acc[i].limit(maxCount);
+  }
+  temp.limit(maxCount);
+
+}
+
+void ImuMoments::gyrMeanVariance(int i, double& mean, double& variance) const {
+  mean = gyr[i].getMean();
+  variance = gyr[i].variance();
+}
+
+void ImuMoments::accMeanVariance(int i, double& mean, double& variance) const {
+  mean = acc[i].getMean();
+  variance = acc[i].variance();
+}
+
+void ImuWindowSums::reset() {
+
+  n = 0;
+  for (int i = 0; i < 3; i++) {
+    gyrSum[i] = 0;
+    accSum[i] = 0;
+    gyrSquares[i] = 0;
+    accSquares[i] = 0;
+  }
+  tempSum = 0;
+  tempSquares = 0;
+
+}
+
+/* n times the sum of squared deviations, exact in integers */
+static int64_t scaledM2(int n, int32_t sum, int64_t squares) {
+  return n * squares - int64_t(sum) * sum;
+}
+
+void ImuWindowSums::gyrMeanVariance(int i, double& mean, double& variance) const {
+  mean = n > 0 ? double(gyrSum[i]) / n : 0;
+  variance = n > 0 ? double(scaledM2(n, gyrSum[i], gyrSquares[i])) / (double(n) * n) : 0;
+}
+
+void ImuWindowSums::accMeanVariance(int i, double& mean, double& variance) const {
+  mean = n > 0 ? double(accSum[i]) / n : 0;
+  variance = n > 0 ? double(scaledM2(n, accSum[i], accSquares[i])) / (double(n) * n) : 0;
+}
+
+void ImuWindowSums::mergeInto(Welford& welford, int n, int32_t sum, int64_t squares) {
+  if (n > 0) {
+    welford.merge(n, double(sum) / n, double(scaledM2(n, sum, squares)) / n);
+  }
+}
+
+void ImuTempModel::reset() {
+
+  n = 0;
+  meanTemp = 0;
+  m2 = 0;
+  for (int i = 0; i < 3; i++) {
+    meanRate[i] = 0;
+    coMoment[i] = 0;
+  }
+
+}
+
+void ImuTempModel::add(double celsius, const double rate[3]) {
+
+  // the temperature deviation from the old mean, the rate deviations
+  // from the new ones, as in Welford::add()
+  n++;
+  double delta = celsius - meanTemp;
+  meanTemp += delta / n;
+  m2 += delta * (celsius - meanTemp);
+  for (int i = 0; i < 3; i++) {
+    meanRate[i] += (rate[i] - meanRate[i]) / n;
+    coMoment[i] += delta * (rate[i] - meanRate[i]);
+  }
+
+}
+
+void ImuTempModel::limit(int maxCount) {
+
+  if (n > maxCount) {
+    double weight = double(maxCount) / n;
+    m2 *= weight;
+    for (int i = 0; i < 3; i++) {
+      coMoment[i] *= weight;
+    }
+    n = maxCount;
+  }
+
+}
+
+void ImuTempModel::restore(int count, double celsius, double variance,
+  const double bias[3], const double slope[3]) {
+
+  n = count;
+  meanTemp = celsius;
+  m2 = variance * count;
+  for (int i = 0; i < 3; i++) {
+    meanRate[i] = bias[i];
+    coMoment[i] = slope[i] * m2;
+  }
+
+}
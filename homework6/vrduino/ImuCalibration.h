@@ -0,0 +1,280 @@
+/**
+ * @class ImuCalibration
+ * Gyro and acc bias, variance and scale of the imu, kept in EEPROM across
+ * power cycles.
+ *
+ * measureImuBiasVariance() holds the boot for 1000 samples, over a
+ * second at rest. With a calibration saved, OrientationTracker loads it
+ * instead, and refreshes it in the background whenever the imu is at
+ * rest, see OrientationTracker::loadImuCalibration(). The gyro bias
+ * drifts with the die temperature, so the record also keeps the line of
+ * bias over temperature learned at rest, see ImuTempModel.
+ *
+ * The record at IMU_CALIBRATION_EEPROM_ADDRESS is a header of magic,
+ * version and payload length, the fields below, and a CRC-32 of all
+ * before it. load() rejects a record of another version or length, or
+ * with a bad CRC, e.g. a blank EEPROM or a write cut short by a reset.
+ * save() only writes the bytes that changed.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "Imu.h"
+
+/* EEPROM byte offset of the record, 108 bytes */
+#if !defined(IMU_CALIBRATION_EEPROM_ADDRESS)
+#define IMU_CALIBRATION_EEPROM_ADDRESS 0
+#endif
+
+struct ImuCalibration {
+
+  /* record layout version, bump when the fields change */
+  static const uint16_t version = 2;
+
+  /* header, payload and CRC */
+  static const int recordBytes = 8 + 24 * sizeof(float) + 4;
+
+  /* deg/s and (deg/s)^2, order x, y, z, gyrBias at gyrTempCelsius */
+  float gyrBias[3];
+  float gyrVariance[3];
+
+  /* m/s^2 and (m/s^2)^2 */
+  float accBias[3];
+  float accVariance[3];
+
+  /* deg/s and m/s^2 per count they were measured with, see Imu::gyrScale */
+  float gyrScale[3];
+  float accScale[3];
+
+  /**
+   * the gyro bias over the die temperature, see ImuTempModel: deg/s per
+   * degree C, the degrees C of gyrBias, and the variance of the
+   * temperatures and the number of windows the slope was fit to, 0 if
+   * there is no slope yet
+   */
+  float gyrTempSlope[3];
+  float gyrTempCelsius;
+  float gyrTempVariance;
+  float gyrTempWindows;
+
+  ImuCalibration();
+
+  /**
+   * reads the record from EEPROM
+   * @returns false if there is no valid record, the fields are then as
+   *   they were
+   */
+  bool load();
+
+  /** writes the record to EEPROM, only the bytes that changed */
+  void save() const;
+
+  /** CRC-32 (IEEE 802.3) of n bytes, continuing from crc */
+  static uint32_t crc32(const uint8_t *data, int n, uint32_t crc = 0);
+
+};
+
+
+/**
+ * @class Welford
+ * Running mean and variance of a series, updated per value with Welford's
+ * algorithm. There is no squared sum to cancel against the squared mean,
+ * so the variance keeps its digits on a large offset, e.g. a gyro bias
+ * of thousands of counts, and is there after every value
+ */
+class Welford {
+
+  public:
+
+    Welford() { reset(); }
+
+    void reset() {
+      n = 0;
+      mean = 0;
+      m2 = 0;
+    }
+
+    void add(double x) {
+      n++;
+      double delta = x - mean;
+      mean += delta / n;
+      m2 += delta * (x - mean);
+    }
+
+    /** adds the values of other, as if added one by one */
+    void merge(const Welford& other);
+
+    /** adds count values of the given mean and sum of squared deviations */
+    void merge(int count, double mean, double m2);
+
+    /**
+     * keeps the mean and variance, but weighs them as at most maxCount
+     * values, so the ones added next count more: a fading memory
+     */
+    void limit(int maxCount);
+
+    int count() const { return n; }
+
+    double getMean() const { return mean; }
+
+    /** population variance, 0 before a value */
+    double variance() const { return n > 0 ? m2 / n : 0; }
+
+  protected:
+
+    int n;
+    double mean;
+    double m2;
+
+};
+
+
+/**
+ * @class ImuWindowSums
+ * Integer sums of the raw counts of each gyro and acc axis and the die
+ * temperature, and of their squares, over the samples of a short window.
+ * add() is integer adds and multiplies only, for the per sample path on
+ * a core without an FPU; the mean and variance are divided out once per
+ * window, exactly, as long as it holds under 65536 samples
+ */
+class ImuWindowSums {
+
+  public:
+
+    ImuWindowSums() { reset(); }
+
+    void reset();
+
+    void add(const ImuSample& sample) {
+      for (int i = 0; i < 3; i++) {
+        int32_t g = sample.gyr[i];
+        int32_t a = sample.acc[i];
+        gyrSum[i] += g;
+        accSum[i] += a;
+        gyrSquares[i] += g * g;
+        accSquares[i] += a * a;
+      }
+      int32_t t = sample.temp;
+      tempSum += t;
+      tempSquares += t * t;
+      n++;
+    }
+
+    int count() const { return n; }
+
+    /** mean and variance of axis i, in counts */
+    void gyrMeanVariance(int i, double& mean, double& variance) const;
+    void accMeanVariance(int i, double& mean, double& variance) const;
+
+    double tempMean() const { return n > 0 ? double(tempSum) / n : 0; }
+
+  protected:
+
+    friend class ImuMoments;
+
+    /** adds the sums of an axis to its Welford, see Welford::merge() */
+    static void mergeInto(Welford& welford, int n, int32_t sum, int64_t squares);
+
+    int n;
+    int32_t gyrSum[3];
+    int32_t accSum[3];
+    int32_t tempSum;
+    int64_t gyrSquares[3];
+    int64_t accSquares[3];
+    int64_t tempSquares;
+
+};
+
+
+/**
+ * @class ImuMoments
+ * Mean and variance of the raw counts of each gyro and acc axis, and the
+ * mean die temperature count, over the samples of a window, see Welford
+ */
+class ImuMoments {
+
+  public:
+
+    void reset();
+
+    void add(const ImuSample& sample);
+
+    /** adds the samples of other, e.g. a window to a longer run */
+    void merge(const ImuMoments& other);
+    void merge(const ImuWindowSums& window);
+
+    /** see Welford::limit() */
+    void limit(int maxCount);
+
+    int count() const { return gyr[0].count(); }
+
+    /** mean and variance of axis i, in counts */
+    void gyrMeanVariance(int i, double& mean, double& variance) const;
+    void accMeanVariance(int i, double& mean, double& variance) const;
+
+    double tempMean() const { return temp.getMean(); }
+
+  protected:
+
+    Welford gyr[3];
+    Welford acc[3];
+    Welford temp;
+
+};
+
+
+/**
+ * @class ImuTempModel
+ * The gyro bias of each axis as a line over the die temperature, fit to
+ * the mean temperature and rates of the windows at rest, online: the
+ * co-moments of Welford's algorithm, so the slope is there after every
+ * window. It is only trusted once the temperatures spread over
+ * minSpreadCelsius, e.g. during the warm-up after power on
+ */
+class ImuTempModel {
+
+  public:
+
+    /** standard deviation of the temperatures before the slope is trusted */
+    static constexpr double minSpreadCelsius = 0.5;
+
+    ImuTempModel() { reset(); }
+
+    void reset();
+
+    /** adds a window at rest, its mean degrees C and gyro deg/s */
+    void add(double celsius, const double rate[3]);
+
+    /** see Welford::limit() */
+    void limit(int maxCount);
+
+    /**
+     * starts again from a saved fit, of count windows around celsius with
+     * a bias and slope per axis, see ImuCalibration
+     */
+    void restore(int count, double celsius, double variance,
+      const double bias[3], const double slope[3]);
+
+    int count() const { return n; }
+
+    /** @returns true once the temperatures spread enough for a slope */
+    bool valid() const {
+      return n > 1 && m2 >= minSpreadCelsius * minSpreadCelsius * n;
+    }
+
+    /** deg/s per degree C of axis i, 0 while not valid() */
+    double slope(int i) const { return valid() ? coMoment[i] / m2 : 0; }
+
+    double meanCelsius() const { return meanTemp; }
+
+    double variance() const { return n > 0 ? m2 / n : 0; }
+
+  protected:
+
+    int n;
+    double meanTemp;
+    double m2;
+    double meanRate[3];
+    double coMoment[3];
+
+};
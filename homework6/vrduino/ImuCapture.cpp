@@ -0,0 +1,115 @@
+#include "ImuCapture.h"
+
+ImuCapture *ImuCapture::running = nullptr;
+
+ImuCapture::ImuCapture() :
+  imu(nullptr),
+  pin(0),
+  active(false),
+  queue(),
+  captured(0),
+  dropped(0),
+  missed(0),
+  previousTicks(0),
+  previousPeriodTicks(0)
+{
+}
+
+void ImuCapture::begin(Imu *imuIn, uint8_t pinIn) {
+
+  end();
+
+  imu = imuIn;
+  pin = pinIn;
+  captured = 0;
+  dropped = 0;
+  missed = 0;
+  previousTicks = 0;
+  queue.clear();
+
+  running = this;
+  pinMode(pin, INPUT);
+  attachInterrupt(digitalPinToInterrupt(pin), isr, RISING);
+  active = true;
+
+  imu->enableDataReadyInterrupt(true);
+
+}
+
+void ImuCapture::end() {
+
+  if (!active) {
+    return;
+  }
+
+  detachInterrupt(digitalPinToInterrupt(pin));
+  active = false;
+  running = nullptr;
+
+  // the ISR is gone, the bus is free again
+  imu->enableDataReadyInterrupt(false);
+
+}
+
+#if defined(__arm__)
+/* the NVIC line of the port of pin, its PORTx_PCR are 0x1000 apart */
+static IRQ_NUMBER_t portIrq(uint8_t pin) {
+  uint32_t port = (uint32_t(portConfigRegister(pin)) - uint32_t(&PORTA_PCR0)) >> 12;
+  return IRQ_NUMBER_t(IRQ_PORTA + port);
+}
+#endif
+
+void ImuCapture::mask() {
+#if defined(__arm__)
+  // the pin keeps its ISF, the edge is pending until unmask()
+  NVIC_DISABLE_IRQ(portIrq(pin));
+#else
+  hostMaskInterrupt(pin, true);
+#endif
+}
+
+void ImuCapture::unmask() {
+#if defined(__arm__)
+  NVIC_ENABLE_IRQ(portIrq(pin));
+#else
+  hostMaskInterrupt(pin, false);
+#endif
+}
+
+void ImuCapture::isr() {
+
+  if (running != nullptr) {
+    running->capture();
+  }
+
+}
+
+void ImuCapture::capture() {
+
+  // stamp before the ~0.4 ms read, at the edge the sample belongs to
+  ImuSample sample;
+  sample.ticks = TickClock::now();
+  imu->readSample(sample);
+
+  if (captured > 0) {
+    // whole periods in the gap beyond the first are overwritten samples
+    uint64_t gap = sample.ticks - previousTicks;
+    // the longer period across a change of the rate, see
+    // Imu::setSampleRateDivider()
+    uint32_t period = imu->samplePeriodTicks;
+    if (previousPeriodTicks > period) {
+      period = previousPeriodTicks;
+    }
+    if (gap > period + period / 2) {
+      missed = missed + uint32_t((gap + period / 2) / period) - 1;
+    }
+  }
+  previousTicks = sample.ticks;
+  previousPeriodTicks = imu->samplePeriodTicks;
+  captured = captured + 1;
+
+  if (!queue.push(sample)) {
+    dropped = dropped + 1;
+  }
+
+}
@@ -0,0 +1,116 @@
+/**
+ * @class ImuCapture
+ * Interrupt-driven sampling of the MPU9250.
+ *
+ * Polling Imu::read() once per loop() only sees the samples that happen to
+ * be ready when loop() comes around, ~150 of the 1000 per second with the
+ * lighthouse work, the serial output and a delay(5) per loop().
+ * With the data ready interrupt of the imu routed to a Teensy pin, the
+ * ISR here reads every sample as it arrives, stamps it with
+ * TickClock::now() at the interrupt edge and pushes it into an
+ * SpscQueue. loop() then pops
+ * and integrates all queued samples, see OrientationTracker::processImu().
+ *
+ * The ISR owns the I2C bus while the capture runs: the imu must not be
+ * read from loop() in between, only through pop().
+ *
+ * Losses are counted, never silent:
+ * - dropped: the queue was full, loop() fell behind by more than
+ *   IMU_QUEUE_LENGTH samples
+ * - missed: the gap between two interrupts was more than 1.5 sample
+ *   periods, the ISR was held off by another interrupt or by masking and
+ *   the imu overwrote a sample
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "Imu.h"
+#include "SpscQueue.h"
+
+/**
+ * Teensy pin wired to the MPU9250 INT line. The VRduino routes it
+ * differently between board revisions, check the schematic of yours
+ */
+#if !defined(IMU_INTERRUPT_PIN)
+#define IMU_INTERRUPT_PIN 2
+#endif
+
+/* queued samples, 64 ms at 1 kHz, a power of 2 */
+#define IMU_QUEUE_LENGTH 64
+
+class ImuCapture {
+
+  public:
+
+    ImuCapture();
+
+    ~ImuCapture() { end(); }
+
+    /**
+     * enables the data ready interrupt of the imu and starts capturing
+     * @param [in] imu - initialized imu, read from the ISR from now on
+     * @param [in] pin - Teensy pin wired to the imu INT line
+     */
+    void begin(Imu *imu, uint8_t pin);
+
+    /** stops capturing and disables the data ready interrupt */
+    void end();
+
+    /** @returns true while the interrupt is attached */
+    bool isActive() const { return active; }
+
+    /**
+     * holds the ISR off, e.g. around a register write from loop(), and
+     * serves an edge that came meanwhile at unmask(). Masks the interrupt
+     * of the port of the pin, no other interrupt of the sketch: the
+     * lighthouse and the TickClock are on FTM0
+     */
+    void mask();
+    void unmask();
+
+    /**
+     * removes the oldest captured sample, call from loop() only
+     * @returns false if no sample is queued
+     */
+    bool pop(ImuSample& sample) { return queue.pop(sample); }
+
+    /** drops all queued samples */
+    void clear() { queue.clear(); }
+
+    /** number of queued samples */
+    int queued() const { return queue.size(); }
+
+    /** samples read by the ISR since begin(), including the dropped ones */
+    uint32_t getCaptured() const { return captured; }
+
+    /** samples lost because the queue was full */
+    uint32_t getDropped() const { return dropped; }
+
+    /** samples lost because the ISR came too late */
+    uint32_t getMissed() const { return missed; }
+
+  protected:
+
+    /** ISR body: read, timestamp and queue one sample */
+    void capture();
+
+    /** data ready ISR, forwards to the running instance */
+    static void isr();
+
+    /* instance served by isr(), there is one imu */
+    static ImuCapture *running;
+
+    Imu *imu;
+    uint8_t pin;
+    bool active;
+
+    SpscQueue<ImuSample, IMU_QUEUE_LENGTH> queue;
+
+    /* written by the ISR only */
+    volatile uint32_t captured;
+    volatile uint32_t dropped;
+    volatile uint32_t missed;
+    uint64_t previousTicks;
+    uint32_t previousPeriodTicks;
+
+};
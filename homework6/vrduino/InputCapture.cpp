@@ -33,6 +33,7 @@
 
 #include <Arduino.h>
 #include "InputCapture.h"
+#include "TickClock.h"
 
 
 // convert from microseconds to I/O clock ticks
@@ -43,8 +44,6 @@
 #define CLOCKS_PER_MICROSECOND ((double)F_PLL / 2000000.0)
 #endif
 
-#define FTM0_SC_VALUE (FTM_SC_TOIE | FTM_SC_CLKS(1) | FTM_SC_PS(0))
-
 #if defined(KINETISK)
 #define CSC_CHANGE(reg, val)         ((reg)->csc = (val))
 #define CSC_INTACK(reg, val)         ((reg)->csc = (val))
@@ -75,7 +74,7 @@ void ftm0_isr(void)
 		#elif defined(KINETISL)
 		FTM0_SC = FTM0_SC_VALUE | FTM_SC_TOF;
 		#endif
-		InputCapture::overflow_count++;
+		TickClock::overflows++;
 		InputCapture::overflow_inc = true;
 	}
 
@@ -98,7 +97,6 @@ void ftm0_isr(void)
 // some explanation regarding this C to C++ trickery can be found here:
 // http://forum.pjrc.com/threads/25278-Low-Power-with-Event-based-software-architecture-brainstorm?p=43496&viewfull=1#post43496
 
-uint16_t InputCapture::overflow_count = 0;
 bool InputCapture::overflow_inc = false;
 volatile uint8_t InputCapture::channelmask = 0;
 InputCapture * InputCapture::list[8];
@@ -119,15 +117,8 @@ bool InputCapture::begin(uint8_t pin, int polarity)
 
 	cscEdge = (polarity == FALLING) ? 0b01001000 : 0b01000100;
 
-	if (FTM0_MOD != 0xFFFF || (FTM0_SC & 0x7F) != FTM0_SC_VALUE) {
-		FTM0_SC = 0;
-		FTM0_CNT = 0;
-		FTM0_MOD = 0xFFFF;
-		FTM0_SC = FTM0_SC_VALUE;
-		#if defined(KINETISK)
-		FTM0_MODE = 0;
-		#endif
-	}
+	// the captures are the low 32 bits of the tick clock
+	TickClock::begin();
 
 	switch (pin) {
 	  case  6: channel = 4; reg = &FTM0_C4SC; break;
@@ -161,9 +152,6 @@ bool InputCapture::begin(uint8_t pin, int polarity)
 	// input capture & interrupt on desired edge
 	CSC_CHANGE(ftm, cscEdge);
 
-	NVIC_SET_PRIORITY(IRQ_FTM0, 32);
-	NVIC_ENABLE_IRQ(IRQ_FTM0);
-
 	return true;
 }
 
@@ -173,7 +161,7 @@ bool InputCapture::begin(uint8_t pin, int polarity)
 
 void InputCapture::isr(void)
 {
-	uint32_t count = overflow_count;
+	uint32_t count = (uint32_t)TickClock::overflows;
 	uint32_t val = ftm->cv;
 
 	CSC_INTACK(ftm, cscEdge); // input capture & interrupt on desired edge
@@ -68,8 +68,8 @@ private:
 
   uint8_t cscEdge;
 
-  // track which channels we have installed
-  static uint16_t overflow_count;
+  // track which channels we have installed, the overflows are counted
+  // by TickClock
   static volatile uint8_t channelmask;
   static bool overflow_inc;
   static InputCapture *list[8];
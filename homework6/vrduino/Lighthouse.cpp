@@ -1,4 +1,5 @@
 #include "Lighthouse.h"
+#include "Profiler.h"
 
 
 Lighthouse::Lighthouse() :
@@ -25,9 +26,22 @@ Lighthouse::Lighthouse() :
 }
 
 
-bool Lighthouse::readTimings(int baseStationMode, unsigned long values[8], unsigned long numPulseDetections[8],
+bool Lighthouse::isDataAvailable(int baseStationMode) const {
+
+  for (int i = 0; i < 2; i++) {
+    if (pulseData.station[i].dataAvailable && baseStationMode == pulseData.station[i].mode) {
+      return true;
+    }
+  }
+  return false;
+
+}
+
+bool Lighthouse::readTimings(int baseStationMode, uint32_t values[8], unsigned long numPulseDetections[8],
   unsigned long pulseWidth[8], double &pitch, double &roll) {
 
+  PROFILE_SCOPE(PROFILE_LIGHTHOUSE_READ);
+
   //disable interrupts so that pulses aren't updated in between reads
   __disable_irq();
 
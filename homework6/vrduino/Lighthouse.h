@@ -35,9 +35,15 @@ class Lighthouse {
      *  false if data is not available
      *
      */
-    bool readTimings(int baseStationMode, unsigned long values[8], unsigned long numPulseDetections[8],
+    bool readTimings(int baseStationMode, uint32_t values[8], unsigned long numPulseDetections[8],
       unsigned long pulseWidth[8], double &pitch, double &roll);
 
+    /**
+     * @returns true if readTimings() has new data of the base station with
+     *   the mode, without reading it
+     */
+    bool isDataAvailable(int baseStationMode) const;
+
   private:
 
     /** the pins of of the sensors */
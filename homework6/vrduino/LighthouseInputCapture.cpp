@@ -1,4 +1,5 @@
 #include "LighthouseInputCapture.h"
+#include "Profiler.h"
 
 LighthouseInputCapture::LighthouseInputCapture( int pinIn, int polarityIn, int sensorIndexIn, PulseData* pulseDataIn) :
 
@@ -18,6 +19,8 @@ LighthouseInputCapture::LighthouseInputCapture( int pinIn, int polarityIn, int s
 /**  interrupt service routine for both edges (falling and rising) */
 void LighthouseInputCapture::callback(uint32_t value) {
 
+  PROFILE_SCOPE(PROFILE_LIGHTHOUSE_CAPTURE);
+
   //callback for falling edge:
   //just record the pulse position
   if (polarity == FALLING) {
@@ -17,6 +17,7 @@
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
 #include "LighthouseOOTX.h"
+#include "BootTimeline.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // constructor - reset all variables
@@ -168,6 +169,7 @@ void LighthouseOOTX::add_word(unsigned long word) {
 
   complete            = 1;
   bCompleteOnce       = true;
+  BootTimeline::stop(BOOT_OOTX);
   waiting_for_length  = 1;
 
   // reset to wait for a preamble
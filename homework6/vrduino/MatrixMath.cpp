@@ -40,7 +40,9 @@ void MatrixMath::Copy(double* A, int n, int m, double* B)
 
 //Matrix Multiplication Routine
 // C = A*B
-void MatrixMath::Multiply(double* A, double* B, int m, int p, int n, double* C)
+// (templated on the element type, instantiated below for double and float)
+template <typename T>
+static void multiply(T* A, T* B, int m, int p, int n, T* C)
 {
     // A = input matrix (m x p)
     // B = input matrix (p x n)
@@ -58,6 +60,16 @@ void MatrixMath::Multiply(double* A, double* B, int m, int p, int n, double* C)
         }
 }
 
+void MatrixMath::Multiply(double* A, double* B, int m, int p, int n, double* C)
+{
+    multiply(A, B, m, p, n, C);
+}
+
+void MatrixMath::Multiply(float* A, float* B, int m, int p, int n, float* C)
+{
+    multiply(A, B, m, p, n, C);
+}
+
 
 //Matrix Addition Routine
 void MatrixMath::Add(double* A, double* B, int m, int n, double* C)
@@ -117,14 +129,16 @@ void MatrixMath::Scale(double* A, int m, int n, double k)
 //   NUMERICAL RECIPES: The Art of Scientific Computing.
 // * The function returns 1 on success, 0 on failure.
 // * NOTE: The argument is ALSO the result matrix, meaning the input matrix is REPLACED
-int MatrixMath::Invert(double* A, int n)
+// * Templated on the element type, instantiated below for double and float.
+template <typename T>
+static int invert(T* A, int n)
 {
     // A = input matrix AND result matrix
     // n = number of rows = number of columns in A (n x n)
     int pivrow=0;     // keeps track of current pivot row
     int k,i,j;      // k: overall index along diagonal; i: row index; j: col index
     int pivrows[n]; // keeps track of rows swaps to undo at end
-    double tmp;      // used for finding max value and making column swaps
+    T tmp;          // used for finding max value and making column swaps
 
     for (k = 0; k < n; k++)
     {
@@ -198,3 +212,13 @@ int MatrixMath::Invert(double* A, int n)
     }
     return 1;
 }
+
+int MatrixMath::Invert(double* A, int n)
+{
+    return invert(A, n);
+}
+
+int MatrixMath::Invert(float* A, int n)
+{
+    return invert(A, n);
+}
@@ -22,11 +22,13 @@ public:
     void Print(double* A, int m, int n, String label);
     void Copy(double* A, int n, int m, double* B);
     void Multiply(double* A, double* B, int m, int p, int n, double* C);
+    void Multiply(float* A, float* B, int m, int p, int n, float* C);
     void Add(double* A, double* B, int m, int n, double* C);
     void Subtract(double* A, double* B, int m, int n, double* C);
     void Transpose(double* A, int m, int n, double* C);
     void Scale(double* A, int m, int n, double k);
     int Invert(double* A, int n);
+    int Invert(float* A, int n);
 };
 
 extern MatrixMath Matrix;
@@ -0,0 +1,19 @@
+#include "OrientationEstimator.h"
+
+
+const char* estimatorName(EstimatorType type) {
+
+  switch (type) {
+    case ESTIMATOR_COMP:
+      return "complementary";
+    case ESTIMATOR_MADGWICK:
+      return "madgwick";
+    case ESTIMATOR_MAHONY:
+      return "mahony";
+    case ESTIMATOR_MEKF:
+      return "mekf";
+    default:
+      return "unknown";
+  }
+
+}
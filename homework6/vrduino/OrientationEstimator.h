@@ -0,0 +1,178 @@
+/**
+ * @file
+ * selectable quaternion orientation estimators, all fusing gyro and acc:
+ * - ESTIMATOR_COMP: complementary filter, updateQuaternionComp()
+ * - ESTIMATOR_MADGWICK: gradient descent filter, updateQuaternionMadgwick()
+ * - ESTIMATOR_MAHONY: PI feedback filter, updateQuaternionMahony()
+ * - ESTIMATOR_MEKF: multiplicative Kalman filter, updateQuaternionMekf(),
+ *   with the measured imu variances as noise model, see setNoise()
+ *
+ * OrientationEstimatorT keeps the state and gains of one of them behind a
+ * single update() call. The engine is picked at startup, by passing the
+ * type to the constructor or setType(), with VRDUINO_ESTIMATOR as the
+ * compile-time default. Dispatch is a switch, so there is no vtable and
+ * all four are inlined into update(). The MEKF integrates every gyro
+ * sample, but propagates its covariance and corrects with the acc only
+ * every MEKF_UPDATE_INTERVAL samples.
+ *
+ * host/HostBench.cpp reports the time per update and the tracking error
+ * of each engine on simulatedImuData.h.
+ */
+
+#pragma once
+#include "OrientationMath.h"
+#include "OrientationMekf.h"
+
+enum EstimatorType {
+  ESTIMATOR_COMP,
+  ESTIMATOR_MADGWICK,
+  ESTIMATOR_MAHONY,
+  ESTIMATOR_MEKF,
+  ESTIMATOR_COUNT
+};
+
+// default estimator of OrientationTracker
+#if !defined(VRDUINO_ESTIMATOR)
+#define VRDUINO_ESTIMATOR ESTIMATOR_COMP
+#endif
+
+/**
+ * default gains, see updateQuaternionMadgwick/Mahony(). Like the
+ * complementary filter with alpha 0.99 at 500 Hz, they take ~0.2 s to
+ * correct a small tilt: Mahony with a time constant of 1/kp, Madgwick
+ * at up to 2 beta = 57 deg/s
+ */
+#define MADGWICK_BETA 0.5
+#define MAHONY_KP 5.0
+#define MAHONY_KI 0.05
+
+/* 1 to run the MEKF with gyro bias states, 0 for the angle error only */
+#define MEKF_ESTIMATE_BIAS 1
+
+
+/** @returns short name of an estimator, for printing */
+const char* estimatorName(EstimatorType type);
+
+
+template <typename T>
+class OrientationEstimatorT {
+
+  public:
+
+    /**
+     * @param [in] type - estimator to run
+     * @param [in] alpha - complementary filter alpha value [0,1]
+     */
+    OrientationEstimatorT(EstimatorType type, T alpha) :
+      type(type),
+      alpha(alpha),
+      beta(T(MADGWICK_BETA)),
+      kp(T(MAHONY_KP)),
+      ki(T(MAHONY_KI)),
+      integral{0, 0, 0},
+      q()
+    {
+      T zero[3] = {0, 0, 0};
+      mekfReset(mekf, MEKF_ESTIMATE_BIAS);
+      mekfSetNoise(mekf, zero, zero);
+    }
+
+
+    /**
+     * updates the orientation estimate
+     * @param [in] gyr - gyro values in deg/s, bias removed
+     * @param [in] acc - acc values
+     * @param [in] deltaT - time since previous imu reading in s
+     */
+    void update(T gyr[3], T acc[3], T deltaT) {
+
+      switch (type) {
+        case ESTIMATOR_MADGWICK:
+          updateQuaternionMadgwick(q, gyr, acc, deltaT, beta);
+          break;
+        case ESTIMATOR_MAHONY:
+          updateQuaternionMahony(q, integral, gyr, acc, deltaT, kp, ki);
+          break;
+        case ESTIMATOR_MEKF:
+          updateQuaternionMekf(q, mekf, gyr, acc, deltaT);
+          break;
+        default:
+          updateQuaternionComp(q, gyr, acc, deltaT, alpha);
+          break;
+      }
+
+    }
+
+
+    /**
+     * pulls the yaw of the estimate towards a magnetometer heading, see
+     * correctYaw(), after update(), with any estimator
+     * @param [in] magWorld - magnetometer values rotated into the world
+     *   frame by the estimate
+     * @param [in] reference - unit (x, z) heading of the field in the world
+     * @param [in] alphaMag - filter alpha value, per measurement
+     */
+    void correctHeading(T magWorld[3], const T reference[2], T alphaMag) {
+      correctYaw(q, magWorld, reference, alphaMag);
+    }
+
+
+    /** resets the orientation and the Mahony and MEKF bias estimates */
+    void reset() {
+      q = QuaternionT<T>();
+      integral[0] = integral[1] = integral[2] = 0;
+      mekfReset(mekf, mekf.estimateBias);
+    }
+
+
+    /** switches to another estimator, starting from the current estimate */
+    void setType(EstimatorType typeIn) { type = typeIn; }
+
+    EstimatorType getType() const { return type; }
+
+    /** @param [in] betaIn - Madgwick correction rate in rad/s */
+    void setMadgwickGain(T betaIn) { beta = betaIn; }
+
+    /** @param [in] kpIn, kiIn - Mahony PI gains */
+    void setMahonyGains(T kpIn, T kiIn) { kp = kpIn; ki = kiIn; }
+
+    /**
+     * sets the MEKF noise model
+     * @param [in] gyrVariance - gyro variance per axis in (deg/s)^2
+     * @param [in] accVariance - acc variance per axis in (m/s^2)^2
+     */
+    void setNoise(const T gyrVariance[3], const T accVariance[3]) {
+      mekfSetNoise(mekf, gyrVariance, accVariance);
+    }
+
+    /** @param [in] estimateBias - true to run the MEKF with gyro bias states */
+    void setMekfBias(bool estimateBias) { mekfReset(mekf, estimateBias); }
+
+    /** @returns read-only reference to the orientation estimate */
+    const QuaternionT<T>& getQuaternion() const { return q; }
+
+
+  protected:
+
+    EstimatorType type;
+
+    /* complementary filter alpha */
+    T alpha;
+
+    /* Madgwick correction rate in rad/s */
+    T beta;
+
+    /* Mahony gains and integral term in rad/s */
+    T kp;
+    T ki;
+    T integral[3];
+
+    /* MEKF covariance, bias and noise model */
+    MekfStateT<T> mekf;
+
+    /* orientation estimate */
+    QuaternionT<T> q;
+
+};
+
+typedef OrientationEstimatorT<Scalar> OrientationEstimator;
@@ -1,38 +1,43 @@
 #include "OrientationMath.h"
 
 /** TODO: see documentation in header file */
-double computeAccPitch(double acc[3]) {
+template <typename T>
+T computeAccPitch(T acc[3]) {
 
   int signAccY = (acc[1] >= 0) * 1 + (acc[1] < 0) * (-1);
-  double pitch = -atan2(acc[2],
-      signAccY * sqrt(sq(acc[0]) + sq(acc[1]))) * RAD_TO_DEG;
+  T pitch = -scalar::atan2(acc[2],
+      signAccY * scalar::sqrt(sq(acc[0]) + sq(acc[1]))) * T(RAD_TO_DEG);
   return pitch;
 
 }
 
 /** TODO: see documentation in header file */
-double computeAccRoll(double acc[3]) {
+template <typename T>
+T computeAccRoll(T acc[3]) {
 
-  return -atan2(-acc[0], acc[1]) * RAD_TO_DEG;
+  return -scalar::atan2(-acc[0], acc[1]) * T(RAD_TO_DEG);
 
 }
 
 /** TODO: see documentation in header file */
-double computeFlatlandRollGyr(double flatlandRollGyrPrev, double gyr[3], double deltaT) {
+template <typename T>
+T computeFlatlandRollGyr(T flatlandRollGyrPrev, T gyr[3], T deltaT) {
 
   return flatlandRollGyrPrev + deltaT * gyr[2];
 
 }
 
 /** TODO: see documentation in header file */
-double computeFlatlandRollAcc(double acc[3]) {
+template <typename T>
+T computeFlatlandRollAcc(T acc[3]) {
 
-  return RAD_TO_DEG * atan2(acc[0], acc[1]);
+  return T(RAD_TO_DEG) * scalar::atan2(acc[0], acc[1]);
 
 }
 
 /** TODO: see documentation in header file */
-double computeFlatlandRollComp(double flatlandRollCompPrev, double gyr[3], double flatlandRollAcc, double deltaT, double alpha) {
+template <typename T>
+T computeFlatlandRollComp(T flatlandRollCompPrev, T gyr[3], T flatlandRollAcc, T deltaT, T alpha) {
 
   return alpha * ( flatlandRollCompPrev + deltaT * gyr[2] ) +
     (1 - alpha) * flatlandRollAcc ;
@@ -40,54 +45,267 @@ double computeFlatlandRollComp(double flatlandRollCompPrev, double gyr[3], doubl
 }
 
 
-/** TODO: see documentation in header file */
-void updateQuaternionGyr(Quaternion& q, double gyr[3], double deltaT) {
+/** see documentation in header file */
+template <typename T>
+void integrateGyrExact(QuaternionT<T>& q, T gyr[3], T deltaT) {
 
-  // integrate gyro
-  double normW = sqrt( gyr[0]*gyr[0] + gyr[1]*gyr[1] + gyr[2]*gyr[2] ); // shouldn't matter that it's in deg/s
-  Quaternion qDelta;
-  if (normW >= 1e-8) {
+  T normW = scalar::sqrt( gyr[0]*gyr[0] + gyr[1]*gyr[1] + gyr[2]*gyr[2] ); // shouldn't matter that it's in deg/s
+  if (normW >= T(1e-8)) {
     // really important to prevent division by zero on Teensy!
-    qDelta = Quaternion().setFromAngleAxis(
+    q *= QuaternionT<T>::fromAngleAxis(
       deltaT * normW, gyr[0] / normW, gyr[1] / normW, gyr[2]/normW);
   }
 
-  //update quaternion variable
-  q = Quaternion().multiply(q,qDelta).normalize();
+  q.normalize();
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void integrateGyrPoly(QuaternionT<T>& q, T gyr[3], T deltaT) {
+
+  // largest |h|^2 with |h|^8 / 8! below epsilon
+  const T maxH2 = (sizeof(T) == sizeof(float)) ? T(0.22) : T(1.45e-3);
+
+  // half rotation vector in rad
+  T k = deltaT * T(0.5 * DEG_TO_RAD);
+  T hx = gyr[0] * k, hy = gyr[1] * k, hz = gyr[2] * k;
+  T h2 = hx*hx + hy*hy + hz*hz;
+
+  if (h2 > maxH2) {
+    integrateGyrExact(q, gyr, deltaT);
+    return;
+  }
+
+  // cos(|h|) and sin(|h|) / |h|
+  T c = 1 - h2 * (T(1.0/2) - h2 * (T(1.0/24) - h2 * T(1.0/720)));
+  T s = 1 - h2 * (T(1.0/6) - h2 * (T(1.0/120) - h2 * T(1.0/5040)));
+
+  q *= QuaternionT<T>(c, s * hx, s * hy, s * hz);
+  q.renormalize();
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void gyrFromRotation(const QuaternionT<T>& q, T deltaT, T gyr[3]) {
+
+  // the shorter way round, w >= 0
+  T sign = q.q[0] < 0 ? T(-1) : T(1);
+  T s = scalar::sqrt(q.q[1]*q.q[1] + q.q[2]*q.q[2] + q.q[3]*q.q[3]);
+  // angle / (deltaT sin(angle / 2)), its limit 2 / deltaT at no rotation
+  T k = T(2 * RAD_TO_DEG) / deltaT;
+  if (s >= T(1e-8)) {
+    k *= scalar::atan2(s, sign * q.q[0]) / s;
+  }
+  for (int i = 0; i < 3; i++) {
+    gyr[i] = sign * q.q[i + 1] * k;
+  }
 
 }
 
 
 /** TODO: see documentation in header file */
-void updateQuaternionComp(Quaternion& q, double gyr[3], double acc[3], double deltaT, double alpha) {
+template <typename T>
+void updateQuaternionGyr(QuaternionT<T>& q, T gyr[3], T deltaT) {
 
   // integrate gyro
-  double normW = sqrt( gyr[0]*gyr[0] + gyr[1]*gyr[1] + gyr[2]*gyr[2] ); // shouldn't matter that it's in deg/s
-  Quaternion qDelta;
-  if (normW >= 1e-8) {
-    // really important to prevent division by zero on Teensy!
-    qDelta = Quaternion().setFromAngleAxis(
-      deltaT * normW, gyr[0] / normW, gyr[1] / normW, gyr[2]/normW);
+  integrateGyr(q, gyr, deltaT);
+
+}
+
+
+/** TODO: see documentation in header file */
+template <typename T>
+void updateQuaternionComp(QuaternionT<T>& q, T gyr[3], T acc[3], T deltaT, T alpha) {
+
+  // integrate gyro
+  integrateGyr(q, gyr, deltaT);
+
+  // get accelerometer vector in world
+  T a[3];
+  q.rotateVector(acc, a);
+
+  // tilt correction
+#if defined(VRDUINO_TILT_EXACT)
+  correctTiltExact(q, a, alpha);
+#else
+  correctTilt(q, a, alpha);
+#endif
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void updateQuaternionMadgwick(QuaternionT<T>& q, T gyr[3], T acc[3], T deltaT, T beta) {
+
+  T normA2 = acc[0]*acc[0] + acc[1]*acc[1] + acc[2]*acc[2];
+  if (normA2 < T(1e-16)) {
+    integrateGyr(q, gyr, deltaT);
+    return;
+  }
+
+  // objective f = g_b(q) - a / |a|, and its gradient J^T f
+  T up[3];
+  expectedUp(q, up);
+  T invNormA = 1 / scalar::sqrt(normA2);
+  T f0 = up[0] - acc[0] * invNormA;
+  T f1 = up[1] - acc[1] * invNormA;
+  T f2 = up[2] - acc[2] * invNormA;
+
+  const T w = q.q[0], x = q.q[1], y = q.q[2], z = q.q[3];
+  QuaternionT<T> grad(
+    2 * (z*f0 - x*f2),
+    2 * (y*f0 - 2*x*f1 - w*f2),
+    2 * (x*f0 + z*f2),
+    2 * (w*f0 - 2*z*f1 + y*f2));
+
+  // gyro step, then a fixed-length step down the gradient
+  integrateGyr(q, gyr, deltaT);
+
+  T normGrad2 = grad.lengthSquared();
+  if (normGrad2 > T(1e-16)) {
+    T step = beta * deltaT / scalar::sqrt(normGrad2);
+    for (int i = 0; i < 4; i++) {
+      q.q[i] -= step * grad.q[i];
+    }
+    q.normalize();
+  }
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void updateQuaternionMahony(QuaternionT<T>& q, T integral[3], T gyr[3], T acc[3],
+  T deltaT, T kp, T ki) {
+
+  T w[3] = {gyr[0], gyr[1], gyr[2]};
+
+  T normA2 = acc[0]*acc[0] + acc[1]*acc[1] + acc[2]*acc[2];
+  if (normA2 >= T(1e-16)) {
+
+    // tilt error e = a / |a| x g_b(q), |e| = sin of the tilt angle
+    T up[3];
+    expectedUp(q, up);
+    T invNormA = 1 / scalar::sqrt(normA2);
+    T e[3] = {
+      (acc[1]*up[2] - acc[2]*up[1]) * invNormA,
+      (acc[2]*up[0] - acc[0]*up[2]) * invNormA,
+      (acc[0]*up[1] - acc[1]*up[0]) * invNormA
+    };
+
+    // PI feedback into the gyro rates
+    for (int i = 0; i < 3; i++) {
+      integral[i] += ki * e[i] * deltaT;
+      w[i] += T(RAD_TO_DEG) * (kp * e[i] + integral[i]);
+    }
+
   }
 
-  Quaternion qw = Quaternion().multiply(q,qDelta).normalize();
+  integrateGyr(q, w, deltaT);
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void correctTiltExact(QuaternionT<T>& q, T accWorld[3], T alpha) {
 
-  // get accelerometer quaternion in world
-  Quaternion qa = Quaternion(0,acc[0],acc[1],acc[2]);
-  qa = qa.rotate(qw);
+  T* a = accWorld;
 
   // compute tilt correction quaternion
-  double normA = sqrt( qa.q[1]*qa.q[1] + qa.q[2]*qa.q[2] + qa.q[3]*qa.q[3] );
-  double phi = RAD_TO_DEG * acos(qa.q[2]/normA);
-
-  // tilt correction quaternion
-  double normN = sqrt( qa.q[1]*qa.q[1] + qa.q[3]*qa.q[3] );
-  Quaternion qt;
-  if (normN >= 1e-8) { // really important to prevent division by zero on Teensy!
-    qt = Quaternion().setFromAngleAxis( (1-alpha)*phi, -qa.q[3]/normN, 0.0, qa.q[1]/normN).normalize();
+  T normA = scalar::sqrt( a[0]*a[0] + a[1]*a[1] + a[2]*a[2] );
+  T phi = T(RAD_TO_DEG) * scalar::acos(a[1]/normA);
+
+  // tilt correction quaternion, a unit axis gives a unit quaternion
+  T normN = scalar::sqrt( a[0]*a[0] + a[2]*a[2] );
+  if (normN >= T(1e-8)) { // really important to prevent division by zero on Teensy!
+    QuaternionT<T> qt = QuaternionT<T>::fromAngleAxis( (1-alpha)*phi, -a[2]/normN, T(0), a[0]/normN);
+
+    // update complementary filter
+    q.premultiply(qt).normalize();
   }
 
-  // update complementary filter
-  q = Quaternion().multiply(qt, qw).normalize();
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void correctTilt(QuaternionT<T>& q, T accWorld[3], T alpha) {
+
+  T* a = accWorld;
+
+  T normN2 = a[0]*a[0] + a[2]*a[2];
+  if (normN2 < T(1e-16)) { // no tilt, or no defined axis
+    return;
+  }
+
+  // (w, n) = (|a| + a_y, (-a_z, 0, a_x)) rotates by phi about n,
+  // tan(phi/2) = |n| / w
+  T w = scalar::sqrt(normN2 + a[1]*a[1]) + a[1];
+  if (w*w < normN2) {
+    // phi > 90 degrees, hold the correction at its 90 degree value
+    w = scalar::sqrt(normN2);
+  }
+  T t2 = normN2 / (w*w);
+
+  // phi/2 = t r with r = atan(t) / t, and tan(x) = x s with
+  // x = (1 - alpha) phi/2, both as [3/2] Pade approximants
+  T beta = 1 - alpha;
+  T r = (15 + 4*t2) / (15 + 9*t2);
+  T x2 = beta*beta * t2 * r*r;
+  T k = beta * r * (15 - x2) / (15 - 6*x2);
+
+  // (w, k n) ~ (1, tan(x) n / |n|)
+  q.premultiply(QuaternionT<T>(w, -k * a[2], T(0), k * a[0])).normalize();
 
 }
+
+
+/** see documentation in header file */
+template <typename T>
+void correctYaw(QuaternionT<T>& q, T magWorld[3], const T reference[2], T alpha) {
+
+  T* m = magWorld;
+
+  T normH = scalar::sqrt( m[0]*m[0] + m[2]*m[2] );
+  if (normH < T(1e-8)) {
+    return;
+  }
+
+  // angle about y from the measured heading to the reference: the
+  // rotation by psi takes x into (cos psi, -sin psi) in (x, z)
+  T c = m[0]*reference[0] + m[2]*reference[1];
+  T s = m[2]*reference[0] - m[0]*reference[1];
+  T psi = T(RAD_TO_DEG) * scalar::atan2(s, c);
+
+  q.premultiply(QuaternionT<T>::fromAngleAxis( (1-alpha)*psi, T(0), T(1), T(0) )).normalize();
+
+}
+
+
+// instantiate the functions above for both precisions, see Scalar.h
+#define INSTANTIATE_ORIENTATION_MATH(T) \
+  template T computeAccPitch<T>(T acc[3]); \
+  template T computeAccRoll<T>(T acc[3]); \
+  template T computeFlatlandRollGyr<T>(T flatlandRollGyrPrev, T gyr[3], T deltaT); \
+  template T computeFlatlandRollAcc<T>(T acc[3]); \
+  template T computeFlatlandRollComp<T>(T flatlandRollCompPrev, T gyr[3], T flatlandRollAcc, T deltaT, T alpha); \
+  template void integrateGyrExact<T>(QuaternionT<T>& q, T gyr[3], T deltaT); \
+  template void integrateGyrPoly<T>(QuaternionT<T>& q, T gyr[3], T deltaT); \
+  template void gyrFromRotation<T>(const QuaternionT<T>& q, T deltaT, T gyr[3]); \
+  template void updateQuaternionGyr<T>(QuaternionT<T>& q, T gyr[3], T deltaT); \
+  template void updateQuaternionComp<T>(QuaternionT<T>& q, T gyr[3], T acc[3], T deltaT, T alpha); \
+  template void correctTiltExact<T>(QuaternionT<T>& q, T accWorld[3], T alpha); \
+  template void correctTilt<T>(QuaternionT<T>& q, T accWorld[3], T alpha); \
+  template void correctYaw<T>(QuaternionT<T>& q, T magWorld[3], const T reference[2], T alpha); \
+  template void updateQuaternionMadgwick<T>(QuaternionT<T>& q, T gyr[3], T acc[3], T deltaT, T beta); \
+  template void updateQuaternionMahony<T>(QuaternionT<T>& q, T integral[3], T gyr[3], T acc[3], \
+    T deltaT, T kp, T ki);
+
+INSTANTIATE_ORIENTATION_MATH(float)
+INSTANTIATE_ORIENTATION_MATH(double)
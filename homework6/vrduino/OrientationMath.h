@@ -3,23 +3,40 @@
  * math implementation for :
  * - quaternion complementary filter
  * - euler complementary filter
+ *
+ * All functions are templated on the scalar type T and instantiated
+ * for float and double, see Scalar.h.
  */
 
 #pragma once
 #include "Quaternion.h"
 
+/**
+ * gyro integration of updateQuaternionGyr/Comp:
+ * by default integrateGyrPoly(), uncomment to use integrateGyrExact()
+ */
+//#define VRDUINO_GYRO_EXACT
+
+/**
+ * tilt correction of updateQuaternionComp:
+ * by default correctTilt(), uncomment to use correctTiltExact()
+ */
+//#define VRDUINO_TILT_EXACT
+
 /**
  * @param[in] acc - current acc values  (ax, ay, az)
  * @returns pitch angle in degrees
  */
-double computeAccPitch(double acc[3]);
+template <typename T>
+T computeAccPitch(T acc[3]);
 
 
 /**
  * @param[in] acc - current acc values  (ax, ay, az)
  * @returns roll angle in degrees
  */
-double computeAccRoll(double acc[3]);
+template <typename T>
+T computeAccRoll(T acc[3]);
 
 
 /**
@@ -30,7 +47,8 @@ double computeAccRoll(double acc[3]);
  * @returns new flatland roll from previous flatland roll
  *  and current gyro values
  */
-double computeFlatlandRollGyr(double flatlandRollGyrPrev, double gyr[3], double deltaT);
+template <typename T>
+T computeFlatlandRollGyr(T flatlandRollGyrPrev, T gyr[3], T deltaT);
 
 
 /**
@@ -38,7 +56,8 @@ double computeFlatlandRollGyr(double flatlandRollGyrPrev, double gyr[3], double
  * @param[in] acc - current acc values (ax, ay, az)
  * @returns flatland roll from acc values
  */
-double computeFlatlandRollAcc(double acc[3]);
+template <typename T>
+T computeFlatlandRollAcc(T acc[3]);
 
 
 /**
@@ -52,7 +71,8 @@ double computeFlatlandRollAcc(double acc[3]);
  * @param[in] alpha - complementary filter alpha value
  * @returns new flatland roll estimate from complementary filter
  */
-double computeFlatlandRollComp(double flatlandRollCompPrev, double gyr[3],  double flatlandRollAcc, double deltaT, double alpha);
+template <typename T>
+T computeFlatlandRollComp(T flatlandRollCompPrev, T gyr[3],  T flatlandRollAcc, T deltaT, T alpha);
 
 
 /**
@@ -64,7 +84,45 @@ double computeFlatlandRollComp(double flatlandRollCompPrev, double gyr[3],  doub
  * @param[in] deltaT - time since previous imu reading in seconds
  * @param[in] alpha - complementary filter alpha value
  */
-void updateQuaternionComp(Quaternion& q, double gyr[3], double acc[3], double deltaT, double alpha);
+template <typename T>
+void updateQuaternionComp(QuaternionT<T>& q, T gyr[3], T acc[3], T deltaT, T alpha);
+
+
+/**
+ * update the quaternion estimate with Madgwick's gradient descent filter
+ * (IMU variant, no magnetometer): the gyro step is followed by a step of
+ * beta * deltaT against the normalized gradient of |g_b(q) - a / |a||^2,
+ * with g_b(q) the world up vector (0, 1, 0) in the imu frame.
+ * Unlike alpha, beta is a rate, so the correction does not depend on the
+ * sample rate. Without acc (|a| = 0) only the gyro is integrated.
+ * @param[in, out] q - previous orientation estimate, updated in place
+ * @param[in] gyr - current gyro values in deg/s
+ * @param[in] acc - current acc values
+ * @param[in] deltaT - time since previous imu reading in seconds
+ * @param[in] beta - correction rate in rad/s, on the order of the gyro
+ *   noise, e.g. 0.1
+ */
+template <typename T>
+void updateQuaternionMadgwick(QuaternionT<T>& q, T gyr[3], T acc[3], T deltaT, T beta);
+
+
+/**
+ * update the quaternion estimate with Mahony's nonlinear complementary
+ * filter: the tilt error e = a / |a| x g_b(q) is fed back into the gyro
+ * rates through a PI controller before integrating them.
+ * The integral term tracks the residual gyro bias.
+ * @param[in, out] q - previous orientation estimate, updated in place
+ * @param[in, out] integral - integral of ki * e in rad/s, the negated
+ *   gyro bias estimate. Start with 0
+ * @param[in] gyr - current gyro values in deg/s
+ * @param[in] acc - current acc values
+ * @param[in] deltaT - time since previous imu reading in seconds
+ * @param[in] kp - proportional gain in rad/s per rad of tilt error
+ * @param[in] ki - integral gain in rad/s^2 per rad, 0 to disable
+ */
+template <typename T>
+void updateQuaternionMahony(QuaternionT<T>& q, T integral[3], T gyr[3], T acc[3],
+  T deltaT, T kp, T ki);
 
 
 /**
@@ -75,4 +133,132 @@ void updateQuaternionComp(Quaternion& q, double gyr[3], double acc[3], double de
  * @param[in] deltaT - time since previous imu reading in seconds
  *
  */
-void updateQuaternionGyr(Quaternion& q, double gyr[3], double deltaT);
+template <typename T>
+void updateQuaternionGyr(QuaternionT<T>& q, T gyr[3], T deltaT);
+
+
+/**
+ * integrates the gyro rates into q with the angle-axis form:
+ * q * (cos(|h|), sin(|h|) h / |h|) with the half rotation vector
+ * h = deltaT/2 * gyr, then normalize().
+ * Costs a sqrt, three divisions, sin and cos, and another sqrt and
+ * division to normalize.
+ * @param[in, out] q - orientation, updated in place
+ * @param[in] gyr - gyro values in deg/s
+ * @param[in] deltaT - time step in s
+ */
+template <typename T>
+void integrateGyrExact(QuaternionT<T>& q, T gyr[3], T deltaT);
+
+
+/**
+ * integrates the gyro rates into q like integrateGyrExact(), with the
+ * quaternion exponential as Taylor series in |h|^2 up to |h|^6, and
+ * renormalize() instead of normalize(). No sqrt, division or trig.
+ *
+ * The series is used while the first omitted term, |h|^8 / 8!, is below
+ * the epsilon of T, i.e. |h| < 0.038 rad in double (4300 deg/s at 1 kHz)
+ * and |h| < 0.47 rad in float. Larger steps fall back to
+ * integrateGyrExact().
+ * @param[in, out] q - orientation, updated in place
+ * @param[in] gyr - gyro values in deg/s
+ * @param[in] deltaT - time step in s
+ */
+template <typename T>
+void integrateGyrPoly(QuaternionT<T>& q, T gyr[3], T deltaT);
+
+
+/**
+ * integrates the gyro rates into q, the integration of all quaternion
+ * filters: integrateGyrPoly(), or integrateGyrExact() with
+ * VRDUINO_GYRO_EXACT
+ */
+template <typename T>
+inline void integrateGyr(QuaternionT<T>& q, T gyr[3], T deltaT) {
+#if defined(VRDUINO_GYRO_EXACT)
+  integrateGyrExact(q, gyr, deltaT);
+#else
+  integrateGyrPoly(q, gyr, deltaT);
+#endif
+}
+
+
+/**
+ * the constant gyro rates that integrate to the rotation q over deltaT,
+ * the inverse of integrateGyrExact(): the rotation vector of q over
+ * deltaT. Gyro samples integrated into q one by one this way reach the
+ * estimator as a single step of their combined rotation, without the
+ * error of integrating their mean rate when the axis moves
+ * @param[in] q - unit rotation over the step
+ * @param[in] deltaT - time of the step in s, > 0
+ * @param[out] gyr - rates in deg/s
+ */
+template <typename T>
+void gyrFromRotation(const QuaternionT<T>& q, T deltaT, T gyr[3]);
+
+
+/**
+ * world up vector (0, 1, 0) in the imu frame of orientation q, i.e. the
+ * second row of the rotation matrix of q. This is where q expects acc
+ * to point
+ * @param[in] q - unit orientation quaternion
+ * @param[out] up - unit vector in the imu frame
+ */
+template <typename T>
+inline void expectedUp(const QuaternionT<T>& q, T up[3]) {
+  const T w = q.q[0], x = q.q[1], y = q.q[2], z = q.q[3];
+  up[0] = 2 * (x*y + w*z);
+  up[1] = 1 - 2 * (x*x + z*z);
+  up[2] = 2 * (y*z - w*x);
+}
+
+
+/**
+ * complementary filter tilt correction with angles: rotates q by
+ * (1-alpha) phi towards the measured up vector, phi = acos(a_y / |a|),
+ * through setFromAngleAxis(). Costs three sqrt, acos, sin and cos.
+ * @param[in, out] q - orientation, updated in place
+ * @param[in] accWorld - acc values rotated into the world frame by q
+ * @param[in] alpha - complementary filter alpha value
+ */
+template <typename T>
+void correctTiltExact(QuaternionT<T>& q, T accWorld[3], T alpha);
+
+
+/**
+ * complementary filter tilt correction without trig. The rotation taking
+ * a onto the y axis is (|a| + a_y, a x y) by the half-angle identities,
+ * i.e. tan(phi/2) = |a x y| / (|a| + a_y). The (1-alpha) phi/2 rotation
+ * is then built from rational approximations of atan and tan, with a
+ * relative error of 1e-8 at phi = 10 degrees and 2e-4 at 50 degrees.
+ * Beyond 90 degrees the correction is held at its 90 degree value, so a
+ * single acc spike cannot flip the estimate. This departs from
+ * correctTiltExact(), which rotates by the full (1-alpha) phi: a tilt
+ * past 90 degrees is corrected by (1-alpha) 90 degrees per call instead,
+ * about the same axis, and converges over the following calls. At
+ * exactly 180 degrees the axis is undefined and neither corrects.
+ * Costs one sqrt and three divisions plus the normalization of the result.
+ * @param[in, out] q - orientation, updated in place
+ * @param[in] accWorld - acc values rotated into the world frame by q
+ * @param[in] alpha - complementary filter alpha value
+ */
+template <typename T>
+void correctTilt(QuaternionT<T>& q, T accWorld[3], T alpha);
+
+
+/**
+ * yaw correction from the magnetometer: rotates q about the world up
+ * axis by (1-alpha) of the angle from the horizontal part of the field
+ * to a reference heading, so the yaw drift of the gyro is pulled back as
+ * the tilt is by the acc. The vertical part of the field, the dip, is
+ * ignored, so run it after the tilt correction. Without a horizontal
+ * field q is left as is.
+ * Costs a sqrt, atan2, sin and cos.
+ * @param[in, out] q - orientation, updated in place
+ * @param[in] magWorld - magnetometer values rotated into the world frame by q
+ * @param[in] reference - unit (x, z) heading of the horizontal field in
+ *   the world frame
+ * @param[in] alpha - filter alpha value, per magnetometer measurement
+ */
+template <typename T>
+void correctYaw(QuaternionT<T>& q, T magWorld[3], const T reference[2], T alpha);
@@ -0,0 +1,214 @@
+#include "OrientationMathFixed.h"
+
+
+FixedGyrScale fixedGyrScale(double fullScaleDps) {
+
+  // deg/s of one Q24.8 count, times 1e-6 s per us
+  double degPerCountUs = fullScaleDps / 32767.0 / 256.0 * 1e-6;
+
+  FixedGyrScale scale;
+  scale.halfRad = (uint32_t)lround(0.5 * DEG_TO_RAD * degPerCountUs * 4611686018427387904.0); // 2^62
+  scale.bam     = (uint32_t)lround(degPerCountUs / 180.0 * 18446744073709551616.0);          // 2^31 * 2^33
+  return scale;
+
+}
+
+
+/* deltaT limited to FIXED_MAX_DELTA_T */
+static inline int64_t clampDeltaT(uint32_t deltaT) {
+  return (deltaT > FIXED_MAX_DELTA_T) ? FIXED_MAX_DELTA_T : deltaT;
+}
+
+
+/* roll increment for the gyro z rate over deltaT */
+static inline bam_t rollIncrement(const int32_t gyr[3], uint32_t deltaT,
+  const FixedGyrScale& scale) {
+
+  int64_t x = (int64_t)gyr[2] * clampDeltaT(deltaT);
+  return (bam_t)((x * scale.bam + ((int64_t)1 << 32)) >> 33);
+
+}
+
+
+/* num / den rounded to nearest, den > 0. Truncation would shrink every
+ * rotation a little and add up to a steady drift */
+static inline q30_t divRound(int64_t num, int32_t den) {
+  return (q30_t)((num >= 0 ? num + den / 2 : num - den / 2) / den);
+}
+
+
+/* Hamilton product a * b */
+static QuaternionQ30 multiply(const QuaternionQ30& a, const QuaternionQ30& b) {
+
+  const int64_t a0 = a.q[0], a1 = a.q[1], a2 = a.q[2], a3 = a.q[3];
+  const int64_t round = (int64_t)1 << 29;
+
+  QuaternionQ30 q;
+  q.q[0] = (q30_t)((a0 * b.q[0] - a1 * b.q[1] - a2 * b.q[2] - a3 * b.q[3] + round) >> 30);
+  q.q[1] = (q30_t)((a0 * b.q[1] + a1 * b.q[0] + a2 * b.q[3] - a3 * b.q[2] + round) >> 30);
+  q.q[2] = (q30_t)((a0 * b.q[2] - a1 * b.q[3] + a2 * b.q[0] + a3 * b.q[1] + round) >> 30);
+  q.q[3] = (q30_t)((a0 * b.q[3] + a1 * b.q[2] - a2 * b.q[1] + a3 * b.q[0] + round) >> 30);
+  return q;
+
+}
+
+
+/**
+ * normalizes a quaternion that is already close to unit length, with one
+ * Newton step of 1/sqrt(x) around 1: q *= (3 - |q|^2) / 2.
+ * The remaining error is quadratic in the length error, so there is no
+ * square root or division.
+ */
+static void normalize(QuaternionQ30& q) {
+
+  int64_t n2 = 0;
+  for (int i = 0; i < 4; i++) {
+    n2 += (int64_t)q.q[i] * q.q[i];
+  }
+
+  q30_t r = (q30_t)((((int64_t)3 << 60) - n2) >> 31);
+  for (int i = 0; i < 4; i++) {
+    q.q[i] = q30Mul(r, q.q[i]);
+  }
+
+}
+
+
+/**
+ * rotation quaternion of the gyro rates over deltaT, the equivalent of
+ * setFromAngleAxis(deltaT * |w|, w / |w|) in OrientationMath.cpp
+ */
+static QuaternionQ30 gyrDelta(const int32_t gyr[3], uint32_t deltaT,
+  const FixedGyrScale& scale) {
+
+  int64_t dt = clampDeltaT(deltaT);
+
+  // half rotation vector in rad
+  q30_t h[3];
+  int64_t n2 = 0;
+  for (int i = 0; i < 3; i++) {
+    h[i] = (q30_t)(((int64_t)gyr[i] * dt * scale.halfRad + ((int64_t)1 << 31)) >> 32);
+    n2 += (int64_t)h[i] * h[i];
+  }
+
+  QuaternionQ30 qDelta;
+  q30_t halfAngle = (q30_t)isqrt64((uint64_t)n2);
+  if (halfAngle == 0) {
+    return qDelta;
+  }
+
+  q30_t s, c;
+  q30SinCos(halfAngle, s, c);
+  qDelta.q[0] = c;
+  for (int i = 0; i < 3; i++) {
+    qDelta.q[i + 1] = divRound((int64_t)h[i] * s, halfAngle);
+  }
+  return qDelta;
+
+}
+
+
+bam_t computeAccPitchFixed(const int32_t acc[3]) {
+
+  // 15 fractional bits, |(ax, ay)| of 16 bit counts still fits 31 bits
+  int64_t ax = (int64_t)acc[0] << 15, ay = (int64_t)acc[1] << 15;
+  int32_t normXY = (int32_t)isqrt64((uint64_t)(ax * ax + ay * ay));
+  if (acc[1] < 0) {
+    normXY = -normXY;
+  }
+  return bamSub(0, fixedAtan2(acc[2] << 15, normXY));
+
+}
+
+
+bam_t computeAccRollFixed(const int32_t acc[3]) {
+
+  return bamSub(0, fixedAtan2(-acc[0], acc[1]));
+
+}
+
+
+bam_t computeFlatlandRollGyrFixed(bam_t flatlandRollGyrPrev,
+  const int32_t gyr[3], uint32_t deltaT, const FixedGyrScale& scale) {
+
+  return bamAdd(flatlandRollGyrPrev, rollIncrement(gyr, deltaT, scale));
+
+}
+
+
+bam_t computeFlatlandRollAccFixed(const int32_t acc[3]) {
+
+  return fixedAtan2(acc[0], acc[1]);
+
+}
+
+
+bam_t computeFlatlandRollCompFixed(bam_t flatlandRollCompPrev,
+  const int32_t gyr[3], bam_t flatlandRollAcc, uint32_t deltaT,
+  const FixedGyrScale& scale, q30_t alpha) {
+
+  // alpha * gyr + (1 - alpha) * acc, written as a step towards acc so it
+  // takes the shorter way around
+  bam_t rollGyr = bamAdd(flatlandRollCompPrev, rollIncrement(gyr, deltaT, scale));
+  return bamAdd(rollGyr, q30Mul(Q30_ONE - alpha, bamSub(flatlandRollAcc, rollGyr)));
+
+}
+
+
+void updateQuaternionGyrFixed(QuaternionQ30& q, const int32_t gyr[3],
+  uint32_t deltaT, const FixedGyrScale& scale) {
+
+  q = multiply(q, gyrDelta(gyr, deltaT, scale));
+  normalize(q);
+
+}
+
+
+void updateQuaternionCompFixed(QuaternionQ30& q, const int32_t gyr[3],
+  const int32_t acc[3], uint32_t deltaT, const FixedGyrScale& scale,
+  q30_t alpha) {
+
+  // integrate gyro
+  QuaternionQ30 qw = multiply(q, gyrDelta(gyr, deltaT, scale));
+  normalize(qw);
+
+  // acc in world, v' = v + w t + u x t with t = 2 u x v.
+  // counts are scaled to at most 0.87 so that t fits Q1.30
+  int64_t v[3] = {(int64_t)acc[0] << 14, (int64_t)acc[1] << 14, (int64_t)acc[2] << 14};
+  const int64_t w = qw.q[0], u[3] = {qw.q[1], qw.q[2], qw.q[3]};
+
+  int64_t t[3] = {
+    (u[1] * v[2] - u[2] * v[1]) >> 29,
+    (u[2] * v[0] - u[0] * v[2]) >> 29,
+    (u[0] * v[1] - u[1] * v[0]) >> 29
+  };
+  int64_t a[3] = {
+    v[0] + ((w * t[0] + u[1] * t[2] - u[2] * t[1]) >> 30),
+    v[1] + ((w * t[1] + u[2] * t[0] - u[0] * t[2]) >> 30),
+    v[2] + ((w * t[2] + u[0] * t[1] - u[1] * t[0]) >> 30)
+  };
+
+  // tilt angle between acc and the world y axis
+  int32_t normN = (int32_t)isqrt64((uint64_t)(a[0] * a[0] + a[2] * a[2]));
+  if (normN == 0) {
+    q = qw;
+    return;
+  }
+  bam_t phi = fixedAtan2(normN, (int32_t)a[1]);
+
+  // tilt correction quaternion, rotating by (1-alpha) phi about (-a_z, 0, a_x)
+  q30_t halfAngle = bamToRadQ30((bam_t)(((int64_t)phi * (Q30_ONE - alpha)) >> 31));
+  q30_t s, c;
+  q30SinCos(halfAngle, s, c);
+
+  QuaternionQ30 qt;
+  qt.q[0] = c;
+  qt.q[1] = divRound(-a[2] * s, normN);
+  qt.q[2] = 0;
+  qt.q[3] = divRound(a[0] * s, normN);
+
+  // update complementary filter
+  q = multiply(qt, qw);
+  normalize(q);
+
+}
@@ -0,0 +1,145 @@
+/**
+ * @file
+ * fixed-point implementation of the flatland roll and quaternion filters
+ * in OrientationMath.h, for boards without an FPU.
+ *
+ * The functions take raw MPU9250 counts as read by Imu::read(), so there
+ * is no float conversion anywhere in the loop:
+ * - gyr: Q24.8 counts, i.e. (Imu::gyrRaw << 8) minus the bias in 1/256
+ *   counts, so the bias keeps sub-count resolution
+ * - acc: raw counts, any scale works as only the direction is used
+ * - deltaT: microseconds, clamped to FIXED_MAX_DELTA_T
+ *
+ * Quaternions and alpha are Q1.30, roll and pitch angles binary angles,
+ * see FixedPoint.h. The math follows OrientationMath.cpp step by step,
+ * except that
+ * - the tilt angle is atan2(|n|, a_y) instead of acos(a_y / |a|), which
+ *   saves a square root and a division
+ * - the roll angles wrap around at +-180 degrees, and the flatland
+ *   complementary filter blends along the shorter arc
+ */
+
+#pragma once
+#include "FixedPoint.h"
+#include "Quaternion.h"
+
+// uncomment to run OrientationTracker on the fixed-point filters
+//#define VRDUINO_FIXED_POINT
+
+/* longest time step in us, keeps the gyro increments in 64 bit */
+#define FIXED_MAX_DELTA_T 32767
+
+
+/** Q1.30 unit quaternion, order w, x, y, z like Quaternion */
+struct QuaternionQ30 {
+
+  q30_t q[4];
+
+  QuaternionQ30() : q{Q30_ONE, 0, 0, 0} {}
+
+  /* converts to a floating point quaternion */
+  template <typename T>
+  QuaternionT<T> toQuaternion() const {
+    return QuaternionT<T>(T(fromQ30(q[0])), T(fromQ30(q[1])),
+      T(fromQ30(q[2])), T(fromQ30(q[3])));
+  }
+
+};
+
+
+/**
+ * conversion factors from gyro counts to angle increments for one gyro
+ * full scale range, see fixedGyrScale()
+ */
+struct FixedGyrScale {
+
+  /* Q1.30 half angle in rad per (Q24.8 count * us), times 2^32 */
+  uint32_t halfRad;
+
+  /* binary angle per (Q24.8 count * us), times 2^33 */
+  uint32_t bam;
+
+};
+
+
+/**
+ * @param[in] fullScaleDps - gyro full scale range in deg/s, i.e. the
+ *   rate of a count of 32767
+ * @returns conversion factors for the fixed-point filters
+ */
+FixedGyrScale fixedGyrScale(double fullScaleDps);
+
+
+/**
+ * @param[in] acc - raw acc counts (ax, ay, az)
+ * @returns pitch angle
+ */
+bam_t computeAccPitchFixed(const int32_t acc[3]);
+
+
+/**
+ * @param[in] acc - raw acc counts (ax, ay, az)
+ * @returns roll angle
+ */
+bam_t computeAccRollFixed(const int32_t acc[3]);
+
+
+/**
+ * get flatland roll from gyro measurements
+ * @param[in] flatlandRollGyrPrev - previous estimate
+ * @param[in] gyr - Q24.8 gyro counts, bias removed
+ * @param[in] deltaT - time since previous imu reading in us
+ * @param[in] scale - gyro conversion factors
+ * @returns new flatland roll
+ */
+bam_t computeFlatlandRollGyrFixed(bam_t flatlandRollGyrPrev,
+  const int32_t gyr[3], uint32_t deltaT, const FixedGyrScale& scale);
+
+
+/**
+ * gets flatland roll from acc measurements
+ * @param[in] acc - raw acc counts (ax, ay, az)
+ * @returns flatland roll
+ */
+bam_t computeFlatlandRollAccFixed(const int32_t acc[3]);
+
+
+/**
+ * gets flatland roll by complementary filtering
+ * @param[in] flatlandRollCompPrev - previous estimate
+ * @param[in] gyr - Q24.8 gyro counts, bias removed
+ * @param[in] flatlandRollAcc - flatland roll from acc
+ * @param[in] deltaT - time since previous imu reading in us
+ * @param[in] scale - gyro conversion factors
+ * @param[in] alpha - Q1.30 complementary filter alpha value
+ * @returns new flatland roll
+ */
+bam_t computeFlatlandRollCompFixed(bam_t flatlandRollCompPrev,
+  const int32_t gyr[3], bam_t flatlandRollAcc, uint32_t deltaT,
+  const FixedGyrScale& scale, q30_t alpha);
+
+
+/**
+ * update the quaternion estimate using imu gyro values
+ * @param[in, out] q - previous orientation estimate, updated in place
+ * @param[in] gyr - Q24.8 gyro counts, bias removed
+ * @param[in] deltaT - time since previous imu reading in us
+ * @param[in] scale - gyro conversion factors
+ */
+void updateQuaternionGyrFixed(QuaternionQ30& q, const int32_t gyr[3],
+  uint32_t deltaT, const FixedGyrScale& scale);
+
+
+/**
+ * update the quaternion estimate with complementary filtering of the
+ * gyro and acc values.
+ * @param[in, out] q - previous orientation estimate, updated in place
+ * @param[in] gyr - Q24.8 gyro counts, bias removed
+ * @param[in] acc - raw acc counts
+ * @param[in] deltaT - time since previous imu reading in us
+ * @param[in] scale - gyro conversion factors
+ * @param[in] alpha - Q1.30 complementary filter alpha value
+ */
+void updateQuaternionCompFixed(QuaternionQ30& q, const int32_t gyr[3],
+  const int32_t acc[3], uint32_t deltaT, const FixedGyrScale& scale,
+  q30_t alpha);
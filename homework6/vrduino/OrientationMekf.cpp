@@ -0,0 +1,215 @@
+#include "OrientationMekf.h"
+
+
+/** see documentation in header file */
+template <typename T>
+void mekfReset(MekfStateT<T>& state, bool estimateBias) {
+
+  state.estimateBias = estimateBias;
+  for (int i = 0; i < 6; i++) {
+    for (int j = 0; j < 6; j++) {
+      state.P[i][j] = 0;
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    state.bias[i] = 0;
+    state.uSum[i] = 0;
+    state.P[i][i] = T(MEKF_ANGLE_SIGMA * MEKF_ANGLE_SIGMA);
+    state.P[3 + i][3 + i] = estimateBias ? T(MEKF_BIAS_SIGMA * MEKF_BIAS_SIGMA) : T(0);
+  }
+  state.dtSum = 0;
+  state.dt2Sum = 0;
+  state.steps = 0;
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void mekfSetNoise(MekfStateT<T>& state, const T gyrVariance[3], const T accVariance[3]) {
+
+  T accMean = 0;
+  for (int i = 0; i < 3; i++) {
+    T gyrVar = (gyrVariance[i] > T(MEKF_MIN_GYR_VARIANCE)) ? gyrVariance[i] : T(MEKF_MIN_GYR_VARIANCE);
+    state.gyrNoise[i] = gyrVar * T(DEG_TO_RAD * DEG_TO_RAD);
+    accMean += accVariance[i] / 3;
+  }
+  if (accMean < T(MEKF_MIN_ACC_VARIANCE)) {
+    accMean = T(MEKF_MIN_ACC_VARIANCE);
+  }
+  state.accNoise = accMean / T(MEKF_GRAVITY * MEKF_GRAVITY);
+
+}
+
+
+/* B = (I - [u]x) X for a 3x3 block X with row stride 6 */
+template <typename T>
+static inline void rotateRows(const T u[3], const T* X, T B[3][3]) {
+  for (int j = 0; j < 3; j++) {
+    T x0 = X[j], x1 = X[6 + j], x2 = X[12 + j];
+    B[0][j] = x0 - (u[1] * x2 - u[2] * x1);
+    B[1][j] = x1 - (u[2] * x0 - u[0] * x2);
+    B[2][j] = x2 - (u[0] * x1 - u[1] * x0);
+  }
+}
+
+
+/**
+ * covariance propagation over the rotation u in rad, summed over
+ * deltaT = state.dtSum:
+ * P' = F P F^T + Q with F = [A, -deltaT I; 0, I] and A = I - [u]x, the
+ * first order rotation of the angle error. The full product is needed,
+ * dropping the u^2 terms lets the large yaw variance leak into the small
+ * tilt variances until P is no longer positive
+ */
+template <typename T>
+static void propagate(MekfStateT<T>& state, const T u[3]) {
+
+  T deltaT = state.dtSum;
+
+  T (*P)[6] = state.P;
+
+  // Ptt' = A Ptt A^T + Q, upper triangle, with B = A Ptt
+  T B[3][3];
+  rotateRows(u, &P[0][0], B);
+  // white gyro noise adds up over the steps
+  T dt2 = state.dt2Sum;
+  P[0][0] = B[0][0] - (u[1] * B[0][2] - u[2] * B[0][1]) + state.gyrNoise[0] * dt2;
+  P[1][1] = B[1][1] - (u[2] * B[1][0] - u[0] * B[1][2]) + state.gyrNoise[1] * dt2;
+  P[2][2] = B[2][2] - (u[0] * B[2][1] - u[1] * B[2][0]) + state.gyrNoise[2] * dt2;
+  P[0][1] = B[0][1] - (u[2] * B[0][0] - u[0] * B[0][2]);
+  P[0][2] = B[0][2] - (u[0] * B[0][1] - u[1] * B[0][0]);
+  P[1][2] = B[1][2] - (u[0] * B[1][1] - u[1] * B[1][0]);
+
+  if (state.estimateBias) {
+
+    // N = A Ptb
+    // Ptt' += -deltaT (N + N^T) + deltaT^2 Pbb
+    // Ptb' = N - deltaT Pbb
+    T N[3][3];
+    rotateRows(u, &P[0][3], N);
+    for (int i = 0; i < 3; i++) {
+      for (int j = i; j < 3; j++) {
+        P[i][j] += deltaT * deltaT * P[3 + i][3 + j] - deltaT * (N[i][j] + N[j][i]);
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        P[i][3 + j] = N[i][j] - deltaT * P[3 + i][3 + j];
+        P[3 + j][i] = P[i][3 + j];
+      }
+    }
+
+    // Pbb' = Pbb + Qb
+    T walk = T(MEKF_BIAS_WALK * MEKF_BIAS_WALK) * deltaT;
+    for (int i = 0; i < 3; i++) {
+      P[3 + i][3 + i] += walk;
+    }
+
+  }
+
+  // mirror the angle block
+  P[1][0] = P[0][1];
+  P[2][0] = P[0][2];
+  P[2][1] = P[1][2];
+
+}
+
+
+/** see documentation in header file */
+template <typename T>
+void updateQuaternionMekf(QuaternionT<T>& q, MekfStateT<T>& state, T gyr[3], T acc[3], T deltaT) {
+
+  // bias-corrected rates, integrated in deg/s like the other filters
+  T w[3];
+  for (int i = 0; i < 3; i++) {
+    w[i] = gyr[i] - T(RAD_TO_DEG) * state.bias[i];
+    state.uSum[i] += T(DEG_TO_RAD) * w[i] * deltaT;
+  }
+  integrateGyr(q, w, deltaT);
+  state.dtSum += deltaT;
+  state.dt2Sum += deltaT * deltaT;
+
+  if (++state.steps < MEKF_UPDATE_INTERVAL) {
+    return;
+  }
+
+  propagate(state, state.uSum);
+  for (int i = 0; i < 3; i++) {
+    state.uSum[i] = 0;
+  }
+  state.dtSum = 0;
+  state.dt2Sum = 0;
+  state.steps = 0;
+
+  T normA2 = acc[0]*acc[0] + acc[1]*acc[1] + acc[2]*acc[2];
+  if (normA2 < T(1e-16)) {
+    return;
+  }
+
+  // residual of the latest acc direction, and its noise with the share of
+  // the linear acceleration. A mean acc over the interval would lag
+  // behind q during fast turns
+  T normA = scalar::sqrt(normA2);
+  T invNormA = 1 / normA;
+  T up[3];
+  expectedUp(q, up);
+  T r[3] = {acc[0] * invNormA - up[0], acc[1] * invNormA - up[1], acc[2] * invNormA - up[2]};
+  T dynamic = normA * T(1 / MEKF_GRAVITY) - 1;
+  T noise = state.accNoise + dynamic * dynamic;
+
+  // H = [[up]x, 0], applied row by row
+  const T H[3][3] = {
+    {0, -up[2], up[1]},
+    {up[2], 0, -up[0]},
+    {-up[1], up[0], 0}
+  };
+
+  T (*P)[6] = state.P;
+  int n = state.estimateBias ? 6 : 3;
+  T x[6] = {0, 0, 0, 0, 0, 0};
+
+  for (int row = 0; row < 3; row++) {
+    const T* h = H[row];
+
+    // P H^T and the innovation variance
+    T PHt[6];
+    for (int j = 0; j < n; j++) {
+      PHt[j] = P[j][0] * h[0] + P[j][1] * h[1] + P[j][2] * h[2];
+    }
+    T s = h[0] * PHt[0] + h[1] * PHt[1] + h[2] * PHt[2] + noise;
+    T invS = 1 / s;
+
+    // x += K (r - H x), P -= K H P with K = P H^T / s
+    T innovation = (r[row] - h[0] * x[0] - h[1] * x[1] - h[2] * x[2]) * invS;
+    for (int j = 0; j < n; j++) {
+      x[j] += PHt[j] * innovation;
+      T k = PHt[j] * invS;
+      for (int l = j; l < n; l++) {
+        P[j][l] -= k * PHt[l];
+        P[l][j] = P[j][l];
+      }
+    }
+  }
+
+  // move the error into the orientation and bias
+  q *= QuaternionT<T>(1, x[0] / 2, x[1] / 2, x[2] / 2);
+  q.normalize();
+  if (state.estimateBias) {
+    for (int i = 0; i < 3; i++) {
+      state.bias[i] += x[3 + i];
+    }
+  }
+
+}
+
+
+// instantiate the functions above for float and double
+#define INSTANTIATE_ORIENTATION_MEKF(T) \
+  template void mekfReset<T>(MekfStateT<T>& state, bool estimateBias); \
+  template void mekfSetNoise<T>(MekfStateT<T>& state, const T gyrVariance[3], const T accVariance[3]); \
+  template void updateQuaternionMekf<T>(QuaternionT<T>& q, MekfStateT<T>& state, T gyr[3], T acc[3], \
+    T deltaT);
+
+INSTANTIATE_ORIENTATION_MEKF(float)
+INSTANTIATE_ORIENTATION_MEKF(double)
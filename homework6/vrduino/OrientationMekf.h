@@ -0,0 +1,117 @@
+/**
+ * @file
+ * multiplicative extended Kalman filter (MEKF) for the quaternion
+ * orientation, with gyro and acc.
+ *
+ * The orientation q itself is integrated from the gyro like in the other
+ * filters. The Kalman filter runs on the small rotation error dtheta of q
+ * in the imu frame, q_true = q * (1, dtheta / 2), and optionally on the
+ * gyro bias error, so the state is 3 or 6 long. After each acc update the
+ * error is moved into q and the bias and starts over at 0.
+ *
+ * The noise model comes from the measured variances, see
+ * OrientationTracker::measureImuBiasVariance():
+ * - gyro white noise, variance per axis, propagates into the angle error
+ * - acc direction noise, plus (|a| / g - 1)^2 while the imu accelerates,
+ *   so the filter trusts the acc less during motion
+ *
+ * All matrix products are written out for the fixed 3x3 blocks, and the
+ * three acc components are applied one after the other as scalar
+ * updates, so there is no matrix inverse.
+ * Yaw, the rotation about the up vector, is not observable from acc and
+ * drifts like the gyro-only estimate, as does the bias about up.
+ */
+
+#pragma once
+#include "OrientationMath.h"
+
+/* initial standard deviation of the angle error in rad, 30 degrees */
+#define MEKF_ANGLE_SIGMA 0.5
+
+/* initial standard deviation of the gyro bias in rad/s, 1 deg/s */
+#define MEKF_BIAS_SIGMA 0.0175
+
+/* gyro bias random walk in rad/s per sqrt(s) */
+#define MEKF_BIAS_WALK 1e-4
+
+/* noise floors in (deg/s)^2 and (m/s^2)^2, used until the variances are measured */
+#define MEKF_MIN_GYR_VARIANCE 0.01
+#define MEKF_MIN_ACC_VARIANCE 0.0025
+
+/**
+ * gyro samples per covariance update. The orientation integrates every
+ * gyro sample; the covariance propagation over the summed rotation and
+ * the acc correction run every MEKF_UPDATE_INTERVAL samples, which
+ * divides their cost. 4 is a 250 Hz update at 1 kHz
+ */
+#define MEKF_UPDATE_INTERVAL 4
+
+/* magnitude of gravity in m/s^2 */
+#define MEKF_GRAVITY 9.80665
+
+
+/** filter state besides the orientation */
+template <typename T>
+struct MekfStateT {
+
+  /* gyro bias estimate in rad/s, subtracted from the bias-free gyro values */
+  T bias[3];
+
+  /**
+   * error covariance, symmetric, blocks
+   * [angle-angle, angle-bias; bias-angle, bias-bias].
+   * Only the angle block is used without bias states
+   */
+  T P[6][6];
+
+  /* gyro variance per axis in (rad/s)^2 */
+  T gyrNoise[3];
+
+  /* variance of the unit acc direction */
+  T accNoise;
+
+  /* true to estimate the gyro bias */
+  bool estimateBias;
+
+  /* rotation in rad, time and squared time steps summed since the last update */
+  T uSum[3];
+  T dtSum;
+  T dt2Sum;
+  int steps;
+
+};
+
+
+/**
+ * resets the bias and the covariance to the initial uncertainty, and
+ * drops the rotation summed since the last update
+ * @param[in, out] state - filter state
+ * @param[in] estimateBias - true to run with gyro bias states
+ */
+template <typename T>
+void mekfReset(MekfStateT<T>& state, bool estimateBias);
+
+
+/**
+ * sets the noise model from measured imu variances, at most up to the
+ * floors MEKF_MIN_GYR/ACC_VARIANCE
+ * @param[in, out] state - filter state
+ * @param[in] gyrVariance - gyro variance per axis in (deg/s)^2
+ * @param[in] accVariance - acc variance per axis in (m/s^2)^2
+ */
+template <typename T>
+void mekfSetNoise(MekfStateT<T>& state, const T gyrVariance[3], const T accVariance[3]);
+
+
+/**
+ * update the quaternion estimate with the MEKF: integrate the gyro, and
+ * every MEKF_UPDATE_INTERVAL calls propagate the covariance and correct
+ * with the acc direction
+ * @param[in, out] q - previous orientation estimate, updated in place
+ * @param[in, out] state - filter state
+ * @param[in] gyr - current gyro values in deg/s
+ * @param[in] acc - current acc values in m/s^2
+ * @param[in] deltaT - time since previous imu reading in seconds
+ */
+template <typename T>
+void updateQuaternionMekf(QuaternionT<T>& q, MekfStateT<T>& state, T gyr[3], T acc[3], T deltaT);
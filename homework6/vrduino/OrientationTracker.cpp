@@ -1,32 +1,213 @@
 #include "OrientationTracker.h"
+#include "CpuIdle.h"
+#include "Profiler.h"
 
-OrientationTracker::OrientationTracker(double imuFilterAlphaIn,  bool simulateImuIn) :
+OrientationTracker::OrientationTracker(double imuFilterAlphaIn,  bool simulateImuIn,
+  EstimatorType estimatorTypeIn) :
 
   imu(),
+  imuCapture(),
+  imuSamplesProcessed(0),
+  imuFifo(false),
+  imuAsync(false),
+  imuBatch(),
+  imuBatchSize(0),
+  imuBatchIndex(0),
+  imuStepSamples(1),
+  imuStepCount(0),
+  imuStepRotation(),
+  imuStepAcc{0, 0, 0},
+  imuStepTime(0),
+  imuStepMag(false),
+  imuIdleRate(false),
+  imuIdle(false),
+  imuStillSamples(0),
+  imuActiveDivider(0),
+  imuActivePeriodMicros(1000),
+  imuIdleEntries(0),
+  imuIdleStartTicks(0),
+  imuIdleTicks(0),
+  imuIdleSamplesProcessed(0),
+  imuIdleSteps(0),
+  imuStillStartTicks(0),
+  imuStillStartBusTicks(0),
+  imuActiveTicks(0),
+  imuActiveBusTicks(0),
+  imuIdleStartBusTicks(0),
+  imuIdleBusTicks(0),
+  imuEstimatorSteps(0),
+  imuEstimatorTicks(0),
   gyr{0,0,0},
   acc{0,0,0},
+  mag{0,0,0},
+  magReady(false),
+  magReference{1,0},
+  magReferenceValid(false),
+  magFilterAlpha(1),
   gyrBias{0,0,0},
+  gyrBiasCounts{0,0,0},
   gyrVariance{0,0,0},
   accBias{0,0,0},
   accVariance{0,0,0},
-  previousTimeImu(0),
+  imuCalibrationRefresh(false),
+  imuRestWindow(),
+  imuRestSamples(),
+  imuRecalibrating(false),
+  imuCalibrationSavePending(false),
+  imuTempModel(),
+  gyrRestBias{0, 0, 0},
+  gyrRestCelsius(0),
+  imuCalibrationRefreshes(0),
+  savedImuCalibration(),
+  previousTicksImu(0),
   imuFilterAlpha(imuFilterAlphaIn),
   deltaT(0.0),
   simulateImu(simulateImuIn),
   simulateImuCounter(0),
+  simulateImuMicros(0),
   flatlandRollGyr(0),
   flatlandRollAcc(0),
   flatlandRollComp(0),
   quaternionGyr{1,0,0,0},
   eulerAcc{0,0,0},
+  estimator(estimatorTypeIn, Scalar(imuFilterAlphaIn)),
   quaternionComp{1,0,0,0}
 
   {
 
+  for (int i = 0; i < 3; i++) {
+    gyrScaleCounts[i] = imu.gyrScale[i] * Scalar(1.0 / 256.0);
+    accScaleCounts[i] = imu.accScale[i];
+  }
+
+#if defined(VRDUINO_FIXED_POINT)
+  for (int i = 0; i < 3; i++) {
+    gyrFixed[i] = 0;
+    accFixed[i] = 0;
+  }
+  deltaTFixed = 0;
+  imuFilterAlphaFixed = toQ30(imuFilterAlphaIn);
+  gyrScaleFixed = fixedGyrScale(imu.getConfig().gyrFullScaleDps);
+  flatlandRollGyrFixed = 0;
+  flatlandRollCompFixed = 0;
+#endif
+
 }
 
-void OrientationTracker::initImu() {
+void OrientationTracker::initImu(const ImuConfig& config, ImuBus *bus) {
+
+  if (bus != nullptr) {
+    imu.setBus(bus);
+  }
+  imu.setConfig(config);
   imu.init();
+
+  // the scales follow the ranges
+  for (int i = 0; i < 3; i++) {
+    gyrScaleCounts[i] = imu.gyrScale[i] * Scalar(1.0 / 256.0);
+    accScaleCounts[i] = imu.accScale[i];
+  }
+#if defined(VRDUINO_FIXED_POINT)
+  gyrScaleFixed = fixedGyrScale(imu.getConfig().gyrFullScaleDps);
+#endif
+  updateGyrBiasCounts();
+
+}
+
+void OrientationTracker::setImuStepSamples(int n) {
+
+#if defined(VRDUINO_FIXED_POINT)
+  // the fixed point filters take counts, not a combined rotation
+  n = 1;
+#endif
+  imuStepSamples = n < 1 ? 1 : n;
+  imuStepCount = 0;
+
+}
+
+bool OrientationTracker::initImuMagnetometer(double magFilterAlphaIn) {
+  magFilterAlpha = Scalar(magFilterAlphaIn);
+  magReferenceValid = false;
+  return imu.enableMagnetometer(true);
+}
+
+void OrientationTracker::initImuInterrupt(uint8_t pin) {
+  stopImuAsync();
+  if (imuFifo) {
+    imu.enableFifo(false);
+    imuFifo = false;
+  }
+  imuCapture.begin(&imu, pin);
+}
+
+void OrientationTracker::initImuFifo() {
+  stopImuAsync();
+  imuCapture.end();
+  imu.enableFifo(true);
+  imuFifo = true;
+  imuBatchSize = 0;
+  imuBatchIndex = 0;
+}
+
+void OrientationTracker::initImuAsync() {
+  imuCapture.end();
+  if (imuFifo) {
+    imu.enableFifo(false);
+    imuFifo = false;
+  }
+  imuAsync = true;
+  imu.startReadAsync();
+}
+
+void OrientationTracker::stopImuAsync() {
+  while (imu.isReadAsyncBusy()) {
+    CpuIdle::sleep();
+  }
+  imuAsync = false;
+}
+
+bool OrientationTracker::readImu(ImuSample& sample) {
+
+  if (imuCapture.isActive()) {
+
+    if (!imuCapture.pop(sample)) {
+      return false;
+    }
+
+  } else if (imuFifo) {
+
+    if (imuBatchIndex == imuBatchSize) {
+      imuBatchSize = imu.readFifo(imuBatch, Imu::fifoMaxFrames);
+      imuBatchIndex = 0;
+      if (imuBatchSize == 0) {
+        return false;
+      }
+    }
+    sample = imuBatch[imuBatchIndex++];
+
+  } else if (imuAsync) {
+
+    if (imu.isReadAsyncBusy()) {
+      return false;
+    }
+    bool fresh = imu.finishReadAsync(sample);
+    // the next read runs while the caller goes on
+    imu.startReadAsync();
+    if (!fresh) {
+      return false;
+    }
+
+  } else {
+
+    if (!imu.readRaw(sample)) {
+      return false;
+    }
+
+  }
+
+  imuSamplesProcessed++;
+  return true;
+
 }
 
 
@@ -35,59 +216,229 @@ void OrientationTracker::initImu() {
  */
 void OrientationTracker::measureImuBiasVariance() {
 
-  // Number of measurements
-  int N = 1000;
+  // running mean and variance of the raw counts, in double in either
+  // precision. Units come in once, at the end
+  ImuMoments moments;
+  ImuSample sample;
 
-  //init variables of recording sum of readings,
-  //and sum of squares of readings
-  double gyrSum[3] = {0, 0, 0};
-  double gyrSquaredSum[3] = {0, 0, 0};
+  while (moments.count() < imuCalibrationSamples) {
 
-  double accSum[3] = {0, 0, 0};
-  double accSquaredSum[3] = {0, 0, 0};
+    if (readImu(sample)) {
 
-  int nRead = 0;
+      moments.add(sample);
 
-  while (nRead < N) {
+    } else {
 
-    if (imu.read()) {
+      // sleep until the next sample, or the next ms when polling
+      CpuIdle::sleep();
 
-      //record sum of readings
-      gyrSum[0] += imu.gyrX;
-      gyrSum[1] += imu.gyrY;
-      gyrSum[2] += imu.gyrZ;
+    }
 
-      accSum[0] += imu.accX;
-      accSum[1] += imu.accY;
-      accSum[2] += imu.accZ;
+  }
 
-      //record sum of square of readings for
-      //variance calculation
-      gyrSquaredSum[0] += sq(imu.gyrX);
-      gyrSquaredSum[1] += sq(imu.gyrY);
-      gyrSquaredSum[2] += sq(imu.gyrZ);
+  setImuBiasVariance(moments);
+  setImuCalibrationRefresh(true);
 
-      accSquaredSum[0] += sq(imu.accX);
-      accSquaredSum[1] += sq(imu.accY);
-      accSquaredSum[2] += sq(imu.accZ);
+}
 
-      nRead++;
+void OrientationTracker::setImuBiasVariance(const ImuMoments& moments) {
+
+  //calculate the mean and variance
+  for (int i = 0; i < 3; i++) {
+
+    double gyrMean, gyrVar, accMean, accVar;
+    moments.gyrMeanVariance(i, gyrMean, gyrVar);
+    moments.accMeanVariance(i, accMean, accVar);
+
+    double gyrScale = double(imu.gyrScale[i]);
+    double accScale = double(imu.accScale[i]);
+
+    gyrBias[i] = gyrMean * gyrScale;
+    accBias[i] = accMean * accScale;
+
+    gyrVariance[i] = gyrVar * gyrScale * gyrScale;
+    accVariance[i] = accVar * accScale * accScale;
+
+    gyrRestBias[i] = gyrMean * gyrScale;
+
+  }
+  gyrRestCelsius = Imu::tempCelsius(moments.tempMean());
+
+  // noise model of the MEKF
+  estimator.setNoise(gyrVariance, accVariance);
+
+  updateGyrBiasCounts();
+
+}
+
+bool OrientationTracker::loadImuCalibration() {
+
+  ImuCalibration calibration;
+  if (!calibration.load()) {
+    return false;
+  }
+
+  // the bias was measured at the same full scale ranges, and the noise
+  // depends on them
+  for (int i = 0; i < 3; i++) {
+    if (calibration.gyrScale[i] != float(imu.gyrScale[i]) ||
+        calibration.accScale[i] != float(imu.accScale[i])) {
+      return false;
     }
+  }
 
+  double slope[3];
+  for (int i = 0; i < 3; i++) {
+    gyrBias[i] = calibration.gyrBias[i];
+    gyrVariance[i] = calibration.gyrVariance[i];
+    accBias[i] = calibration.accBias[i];
+    accVariance[i] = calibration.accVariance[i];
+    gyrRestBias[i] = calibration.gyrBias[i];
+    slope[i] = calibration.gyrTempSlope[i];
   }
+  gyrRestCelsius = calibration.gyrTempCelsius;
+  imuTempModel.restore(int(calibration.gyrTempWindows), gyrRestCelsius,
+    calibration.gyrTempVariance, gyrRestBias, slope);
+  estimator.setNoise(gyrVariance, accVariance);
+  updateGyrBiasCounts();
+
+  savedImuCalibration = calibration;
+  setImuCalibrationRefresh(true);
+  return true;
 
-  //calculate the mean and variance
+}
+
+void OrientationTracker::saveImuCalibration() {
+
+  // the bias at rest, with the temperature it holds at
+  ImuCalibration calibration;
   for (int i = 0; i < 3; i++) {
+    calibration.gyrBias[i] = float(gyrRestBias[i]);
+    calibration.gyrVariance[i] = float(gyrVariance[i]);
+    calibration.accBias[i] = float(accBias[i]);
+    calibration.accVariance[i] = float(accVariance[i]);
+    calibration.gyrScale[i] = float(imu.gyrScale[i]);
+    calibration.accScale[i] = float(imu.accScale[i]);
+    calibration.gyrTempSlope[i] = float(imuTempModel.slope(i));
+  }
+  calibration.gyrTempCelsius = float(gyrRestCelsius);
+  calibration.gyrTempVariance = float(imuTempModel.variance());
+  calibration.gyrTempWindows = float(imuTempModel.count());
+  calibration.save();
+  savedImuCalibration = calibration;
+  imuCalibrationSavePending = false;
 
-    gyrBias[i] = gyrSum[i]/N;
-    accBias[i] = accSum[i]/N;
+}
 
-    //Var(X) = E(X^2) - E(X)^2
-    gyrVariance[i] = gyrSquaredSum[i]/N - sq(gyrBias[i]);
-    accVariance[i] = accSquaredSum[i]/N - sq(accBias[i]);
+void OrientationTracker::setImuCalibrationRefresh(bool enable) {
+
+  imuCalibrationRefresh = enable;
+  imuRecalibrating = false;
+  imuRestWindow.reset();
+  imuRestSamples.reset();
+
+}
 
+void OrientationTracker::recalibrateImu() {
+
+  setImuCalibrationRefresh(true);
+  imuRecalibrating = true;
+
+}
+
+/* deg/s off the bias beyond which a quiet gyro is turning, not drifting */
+static const double imuRestMaxDriftDps = 1.0;
+
+/* deg/s and m/s^2, about the noise of the MPU9250 at a 184 Hz bandwidth,
+ * so rest is found also before a calibration, or on a noise-free axis */
+static const double imuRestGyrNoiseDps = 0.2;
+static const double imuRestAccNoise = 0.05;
+
+/* samples at rest before they refresh the bias, a quarter second */
+static const int imuRestMinSamples = 250;
+
+/* deg/s the bias moves before a refresh is saved, to spare the EEPROM,
+ * and deg/s per degree C the slope over the temperature moves */
+static const double imuCalibrationSaveDps = 0.05;
+static const double imuTempSlopeSaveDps = 0.005;
+
+/* windows at rest the temperature fit weighs, the last few minutes at rest */
+static const int imuTempWindows = 10000;
+
+void OrientationTracker::refreshImuCalibration(const ImuSample& sample) {
+
+  // integer sums only, the divisions once per window
+  imuRestWindow.add(sample);
+  if (imuRestWindow.count() < imuRestWindowSamples) {
+    return;
+  }
+
+  double celsius = Imu::tempCelsius(imuRestWindow.tempMean());
+
+  // at rest, the axes vary about as at the last calibration: twice their
+  // sum covers the spread of a window. A gyro off its bias is turning,
+  // unless the bias is measured again
+  double gyrNoise = imuRestGyrNoiseDps * imuRestGyrNoiseDps;
+  double accNoise = imuRestAccNoise * imuRestAccNoise;
+  double gyrSpread = 0;
+  double accSpread = 0;
+  double drift = 0;
+  double rate[3];
+  for (int i = 0; i < 3; i++) {
+    double gyrScale = double(imu.gyrScale[i]);
+    double accScale = double(imu.accScale[i]);
+    double mean, variance;
+    imuRestWindow.gyrMeanVariance(i, mean, variance);
+    rate[i] = mean * gyrScale;
+    gyrSpread += variance * gyrScale * gyrScale;
+    drift += (rate[i] - gyrBias[i]) * (rate[i] - gyrBias[i]);
+    imuRestWindow.accMeanVariance(i, mean, variance);
+    accSpread += variance * accScale * accScale;
+    gyrNoise += 2 * double(gyrVariance[i]);
+    accNoise += 2 * double(accVariance[i]);
+  }
+  bool rest = gyrSpread <= gyrNoise && accSpread <= accNoise &&
+    (imuRecalibrating || drift < imuRestMaxDriftDps * imuRestMaxDriftDps);
+
+  if (rest) {
+    imuTempModel.add(celsius, rate);
+    imuTempModel.limit(imuTempWindows);
+    imuRestSamples.merge(imuRestWindow);
+    imuRestSamples.limit(imuCalibrationSamples);
+  } else {
+    imuRestSamples.reset();
   }
+  imuRestWindow.reset();
 
+  int needed = imuRecalibrating ? imuCalibrationSamples : imuRestMinSamples;
+  if (imuRestSamples.count() < needed) {
+
+    // along the slope from the last bias at rest
+    if (imuTempModel.valid() && !imuRecalibrating) {
+      for (int i = 0; i < 3; i++) {
+        gyrBias[i] = gyrRestBias[i] + imuTempModel.slope(i) * (celsius - gyrRestCelsius);
+      }
+      updateGyrBiasCounts();
+    }
+    return;
+
+  }
+
+  setImuBiasVariance(imuRestSamples);
+  imuCalibrationRefreshes++;
+
+  // the bias at the saved temperature, and the slope
+  bool moved = imuRecalibrating;
+  for (int i = 0; i < 3; i++) {
+    double slope = imuTempModel.slope(i);
+    double bias = gyrRestBias[i] + slope * (savedImuCalibration.gyrTempCelsius - gyrRestCelsius);
+    moved |= fabs(bias - savedImuCalibration.gyrBias[i]) > imuCalibrationSaveDps;
+    moved |= fabs(slope - savedImuCalibration.gyrTempSlope[i]) > imuTempSlopeSaveDps;
+  }
+  // written by the sketch outside the imu task, see
+  // isImuCalibrationSavePending()
+  imuCalibrationSavePending |= moved;
+  imuRecalibrating = false;
 
 }
 
@@ -97,6 +448,17 @@ void OrientationTracker::setImuBias(double bias[3]) {
     gyrBias[i] = bias[i];
   }
 
+  updateGyrBiasCounts();
+
+}
+
+void OrientationTracker::updateGyrBiasCounts() {
+
+  // deg/s to Q24.8 counts
+  for (int i = 0; i < 3; i++) {
+    gyrBiasCounts[i] = (int32_t)lround(double(gyrBias[i]) * 256.0 / double(imu.gyrScale[i]));
+  }
+
 }
 
 void OrientationTracker::resetOrientation() {
@@ -108,7 +470,16 @@ void OrientationTracker::resetOrientation() {
   eulerAcc[0] = 0;
   eulerAcc[1] = 0;
   eulerAcc[2] = 0;
+  estimator.reset();
   quaternionComp = Quaternion();
+  magReferenceValid = false;
+
+#if defined(VRDUINO_FIXED_POINT)
+  flatlandRollGyrFixed = 0;
+  flatlandRollCompFixed = 0;
+  quaternionGyrFixed = QuaternionQ30();
+  quaternionCompFixed = QuaternionQ30();
+#endif
 
 }
 
@@ -117,7 +488,12 @@ bool OrientationTracker::processImu() {
   if (simulateImu) {
 
     //get imu values from simulation
-    updateImuVariablesFromSimulation();
+    if (!updateImuVariablesFromSimulation()) {
+
+      //the next simulated sample is not due yet
+      return false;
+
+    }
 
   } else {
 
@@ -132,15 +508,217 @@ bool OrientationTracker::processImu() {
   }
 
   //run orientation tracking algorithms
-  updateOrientation();
+  bool stepped = stepOrientation();
+
+  //integrate the rest of the samples queued by the interrupt,
+  //or of the FIFO batch
+  if (!simulateImu && imuCapture.isActive()) {
+    while (updateImuVariables()) {
+      stepped |= stepOrientation();
+    }
+  } else if (!simulateImu && imuFifo) {
+    while (imuBatchIndex < imuBatchSize && updateImuVariables()) {
+      stepped |= stepOrientation();
+    }
+  }
+
+  return stepped;
+
+}
+
+// still under these for imuIdleSamples samples in a row: idle
+static const double imuIdleGyrDps = 3.0;
+static const double imuIdleAccDeviation = 0.5;
+
+// 100 Hz while idle, and an estimator step per 10 samples
+static const uint8_t imuIdleRateDivider = 9;
+static const int imuIdleStepSamples = 10;
+
+bool OrientationTracker::stepOrientation() {
+
+  bool woke = updateMotion();
+  if (imuIdle) {
+    imuIdleSamplesProcessed++;
+  }
+
+  int n = imuIdle ? imuIdleStepSamples : imuStepSamples;
+#if defined(VRDUINO_FIXED_POINT)
+  n = 1;
+#endif
+  if (n <= 1 && imuStepCount == 0) {
+    updateOrientation();
+    return true;
+  }
+
+  if (imuStepCount == 0) {
+    imuStepRotation = Quaternion();
+    imuStepTime = 0;
+    imuStepMag = false;
+    for (int i = 0; i < 3; i++) {
+      imuStepAcc[i] = 0;
+    }
+  }
+
+  // each gyro sample rotates on from the ones before
+  integrateGyr(imuStepRotation, gyr, deltaT);
+  imuStepTime += deltaT;
+  for (int i = 0; i < 3; i++) {
+    imuStepAcc[i] += acc[i];
+  }
+  imuStepMag |= magReady;
+  // a sample in motion steps at once, with the still ones before it
+  if (++imuStepCount < n && !woke) {
+    return false;
+  }
+  int samples = imuStepCount;
+  imuStepCount = 0;
 
+  // the first sample of a run has no time to integrate over
+  if (imuStepTime <= 0) {
+    return false;
+  }
+  gyrFromRotation(imuStepRotation, imuStepTime, gyr);
+  deltaT = imuStepTime;
+  for (int i = 0; i < 3; i++) {
+    acc[i] = imuStepAcc[i] * (Scalar(1) / Scalar(samples));
+  }
+  magReady = imuStepMag;
+  updateOrientation();
   return true;
 
 }
 
-void OrientationTracker::updateImuVariablesFromSimulation() {
+void OrientationTracker::setImuIdleRate(bool enable) {
+
+  imuIdleRate = enable;
+  if (!enable && imuIdle) {
+    // restores the rate
+    updateMotion();
+  }
+
+}
+
+bool OrientationTracker::updateMotion() {
+
+  if (!imuIdleRate && !imuIdle) {
+    return false;
+  }
+
+  // squared magnitudes, no sqrt per sample
+  const Scalar gravity = Scalar(9.80665);
+  const Scalar gyrMax = Scalar(imuIdleGyrDps * imuIdleGyrDps);
+  const Scalar accMin = (gravity - Scalar(imuIdleAccDeviation)) * (gravity - Scalar(imuIdleAccDeviation));
+  const Scalar accMax = (gravity + Scalar(imuIdleAccDeviation)) * (gravity + Scalar(imuIdleAccDeviation));
+  Scalar gyrSquared = gyr[0]*gyr[0] + gyr[1]*gyr[1] + gyr[2]*gyr[2];
+  Scalar accSquared = acc[0]*acc[0] + acc[1]*acc[1] + acc[2]*acc[2];
+  bool still = gyrSquared < gyrMax && accSquared > accMin && accSquared < accMax &&
+    imuIdleRate && !imuRecalibrating;
+
+  if (!still) {
+    imuStillSamples = 0;
+    if (!imuIdle) {
+      return false;
+    }
+    // the full rate from the next sample
+    imuIdle = false;
+    imuIdleTicks += previousTicksImu - imuIdleStartTicks;
+    imuIdleBusTicks += imu.readTicks - imuIdleStartBusTicks;
+    setImuRateDivider(imuActiveDivider);
+    return true;
+  }
+
+  // the bus time of the still samples at the full rate, the baseline of
+  // the idle time after them
+  if (!imuIdle && imuStillSamples == 0) {
+    imuStillStartTicks = previousTicksImu;
+    imuStillStartBusTicks = imu.readTicks;
+  }
+  if (!imuIdle && ++imuStillSamples >= imuIdleSamples) {
+    imuIdle = true;
+    imuIdleEntries++;
+    imuIdleStartTicks = previousTicksImu;
+    imuActiveTicks += previousTicksImu - imuStillStartTicks;
+    imuActiveBusTicks += imu.readTicks - imuStillStartBusTicks;
+    imuIdleStartBusTicks = imu.readTicks;
+    imuActiveDivider = imu.getConfig().sampleRateDivider;
+    imuActivePeriodMicros = imu.samplePeriodMicros;
+    setImuRateDivider(imuActiveDivider > imuIdleRateDivider ? imuActiveDivider : imuIdleRateDivider);
+  }
+  return false;
+
+}
+
+void OrientationTracker::setImuRateDivider(uint8_t divider) {
 
-    deltaT = 0.002;
+  if (simulateImu) {
+    return;
+  }
+  // the background read has the bus until it ends
+  while (imu.isReadAsyncBusy()) {
+    CpuIdle::sleep();
+  }
+  // the ISR reads the imu on the same bus, hold off only it
+  if (imuCapture.isActive()) {
+    imuCapture.mask();
+  }
+  imu.setSampleRateDivider(divider);
+  if (imuCapture.isActive()) {
+    imuCapture.unmask();
+  }
+
+}
+
+uint64_t OrientationTracker::getImuIdleMicros() const {
+  uint64_t ticks = imuIdleTicks + (imuIdle ? previousTicksImu - imuIdleStartTicks : 0);
+  return ticks / TickClock::ticksPerMicro;
+}
+
+uint32_t OrientationTracker::getImuSamplesSkipped() const {
+  // the samples of the idle time at the full rate, less the ones taken
+  uint64_t full = getImuIdleMicros() / imuActivePeriodMicros;
+  return full > imuIdleSamplesProcessed ? uint32_t(full - imuIdleSamplesProcessed) : 0;
+}
+
+uint32_t OrientationTracker::getImuStepsSkipped() const {
+  uint64_t full = getImuIdleMicros() / imuActivePeriodMicros / imuStepSamples;
+  return full > imuIdleSteps ? uint32_t(full - imuIdleSteps) : 0;
+}
+
+uint64_t OrientationTracker::getImuBusMicrosFreed() const {
+
+  if (imuActiveTicks == 0) {
+    return 0;
+  }
+  uint64_t idleTicks = imuIdleTicks + (imuIdle ? previousTicksImu - imuIdleStartTicks : 0);
+  uint64_t busTicks = imuIdleBusTicks + (imuIdle ? imu.readTicks - imuIdleStartBusTicks : 0);
+  double full = double(idleTicks) * double(imuActiveBusTicks) / double(imuActiveTicks);
+  return full > busTicks ? uint64_t((full - busTicks) / TickClock::ticksPerMicro) : 0;
+
+}
+
+double OrientationTracker::getImuEstimatorMicros() const {
+  return imuEstimatorSteps > 0 ?
+    double(imuEstimatorTicks) / imuEstimatorSteps / TickClock::ticksPerMicro : 0;
+}
+
+double OrientationTracker::getImuReadMicros() const {
+  return imu.readSamples > 0 ?
+    double(imu.readTicks) / imu.readSamples / TickClock::ticksPerMicro : 0;
+}
+
+bool OrientationTracker::updateImuVariablesFromSimulation() {
+
+    //a sample per 2 ms, as recorded
+    uint32_t now = micros();
+    if (now - simulateImuMicros < 2000) {
+      return false;
+    }
+    simulateImuMicros += 2000;
+    if (now - simulateImuMicros >= 2000) {
+      simulateImuMicros = now;
+    }
+
+    deltaT = Scalar(0.002);
     //get simulated imu values from external file
     for (int i = 0; i < 3; i++) {
       gyr[i] = imuData[simulateImuCounter + i];
@@ -152,8 +730,16 @@ void OrientationTracker::updateImuVariablesFromSimulation() {
     simulateImuCounter += 3;
     simulateImuCounter = simulateImuCounter % nImuSamples;
 
-    //simulate delay
-    delay(1);
+#if defined(VRDUINO_FIXED_POINT)
+    // back to the counts Imu::read() would have returned
+    deltaTFixed = 2000;
+    for (int i = 0; i < 3; i++) {
+      gyrFixed[i] = (int32_t)lround(double(gyr[i]) * (32767.0 * 256.0 / imu.getConfig().gyrFullScaleDps));
+      accFixed[i] = (int32_t)lround(double(acc[i]) * (32767.0 / (9.80665 * imu.getConfig().accFullScaleG)));
+    }
+#endif
+
+    return true;
 
 }
 
@@ -163,30 +749,54 @@ void OrientationTracker::updateImuVariablesFromSimulation() {
 bool OrientationTracker::updateImuVariables() {
 
   //sample imu values
-  if (!imu.read()) {
+  ImuSample sample;
+  if (!readImu(sample)) {
   // return if there's no data
     return false;
   }
+  if (imuCalibrationRefresh) {
+    refreshImuCalibration(sample);
+  }
+  uint64_t currentTicksImu = sample.ticks;
 
-  double currentTimeImu = micros()/1000000.0;
-
-  if (previousTimeImu == 0.0) {
+  if (previousTicksImu == 0) {
   // first reading, set prev time to current
-    previousTimeImu = currentTimeImu;
+    previousTicksImu = currentTicksImu;
   }
 
-  // Compute the elapsed time from the previous iteration
-  deltaT = currentTimeImu - previousTimeImu;
-  previousTimeImu = currentTimeImu;
+  // Compute the elapsed time from the previous sample, in 32 bits, a
+  // gap of over 89 s is meaningless to integrate anyway. One
+  // multiplication in Scalar, no division and no double
+  uint64_t elapsedTicks = currentTicksImu - previousTicksImu;
+  uint32_t deltaTicks = elapsedTicks > UINT32_MAX ? UINT32_MAX : uint32_t(elapsedTicks);
+  previousTicksImu = currentTicksImu;
+  deltaT = Scalar(deltaTicks) * Scalar(TickClock::secondsPerTick);
+
+  // remove bias from the gyro counts, in integers, then one
+  // multiplication per axis to deg/s and m/s^2
+  int32_t gyrCounts[3];
+  for (int i = 0; i < 3; i++) {
+    gyrCounts[i] = ((int32_t)sample.gyr[i] << 8) - gyrBiasCounts[i];
+    gyr[i] = Scalar(gyrCounts[i]) * gyrScaleCounts[i];
+    acc[i] = Scalar(sample.acc[i]) * accScaleCounts[i];
+  }
 
-  // remove bias from the gyro measurements
-  gyr[0] = imu.gyrX - gyrBias[0];
-  gyr[1] = imu.gyrY - gyrBias[1];
-  gyr[2] = imu.gyrZ - gyrBias[2];
+  // uT, on a new magnetometer measurement
+  magReady = sample.magReady;
+  if (magReady) {
+    for (int i = 0; i < 3; i++) {
+      mag[i] = Scalar(sample.mag[i]) * imu.magScale[i];
+    }
+  }
+
+#if defined(VRDUINO_FIXED_POINT)
+  deltaTFixed = deltaTicks / TickClock::ticksPerMicro;
 
-  acc[0] = imu.accX;
-  acc[1] = imu.accY;
-  acc[2] = imu.accZ;
+  for (int i = 0; i < 3; i++) {
+    gyrFixed[i] = gyrCounts[i];
+    accFixed[i] = sample.acc[i];
+  }
+#endif
 
   return true;
 
@@ -198,6 +808,37 @@ bool OrientationTracker::updateImuVariables() {
  */
 void OrientationTracker::updateOrientation() {
 
+  PROFILE_SCOPE(PROFILE_ORIENTATION);
+
+  uint64_t start = TickClock::now();
+
+#if defined(VRDUINO_FIXED_POINT)
+
+  bam_t flatlandRollAccFixed = computeFlatlandRollAccFixed(accFixed);
+
+  flatlandRollGyrFixed = computeFlatlandRollGyrFixed(
+    flatlandRollGyrFixed, gyrFixed, deltaTFixed, gyrScaleFixed);
+
+  flatlandRollCompFixed = computeFlatlandRollCompFixed(
+    flatlandRollCompFixed, gyrFixed, flatlandRollAccFixed, deltaTFixed,
+    gyrScaleFixed, imuFilterAlphaFixed);
+
+  updateQuaternionGyrFixed(quaternionGyrFixed, gyrFixed, deltaTFixed, gyrScaleFixed);
+
+  updateQuaternionCompFixed(quaternionCompFixed, gyrFixed, accFixed,
+    deltaTFixed, gyrScaleFixed, imuFilterAlphaFixed);
+
+  // floating point copies for the getters
+  flatlandRollGyr = Scalar(bamToDeg(flatlandRollGyrFixed));
+  flatlandRollAcc = Scalar(bamToDeg(flatlandRollAccFixed));
+  flatlandRollComp = Scalar(bamToDeg(flatlandRollCompFixed));
+  quaternionGyr = quaternionGyrFixed.toQuaternion<Scalar>();
+  eulerAcc[0] = Scalar(bamToDeg(computeAccPitchFixed(accFixed)));
+  eulerAcc[2] = Scalar(bamToDeg(computeAccRollFixed(accFixed)));
+  quaternionComp = quaternionCompFixed.toQuaternion<Scalar>();
+
+#else
+
   //flatland roll estimate
   flatlandRollGyr = computeFlatlandRollGyr(
     flatlandRollGyr, gyr, deltaT);
@@ -214,7 +855,46 @@ void OrientationTracker::updateOrientation() {
   eulerAcc[0] = computeAccPitch(acc);
   eulerAcc[2] = computeAccRoll(acc);
 
-  //performs quaternion complementary filtering with gyro and acc values
-  updateQuaternionComp(quaternionComp, gyr, acc, deltaT, imuFilterAlpha);
+  //estimates quaternion orientation from gyro and acc values,
+  //with complementary filtering by default
+  estimator.update(gyr, acc, deltaT);
+
+  //pulls the yaw towards the magnetometer heading
+  updateHeading();
+  quaternionComp = estimator.getQuaternion();
+
+#endif
+
+  imuEstimatorSteps++;
+  if (imuIdle) {
+    imuIdleSteps++;
+  }
+  imuEstimatorTicks += TickClock::now() - start;
+
+}
+
+
+void OrientationTracker::updateHeading() {
+
+  if (!magReady) {
+    return;
+  }
+  magReady = false;
+
+  // the field in the world frame of the estimate, after its tilt correction
+  Scalar m[3];
+  estimator.getQuaternion().rotateVector(mag, m);
+
+  if (magReferenceValid) {
+    estimator.correctHeading(m, magReference, magFilterAlpha);
+    return;
+  }
+
+  Scalar normH = scalar::sqrt(m[0]*m[0] + m[2]*m[2]);
+  if (normH > Scalar(1e-8)) {
+    magReference[0] = m[0] / normH;
+    magReference[1] = m[2] / normH;
+    magReferenceValid = true;
+  }
 
 }
@@ -2,9 +2,16 @@
  * @class OrientationTracker
  * This class performs orientation tracking using values from the IMU.
  * Overview:
- * - samples data from the imu.
+ * - samples data from the imu, by polling once per processImu(), from
+ * the data ready interrupt after initImuInterrupt(), see ImuCapture.h,
+ * in batches from the imu FIFO after initImuFifo(), or with background
+ * reads that overlap the rest of loop() after initImuAsync()
  * - performs complementary filtering to estimate orientation
  * in either  euler angles or quaternion
+ * - corrects the yaw drift of the quaternion estimate with the
+ * magnetometer after initImuMagnetometer()
+ * - estimates the quaternion orientation with the estimator selected
+ * in the constructor or with setEstimator(), see OrientationEstimator.h
  * - calls functions from Quaternion for quaternion math
  * - calls functions from OrientationMath for complementary filtering
  *
@@ -18,12 +25,29 @@
  * - gyro and acc values (after preprocessing)
  * - gyro bias and variance
  *
+ * The bias and variance come from measureImuBiasVariance(), or from the
+ * calibration saved in EEPROM, see loadImuCalibration(). Either way they
+ * then follow the samples at rest, without pausing the tracking, see
+ * setImuCalibrationRefresh(), and the die temperature in motion.
+ *
+ * With setImuIdleRate(), a still imu samples at 100 Hz and steps the
+ * estimator ten times a second, until the first sample in motion.
+ *
+ * With VRDUINO_FIXED_POINT defined, the filters run on the raw imu counts
+ * in OrientationMathFixed.h instead, and the estimates are converted to
+ * Scalar only for the get..() functions. The quaternion estimate is then
+ * always the complementary filter.
+ *
  */
 
 #pragma once
 #include "Imu.h"
+#include "ImuCalibration.h"
+#include "ImuCapture.h"
 #include "Quaternion.h"
+#include "OrientationEstimator.h"
 #include "OrientationMath.h"
+#include "OrientationMathFixed.h"
 #include "simulatedImuData.h"
 
 class OrientationTracker {
@@ -35,43 +59,195 @@ class OrientationTracker {
      * @param [in] imuFilterAlpha - alpha value [0,1] for complementary filter
      *   1: ignore tilt correction from acc. 0: use full tilt correction from acc
      * @param [in] simulateImu - if true, get imu values from external file
+     * @param [in] estimatorType - quaternion orientation estimator
      */
-    OrientationTracker(double imuFilterAlpha, bool simulateImu) ;
+    OrientationTracker(double imuFilterAlpha, bool simulateImu,
+      EstimatorType estimatorType = VRDUINO_ESTIMATOR) ;
 
 
     /**
      * samples and processes imu data.
      * updates the quaternion, and euler
+     * with the interrupt capture or the FIFO, processes all pending samples
      * @returns true if sampling processing was successful,
-     * false, if no data was available.
+     * false, if no data was available, or no step of
+     * setImuStepSamples() completed
      */
     bool processImu();
 
 
-    /** initializes Imu */
-    void initImu();
+    /**
+     * initializes Imu, with the output data rate, filters and ranges of
+     * config, see ImuConfig. The default is 1 kHz at the full ranges
+     * @param [in] bus - link to the imu, nullptr to choose it as
+     *   Imu::init() does
+     */
+    void initImu(const ImuConfig& config = ImuConfig(), ImuBus *bus = nullptr);
+
+
+    /**
+     * runs the estimator once per n imu samples instead of per sample:
+     * the gyro samples in between are integrated into the rotation of the
+     * step, which reaches the estimator as the rates of one step of their
+     * combined time, see gyrFromRotation(), with the mean acc. At 8 kHz,
+     * n = 8 keeps the cost of the estimator at that of 1 kHz and the
+     * gyro integration at 8 kHz. 1 by default, always 1 with
+     * VRDUINO_FIXED_POINT
+     */
+    void setImuStepSamples(int n);
+
+
+    /**
+     * lowers the imu output rate and the estimator rate while the imu is
+     * still, off by default. After imuIdleSamples samples with the
+     * bias-free gyro under 3 deg/s and the acc within 0.5 m/s^2 of g, the
+     * imu samples at 100 Hz (or slower, at its own divider) and the
+     * estimator steps once per 10 of them, their rotation pre-integrated
+     * as with setImuStepSamples(). The first sample over either threshold
+     * restores the rate, and steps the estimator with it and the samples
+     * pending. Stays at the full rate during recalibrateImu(). See
+     * getImuSamplesSkipped() for the time freed
+     */
+    void setImuIdleRate(bool enable);
+
+
+    /** @returns true while the imu is still at the lower rate */
+    bool isImuIdle() const { return imuIdle; }
+
+
+    /**
+     * @returns us between imu samples at the current rate, of the
+     * ImuConfig of initImu() or the idle rate, to poll the imu at
+     */
+    uint32_t getImuSamplePeriodMicros() const { return imu.samplePeriodMicros; }
+
+
+    /** still samples before the rate is lowered, 0.5 s at 1 kHz */
+    static const int imuIdleSamples = 500;
+
+
+    /**
+     * starts sampling the imu from its data ready interrupt, call after
+     * initImu(). From then on the imu is only read through the queue
+     * @param [in] pin - Teensy pin wired to the imu INT line
+     */
+    void initImuInterrupt(uint8_t pin = IMU_INTERRUPT_PIN);
+
+
+    /**
+     * starts sampling the imu in batches from its FIFO, call after
+     * initImu(). Stops the interrupt capture
+     */
+    void initImuFifo();
+
+
+    /**
+     * starts sampling the imu with background reads, call after
+     * initImu(). Each processImu() takes the read started by the previous
+     * one and starts the next, which then runs on the I2C interrupt while
+     * loop() does the lighthouse and serial work, see Imu::startReadAsync().
+     * Stops the interrupt capture and the FIFO
+     */
+    void initImuAsync();
+
+
+    /**
+     * turns the magnetometer on, see Imu::enableMagnetometer(), call
+     * after initImu() and before the other init..() functions. Each new
+     * measurement then pulls the yaw of the quaternion estimate towards
+     * the heading of the first one after resetOrientation(), for every
+     * estimator. Not in the fixed-point build
+     * @param [in] magFilterAlpha - alpha value [0,1] per measurement, at
+     *   100 Hz. 1: ignore the magnetometer
+     * @returns false if the magnetometer does not answer
+     */
+    bool initImuMagnetometer(double magFilterAlpha = 0.99);
 
 
     /**
      * measures Imu bias and variance.
      * updates the gyrBias and gyrVariance fields.
      * updates the accBias and accVariance fields.
+     * the variances are the noise model of the MEKF estimator.
      * the order of elements is [x-axis, y-axis, z-axis],
      * i.e. gyrBias[0] is the gyro bias of the x-axis
      *
      * steps to sample from imu:
-     * - call imu.read() to sample IMU
-     * - if it returns true, get values from
-     *   imu.gyrX, imu.gyrY, imu.gyrZ,
-     *   imu.accX, imu.accY, imu.accZ,
+     * - call readImu() to sample IMU
+     * - if it returns true, add the raw counts of the sample to the
+     *   running mean and variance, see Welford
+     * - scale mean and variance to physical units once at the end
+     *
+     * Holds the caller for imuCalibrationSamples samples, only for a
+     * first calibration, see recalibrateImu(). Starts the background
+     * refresh, see setImuCalibrationRefresh()
      */
     void measureImuBiasVariance();
 
 
+    /**
+     * loads the bias and variance saved by saveImuCalibration(), instead
+     * of measuring them for a second at boot, see ImuCalibration.h.
+     * Starts the background refresh, see setImuCalibrationRefresh()
+     * @returns false if there is no valid calibration in EEPROM, or it
+     *   was measured at other full scale ranges
+     */
+    bool loadImuCalibration();
+
+
+    /** saves the bias, variance and scales to EEPROM */
+    void saveImuCalibration();
+
+
+    /**
+     * @returns true if the refresh moved the calibration far enough to
+     *   save it. It does not write the EEPROM itself, a write of ms in
+     *   the imu task would hold off the next samples: the sketch calls
+     *   saveImuCalibration() from a task of its own, which clears this
+     */
+    bool isImuCalibrationSavePending() const { return imuCalibrationSavePending; }
+
+
+    /**
+     * estimates the bias and variance online from the processed samples,
+     * while tracking goes on. Each window of imuRestWindowSamples is at
+     * rest if its mean gyro is within 1 deg/s of the bias, and the gyro
+     * and acc axes are about as quiet as calibrated. The
+     * windows at rest since the last motion are merged into a running
+     * mean and variance, that weighs the last imuCalibrationSamples
+     * samples, and set the bias and variance from a quarter second on.
+     * The windows at rest also fit the gyro bias over the die
+     * temperature, see ImuTempModel. Once it has a slope, each window
+     * not refreshed moves the bias along it from the last one at rest,
+     * so it follows the warm-up also in motion. Asks to save them to
+     * EEPROM when the gyro bias at the saved temperature moved by over
+     * 0.05 deg/s, or the slope by over 0.005 deg/s per degree C, see
+     * isImuCalibrationSavePending()
+     */
+    void setImuCalibrationRefresh(bool enable);
+
+
+    /**
+     * measures the bias again, without pausing the tracking: the next
+     * imuCalibrationSamples samples at rest set the bias and variance,
+     * however far from the old bias, and ask to save them. Then the refresh
+     * goes on. Keep the imu still meanwhile
+     */
+    void recalibrateImu();
+
+
+    /** samples of a bias measurement, and the weight of the refresh */
+    static const int imuCalibrationSamples = 1000;
+
+
+    /** samples of a window of the rest detection */
+    static const int imuRestWindowSamples = 50;
+
+
     /**
      * sets the Imu bias
      * @param [in] bias - copy the bias values in this array into
-     *  this class' gyrBias variable
+     *  this class' gyrBias variable, in deg/s
      */
     void setImuBias(double bias[3]);
 
@@ -82,29 +258,42 @@ class OrientationTracker {
     void resetOrientation();
 
 
+    /**
+     * switches the quaternion orientation estimator, keeping the
+     * current estimate
+     */
+    void setEstimator(EstimatorType type) { estimator.setType(type); }
+
+
+    /**
+     * @returns the quaternion orientation estimator in use
+     */
+    EstimatorType getEstimator() const { return estimator.getType(); }
+
+
     /**
      * @returns flatland roll estimate from gyro readings
      */
-    double getFlatLandRollGyr() { return flatlandRollGyr; }
+    Scalar getFlatLandRollGyr() { return flatlandRollGyr; }
 
 
     /**
      * @returns flatland roll estimate from acc readings
      */
-    double getFlatLandRollAcc() { return flatlandRollAcc; }
+    Scalar getFlatLandRollAcc() { return flatlandRollAcc; }
 
 
     /**
      * @returns flatland roll estimate from complementary filter
      */
-    double getFlatLandRollComp() { return flatlandRollComp; }
+    Scalar getFlatLandRollComp() { return flatlandRollComp; }
 
 
     /**
      * @returns read-only reference to euler angles array
      * order is pitch (x), yaw (y), roll (z)
      */
-    const double* getEulerAcc() const { return eulerAcc; };
+    const Scalar* getEulerAcc() const { return eulerAcc; };
 
 
     /**
@@ -114,7 +303,8 @@ class OrientationTracker {
 
 
     /**
-     * @returns read-only reference to quaternion from comp filter
+     * @returns read-only reference to quaternion from the orientation
+     * estimator, the comp filter by default
      */
     const Quaternion& getQuaternionComp() const { return quaternionComp; };
 
@@ -123,57 +313,156 @@ class OrientationTracker {
      * @returns read-only reference to accelerometer values,
      * order is ax,ay,az
      */
-    const double* getAcc() const { return acc; };
+    const Scalar* getAcc() const { return acc; };
 
 
     /**
      * @returns read-only reference to gyroscope values,
      * order is wx, wy, wz
      */
-    const double* getGyr() const { return gyr; };
+    const Scalar* getGyr() const { return gyr; };
+
+
+    /**
+     * @returns read-only reference to magnetometer values in uT, of the
+     * latest measurement, order is mx, my, mz
+     */
+    const Scalar* getMag() const { return mag; };
 
 
     /**
      * @returns read-only reference to gyroscope bias values
      * order is wx, wy, wz
      */
-    const double* getGyrBias() const { return gyrBias; };
+    const Scalar* getGyrBias() const { return gyrBias; };
 
 
     /**
      * @returns read-only reference to gyroscope variance values,
      * order is wx, wy, wz
      */
-    const double* getGyrVariance() const { return gyrVariance; };
+    const Scalar* getGyrVariance() const { return gyrVariance; };
 
 
     /**
      * @returns read-only reference to accelerometer bias values
      * order is ax, ay, az
      */
-    const double* getAccBias() const { return accBias; };
+    const Scalar* getAccBias() const { return accBias; };
 
 
     /**
      * @returns read-only reference to accelerometer variance values,
      * order is ax, ay, az
      */
-    const double* getAccVariance() const { return accVariance; };
+    const Scalar* getAccVariance() const { return accVariance; };
+
+
+    /**
+     * @returns the interrupt capture, with its captured, dropped and
+     * missed sample counters
+     */
+    const ImuCapture& getImuCapture() const { return imuCapture; };
+
+
+    /**
+     * @returns number of imu samples processed, by processImu() and by
+     * measureImuBiasVariance()
+     */
+    uint32_t getImuSamplesProcessed() const { return imuSamplesProcessed; };
+
+
+    /**
+     * @returns number of background refreshes of the bias and variance,
+     * see setImuCalibrationRefresh()
+     */
+    uint32_t getImuCalibrationRefreshes() const { return imuCalibrationRefreshes; };
+
+
+    /**
+     * @returns the fit of the gyro bias over the die temperature, see
+     * setImuCalibrationRefresh()
+     */
+    const ImuTempModel& getImuTempModel() const { return imuTempModel; };
+
+
+    /**
+     * @returns number of imu FIFO overflows, see Imu::readFifo()
+     */
+    uint32_t getImuFifoOverflows() const { return imu.fifoOverflows; };
+
+
+    /**
+     * @returns number of times and us the imu was idle, see
+     * setImuIdleRate(), and the samples processed meanwhile
+     */
+    uint32_t getImuIdleEntries() const { return imuIdleEntries; };
+    uint64_t getImuIdleMicros() const;
+    uint32_t getImuIdleSamples() const { return imuIdleSamplesProcessed; };
+
+
+    /**
+     * @returns the samples the imu would have taken at its full rate while
+     * idle, but did not, and the estimator steps that did not run
+     * meanwhile: the cpu time freed is the steps at getImuEstimatorMicros()
+     * each
+     */
+    uint32_t getImuSamplesSkipped() const;
+    uint32_t getImuStepsSkipped() const;
+
+
+    /**
+     * @returns us of bus time freed while idle: the bus time per second of
+     * the still samples at the full rate before each idle period, over the
+     * idle time, less the bus time the reads took meanwhile, empty polls
+     * included. Polled at the full rate while idle, only the polls that
+     * find no sample are shorter, see Imu::setStatusBurst(), so the imu
+     * task of vrduino.ino polls at getImuSamplePeriodMicros()
+     */
+    uint64_t getImuBusMicrosFreed() const;
+
+
+    /**
+     * @returns mean us of an estimator step, all of updateOrientation(),
+     * and of the bus time per sample read from the imu, the empty polls
+     * included, 0 before the first
+     */
+    double getImuEstimatorMicros() const;
+    double getImuReadMicros() const;
+
+
+    /** @returns number of estimator steps, see setImuStepSamples() */
+    uint32_t getImuEstimatorSteps() const { return imuEstimatorSteps; };
 
 
   protected:
 
+    /**
+     * reads the next imu sample in raw counts, from the interrupt capture
+     * queue if it runs, from the current FIFO batch, reading the next
+     * batch when it is used up, from the ended background read, starting
+     * the next one, or by polling the imu
+     * @param [out] sample - counts and TickClock time of the sample
+     * @returns true if a sample was available
+     */
+    bool readImu(ImuSample& sample);
+
+
+    /** waits for a running background read, and stops starting new ones */
+    void stopImuAsync();
+
+
     /**
      * samples the Imu and preprocesses the variables for orientation calculation.
      *
      * steps:
-     * - call imu.read() to sample imu, then read imu.gyrX/Y/Z, imu.accX/Y/Z.
-     *   units are in deg/s for gyro, m/s^2 for acc
-     * - subtract bias for the gyro
-     * - store the values in the arrays: gyr, acc.
+     * - call readImu() to sample imu in raw counts
+     * - subtract bias for the gyro, in counts, see gyrBiasCounts
+     * - scale to deg/s for gyro, m/s^2 for acc, with one factor per axis,
+     *   and store the values in the arrays: gyr, acc.
      *   These are 3 element arrays, with elements the following order [x,y,z]
      *   i.e. gyr[0] corresponds to the rotational velocity about x-axis
-     * - update deltaT (s), prevTimeImu (s)
+     * - update deltaT (s) from the sample times, previousTicksImu (ticks)
      *
      * The IMU reference frame has the z-axis pointing out of the IMU.
      * You should not negate any axis.
@@ -186,8 +475,31 @@ class OrientationTracker {
     /**
      * gets imu variables from simulation, instead of sampling from the imu.
      * updates acc, gyr, deltaT
+     * @returns false until 2 ms after the last sample, the rate of the
+     *   recorded data, without blocking
      */
-    void updateImuVariablesFromSimulation();
+    bool updateImuVariablesFromSimulation();
+
+
+    /**
+     * calls updateOrientation() for the sample of updateImuVariables(),
+     * or adds it to the step of setImuStepSamples(), and calls it with
+     * the step once complete
+     * @returns true if updateOrientation() ran
+     */
+    bool stepOrientation();
+
+
+    /**
+     * classifies the sample of updateImuVariables() as still or in
+     * motion, and lowers or restores the imu rate, see setImuIdleRate()
+     * @returns true if the sample ended an idle period
+     */
+    bool updateMotion();
+
+
+    /** sets the imu output rate divider, after a background read */
+    void setImuRateDivider(uint8_t divider);
 
 
     /**
@@ -216,16 +528,123 @@ class OrientationTracker {
     void updateOrientation();
 
 
+    /**
+     * converts gyrBias to gyrBiasCounts, call whenever gyrBias changes
+     */
+    void updateGyrBiasCounts();
+
+
+    /**
+     * sets the bias and variance fields from the moments of a window of
+     * samples at rest, and the noise model of the MEKF
+     */
+    void setImuBiasVariance(const ImuMoments& moments);
+
+
+    /**
+     * adds a sample to the integer sums of the rest window, and at its
+     * end merges it into the samples at rest, or restarts them on motion.
+     * Refreshes the bias and variance from them, see
+     * setImuCalibrationRefresh()
+     */
+    void refreshImuCalibration(const ImuSample& sample);
+
+
+    /**
+     * on a new magnetometer measurement, corrects the yaw of the
+     * estimator towards magReference with magFilterAlpha, or sets
+     * magReference from the first measurement
+     */
+    void updateHeading();
+
+
     /** Imu class for sampling from IMU */
     Imu imu;
 
 
+    /** data ready interrupt capture of the imu, inactive by default */
+    ImuCapture imuCapture;
+
+
+    /** number of imu samples processed */
+    uint32_t imuSamplesProcessed;
+
+
+    /** true to read the imu FIFO */
+    bool imuFifo;
+
+
+    /** true to read the imu in the background */
+    bool imuAsync;
+
+
+    /** batch read from the imu FIFO, and the next sample to process */
+    ImuSample imuBatch[Imu::fifoMaxFrames];
+    int imuBatchSize;
+    int imuBatchIndex;
+
+
+    /**
+     * samples per estimator step, see setImuStepSamples(), the samples in
+     * the current step, their rotation, summed acc and time, and whether
+     * one had a new magnetometer measurement
+     */
+    int imuStepSamples;
+    int imuStepCount;
+    Quaternion imuStepRotation;
+    Scalar imuStepAcc[3];
+    Scalar imuStepTime;
+    bool imuStepMag;
+
+
+    /**
+     * rate lowering while still, see setImuIdleRate(): enabled, idle, the
+     * still samples in a row, and the divider and period to restore
+     */
+    bool imuIdleRate;
+    bool imuIdle;
+    int imuStillSamples;
+    uint8_t imuActiveDivider;
+    uint32_t imuActivePeriodMicros;
+
+
+    /**
+     * idle periods, the sample ticks the current one started at, the
+     * ticks of the ended ones, and the samples and estimator steps
+     * meanwhile
+     */
+    uint32_t imuIdleEntries;
+    uint64_t imuIdleStartTicks;
+    uint64_t imuIdleTicks;
+    uint32_t imuIdleSamplesProcessed;
+    uint32_t imuIdleSteps;
+
+
+    /**
+     * bus time of the reads, see Imu::readTicks: at the start of the still
+     * samples in a row, the ticks and bus ticks of the still samples
+     * before each idle period, at the start of the current one, and of
+     * the ended ones
+     */
+    uint64_t imuStillStartTicks;
+    uint64_t imuStillStartBusTicks;
+    uint64_t imuActiveTicks;
+    uint64_t imuActiveBusTicks;
+    uint64_t imuIdleStartBusTicks;
+    uint64_t imuIdleBusTicks;
+
+
+    /** estimator steps, and the TickClock ticks they took */
+    uint32_t imuEstimatorSteps;
+    uint64_t imuEstimatorTicks;
+
+
     /**
      * gyro values in order (x,y,z) after bias subtraction
      * in IMU ref frame (z-axis points out of imu).
      * units are deg/s
      */
-    double gyr[3];
+    Scalar gyr[3];
 
 
     /**
@@ -233,37 +652,93 @@ class OrientationTracker {
      * units are m/s^2
      * in IMU ref frame (z-axis points out of imu).
      */
-    double acc[3];
+    Scalar acc[3];
+
+
+    /**
+     * magnetometer values in order (x,y,z) in the imu frame, in uT, and
+     * whether the latest sample brought a new measurement
+     */
+    Scalar mag[3];
+    bool magReady;
+
+
+    /**
+     * heading reference, the unit (x, z) direction of the horizontal
+     * field in the world frame, once valid, and the alpha value of the
+     * yaw correction
+     */
+    Scalar magReference[2];
+    bool magReferenceValid;
+    Scalar magFilterAlpha;
 
 
     /**
      * gyro bias values. order is: (wx,wy,wz)
      */
-    double gyrBias[3];
+    Scalar gyrBias[3];
+
+
+    /**
+     * gyro bias in Q24.8 raw counts, subtracted from the counts in
+     * integers, see updateGyrBiasCounts()
+     */
+    int32_t gyrBiasCounts[3];
+
+
+    /**
+     * deg/s per Q24.8 gyro count and m/s^2 per acc count, per axis, the
+     * scales of the imu folded with the 8 fractional bits
+     */
+    Scalar gyrScaleCounts[3];
+    Scalar accScaleCounts[3];
 
 
     /**
      * gyro variance values. order is: (wx,wy,wz)
      */
-    double gyrVariance[3];
+    Scalar gyrVariance[3];
 
 
     /**
      * accelerometer bias values. order is: (ax,ay,az)
      */
-    double accBias[3];
+    Scalar accBias[3];
 
 
     /**
      * accelerometer variance values. order is: (ax,ay,az)
      */
-    double accVariance[3];
+    Scalar accVariance[3];
+
 
+    /**
+     * background refresh of the calibration: on or off, the sums of the
+     * rest window so far, the samples at rest since the last motion,
+     * whether the bias is being measured again, whether it awaits a
+     * save, refreshes done, and the calibration last loaded or saved
+     */
+    bool imuCalibrationRefresh;
+    ImuWindowSums imuRestWindow;
+    ImuMoments imuRestSamples;
+    bool imuRecalibrating;
+    bool imuCalibrationSavePending;
 
     /**
-     * the previous time in s the imu was polled
+     * the gyro bias over the die temperature, and the last bias measured
+     * at rest, in deg/s, with its degrees C, that the slope moves it from
      */
-    double previousTimeImu;
+    ImuTempModel imuTempModel;
+    double gyrRestBias[3];
+    double gyrRestCelsius;
+    uint32_t imuCalibrationRefreshes;
+    ImuCalibration savedImuCalibration;
+
+
+    /**
+     * the TickClock time of the previous imu sample, 0 before the first
+     */
+    uint64_t previousTicksImu;
 
 
     /**
@@ -271,13 +746,13 @@ class OrientationTracker {
      * - 1: use full value of acc tilt correction
      * - 0: ignore acc tilt correction
      */
-    double imuFilterAlpha;
+    Scalar imuFilterAlpha;
 
 
     /**
      * time since the previous imu read, in s
      */
-    double deltaT;
+    Scalar deltaT;
 
 
     /**
@@ -293,22 +768,26 @@ class OrientationTracker {
     int simulateImuCounter;
 
 
+    /** micros() of the last simulated sample */
+    uint32_t simulateImuMicros;
+
+
     /**
      * estimate of flatland roll from gyro values
      */
-    double flatlandRollGyr;
+    Scalar flatlandRollGyr;
 
 
     /**
      * estimate of flatland roll from acc values
      */
-    double flatlandRollAcc;
+    Scalar flatlandRollAcc;
 
 
     /**
      * estimate of flatland roll from complementary filter
      */
-    double flatlandRollComp;
+    Scalar flatlandRollComp;
 
 
     /**
@@ -321,13 +800,38 @@ class OrientationTracker {
      * estimate of euler orientation from acc only
      * order: pitch (x-axis), yaw (y-axis), roll (z-axis)
      */
-    double eulerAcc[3];
+    Scalar eulerAcc[3];
+
+    /**
+     * estimator of the quaternion orientation from acc and gyr
+     */
+    OrientationEstimator estimator;
+
 
     /**
      * estimate of quaternion orientation
-     * from comp. filter of acc and gyr
+     * from the estimator, comp. filter of acc and gyr by default
      */
     Quaternion quaternionComp;
 
 
+#if defined(VRDUINO_FIXED_POINT)
+    /**
+     * fixed-point state, formats as in OrientationMathFixed.h
+     * - gyr in Q24.8 counts after bias subtraction, acc in raw counts
+     * - deltaT in us
+     * - flatland rolls as binary angles, quaternions and alpha in Q1.30
+     */
+    int32_t gyrFixed[3];
+    int32_t accFixed[3];
+    uint32_t deltaTFixed;
+    q30_t imuFilterAlphaFixed;
+    FixedGyrScale gyrScaleFixed;
+    bam_t flatlandRollGyrFixed;
+    bam_t flatlandRollCompFixed;
+    QuaternionQ30 quaternionGyrFixed;
+    QuaternionQ30 quaternionCompFixed;
+#endif
+
+
 };
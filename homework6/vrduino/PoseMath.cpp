@@ -1,18 +1,19 @@
 #include "PoseMath.h"
 
 
-void convertTicksTo2DPositions(uint32_t clockTicks[8], double pos2D[8])
+template <typename T>
+void convertTicksTo2DPositions(uint32_t clockTicks[8], T pos2D[8])
 {
   for (int i = 0; i < 8; i +=2) {
     // horizontal component
-    double deltaT_h = (double)clockTicks[i]/(double)CLOCKS_PER_SECOND;
-    double a_h = -deltaT_h*360.0*60.0 + 90.0;
-    double x = tan(a_h *2*PI/360.0);
+    T deltaT_h = (T)clockTicks[i]/(T)CLOCKS_PER_SECOND;
+    T a_h = -deltaT_h*T(360.0*60.0) + T(90.0);
+    T x = scalar::tan(a_h*T(2*PI/360.0));
 
     // vertical component
-    double deltaT_v = (double)clockTicks[i+1]/(double)CLOCKS_PER_SECOND;
-    double a_v = deltaT_v*360.0*60.0 - 90.0;
-    double y = tan(a_v*2*PI/360.0);
+    T deltaT_v = (T)clockTicks[i+1]/(T)CLOCKS_PER_SECOND;
+    T a_v = deltaT_v*T(360.0*60.0) - T(90.0);
+    T y = scalar::tan(a_v*T(2*PI/360.0));
     
     pos2D[i] = x;
     pos2D[i+1] = y;
@@ -21,7 +22,8 @@ void convertTicksTo2DPositions(uint32_t clockTicks[8], double pos2D[8])
 }
 
 
-void formA(double pos2D[8], double posRef[8], double Aout[8][8]) {
+template <typename T>
+void formA(T pos2D[8], T posRef[8], T Aout[8][8]) {
   for (int i = 0; i < 8; i += 2) {
       Aout[i][0] = posRef[i]; // x
       Aout[i][1] = posRef[i+1]; //y
@@ -44,47 +46,49 @@ void formA(double pos2D[8], double posRef[8], double Aout[8][8]) {
 
 }
 
-bool solveForH(double A[8][8], double b[8], double hOut[8]) {
+template <typename T>
+bool solveForH(T A[8][8], T b[8], T hOut[8]) {
 
- int inv = Matrix.Invert((double*)A, 8);
+ int inv = Matrix.Invert((T*)A, 8);
   if (inv == 0) {
     return false;
   }
   
-  Matrix.Multiply((double*)A, b, 8, 8, 1, hOut);
+  Matrix.Multiply((T*)A, b, 8, 8, 1, hOut);
   
   return inv;
 
 }
 
 
-void getRtFromH(double h[8], double ROut[3][3], double pos3DOut[3]) {
-  double s = 2/( sqrt( sq(h[0])+sq(h[3])+sq(h[6]) ) + sqrt( sq(h[1]) + sq(h[4]) + sq(h[7]) ) );
+template <typename T>
+void getRtFromH(T h[8], T ROut[3][3], T pos3DOut[3]) {
+  T s = 2/( scalar::sqrt( sq(h[0])+sq(h[3])+sq(h[6]) ) + scalar::sqrt( sq(h[1]) + sq(h[4]) + sq(h[7]) ) );
 
   pos3DOut[0] = s*h[2];
   pos3DOut[1] = s*h[5];
   pos3DOut[2] = -s;
 
    //column 1
-   double r11 = h[0]/sqrt(sq(h[0]) + sq(h[3]) +sq(h[6]));
-   double r21 = h[3]/sqrt( sq(h[0])+sq(h[3])+sq(h[6]));
-   double r31 = h[6]/sqrt( sq(h[0])+sq(h[3])+sq(h[6]));
+   T r11 = h[0]/scalar::sqrt(sq(h[0]) + sq(h[3]) +sq(h[6]));
+   T r21 = h[3]/scalar::sqrt( sq(h[0])+sq(h[3])+sq(h[6]));
+   T r31 = h[6]/scalar::sqrt( sq(h[0])+sq(h[3])+sq(h[6]));
 
    //column 2
-   double r12_t = h[1] - ( r11*( r11*h[1]+r21*h[4]+r31*h[7] ) );
-   double r22_t = h[4] - ( r21*( r11*h[1]+r21*h[4]+r31*h[7] ) );
-   double r32_t = -h[7] - ( r31*( r11*h[1]+r21*h[4]+r31*h[7] ) );
+   T r12_t = h[1] - ( r11*( r11*h[1]+r21*h[4]+r31*h[7] ) );
+   T r22_t = h[4] - ( r21*( r11*h[1]+r21*h[4]+r31*h[7] ) );
+   T r32_t = -h[7] - ( r31*( r11*h[1]+r21*h[4]+r31*h[7] ) );
 
    //divide each my l2 norm
-   double l2 = sqrt( sq(r12_t)+sq(r22_t)+sq(r32_t) );
-   double r12 = r12_t/l2;
-   double r22 = r22_t/l2;
-   double r32 = r32_t/l2;
+   T l2 = scalar::sqrt( sq(r12_t)+sq(r22_t)+sq(r32_t) );
+   T r12 = r12_t/l2;
+   T r22 = r22_t/l2;
+   T r32 = r32_t/l2;
 
    //column 3: cross prod
-   double r13 = r21 * r32 - r31 * r22;
-   double r23 = r31 * r12 - r11 * r32;
-   double r33 = r11 * r22 - r21 * r12;
+   T r13 = r21 * r32 - r31 * r22;
+   T r23 = r31 * r12 - r11 * r32;
+   T r33 = r11 * r22 - r21 * r12;
 
    ROut[0][0] = r11;
    ROut[1][0] = r21;
@@ -100,18 +104,31 @@ void getRtFromH(double h[8], double ROut[3][3], double pos3DOut[3]) {
 
 }
 
-Quaternion getQuaternionFromRotationMatrix(double R[3][3]) {
+template <typename T>
+QuaternionT<T> getQuaternionFromRotationMatrix(T R[3][3]) {
 
-  double qw = sqrt(1 + R[0][0] + R[1][1] + R[2][2]) / 2;
-  double qx = (R[2][1] - R[1][2]) / (4*qw);
-  double qy = (R[0][2] - R[2][0]) / (4*qw);
-  double qz = (R[1][0] - R[0][1]) / (4*qw);
+  T qw = scalar::sqrt(1 + R[0][0] + R[1][1] + R[2][2]) / 2;
+  T qx = (R[2][1] - R[1][2]) / (4*qw);
+  T qy = (R[0][2] - R[2][0]) / (4*qw);
+  T qz = (R[1][0] - R[0][1]) / (4*qw);
 
-  double l2 = sqrt(sq(qw)+sq(qx)+sq(qy)+sq(qz));
+  T l2 = scalar::sqrt(sq(qw)+sq(qx)+sq(qy)+sq(qz));
   qw /= l2;
   qx /= l2;
   qy /= l2;
   qz /= l2;
-  return Quaternion(qw, qx, qy, qz);
+  return QuaternionT<T>(qw, qx, qy, qz);
 
 }
+
+
+// instantiate the functions above for both precisions, see Scalar.h
+#define INSTANTIATE_POSE_MATH(T) \
+  template void convertTicksTo2DPositions<T>(uint32_t clockTicks[8], T pos2D[8]); \
+  template void formA<T>(T pos2D[8], T posRef[8], T Aout[8][8]); \
+  template bool solveForH<T>(T A[8][8], T b[8], T hOut[8]); \
+  template void getRtFromH<T>(T h[8], T ROut[3][3], T pos3DOut[3]); \
+  template QuaternionT<T> getQuaternionFromRotationMatrix<T>(T R[3][3]);
+
+INSTANTIATE_POSE_MATH(float)
+INSTANTIATE_POSE_MATH(double)
@@ -1,6 +1,9 @@
 /**
  * @file
  * math implementation for algorithm to estimate 3D pose from clock ticks
+ *
+ * All functions are templated on the scalar type T and instantiated
+ * for float and double, see Scalar.h.
  */
 
 #pragma once
@@ -27,7 +30,8 @@
  * @param [out] pos2D positions of measurements on plane at
  *   unit distance
  */
-void convertTicksTo2DPositions(uint32_t *clockTicks, double *pos2D);
+template <typename T>
+void convertTicksTo2DPositions(uint32_t *clockTicks, T *pos2D);
 
 
 /**
@@ -43,7 +47,8 @@ void convertTicksTo2DPositions(uint32_t *clockTicks, double *pos2D);
  *  [sensor0x, sensor0y, ... sensor3x, sensor3y]
  * @param [out] AOut - 8x8 output matrix. A[i][j] refers to A_{i,j}
  */
-void formA(double pos2D[8], double posRef[8], double AOut[8][8]);
+template <typename T>
+void formA(T pos2D[8], T posRef[8], T AOut[8][8]);
 
 /**
  * solves for h, given A and b: h = A^{-1} * b
@@ -54,7 +59,8 @@ void formA(double pos2D[8], double posRef[8], double AOut[8][8]);
  *  [h11, h12, h13, h21, h22, h23, h31, h32] (h33 is set to 1)
  * @returns - true if the matrix inversion of A was successful. false if not.
  */
-bool solveForH(double A[8][8], double b[8], double hOut[8]);
+template <typename T>
+bool solveForH(T A[8][8], T b[8], T hOut[8]);
 
 
 /**
@@ -66,7 +72,8 @@ bool solveForH(double A[8][8], double b[8], double hOut[8]);
  * @param [out] ROut - 3x3 output Rotation matrix
  * @param [out] pos3DOut - 3x1 position vector. order is [x,y,z]
  */
-void getRtFromH(double h[8], double ROut[3][3], double pos3DOut[3]);
+template <typename T>
+void getRtFromH(T h[8], T ROut[3][3], T pos3DOut[3]);
 
 
 /**
@@ -76,4 +83,5 @@ void getRtFromH(double h[8], double ROut[3][3], double pos3DOut[3]);
  * @param [in] R - 3x3 rotation matrix
  * @returns output quaternion
  */
-Quaternion getQuaternionFromRotationMatrix(double R[3][3]);
+template <typename T>
+QuaternionT<T> getQuaternionFromRotationMatrix(T R[3][3]);
@@ -1,12 +1,16 @@
 #include "PoseTracker.h"
+#include "BootTimeline.h"
+#include "Profiler.h"
 #include <Wire.h>
 
-PoseTracker::PoseTracker(double alphaImuFilterIn, int baseStationModeIn, bool simulateLighthouseIn) :
+PoseTracker::PoseTracker(double alphaImuFilterIn, int baseStationModeIn, bool simulateLighthouseIn,
+  EstimatorType estimatorTypeIn) :
 
-  OrientationTracker(alphaImuFilterIn, false),
+  OrientationTracker(alphaImuFilterIn, false, estimatorTypeIn),
   lighthouse(),
   simulateLighthouse(simulateLighthouseIn),
   simulateLighthouseCounter(0),
+  simulateLighthouseMicros(0),
   position{0,0,-500},
   baseStationPitch(0),
   baseStationRoll(0),
@@ -18,12 +22,39 @@ PoseTracker::PoseTracker(double alphaImuFilterIn, int baseStationModeIn, bool si
 
   {
 
+  // the lighthouse captures run from here, before setup()
+  if (!simulateLighthouse) {
+    BootTimeline::start(BOOT_OOTX);
+  }
+
+}
+
+bool PoseTracker::isLighthouseReady() const {
+
+  if (simulateLighthouse) {
+    //one sweep pair per 8.3 ms, the 120 Hz of a base station, without
+    //blocking
+    return micros() - simulateLighthouseMicros >= 8333;
+  }
+  return lighthouse.isDataAvailable(baseStationMode);
+
 }
 
 int PoseTracker::processLighthouse() {
 
   if (simulateLighthouse) {
   //if in simulation mode, get data from external file
+
+    if (!isLighthouseReady()) {
+      return -2;
+    }
+    //on the 120 Hz grid, unless far behind it
+    uint32_t now = micros();
+    simulateLighthouseMicros += 8333;
+    if (now - simulateLighthouseMicros >= 8333) {
+      simulateLighthouseMicros = now;
+    }
+
     for (int i = 0; i < 8; i++) {
       clockTicks[i] = clockTicksData[(simulateLighthouseCounter*8 + i) % nLighthouseSamples];
       numPulseDetections[i] = 0;
@@ -38,9 +69,6 @@ int PoseTracker::processLighthouse() {
     //data wraps around after end of array is reached
     simulateLighthouseCounter = (simulateLighthouseCounter + 1) % nLighthouseSamples;
 
-    //slight delay to simulate delay between sensor readings (not exactly 120 Hz)
-    delay(1);
-
   } else {
     //check data is available
     if (!lighthouse.readTimings(baseStationMode, clockTicks, numPulseDetections, pulseWidth,
@@ -63,19 +91,29 @@ int PoseTracker::processLighthouse() {
 
 
 int PoseTracker::updatePose() {
-  convertTicksTo2DPositions(clockTicks, position2D);
+  {
+    PROFILE_SCOPE(PROFILE_TICKS_TO_2D);
+    convertTicksTo2DPositions(clockTicks, position2D);
+  }
   
-  double A[8][8];
+  Scalar A[8][8];
   formA(position2D, positionRef, A);
 
-  double h[8];
-  bool success = solveForH(A, position2D, h);
+  Scalar h[8];
+  bool success;
+  {
+    PROFILE_SCOPE(PROFILE_SOLVE_H);
+    success = solveForH(A, position2D, h);
+  }
   if (!success) {
     return 0;
   }
   
-  double R[3][3];
-  getRtFromH(h, R, position);
+  Scalar R[3][3];
+  {
+    PROFILE_SCOPE(PROFILE_RT_FROM_H);
+    getRtFromH(h, R, position);
+  }
 
   quaternionHm = getQuaternionFromRotationMatrix(R);
   
@@ -26,8 +26,10 @@ class PoseTracker : public OrientationTracker {
      *   from specified base station
      * @param [in] simulateLighthouseIn - if true, get lighthouse timings from external file
      *   and ignore lighthouse sensor, and IMU readings.
+     * @param [in] estimatorType - quaternion orientation estimator of the IMU
      */
-    PoseTracker(double alphaImuFilterIn, int baseStationMode, bool simulateLighthouseIn=false) ;
+    PoseTracker(double alphaImuFilterIn, int baseStationMode, bool simulateLighthouseIn=false,
+      EstimatorType estimatorType=VRDUINO_ESTIMATOR) ;
 
     /**
      * samples photodiodes and processes timing to estimate pose.
@@ -43,10 +45,16 @@ class PoseTracker : public OrientationTracker {
      */
     int processLighthouse();
 
+    /**
+     * @returns true if processLighthouse() has new timings to solve, a
+     *   sweep pair of the base station, or the next simulated one is due
+     */
+    bool isLighthouseReady() const;
+
     /**
      * x,y,z position of board from base station. units is mm
      */
-    const double * getPosition() const { return position; };
+    const Scalar * getPosition() const { return position; };
 
     /**
      * get quaternion of board from base station.
@@ -72,13 +80,13 @@ class PoseTracker : public OrientationTracker {
      *  get 2D normalized coordinates of diodes, in base station 'sensor' plane
      *  order: sensor0.x, sensor0.y, ... sensor3.x, sensor3.y
      */
-    const double * getPosition2D() const { return position2D; };
+    const Scalar * getPosition2D() const { return position2D; };
 
     /**
      * get clock ticks of sweep pulses for each diode, for each axis.
      * order: sensor0.x, sensor0.y, ... sensor3.x, sensor3.y
      */
-    const unsigned long * getClockTicks() const { return clockTicks; };
+    const uint32_t * getClockTicks() const { return clockTicks; };
 
     /**
      * get number of sweep pulse detections for each diode, for each axis.
@@ -137,10 +145,15 @@ class PoseTracker : public OrientationTracker {
      */
     int simulateLighthouseCounter;
 
+    /**
+     * micros() of the last simulated timing
+     */
+    uint32_t simulateLighthouseMicros;
+
     /**
      * most recent estimate of translation (ordrer: x,y,z) in mm
      */
-    double position[3];
+    Scalar position[3];
 
 
     /**
@@ -172,13 +185,13 @@ class PoseTracker : public OrientationTracker {
      * from the base station.
      * order is sensor0x, sensor0y,...sensor3x, sensor3y
      */
-    double position2D[8];
+    Scalar position2D[8];
 
     /**
      * 2D actual coordinates of the photodioes, based on the board layout.
      * units is mm. order is: sensor0x, sensor0y,...sensor3x, sensor3y
      */
-    double positionRef[8] = {-42.0, 25.0, 42.0, 25.0, 42.0, -25.0, -42.0, -25.0};
+    Scalar positionRef[8] = {-42.0, 25.0, 42.0, 25.0, 42.0, -25.0, -42.0, -25.0};
 
     /**
      * clock ticks of sweep pulses since last sync pulse, as detected by
@@ -186,7 +199,7 @@ class PoseTracker : public OrientationTracker {
      * order is : sensor0H, sensor0V, ... sensor3H, sensor3V
      * not needed for visualization, can be used for debugging
      */
-    unsigned long clockTicks[8];
+    uint32_t clockTicks[8];
 
     /**
      * number of pulse detections
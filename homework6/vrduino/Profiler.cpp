@@ -0,0 +1,92 @@
+#include "Profiler.h"
+
+#if defined(VRDUINO_PROFILE)
+
+Profiler::Stage Profiler::stages[PROFILE_STAGE_COUNT];
+bool Profiler::started = false;
+
+static const char *const stageNames[PROFILE_STAGE_COUNT] = {
+  "imu", "orientation", "capture", "readTimings", "ticksTo2D", "solveForH",
+  "getRtFromH", "serial"
+};
+
+void Profiler::begin() {
+
+#if defined(__arm__)
+  // trace enable, then the cycle counter of the DWT
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+  if (!started) {
+    reset();
+    started = true;
+  }
+
+}
+
+double Profiler::cyclesPerMicro() {
+#if defined(__arm__)
+  return F_CPU / 1e6;
+#else
+  return 1000;
+#endif
+}
+
+void Profiler::record(ProfileStage stage, uint32_t cycles) {
+
+  if (!started) {
+    return;
+  }
+
+  Stage& s = stages[stage];
+  if (s.count == 0 || cycles < s.minCycles) {
+    s.minCycles = cycles;
+  }
+  if (cycles > s.maxCycles) {
+    s.maxCycles = cycles;
+  }
+  s.sumCycles += cycles;
+  s.count++;
+
+  // the index of the highest bit set
+  int bin = 0;
+  while (bin < histogramBins - 1 && (cycles >> (bin + 1)) != 0) {
+    bin++;
+  }
+  s.bins[bin]++;
+
+}
+
+double Profiler::meanCycles(ProfileStage stage) {
+  const Stage& s = stages[stage];
+  return s.count > 0 ? double(s.sumCycles) / s.count : 0;
+}
+
+void Profiler::print() {
+
+  double perMicro = cyclesPerMicro();
+  for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+    ProfileStage stage = ProfileStage(i);
+    const Stage& s = stages[i];
+    if (s.count == 0) {
+      continue;
+    }
+    Serial.printf("PF %s %lu runs %.1f us min %.1f us mean %.1f us max\n",
+      stageNames[i], (unsigned long)s.count, s.minCycles / perMicro,
+      meanCycles(stage) / perMicro, s.maxCycles / perMicro);
+    Serial.printf("PH %s", stageNames[i]);
+    for (int bin = 0; bin < histogramBins; bin++) {
+      if (s.bins[bin] != 0) {
+        Serial.printf(" %d:%lu", bin, (unsigned long)s.bins[bin]);
+      }
+    }
+    Serial.printf("\n");
+  }
+
+}
+
+void Profiler::reset() {
+  memset(stages, 0, sizeof(stages));
+}
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * @class Profiler
+ * Time spent in each stage of a frame, in CPU cycles.
+ *
+ * PROFILE_SCOPE(stage) at the top of a block reads the cycle counter
+ * there and again when the block is left, and adds the difference to the
+ * stage: the count, min, max and mean, and a histogram of its log2, bin
+ * k for 2^k to 2^(k+1) - 1 cycles. The stages are listed in ProfileStage.
+ *
+ * The cycles are the DWT cycle counter of the Cortex-M4, CYCCNT, enabled
+ * by begin() in setup() of vrduino.ino. It wraps after 44 s at 96 MHz,
+ * far above any stage. On the host they are the ns of
+ * std::chrono::steady_clock, so the stages there measure the PC, see
+ * cyclesPerMicro().
+ *
+ * A stage interrupted by an ISR includes the time of the ISR. Each stage
+ * is recorded from one context at a time, e.g. the capture callback only
+ * from ftm0_isr(), so the table needs no locking. print() may see a
+ * stage half updated by an ISR, which is good enough for a dump.
+ *
+ * Without VRDUINO_PROFILE, PROFILE_SCOPE() compiles to nothing and
+ * there is no Profiler.
+ *
+ * print() writes a "PF" line per stage that ran, and a "PH" line of its
+ * non-empty histogram bins as bin:count, e.g.
+ *   PF solveForH 120 runs 21.3 us min 22.0 us mean 30.9 us max
+ *   PH solveForH 11:118 12:2
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// uncomment to profile the stages of a frame, 'p' prints them
+//#define VRDUINO_PROFILE
+
+enum ProfileStage {
+  PROFILE_IMU_READ,
+  PROFILE_ORIENTATION,
+  PROFILE_LIGHTHOUSE_CAPTURE,
+  PROFILE_LIGHTHOUSE_READ,
+  PROFILE_TICKS_TO_2D,
+  PROFILE_SOLVE_H,
+  PROFILE_RT_FROM_H,
+  PROFILE_SERIAL,
+  PROFILE_STAGE_COUNT
+};
+
+#if defined(VRDUINO_PROFILE)
+
+#if !defined(__arm__)
+#include <chrono>
+#endif
+
+class Profiler {
+
+  public:
+
+    /** bins of the log2 histogram, one per bit of the cycles */
+    static const int histogramBins = 32;
+
+    /** starts the cycle counter, runs recorded before are dropped */
+    static void begin();
+
+    /** @returns the cycle counter, wrapping over 32 bits */
+    static uint32_t cycles() {
+#if defined(__arm__)
+      return ARM_DWT_CYCCNT;
+#else
+      return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    /** cycles per us, F_CPU, or 1000 ns on the host */
+    static double cyclesPerMicro();
+
+    /** adds a run of stage that took cycles */
+    static void record(ProfileStage stage, uint32_t cycles);
+
+    static uint32_t count(ProfileStage stage) { return stages[stage].count; }
+    static uint32_t minCycles(ProfileStage stage) { return stages[stage].minCycles; }
+    static uint32_t maxCycles(ProfileStage stage) { return stages[stage].maxCycles; }
+    static double meanCycles(ProfileStage stage);
+
+    /** runs of stage of 2^bin to 2^(bin+1) - 1 cycles, bin 0 from 0 */
+    static uint32_t histogram(ProfileStage stage, int bin) { return stages[stage].bins[bin]; }
+
+    /** writes the "PF" and "PH" lines to Serial */
+    static void print();
+
+    /** forgets all runs */
+    static void reset();
+
+  private:
+
+    struct Stage {
+      uint32_t count;
+      uint32_t minCycles;
+      uint32_t maxCycles;
+      uint64_t sumCycles;
+      uint32_t bins[histogramBins];
+    };
+
+    static Stage stages[PROFILE_STAGE_COUNT];
+    static bool started;
+
+};
+
+/** adds the cycles from its construction to the end of its scope to a stage */
+class ProfileScope {
+
+  public:
+
+    explicit ProfileScope(ProfileStage stageIn) :
+      stage(stageIn),
+      start(Profiler::cycles())
+    {
+    }
+
+    ~ProfileScope() {
+      Profiler::record(stage, Profiler::cycles() - start);
+    }
+
+  private:
+
+    ProfileStage stage;
+    uint32_t start;
+
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage)
+
+#endif
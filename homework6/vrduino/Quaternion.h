@@ -1,6 +1,13 @@
 /**
  * Quaternion class
  *
+ * The class is templated on the scalar type (float or double), Quaternion
+ * is the instance for the Scalar type of the build, see Scalar.h.
+ *
+ * Products are written a * b; *=, premultiply() and normalize() work in
+ * place. Use rotateVector() to rotate a 3-vector by a unit quaternion,
+ * rotate() is the general r * q * r^{-1}.
+ *
  * We are using C++! Not JavaScript!
  * Unlike JavaScript, "this" keyword is representing a pointer!
  * If you want to access the member variable q[0], you should write
@@ -14,8 +21,10 @@
 #define QUATERNION_H
 
 #include "Arduino.h"
+#include "Scalar.h"
 
-class Quaternion {
+template <typename T>
+class QuaternionT {
 public:
 
   /***
@@ -24,116 +33,156 @@ public:
    * Definition:
    * q = q[0] + q[1] * i + q[2] * j + q[3] * k
    */
-  double q[4];
+  T q[4];
 
 
-  /* Default constructor */
-  Quaternion() :
-    q{1.0, 0.0, 0.0, 0.0} {}
+  /* Default constructor, the identity rotation */
+  constexpr QuaternionT() :
+    q{1, 0, 0, 0} {}
 
 
   /* Constructor with some inputs */
-  Quaternion(double q0, double q1, double q2, double q3) :
+  constexpr QuaternionT(T q0, T q1, T q2, T q3) :
     q{q0, q1, q2, q3} {}
 
 
   /* function to create another quaternion with the same values. */
-  Quaternion clone() {
-    return Quaternion(this->q[0], this->q[1], this->q[2], this->q[3]);
+  constexpr QuaternionT clone() const {
+    return *this;
   }
 
-  /* function to construct a quaternion from angle-axis representation */
-  Quaternion& setFromAngleAxis(double angle, double vx, double vy, double vz) {
-    double halfangle = angle * 0.5 * DEG_TO_RAD;
-
-    double s = sin(halfangle);
-
-    this->q[0] = cos(halfangle);
-
-    this->q[1] = vx * s;
-
-    this->q[2] = vy * s;
+  /**
+   * rotation by angle (in degrees) about the unit axis (vx, vy, vz)
+   */
+  static QuaternionT fromAngleAxis(T angle, T vx, T vy, T vz) {
+    T halfangle = angle * T(0.5 * DEG_TO_RAD);
+    T s = scalar::sin(halfangle);
+    return QuaternionT(scalar::cos(halfangle), vx * s, vy * s, vz * s);
+  }
 
-    this->q[3] = vz * s;
+  /* function to construct a quaternion from angle-axis representation */
+  QuaternionT& setFromAngleAxis(T angle, T vx, T vy, T vz) {
+    return *this = fromAngleAxis(angle, vx, vy, vz);
+  }
 
-    return *this;
+  /* squared length, no square root */
+  constexpr T lengthSquared() const {
+    return this->q[0] * this->q[0] + this->q[1] * this->q[1] +
+           this->q[2] * this->q[2] + this->q[3] * this->q[3];
   }
 
   /* function to compute the length of a quaternion */
-  double length() {
-    return sqrt(sq(this->q[0]) + sq(this->q[1]) +
-                sq(this->q[2]) + sq(this->q[3]));
+  T length() const {
+    return scalar::sqrt(lengthSquared());
   }
 
-  /* function to normalize a quaternion */
-  Quaternion& normalize() {
-    double length = this->length();
+  /* function to normalize a quaternion, in place */
+  QuaternionT& normalize() {
+    T invLength = T(1) / this->length();
 
-    this->q[0] /= length;
-    this->q[1] /= length;
-    this->q[2] /= length;
-    this->q[3] /= length;
+    this->q[0] *= invLength;
+    this->q[1] *= invLength;
+    this->q[2] *= invLength;
+    this->q[3] *= invLength;
 
     return *this;
   }
 
-  /* function to invert a quaternion */
-  Quaternion& inverse() {
-
-    double s = sq(this->q[0]) + sq(this->q[1]) +
-               sq(this->q[2]) + sq(this->q[3]);
+  /**
+   * first-order normalize for quaternions already close to unit length,
+   * e.g. after a product of unit quaternions: q *= (3 - |q|^2) / 2, one
+   * Newton step of 1/sqrt around 1. No square root or division; the
+   * length error left is quadratic in the one before.
+   */
+  QuaternionT& renormalize() {
+    T k = T(1.5) - T(0.5) * lengthSquared();
 
-    this->q[0] /= s;
-    this->q[1] /= -s;
-    this->q[2] /= -s;
-    this->q[3] /= -s;
+    this->q[0] *= k;
+    this->q[1] *= k;
+    this->q[2] *= k;
+    this->q[3] *= k;
 
     return *this;
   }
 
-  /* function to multiply two quaternions */
-  Quaternion multiply(Quaternion& a, Quaternion& b) {
+  /* normalized copy */
+  QuaternionT normalized() const {
+    return QuaternionT(*this).normalize();
+  }
 
-    /*
-    this->q[0] = a.q[0] * b.q[0] - a.q[1] * b.q[1]
-                 - a.q[2] * b.q[2] - a.q[3] * b.q[3];
+  /* conjugate, which is the inverse of a unit quaternion */
+  constexpr QuaternionT conjugate() const {
+    return QuaternionT(this->q[0], -this->q[1], -this->q[2], -this->q[3]);
+  }
 
-    this->q[1] = a.q[0] * b.q[1] + a.q[1] * b.q[0]
-                 + a.q[2] * b.q[3] - a.q[3] * b.q[2];
+  /* function to invert a quaternion, in place */
+  QuaternionT& inverse() {
 
-    this->q[2] = a.q[0] * b.q[2] - a.q[1] * b.q[3]
-                 + a.q[2] * b.q[0] + a.q[3] * b.q[1];
+    T invS = T(1) / lengthSquared();
 
-    this->q[3] = a.q[0] * b.q[3] + a.q[1] * b.q[2]
-                 - a.q[2] * b.q[1] + a.q[3] * b.q[0];
+    this->q[0] *= invS;
+    this->q[1] *= -invS;
+    this->q[2] *= -invS;
+    this->q[3] *= -invS;
 
     return *this;
+  }
 
-    */
-
-    Quaternion q;
-    q.q[0] = a.q[0] * b.q[0] - a.q[1] * b.q[1]
-                 - a.q[2] * b.q[2] - a.q[3] * b.q[3];
-
-    q.q[1] = a.q[0] * b.q[1] + a.q[1] * b.q[0]
-                 + a.q[2] * b.q[3] - a.q[3] * b.q[2];
-
-    q.q[2] = a.q[0] * b.q[2] - a.q[1] * b.q[3]
-                 + a.q[2] * b.q[0] + a.q[3] * b.q[1];
+  /* Hamilton product this * b */
+  constexpr QuaternionT operator*(const QuaternionT& b) const {
+    return QuaternionT(
+      this->q[0] * b.q[0] - this->q[1] * b.q[1]
+        - this->q[2] * b.q[2] - this->q[3] * b.q[3],
+      this->q[0] * b.q[1] + this->q[1] * b.q[0]
+        + this->q[2] * b.q[3] - this->q[3] * b.q[2],
+      this->q[0] * b.q[2] - this->q[1] * b.q[3]
+        + this->q[2] * b.q[0] + this->q[3] * b.q[1],
+      this->q[0] * b.q[3] + this->q[1] * b.q[2]
+        - this->q[2] * b.q[1] + this->q[3] * b.q[0]);
+  }
 
-    q.q[3] = a.q[0] * b.q[3] + a.q[1] * b.q[2]
-                 - a.q[2] * b.q[1] + a.q[3] * b.q[0];
+  /* this = this * b */
+  QuaternionT& operator*=(const QuaternionT& b) {
+    return *this = *this * b;
+  }
 
-    return q;
+  /* this = a * this */
+  QuaternionT& premultiply(const QuaternionT& a) {
+    return *this = a * *this;
   }
 
-  /* function to rotate a quaternion by r * q * r^{-1} */
-  Quaternion rotate(Quaternion& r) {
-    Quaternion rinv = r.clone().inverse();
+  /* function to multiply two quaternions, returns a * b */
+  static constexpr QuaternionT multiply(const QuaternionT& a, const QuaternionT& b) {
+    return a * b;
+  }
 
-    Quaternion qrinv = Quaternion().multiply(*this, rinv);
+  /**
+   * rotates the vector v by this quaternion, which must be unit length.
+   * Same result as rotate() on the pure quaternion (0, v), in the
+   * cross-product form v + w t + u x t with t = 2 u x v:
+   * 15 multiplies and no division, instead of an inverse and two full
+   * products.
+   */
+  void rotateVector(const T v[3], T out[3]) const {
+    const T w = this->q[0], ux = this->q[1], uy = this->q[2], uz = this->q[3];
+
+    T tx = uy * v[2] - uz * v[1];
+    T ty = uz * v[0] - ux * v[2];
+    T tz = ux * v[1] - uy * v[0];
+    tx += tx;
+    ty += ty;
+    tz += tz;
+
+    out[0] = v[0] + w * tx + (uy * tz - uz * ty);
+    out[1] = v[1] + w * ty + (uz * tx - ux * tz);
+    out[2] = v[2] + w * tz + (ux * ty - uy * tx);
+  }
 
-    return Quaternion().multiply(r, qrinv);
+  /* function to rotate a quaternion by r * q * r^{-1}, r need not be unit */
+  QuaternionT rotate(const QuaternionT& r) const {
+    QuaternionT p = r * *this * r.conjugate();
+    T invS = T(1) / r.lengthSquared();
+    return QuaternionT(p.q[0] * invS, p.q[1] * invS, p.q[2] * invS, p.q[3] * invS);
   }
 
 
@@ -142,25 +191,25 @@ public:
    * by a factor alpha [0, 1]. New q is renormalized
    * If alpha = 0, qnew = q0. if alpha = 1, qnew = q1
    */
-  Quaternion nlerp(Quaternion& q0, Quaternion& q1, double alpha) {
-    Quaternion qnew;
+  QuaternionT nlerp(const QuaternionT& q0, const QuaternionT& q1, T alpha) const {
+    QuaternionT qnew;
     if (alpha <= 0) {
-      qnew =  q0.clone();
+      qnew =  q0;
     } else if (alpha >= 1) {
-      qnew =  q1.clone();
+      qnew =  q1;
     } else {
       for (int i = 0; i < 4; i++) {
         qnew.q[i] = alpha * q0.q[i] + (1-alpha) * q1.q[i];
       }
     }
-    qnew = qnew.normalize();
+    qnew.normalize();
     return qnew;
   }
 
 
 
   /* helper function to print out a quaternion */
-  void serialPrint() {
+  void serialPrint() const {
     Serial.print(q[0]);
     Serial.print(" ");
     Serial.print(q[1]);
@@ -172,4 +221,7 @@ public:
   }
 };
 
+/* quaternion in the precision of the build */
+typedef QuaternionT<Scalar> Quaternion;
+
 #endif // ifndef QUATERNION_H
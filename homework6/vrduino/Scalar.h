@@ -0,0 +1,58 @@
+/**
+ * @file
+ * scalar type of the orientation and pose math
+ *
+ * Quaternion, OrientationMath and PoseMath are templated on the scalar type;
+ * the trackers use Scalar, which is picked per target here:
+ * - parts with a single-precision FPU (Cortex-M4F, e.g. Teensy 3.5/3.6)
+ *   use float, which runs in hardware there
+ * - everything else (Teensy 3.2 has no FPU at all) uses double, unless
+ *   VRDUINO_SINGLE_PRECISION is defined. Software float is still about
+ *   twice as fast as software double, at ~7 instead of ~16 digits.
+ * - VRDUINO_DOUBLE_PRECISION forces double on any target
+ */
+
+#pragma once
+#include <Arduino.h>
+
+// uncomment to build the Teensy 3.2 with single precision
+//#define VRDUINO_SINGLE_PRECISION
+
+#if defined(VRDUINO_DOUBLE_PRECISION)
+typedef double Scalar;
+#elif defined(VRDUINO_SINGLE_PRECISION) || (defined(__ARM_FP) && !(__ARM_FP & 0x8))
+typedef float Scalar;
+#else
+typedef double Scalar;
+#endif
+
+
+/**
+ * precision-matched math functions for templated code.
+ * The Teensy toolchain's math.h only declares the double versions, so a
+ * plain sqrt(x) on a float would silently promote to double.
+ */
+namespace scalar {
+
+  inline float  sqrt(float x)  { return ::sqrtf(x); }
+  inline double sqrt(double x) { return ::sqrt(x); }
+
+  inline float  sin(float x)  { return ::sinf(x); }
+  inline double sin(double x) { return ::sin(x); }
+
+  inline float  cos(float x)  { return ::cosf(x); }
+  inline double cos(double x) { return ::cos(x); }
+
+  inline float  tan(float x)  { return ::tanf(x); }
+  inline double tan(double x) { return ::tan(x); }
+
+  inline float  acos(float x)  { return ::acosf(x); }
+  inline double acos(double x) { return ::acos(x); }
+
+  inline float  atan2(float y, float x)   { return ::atan2f(y, x); }
+  inline double atan2(double y, double x) { return ::atan2(y, x); }
+
+  inline float  fabs(float x)  { return ::fabsf(x); }
+  inline double fabs(double x) { return ::fabs(x); }
+
+}
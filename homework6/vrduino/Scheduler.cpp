@@ -0,0 +1,171 @@
+#include "Scheduler.h"
+#include "TickClock.h"
+
+Scheduler::Scheduler() :
+  taskCount(0)
+{
+}
+
+int Scheduler::add(const char *name, TaskFunction run, ReadyFunction ready,
+  uint32_t periodMicros, uint32_t deadlineMicros, uint8_t priority) {
+
+  if (taskCount >= maxTasks) {
+    return -1;
+  }
+
+  // the clock of the releases and run times, see TickClock::begin()
+  TickClock::begin();
+
+  Task& task = tasks[taskCount];
+  task.name = name;
+  task.run = run;
+  task.ready = ready;
+  task.periodTicks = uint64_t(periodMicros) * TickClock::ticksPerMicro;
+  task.deadlineTicks = uint64_t(deadlineMicros) * TickClock::ticksPerMicro;
+  task.priority = priority;
+  task.enabled = true;
+  task.released = false;
+  task.releaseTicks = TickClock::now();
+  task.runs = 0;
+  task.missed = 0;
+  task.skipped = 0;
+  task.runTicks = 0;
+  task.maxRunTicks = 0;
+  return taskCount++;
+
+}
+
+int Scheduler::addPeriodic(const char *name, TaskFunction run, uint32_t periodMicros,
+  uint32_t deadlineMicros, uint8_t priority) {
+  return add(name, run, nullptr, periodMicros, deadlineMicros, priority);
+}
+
+int Scheduler::addEvent(const char *name, TaskFunction run, ReadyFunction ready,
+  uint32_t deadlineMicros, uint8_t priority) {
+  return add(name, run, ready, 0, deadlineMicros, priority);
+}
+
+void Scheduler::setPeriod(int task, uint32_t periodMicros) {
+  tasks[task].periodTicks = uint64_t(periodMicros) * TickClock::ticksPerMicro;
+}
+
+void Scheduler::setEnabled(int task, bool enabled) {
+
+  Task& t = tasks[task];
+  if (enabled && !t.enabled) {
+    t.released = false;
+    t.releaseTicks = TickClock::now();
+  }
+  t.enabled = enabled;
+
+}
+
+int Scheduler::nextReleased(uint64_t now) {
+
+  int next = -1;
+  for (int i = 0; i < taskCount; i++) {
+
+    Task& t = tasks[i];
+    if (!t.enabled) {
+      continue;
+    }
+    if (t.ready != nullptr) {
+      if (!t.released && t.ready()) {
+        t.released = true;
+        t.releaseTicks = now;
+      }
+      if (!t.released) {
+        continue;
+      }
+    } else if (now < t.releaseTicks) {
+      continue;
+    }
+
+    if (next < 0 || t.priority < tasks[next].priority ||
+      (t.priority == tasks[next].priority &&
+      t.releaseTicks + t.deadlineTicks < tasks[next].releaseTicks + tasks[next].deadlineTicks)) {
+      next = i;
+    }
+
+  }
+
+  return next;
+
+}
+
+bool Scheduler::hasReleased() {
+  return nextReleased(TickClock::now()) >= 0;
+}
+
+bool Scheduler::runOnce() {
+
+  uint64_t now = TickClock::now();
+  int next = nextReleased(now);
+  if (next < 0) {
+    return false;
+  }
+
+  Task& t = tasks[next];
+
+  // a periodic task a whole period behind skips to its latest release
+  if (t.ready == nullptr && t.periodTicks > 0 && now - t.releaseTicks >= t.periodTicks) {
+    uint64_t behind = (now - t.releaseTicks) / t.periodTicks;
+    t.skipped += uint32_t(behind);
+    t.missed += uint32_t(behind);
+    t.releaseTicks += behind * t.periodTicks;
+  }
+
+  uint64_t start = TickClock::now();
+  t.run();
+  uint64_t end = TickClock::now();
+
+  t.runs++;
+  t.runTicks += end - start;
+  if (end - start > t.maxRunTicks) {
+    t.maxRunTicks = end - start;
+  }
+  if (end > t.releaseTicks + t.deadlineTicks) {
+    t.missed++;
+  }
+
+  if (t.ready != nullptr) {
+    t.released = false;
+  } else {
+    t.releaseTicks += t.periodTicks;
+  }
+
+  return true;
+
+}
+
+double Scheduler::meanRunMicros(int task) const {
+  const Task& t = tasks[task];
+  return t.runs > 0 ? double(t.runTicks) / t.runs / TickClock::ticksPerMicro : 0;
+}
+
+double Scheduler::maxRunMicros(int task) const {
+  return double(tasks[task].maxRunTicks) / TickClock::ticksPerMicro;
+}
+
+void Scheduler::resetCounters() {
+
+  for (int i = 0; i < taskCount; i++) {
+    tasks[i].runs = 0;
+    tasks[i].missed = 0;
+    tasks[i].skipped = 0;
+    tasks[i].runTicks = 0;
+    tasks[i].maxRunTicks = 0;
+  }
+
+}
+
+void Scheduler::print() const {
+
+  for (int i = 0; i < taskCount; i++) {
+    const Task& t = tasks[i];
+    Serial.printf("TK %s %lu runs %lu missed %lu skipped %.1f us mean %.1f us max\n",
+      t.name, (unsigned long)t.runs, (unsigned long)t.missed, (unsigned long)t.skipped,
+      meanRunMicros(i), maxRunMicros(i));
+  }
+
+}
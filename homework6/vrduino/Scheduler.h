@@ -0,0 +1,117 @@
+/**
+ * @class Scheduler
+ * Cooperative scheduler of a fixed set of tasks, for loop() of
+ * vrduino.ino.
+ *
+ * A task is a function that runs to completion, released either
+ * - periodically, every periodMicros from when it was added, e.g. the
+ *   imu integration at the sample rate, or telemetry at its rate
+ * - on an event, when its ready() returns true, e.g. new sweep data of
+ *   the lighthouse or serial bytes of a command
+ * runOnce() runs the released task with the lowest priority value, 0
+ * first as with the NVIC, and of those the one with the earliest
+ * deadline, its release plus deadlineMicros. It never preempts: a long
+ * task delays all others, which shows in their counters.
+ *
+ * Per task it counts the runs, the deadlines missed, i.e. finished after
+ * the release plus deadlineMicros, and the periods skipped when a
+ * periodic task fell a whole period behind, which also count as missed.
+ * The run time is measured in TickClock ticks, mean and max, so the
+ * first task added starts the clock if the imu did not yet.
+ *
+ * print() writes a "TK" line per task, e.g.
+ *   TK imu 1000 runs 0 missed 0 skipped 12.5 us mean 40.1 us max
+ */
+
+#pragma once
+#include <Arduino.h>
+
+class Scheduler {
+
+  public:
+
+    /** tasks a scheduler holds */
+    static const int maxTasks = 8;
+
+    typedef void (*TaskFunction)();
+    typedef bool (*ReadyFunction)();
+
+    struct Task {
+      const char *name;
+      TaskFunction run;
+      ReadyFunction ready;     // nullptr for a periodic task
+      uint64_t periodTicks;
+      uint64_t deadlineTicks;
+      uint8_t priority;
+      bool enabled;
+      bool released;           // event task: ready() was seen true
+      uint64_t releaseTicks;   // the release pending, or the next one
+      uint32_t runs;
+      uint32_t missed;
+      uint32_t skipped;
+      uint64_t runTicks;
+      uint64_t maxRunTicks;
+    };
+
+    Scheduler();
+
+    /**
+     * adds a task released every periodMicros, the first at once
+     * @returns its index, or -1 if there are maxTasks already
+     */
+    int addPeriodic(const char *name, TaskFunction run, uint32_t periodMicros,
+      uint32_t deadlineMicros, uint8_t priority);
+
+    /**
+     * adds a task released when ready() returns true, polled by runOnce()
+     * @returns its index, or -1 if there are maxTasks already
+     */
+    int addEvent(const char *name, TaskFunction run, ReadyFunction ready,
+      uint32_t deadlineMicros, uint8_t priority);
+
+    /** changes the period of a periodic task, from its next release */
+    void setPeriod(int task, uint32_t periodMicros);
+
+    /** a disabled task is not released, a periodic one starts over at enable */
+    void setEnabled(int task, bool enabled);
+
+    /**
+     * runs the most urgent released task
+     * @returns false if no task was released, the caller may then sleep
+     *   until the next interrupt, see CpuIdle
+     */
+    bool runOnce();
+
+    /**
+     * @returns true if a task is released, without running it. Polls the
+     *   ready() of the event tasks, so it is safe with interrupts masked
+     *   as long as they are, see CpuIdle::sleepUnless()
+     */
+    bool hasReleased();
+
+    int count() const { return taskCount; }
+
+    const Task& getTask(int task) const { return tasks[task]; }
+
+    /** us a task ran, mean and max over its runs */
+    double meanRunMicros(int task) const;
+    double maxRunMicros(int task) const;
+
+    /** forgets the counters of all tasks */
+    void resetCounters();
+
+    /** writes a "TK" line per task to Serial */
+    void print() const;
+
+  private:
+
+    /* the index of the most urgent released task at now, or -1 */
+    int nextReleased(uint64_t now);
+
+    int add(const char *name, TaskFunction run, ReadyFunction ready,
+      uint32_t periodMicros, uint32_t deadlineMicros, uint8_t priority);
+
+    Task tasks[maxTasks];
+    int taskCount;
+
+};
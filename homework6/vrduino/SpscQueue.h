@@ -0,0 +1,79 @@
+/**
+ * @file
+ * fixed size single-producer single-consumer ring buffer, to hand data
+ * from an interrupt handler to loop() without masking interrupts.
+ *
+ * push() may only be called from one context (the producer, e.g. an ISR)
+ * and pop() only from another (the consumer, e.g. loop()). Each side
+ * writes only its own index: the producer fills a slot before it
+ * publishes the new head, the consumer reads a slot before it releases
+ * it with the new tail. The indices are free-running 32 bit counters,
+ * so head - tail is the fill level even across the wrap-around, and all
+ * N slots are usable.
+ *
+ * 32 bit loads and stores are atomic on the Cortex-M4, and the ISR and
+ * loop() run on the same core, so a compiler barrier is enough to keep
+ * the slot and the index accesses in order.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#define SPSC_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+template <typename T, int N>
+class SpscQueue {
+
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue length must be a power of 2");
+
+  public:
+
+    SpscQueue() : head(0), tail(0) {}
+
+    /**
+     * producer: appends an item
+     * @returns false, and drops the item, if the queue is full
+     */
+    bool push(const T& item) {
+      uint32_t h = head;
+      if (h - tail >= uint32_t(N)) {
+        return false;
+      }
+      buffer[h & (N - 1)] = item;
+      SPSC_BARRIER();
+      head = h + 1;
+      return true;
+    }
+
+    /**
+     * consumer: removes the oldest item
+     * @returns false if the queue is empty
+     */
+    bool pop(T& item) {
+      uint32_t t = tail;
+      if (head == t) {
+        return false;
+      }
+      item = buffer[t & (N - 1)];
+      SPSC_BARRIER();
+      tail = t + 1;
+      return true;
+    }
+
+    /** consumer: drops all queued items */
+    void clear() { tail = head; }
+
+    /** number of queued items, exact for the consumer */
+    int size() const { return int(head - tail); }
+
+    static int capacity() { return N; }
+
+  private:
+
+    T buffer[N];
+
+    /* count of pushed and popped items */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+
+};
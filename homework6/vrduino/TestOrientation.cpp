@@ -5,12 +5,13 @@
 bool test1() {
   Serial.println();
   Quaternion q = Quaternion(2.3, 1.2, 2.1, 3.0);
-  double l = q.length();
-  double exp = 4.487761;
+  Scalar l = q.length();
+  Scalar exp = 4.487761;
   Serial.printf("Expected length: %f\n", exp);
   Serial.printf("Your result: %f\n", l);
+  bool near = scalarNear(l, exp);
   Serial.println();
-  return doubleNear(l, exp);
+  return near;
 }
 
 
@@ -24,8 +25,9 @@ bool test2() {
   qExp.serialPrint();
   Serial.println("Your result: ");
   q.serialPrint();
+  bool near = quaternionNear(q, qExp);
   Serial.println();
-  return quaternionNear(q, qExp);
+  return near;
 }
 
 /* inverse() */
@@ -37,8 +39,9 @@ bool test3() {
   pExp.serialPrint();
   Serial.println("Your result: ");
   p.serialPrint();
+  bool near = quaternionNear(p, pExp);
   Serial.println();
-  return quaternionNear(p, pExp);
+  return near;
 }
 
 /* setFromAngleAxis() */
@@ -53,8 +56,9 @@ bool test4() {
   qExp.serialPrint();
   Serial.println("Your result: ");
   q0.serialPrint();
+  bool near = quaternionNear(q0, qExp);
   Serial.println();
-  return quaternionNear(q0, qExp);
+  return near;
 }
 
 
@@ -69,8 +73,9 @@ bool test5() {
   qExp.serialPrint();
   Serial.println("Your result: ");
   q1q2.serialPrint();
+  bool near = quaternionNear(q1q2, qExp);
   Serial.println();
-  return quaternionNear(q1q2, qExp);
+  return near;
 }
 
   /* rotate() */
@@ -84,17 +89,242 @@ bool test6() {
   qExp.serialPrint();
   Serial.println("Your result: ");
   q5.serialPrint();
+  bool near = quaternionNear(q5, qExp);
   Serial.println();
-  return quaternionNear(q5, qExp);
+  return near;
 }
 
-/** run all tests */
-void testMain() {
+/* rotateVector() and operator* */
+bool test7() {
+  Quaternion q3 = Quaternion(0.512505, 0.267394, 0.467939, 0.668485);
+  Quaternion q4 = Quaternion(0.461017, -0.475423, -0.749152, -0.014407).normalized();
+  Scalar v[3] = {q3.q[1], q3.q[2], q3.q[3]};
+  Scalar r[3];
+  q4.rotateVector(v, r);
+  Quaternion q5 = Quaternion(q3.q[0], r[0], r[1], r[2]);
+  Quaternion q6 = q4 * q3 * q4.conjugate();
+  Quaternion qExp = Quaternion(
+    0.512505, -0.145908, 0.750596, -0.390712);
+  Serial.println("Expected rotated vector:");
+  qExp.serialPrint();
+  Serial.println("Your result (rotateVector, then operator*): ");
+  q5.serialPrint();
+  q6.serialPrint();
+  bool near = quaternionNear(q5, qExp) && quaternionNear(q6, qExp);
+  Serial.println();
+  return near;
+}
+
+/* rotation angle of a unit quaternion in rad */
+static Scalar rotationAngle(const Quaternion& q) {
+  Scalar v = scalar::sqrt(q.q[1]*q.q[1] + q.q[2]*q.q[2] + q.q[3]*q.q[3]);
+  return 2 * scalar::atan2(v, scalar::fabs(q.q[0]));
+}
+
+/* correctTilt() against correctTiltExact() */
+bool test8() {
+  bool near = true;
+  Scalar maxErr = 0;
+  for (int i = 0; i < 10; i++) {
+    Scalar alpha = Scalar(i) / 10;
+    for (int k = 1; k <= 10; k++) {
+      // world acc tilted by 3k degrees about (1, 0, 1) / sqrt(2)
+      Scalar phi = 3 * k * Scalar(DEG_TO_RAD);
+      Scalar s = Scalar(9.81) * scalar::sin(phi) / scalar::sqrt(Scalar(2));
+      Scalar acc[3] = {-s, Scalar(9.81) * scalar::cos(phi), s};
+
+      Quaternion qExact, q;
+      correctTiltExact(qExact, acc, alpha);
+      correctTilt(q, acc, alpha);
+
+      // same axis, angles agree to 8e-6 relative at 30 degrees
+      Scalar angleExact = rotationAngle(qExact);
+      Scalar err = scalar::fabs(rotationAngle(q) - angleExact);
+      maxErr = err > maxErr ? err : maxErr;
+      near &= err <= Scalar(1e-4) * angleExact;
+      near &= scalar::fabs(q.q[1] * qExact.q[3] - q.q[3] * qExact.q[1]) <= Scalar(scalarTolerance);
+    }
+  }
+
+  // alpha 1 is gyro only
+  Scalar acc[3] = {1, 1, 1};
+  Quaternion q;
+  correctTilt(q, acc, Scalar(1));
+  near &= quaternionNear(q, Quaternion());
+
+  // up to 90 degrees within 1% of the exact angle, past it held at the
+  // correction of 90 degrees, about the same axis, for alpha 0 too
+  Scalar maxRel = 0;
+  static const int tilts[] = {45, 60, 80, 89, 90, 91, 100, 135, 170, 179};
+  for (int i = 0; i < 10; i += 3) {
+    Scalar alpha = Scalar(i) / 10;
+    Scalar s90 = Scalar(9.81) / scalar::sqrt(Scalar(2));
+    Scalar acc90[3] = {-s90, 0, s90};
+    Quaternion q90;
+    correctTilt(q90, acc90, alpha);
+    Scalar held = rotationAngle(q90);
+    for (int k = 0; k < 10; k++) {
+      Scalar phi = tilts[k] * Scalar(DEG_TO_RAD);
+      Scalar s = Scalar(9.81) * scalar::sin(phi) / scalar::sqrt(Scalar(2));
+      Scalar accTilt[3] = {-s, Scalar(9.81) * scalar::cos(phi), s};
+
+      Quaternion qExact, qTilt;
+      correctTiltExact(qExact, accTilt, alpha);
+      correctTilt(qTilt, accTilt, alpha);
+      Scalar angle = rotationAngle(qTilt);
+      Scalar angleExact = rotationAngle(qExact);
+      if (tilts[k] <= 90) {
+        Scalar rel = scalar::fabs(angle - angleExact) / angleExact;
+        maxRel = rel > maxRel ? rel : maxRel;
+        near &= rel <= Scalar(0.01);
+      } else {
+        near &= scalar::fabs(angle - held) <= Scalar(1e-5) && angle < angleExact;
+      }
+      near &= scalar::fabs(qTilt.q[1] * qExact.q[3] - qTilt.q[3] * qExact.q[1]) <= Scalar(scalarTolerance);
+      near &= qTilt.q[1] * qExact.q[1] >= 0 && qTilt.q[3] * qExact.q[3] >= 0;
+    }
+  }
+
+  // the held correction still converges, from any tilt short of 180
+  // degrees, where the axis is undefined and neither corrects
+  Scalar maxTilt = 0;
+  for (int i = 0; i < 10; i += 3) {
+    Scalar alpha = Scalar(i) / 10;
+    for (int k = 0; k < 10; k++) {
+      Scalar phi = tilts[k] * Scalar(DEG_TO_RAD);
+      Scalar s = Scalar(9.81) * scalar::sin(phi) / scalar::sqrt(Scalar(2));
+      Scalar accBody[3] = {-s, Scalar(9.81) * scalar::cos(phi), s};
+      Quaternion qTilt;
+      Scalar a[3];
+      for (int n = 0; n < 200; n++) {
+        qTilt.rotateVector(accBody, a);
+        correctTilt(qTilt, a, alpha);
+      }
+      qTilt.rotateVector(accBody, a);
+      Scalar tilt = scalar::atan2(scalar::sqrt(a[0]*a[0] + a[2]*a[2]), a[1]);
+      maxTilt = tilt > maxTilt ? tilt : maxTilt;
+    }
+  }
+  near &= maxTilt < Scalar(0.01 * DEG_TO_RAD);
+  Scalar accDown[3] = {0, Scalar(-9.81), 0};
+  Quaternion qDown, qDownExact;
+  correctTilt(qDown, accDown, Scalar(0));
+  correctTiltExact(qDownExact, accDown, Scalar(0));
+  near &= quaternionNear(qDown, Quaternion()) && quaternionNear(qDownExact, Quaternion());
+
+  Serial.printf("correctTilt vs correctTiltExact, max angle error %.2e deg\n",
+    double(maxErr) * RAD_TO_DEG);
+  Serial.printf("up to 90 degrees %.2e relative, past 90 held, converged to %.2e deg\n",
+    double(maxRel), double(maxTilt) * RAD_TO_DEG);
+  Serial.println();
+  return near;
+}
+
+/* all estimators settle on a static tilt */
+bool test9() {
+  bool near = true;
+  for (int e = 0; e < ESTIMATOR_COUNT; e++) {
+    // acc tilted by 30 degrees about (1, 0, 1) / sqrt(2), no rotation
+    Scalar phi = 30 * Scalar(DEG_TO_RAD);
+    Scalar s = Scalar(9.81) * scalar::sin(phi) / scalar::sqrt(Scalar(2));
+    Scalar acc[3] = {-s, Scalar(9.81) * scalar::cos(phi), s};
+    Scalar gyr[3] = {0, 0, 0};
+
+    OrientationEstimator estimator(EstimatorType(e), Scalar(0.99));
+    for (int i = 0; i < 5000; i++) {
+      estimator.update(gyr, acc, Scalar(0.002));
+    }
+
+    // acc in world points up, y only. Madgwick keeps dithering by its
+    // fixed step of 2 beta deltaT = 0.1 degrees, Mahony's integral term
+    // decays slowly
+    Scalar a[3];
+    estimator.getQuaternion().rotateVector(acc, a);
+    Scalar tilt = scalar::atan2(scalar::sqrt(a[0]*a[0] + a[2]*a[2]), a[1]);
+    Serial.printf("%s: tilt after 10 s %.2e deg\n", estimatorName(EstimatorType(e)),
+      double(tilt) * RAD_TO_DEG);
+    near &= tilt < Scalar(0.2 * DEG_TO_RAD);
+  }
+  Serial.println();
+  return near;
+}
+
+/* the MEKF removes the tilt error of a gyro bias, the comp filter cannot */
+bool test10() {
+  // acc tilted by 30 degrees, a biased gyro at rest
+  Scalar phi = 30 * Scalar(DEG_TO_RAD);
+  Scalar s = Scalar(9.81) * scalar::sin(phi) / scalar::sqrt(Scalar(2));
+  Scalar acc[3] = {-s, Scalar(9.81) * scalar::cos(phi), s};
+  Scalar gyr[3] = {Scalar(0.5), Scalar(-0.3), Scalar(0.4)};
+
+  OrientationEstimator mekf(ESTIMATOR_MEKF, Scalar(0.999));
+  OrientationEstimator comp(ESTIMATOR_COMP, Scalar(0.999));
+  for (int i = 0; i < 30000; i++) {
+    mekf.update(gyr, acc, Scalar(0.002));
+    comp.update(gyr, acc, Scalar(0.002));
+  }
+
+  Scalar a[3];
+  mekf.getQuaternion().rotateVector(acc, a);
+  Scalar tiltMekf = scalar::atan2(scalar::sqrt(a[0]*a[0] + a[2]*a[2]), a[1]);
+  comp.getQuaternion().rotateVector(acc, a);
+  Scalar tiltComp = scalar::atan2(scalar::sqrt(a[0]*a[0] + a[2]*a[2]), a[1]);
+  Serial.printf("tilt after 60 s with gyro bias, mekf %.2e deg, complementary %.2e deg\n",
+    double(tiltMekf) * RAD_TO_DEG, double(tiltComp) * RAD_TO_DEG);
+  Serial.println();
+  return tiltMekf < Scalar(0.01 * DEG_TO_RAD) && tiltComp > Scalar(0.5 * DEG_TO_RAD);
+}
+
+/* the MEKF starts over at reset(), from any state before */
+bool test11() {
+  Scalar phi = 30 * Scalar(DEG_TO_RAD);
+  Scalar s = Scalar(9.81) * scalar::sin(phi) / scalar::sqrt(Scalar(2));
+  Scalar acc[3] = {-s, Scalar(9.81) * scalar::cos(phi), s};
+  Scalar gyr[3] = {Scalar(0.5), Scalar(-0.3), Scalar(0.4)};
+  Scalar turn[3] = {200, -100, 50};
+
+  // in the middle of a summed window, and on memory that held garbage
+  OrientationEstimator used(ESTIMATOR_MEKF, Scalar(0.999));
+  for (int i = 0; i < 1000 + MEKF_UPDATE_INTERVAL / 2; i++) {
+    used.update(turn, acc, Scalar(0.002));
+  }
+  used.reset();
+  MekfStateT<Scalar> garbage;
+  memset(&garbage, 0xA5, sizeof(garbage));
+  Scalar zero[3] = {0, 0, 0};
+  mekfReset(garbage, MEKF_ESTIMATE_BIAS);
+  mekfSetNoise(garbage, zero, zero);
+  Quaternion q;
+
+  OrientationEstimator fresh(ESTIMATOR_MEKF, Scalar(0.999));
+  bool near = true;
+  for (int i = 0; i < 5000; i++) {
+    fresh.update(gyr, acc, Scalar(0.002));
+    used.update(gyr, acc, Scalar(0.002));
+    updateQuaternionMekf(q, garbage, gyr, acc, Scalar(0.002));
+    if (i % (MEKF_UPDATE_INTERVAL + 1) == 0) {
+      near &= quaternionNear(used.getQuaternion(), fresh.getQuaternion());
+      near &= quaternionNear(q, fresh.getQuaternion());
+    }
+  }
+
+  Scalar a[3];
+  used.getQuaternion().rotateVector(acc, a);
+  Scalar tilt = scalar::atan2(scalar::sqrt(a[0]*a[0] + a[2]*a[2]), a[1]);
+  Serial.printf("mekf after reset(): tilt after 10 s %.2e deg, as a new one: %s\n",
+    double(tilt) * RAD_TO_DEG, near ? "yes" : "no");
+  Serial.println();
+  return near && tilt < Scalar(0.2 * DEG_TO_RAD);
+}
+
+/** run all tests, returns true if all of them pass */
+bool testMain() {
 
   Serial.printf("Testing quaternion:\n\n");
   int res = test1() + test2() + test3() + test4()
-    + test5() + test6();
-  Serial.printf("total passes: %d/6\n", res);
+    + test5() + test6() + test7() + test8() + test9() + test10() + test11();
+  Serial.printf("total passes: %d/11\n", res);
 
+  return res == 11;
 
 }
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "Quaternion.h"
+#include "OrientationEstimator.h"
 #include "OrientationMath.h"
 #include "TestUtil.h"
 
@@ -16,4 +17,9 @@ bool test3();
 bool test4();
 bool test5();
 bool test6();
-void testMain();
+bool test7();
+bool test8();
+bool test9();
+bool test10();
+bool test11();
+bool testMain();
@@ -6,9 +6,9 @@ bool testPose1() {
 
 }
 
-void testPoseMain() {
+bool testPoseMain() {
 
   Serial.printf("testing\n");
-  testPose1();
+  return testPose1();
 
 }
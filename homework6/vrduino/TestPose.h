@@ -11,4 +11,4 @@
 
 bool testPose1();
 
-void testPoseMain();
+bool testPoseMain();
@@ -4,13 +4,22 @@ bool doubleNear(double d1, double d2) {
   return fabs(d1 - d2) <= 0.00001;
 }
 
-bool quaternionNear(Quaternion& q1, Quaternion& q2) {
+bool scalarNear(Scalar d1, Scalar d2) {
+  double error = fabs(double(d1) - double(d2));
+  Serial.printf("Error: %g (tolerance %g)\n", error, scalarTolerance);
+  return error <= scalarTolerance;
+}
+
+bool quaternionNear(const Quaternion& q1, const Quaternion& q2) {
+  double maxError = 0;
   for (int i = 0; i < 4; i++) {
-    if (!doubleNear(q1.q[i], q2.q[i])) {
-      return false;
+    double error = fabs(double(q1.q[i]) - double(q2.q[i]));
+    if (error > maxError) {
+      maxError = error;
     }
   }
-  return true;
+  Serial.printf("Max error: %g (tolerance %g)\n", maxError, scalarTolerance);
+  return maxError <= scalarTolerance;
 }
 
 bool floatNear(float d1, float d2) {
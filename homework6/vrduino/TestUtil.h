@@ -1,8 +1,21 @@
 #pragma once
 #include "Quaternion.h"
 
+/**
+ * absolute tolerance of scalarNear() and quaternionNear(). The expected
+ * values in the tests are given to 6 decimals, which the double build
+ * matches to 1e-5. The single precision build carries ~7 significant
+ * digits and accumulates rounding in normalize()/multiply(), so its
+ * bound is looser.
+ */
+const double scalarTolerance = (sizeof(Scalar) == sizeof(float)) ? 1e-4 : 1e-5;
+
 bool doubleNear(double d1, double d2);
 
 bool floatNear(float d1, float d2);
 
-bool quaternionNear(Quaternion& q1, Quaternion& q2);
+/* compares with scalarTolerance and prints the error */
+bool scalarNear(Scalar d1, Scalar d2);
+
+/* compares with scalarTolerance and prints the largest error */
+bool quaternionNear(const Quaternion& q1, const Quaternion& q2);
@@ -0,0 +1,43 @@
+#include "TickClock.h"
+
+volatile uint64_t TickClock::overflows = 0;
+
+void TickClock::begin() {
+
+  if (FTM0_MOD != 0xFFFF || (FTM0_SC & 0x7F) != FTM0_SC_VALUE) {
+    FTM0_SC = 0;
+    FTM0_CNT = 0;
+    FTM0_MOD = 0xFFFF;
+    FTM0_SC = FTM0_SC_VALUE;
+    #if defined(KINETISK)
+    FTM0_MODE = 0;
+    #endif
+  }
+
+  // ftm0_isr() of InputCapture counts the overflows
+  attachInterruptVector(IRQ_FTM0, ftm0_isr);
+  NVIC_SET_PRIORITY(IRQ_FTM0, 32);
+  NVIC_ENABLE_IRQ(IRQ_FTM0);
+
+}
+
+uint64_t TickClock::now() {
+
+  // the ISR may count an overflow while the 64 bits are read
+  uint64_t count;
+  uint32_t cnt;
+  bool pending;
+  do {
+    count = overflows;
+    cnt = FTM0_CNT;
+    pending = (FTM0_SC & FTM_SC_TOF) != 0;
+  } while (count != overflows);
+
+  // an overflow not counted yet, with interrupts masked or in a higher
+  // priority ISR. If it came after CNT was read, CNT is still high
+  if (pending && cnt < 0x8000) {
+    count++;
+  }
+  return count << 16 | cnt;
+
+}
@@ -0,0 +1,67 @@
+/**
+ * @class TickClock
+ * Monotonic 64-bit time in FTM0 ticks, the timebase shared by the imu and
+ * the lighthouse.
+ *
+ * FTM0 counts the bus clock, 48 MHz on the Teensy 3.2, free running over
+ * 16 bits. InputCapture already counted its overflows to extend the
+ * lighthouse edge captures to 32 bits, which wrap after 89 s. ftm0_isr()
+ * now counts them here in 64 bits, so the same counter gives:
+ * - now(), 64-bit ticks that do not wrap, 21 ns resolution. It is safe
+ *   to call from any priority, also with interrupts masked: an overflow
+ *   the ISR has not counted yet is taken from the pending TOF flag, as
+ *   long as the ISR is held off for less than half a wrap, 0.68 ms
+ * - the 32-bit lighthouse captures, unchanged, as the low 32 bits of the
+ *   same ticks, see extend()
+ *
+ * The imu samples are stamped with now(), see ImuSample, so an imu sample
+ * and a lighthouse sweep can be ordered and related in one timebase, and
+ * intervals need no division by a clock rate: one multiplication by
+ * secondsPerTick.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+/* FTM0 status and control of the tick clock: overflow interrupt, bus clock */
+#define FTM0_SC_VALUE (FTM_SC_TOIE | FTM_SC_CLKS(1) | FTM_SC_PS(0))
+
+class TickClock {
+
+  public:
+
+    /** FTM0 ticks per microsecond, the bus clock without prescaler */
+    static const uint32_t ticksPerMicro = F_BUS / 1000000;
+
+    /** seconds per tick, to scale tick differences */
+    static constexpr double secondsPerTick = 1.0 / F_BUS;
+
+    /**
+     * starts FTM0 free running over 16 bits at the bus clock, with the
+     * overflow interrupt, if it does not run like that yet. Keeps the
+     * count when it does, so now() stays monotonic. Called by
+     * InputCapture::begin() and Imu::init()
+     */
+    static void begin();
+
+    /** @returns ticks since the first begin() */
+    static uint64_t now();
+
+    /**
+     * the 64-bit ticks of a 32-bit tick time at most 89 s in the past,
+     * e.g. a lighthouse capture of InputCapture
+     */
+    static uint64_t extend(uint32_t ticks) {
+      uint64_t current = now();
+      return current - uint32_t(uint32_t(current) - ticks);
+    }
+
+    friend void ftm0_isr(void);
+    friend class InputCapture;
+
+  private:
+
+    /* FTM0 overflows, counted by ftm0_isr() */
+    static volatile uint64_t overflows;
+
+};
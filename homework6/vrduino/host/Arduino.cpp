@@ -0,0 +1,320 @@
+/**
+ * Host stand-in for the Teensyduino core, see Arduino.h
+ */
+
+#include "Arduino.h"
+
+HostSerial Serial;
+
+HostFtm hostFtm0;
+
+volatile uint32_t hostPortConfig[64];
+
+///////////////////////////////////////////////////////////////////////////////
+// time
+
+static uint64_t virtualMicros = 0;
+
+static HostTimedDevice *timedDevices[8];
+static int numTimedDevices = 0;
+
+/* true while an event runs, the clock then advances without nested events */
+static bool inEvent = false;
+
+/* moves the clock to target, stopping at each device event in order */
+static void advanceTo(uint64_t target) {
+
+  while (!inEvent) {
+    HostTimedDevice *next = nullptr;
+    uint64_t nextTime = target;
+    for (int i = 0; i < numTimedDevices; i++) {
+      uint64_t t = timedDevices[i]->hostNextEvent();
+      if (t <= nextTime) {
+        next = timedDevices[i];
+        nextTime = t;
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    if (nextTime > virtualMicros) {
+      virtualMicros = nextTime;
+    }
+    inEvent = true;
+    next->hostEvent();
+    inEvent = false;
+  }
+  if (target > virtualMicros) {
+    virtualMicros = target;
+  }
+
+}
+
+uint32_t micros() {
+  return (uint32_t)virtualMicros;
+}
+
+uint32_t millis() {
+  return (uint32_t)(virtualMicros / 1000);
+}
+
+void delay(uint32_t ms) {
+  advanceTo(virtualMicros + (uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  advanceTo(virtualMicros + us);
+}
+
+void yield() {
+  advanceTo(virtualMicros + 1);
+}
+
+void hostAdvanceMicros(uint64_t us) {
+  advanceTo(virtualMicros + us);
+}
+
+uint64_t hostMicros64() {
+  return virtualMicros;
+}
+
+void hostWaitForInterrupt() {
+  uint64_t target = (virtualMicros / 1000 + 1) * 1000;
+  for (int i = 0; i < numTimedDevices; i++) {
+    uint64_t t = timedDevices[i]->hostNextEvent();
+    if (t > virtualMicros && t < target) {
+      target = t;
+    }
+  }
+  advanceTo(target);
+}
+
+void hostAttachTimedDevice(HostTimedDevice *device) {
+  if (numTimedDevices < 8) {
+    timedDevices[numTimedDevices++] = device;
+  }
+}
+
+void hostDetachTimedDevice(HostTimedDevice *device) {
+  for (int i = 0; i < numTimedDevices; i++) {
+    if (timedDevices[i] == device) {
+      timedDevices[i] = timedDevices[--numTimedDevices];
+      return;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FTM0 counter
+
+static const uint64_t ftm0TicksPerMicro = F_BUS / 1000000;
+
+/* bus ticks of the virtual clock at which CNT was 0 */
+static uint64_t ftm0Base = 0;
+
+/* wraps of CNT since then whose event ran */
+static uint64_t ftm0Wraps = 0;
+
+static bool ftm0Clocked() {
+  return (hostFtm0.SC & FTM_SC_CLKS(3)) != 0;
+}
+
+/* virtual time of the next wrap, the first us at or after it */
+static uint64_t ftm0NextWrap() {
+  uint64_t ticks = ftm0Base + (ftm0Wraps + 1) * 0x10000;
+  return (ticks + ftm0TicksPerMicro - 1) / ftm0TicksPerMicro;
+}
+
+/* sets TOF at each wrap of CNT, see Arduino.h */
+class HostFtm0Overflow : public HostTimedDevice {
+public:
+
+  virtual uint64_t hostNextEvent() {
+    return ftm0Clocked() ? ftm0NextWrap() : UINT64_MAX;
+  }
+
+  virtual void hostEvent() {
+    ftm0Wraps++;
+    hostFtm0.SC |= FTM_SC_TOF;
+    if (hostFtm0.SC & FTM_SC_TOIE) {
+      hostRaiseIrq(IRQ_FTM0);
+    }
+  }
+};
+
+static HostFtm0Overflow ftm0Overflow;
+
+uint32_t hostFtm0Count() {
+  // a wrap during another event, e.g. an ISR reading the bus: its event,
+  // and the interrupt, only follow after that one, TOF is set right away
+  if (ftm0Clocked() && virtualMicros >= ftm0NextWrap()) {
+    hostFtm0.SC |= FTM_SC_TOF;
+  }
+  return (uint32_t)((virtualMicros * ftm0TicksPerMicro - ftm0Base) & 0xFFFF);
+}
+
+void hostFtm0SetCount(uint32_t value) {
+  (void)value;
+  static bool attached = false;
+  if (!attached) {
+    hostAttachTimedDevice(&ftm0Overflow);
+    attached = true;
+  }
+  // writing any value clears the counter, like on the Kinetis
+  ftm0Base = virtualMicros * ftm0TicksPerMicro;
+  ftm0Wraps = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pins and interrupts
+
+static int heldPin = -1;
+static int heldClockPin = -1;
+static int heldClocks = 0;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin == heldClockPin && mode == OUTPUT && heldClocks > 0 && --heldClocks == 0) {
+    heldPin = -1;
+  }
+}
+
+void hostHoldLow(uint8_t pin, uint8_t clockPin, int clocks) {
+  heldPin = clocks != 0 ? pin : -1;
+  heldClockPin = clockPin;
+  heldClocks = clocks;
+}
+
+static void (*pinWatchers[CORE_NUM_DIGITAL])(uint8_t pin, uint8_t value);
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < CORE_NUM_DIGITAL && pinWatchers[pin] != nullptr) {
+    pinWatchers[pin](pin, value);
+  }
+}
+
+void hostWatchPin(uint8_t pin, void (*fn)(uint8_t pin, uint8_t value)) {
+  if (pin < CORE_NUM_DIGITAL) {
+    pinWatchers[pin] = fn;
+  }
+}
+
+uint8_t digitalRead(uint8_t pin) {
+  return pin == heldPin ? LOW : HIGH;
+}
+
+static void (*interruptHandlers[CORE_NUM_DIGITAL])(void);
+static bool interruptMasked[CORE_NUM_DIGITAL];
+static bool interruptPending[CORE_NUM_DIGITAL];
+
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode) {
+  (void)mode;
+  if (pin < CORE_NUM_DIGITAL) {
+    interruptHandlers[pin] = function;
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < CORE_NUM_DIGITAL) {
+    interruptHandlers[pin] = nullptr;
+  }
+}
+
+void hostRaiseInterrupt(uint8_t pin) {
+  if (pin < CORE_NUM_DIGITAL && interruptMasked[pin]) {
+    interruptPending[pin] = true;
+  } else if (pin < CORE_NUM_DIGITAL && interruptHandlers[pin] != nullptr) {
+    interruptHandlers[pin]();
+  }
+}
+
+void hostMaskInterrupt(uint8_t pin, bool masked) {
+  if (pin >= CORE_NUM_DIGITAL) {
+    return;
+  }
+  interruptMasked[pin] = masked;
+  if (!masked && interruptPending[pin]) {
+    interruptPending[pin] = false;
+    hostRaiseInterrupt(pin);
+  }
+}
+
+static void (*interruptVectors[64])(void);
+
+void attachInterruptVector(enum IRQ_NUMBER_t irq, void (*function)(void)) {
+  interruptVectors[irq] = function;
+}
+
+void hostRaiseIrq(enum IRQ_NUMBER_t irq) {
+  if (interruptVectors[irq] != nullptr) {
+    interruptVectors[irq]();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Serial
+
+int HostSerial::available() {
+  return (int)input.size();
+}
+
+int HostSerial::read() {
+  if (input.empty()) {
+    return -1;
+  }
+  int c = (unsigned char)input[0];
+  input.erase(0, 1);
+  return c;
+}
+
+void HostSerial::hostInput(const char *s) {
+  input += s;
+}
+
+size_t HostSerial::write(uint8_t c) {
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HostSerial::print(const char *s) {
+  return fputs(s, stdout) == EOF ? 0 : strlen(s);
+}
+
+size_t HostSerial::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t HostSerial::print(long n, int base) {
+  if (base == DEC) {
+    return ::printf("%ld", n);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t HostSerial::print(unsigned long n, int base) {
+  if (base == HEX) {
+    return ::printf("%lX", n);
+  } else if (base == OCT) {
+    return ::printf("%lo", n);
+  } else if (base == BIN) {
+    char buf[8 * sizeof(n) + 1];
+    char *p = &buf[sizeof(buf) - 1];
+    *p = '\0';
+    do {
+      *--p = (n & 1) ? '1' : '0';
+      n >>= 1;
+    } while (n);
+    return print(p);
+  }
+  return ::printf("%lu", n);
+}
+
+size_t HostSerial::print(double n, int digits) {
+  return ::printf("%.*f", digits, n);
+}
+
+int HostSerial::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
@@ -0,0 +1,349 @@
+/**
+ * Host stand-in for the Teensyduino core (Arduino.h)
+ *
+ * This header is only on the include path of the host (x86 Linux) build, see
+ * CMakeLists.txt. It provides just enough of the Teensy 3.2 core for the
+ * vrduino tracking code to compile and run natively:
+ * - math constants and helpers (PI, DEG_TO_RAD, sq(), ...)
+ * - a virtual microsecond clock driven by delay()/delayMicroseconds(),
+ *   which runs the events of HostTimedDevice models on the way
+ * - pin stubs (the I2C lines always read back HIGH, i.e. an idle bus),
+ *   with pin writes forwarded to device models, e.g. an SPI chip select
+ * - pin interrupts, raised by the device models with hostRaiseInterrupt()
+ * - a Serial object that prints to stdout and reads injected input
+ * - a fake FTM0 register block so InputCapture can be driven by tests
+ * - I2C0 registers backed by a model of the peripheral, for I2cAsync
+ *
+ * The Teensy toolchain never sees this directory.
+ */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/*
+ * pretend to be a Teensy 3.2 running at 96 MHz. ARDUINO, TEENSYDUINO and
+ * F_CPU are passed on the command line as by Teensyduino, the rest comes
+ * from kinetis.h on the real core.
+ */
+#define KINETISK
+#define F_BUS 48000000
+#define F_PLL 96000000
+
+#define PI         3.1415926535897932384626433832795
+#define HALF_PI    1.5707963267948966192313216916398
+#define TWO_PI     6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define sq(x) ((x)*(x))
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define FALLING 2
+#define RISING  3
+#define CHANGE  4
+
+#define BIN 2
+#define OCT 8
+#define DEC 10
+#define HEX 16
+
+/* I2C0 pins of the Teensy 3.2 */
+#define SDA 18
+#define SCL 19
+
+/* binary constants used by the sketch (subset of binary.h) */
+#define B00010001 17
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// String
+
+class String : public std::string {
+public:
+  String() {}
+  String(const char *s) : std::string(s) {}
+  String(const std::string& s) : std::string(s) {}
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// time
+
+/* microseconds since start, wraps after ~71 minutes like on the Teensy */
+uint32_t micros();
+
+/* milliseconds since start */
+uint32_t millis();
+
+/* advances the virtual clock, returns immediately */
+void delay(uint32_t ms);
+
+/* advances the virtual clock, returns immediately */
+void delayMicroseconds(uint32_t us);
+
+/* called by busy-wait loops, advances the virtual clock by 1 us */
+void yield();
+
+/* host only: advance the virtual clock by us microseconds */
+void hostAdvanceMicros(uint64_t us);
+
+/* host only: virtual clock without wrap-around */
+uint64_t hostMicros64();
+
+/* host only: WFI, advances the virtual clock to the next device event,
+ * which may raise an interrupt, or to the SysTick of the next ms */
+void hostWaitForInterrupt();
+
+
+/**
+ * host only: model of a device with its own time base, e.g. a sensor
+ * sampling at a fixed rate. While the virtual clock advances, it stops at
+ * each event time in order and calls hostEvent(), so micros() inside the
+ * event, and inside interrupt handlers it raises, reads the event time.
+ * Events are the only place where the host "preempts" the sketch.
+ */
+class HostTimedDevice {
+public:
+
+  virtual ~HostTimedDevice() {}
+
+  /* virtual time of the next event in us, see hostMicros64() */
+  virtual uint64_t hostNextEvent() = 0;
+
+  /* runs the event, and moves hostNextEvent() past the current time */
+  virtual void hostEvent() = 0;
+};
+
+/* host only: add or remove a device from the virtual clock, at most 8 */
+void hostAttachTimedDevice(HostTimedDevice *device);
+void hostDetachTimedDevice(HostTimedDevice *device);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// pins and interrupts
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+void digitalWrite(uint8_t pin, uint8_t value);
+
+/* all pins read HIGH (pulled-up, idle), except one held by hostHoldLow() */
+uint8_t digitalRead(uint8_t pin);
+
+/* host only: pin reads LOW until clockPin was driven low (made an OUTPUT)
+ * clocks times, e.g. SDA held by an I2C slave until clocked on SCL. A
+ * negative count holds it for good, 0 releases it */
+void hostHoldLow(uint8_t pin, uint8_t clockPin, int clocks);
+
+/* host only: calls fn on every digitalWrite() of pin, nullptr stops */
+void hostWatchPin(uint8_t pin, void (*fn)(uint8_t pin, uint8_t value));
+
+/* interrupts are never preempting on the host, so masking is a no-op */
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+/* every digital pin can interrupt on the Teensy 3.2 */
+#define CORE_NUM_DIGITAL 34
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(pin) ((pin) < CORE_NUM_DIGITAL ? (pin) : NOT_AN_INTERRUPT)
+
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode);
+
+void detachInterrupt(uint8_t pin);
+
+/* host only: runs the handler attached to pin, as if its edge arrived */
+void hostRaiseInterrupt(uint8_t pin);
+
+/* host only: holds the handler of pin off like NVIC_DISABLE_IRQ of its
+ * port, the edges meanwhile run it once when unmasked */
+void hostMaskInterrupt(uint8_t pin, bool masked);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Serial
+
+class HostSerial {
+public:
+
+  void begin(long baud) { (void)baud; }
+
+  /* number of injected input bytes not yet read */
+  int available();
+
+  /* next injected input byte, or -1 */
+  int read();
+
+  size_t write(uint8_t c);
+
+  size_t print(const char *s);
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t print(char c);
+  size_t print(int n, int base = DEC) { return print(long(n), base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+
+  size_t println() { return print("\n"); }
+
+  template <typename T>
+  size_t println(const T& value) { size_t n = print(value); return n + println(); }
+
+  template <typename T>
+  size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+  int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  operator bool() { return true; }
+
+  /* host only: queue bytes to be returned by read() */
+  void hostInput(const char *s);
+
+private:
+  std::string input;
+};
+
+extern HostSerial Serial;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Kinetis FTM0 registers used by InputCapture and TickClock.
+// Each channel is a {CnSC, CnV} pair, laid out like the real register block,
+// so tests can set a capture value and call ftm0_isr() directly.
+// All but CNT are plain memory. CNT counts F_BUS on the virtual clock,
+// over 16 bits, from the last write to it. From then on, while SC selects
+// a clock, each wrap sets TOF and raises IRQ_FTM0 if TOIE is set.
+
+uint32_t hostFtm0Count();
+void hostFtm0SetCount(uint32_t value);
+
+class HostFtmCounter {
+public:
+  operator uint32_t() const { return hostFtm0Count(); }
+  HostFtmCounter& operator=(uint32_t value) { hostFtm0SetCount(value); return *this; }
+};
+
+struct HostFtm {
+  volatile uint32_t SC;
+  HostFtmCounter CNT;
+  volatile uint32_t MOD;
+  volatile uint32_t MODE;
+  volatile uint32_t channel[8][2];
+};
+
+extern HostFtm hostFtm0;
+
+#define FTM0_SC   (hostFtm0.SC)
+#define FTM0_CNT  (hostFtm0.CNT)
+#define FTM0_MOD  (hostFtm0.MOD)
+#define FTM0_MODE (hostFtm0.MODE)
+#define FTM0_C0SC (hostFtm0.channel[0][0])
+#define FTM0_C0V  (hostFtm0.channel[0][1])
+#define FTM0_C1SC (hostFtm0.channel[1][0])
+#define FTM0_C1V  (hostFtm0.channel[1][1])
+#define FTM0_C2SC (hostFtm0.channel[2][0])
+#define FTM0_C2V  (hostFtm0.channel[2][1])
+#define FTM0_C3SC (hostFtm0.channel[3][0])
+#define FTM0_C3V  (hostFtm0.channel[3][1])
+#define FTM0_C4SC (hostFtm0.channel[4][0])
+#define FTM0_C4V  (hostFtm0.channel[4][1])
+#define FTM0_C5SC (hostFtm0.channel[5][0])
+#define FTM0_C5V  (hostFtm0.channel[5][1])
+#define FTM0_C6SC (hostFtm0.channel[6][0])
+#define FTM0_C6V  (hostFtm0.channel[6][1])
+#define FTM0_C7SC (hostFtm0.channel[7][0])
+#define FTM0_C7V  (hostFtm0.channel[7][1])
+
+#define FTM_SC_TOF     0x80
+#define FTM_SC_TOIE    0x40
+#define FTM_SC_CLKS(n) (((n) & 3) << 3)
+#define FTM_SC_PS(n)   ((n) & 7)
+#define FTM_CSC_CHF    0x80
+
+void ftm0_isr(void);
+
+#define NVIC_SET_PRIORITY(irq, priority) ((void)(irq), (void)(priority))
+#define NVIC_ENABLE_IRQ(irq)             ((void)(irq))
+
+extern volatile uint32_t hostPortConfig[64];
+
+#define portConfigRegister(pin) (&hostPortConfig[(pin)])
+#define PORT_PCR_MUX(n)         (((n) & 7) << 8)
+
+
+///////////////////////////////////////////////////////////////////////////////
+// interrupt vectors
+
+enum IRQ_NUMBER_t {
+  IRQ_I2C0 = 24,
+  IRQ_FTM0 = 25
+};
+
+/* the vector table is in RAM on the Teensy 3, so handlers can be swapped */
+void attachInterruptVector(enum IRQ_NUMBER_t irq, void (*function)(void));
+
+/* host only: runs the vector of irq, as if its peripheral raised it */
+void hostRaiseIrq(enum IRQ_NUMBER_t irq);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Kinetis I2C0 registers used by I2cAsync.
+// Unlike FTM0 these are not plain memory: each access goes to a model of
+// the peripheral in Wire.cpp. It shifts bytes to and from the
+// HostI2CDevices attached to Wire, taking their time on the bus of the
+// virtual clock, and raises IRQ_I2C0 after each byte.
+
+uint8_t hostI2c0Read(int reg);
+void hostI2c0Write(int reg, uint8_t value);
+
+class HostI2cRegister {
+public:
+  explicit HostI2cRegister(int reg) : reg(reg) {}
+  operator uint8_t() const { return hostI2c0Read(reg); }
+  HostI2cRegister& operator=(uint8_t value) { hostI2c0Write(reg, value); return *this; }
+  HostI2cRegister& operator|=(uint8_t value) { return *this = uint8_t(*this | value); }
+  HostI2cRegister& operator&=(uint8_t value) { return *this = uint8_t(*this & value); }
+private:
+  int reg;
+};
+
+extern HostI2cRegister hostI2c0[7];
+
+#define I2C0_A1  (hostI2c0[0])
+#define I2C0_F   (hostI2c0[1])
+#define I2C0_C1  (hostI2c0[2])
+#define I2C0_S   (hostI2c0[3])
+#define I2C0_D   (hostI2c0[4])
+#define I2C0_C2  (hostI2c0[5])
+#define I2C0_FLT (hostI2c0[6])
+
+#define I2C_C1_IICEN ((uint8_t)0x80)
+#define I2C_C1_IICIE ((uint8_t)0x40)
+#define I2C_C1_MST   ((uint8_t)0x20)
+#define I2C_C1_TX    ((uint8_t)0x10)
+#define I2C_C1_TXAK  ((uint8_t)0x08)
+#define I2C_C1_RSTA  ((uint8_t)0x04)
+
+#define I2C_S_TCF   ((uint8_t)0x80)
+#define I2C_S_BUSY  ((uint8_t)0x20)
+#define I2C_S_ARBL  ((uint8_t)0x10)
+#define I2C_S_IICIF ((uint8_t)0x02)
+#define I2C_S_RXAK  ((uint8_t)0x01)
+
+#endif // ifndef ARDUINO_H
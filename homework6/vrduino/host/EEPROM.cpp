@@ -0,0 +1,38 @@
+/**
+ * Host stand-in for the EEPROM library, see EEPROM.h
+ */
+
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass() :
+  writes(0)
+{
+  hostErase();
+}
+
+uint8_t EEPROMClass::read(int address) {
+  if (address < 0 || address >= (int)sizeof(data)) {
+    return 0xFF;
+  }
+  return data[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  if (address < 0 || address >= (int)sizeof(data)) {
+    return;
+  }
+  data[address] = value;
+  writes++;
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if (read(address) != value) {
+    write(address, value);
+  }
+}
+
+void EEPROMClass::hostErase() {
+  memset(data, 0xFF, sizeof(data));
+}
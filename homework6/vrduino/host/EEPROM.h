@@ -0,0 +1,41 @@
+/**
+ * Host stand-in for the EEPROM library of the Teensy 3
+ *
+ * 2048 bytes, blank (0xFF) at start like erased flash. Counts the bytes
+ * written, so tests can check how much a save wears the EEPROM.
+ */
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include "Arduino.h"
+
+class EEPROMClass {
+public:
+
+  EEPROMClass();
+
+  uint8_t read(int address);
+
+  void write(int address, uint8_t value);
+
+  /* writes only if the byte differs */
+  void update(int address, uint8_t value);
+
+  uint16_t length() { return sizeof(data); }
+
+  /* host only: number of bytes written so far */
+  uint32_t hostWrites() const { return writes; }
+
+  /* host only: blanks all bytes */
+  void hostErase();
+
+private:
+
+  uint8_t data[2048];
+  uint32_t writes;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // ifndef EEPROM_H
@@ -0,0 +1,588 @@
+/**
+ * Host benchmark of the tracking hot paths
+ *
+ * Replays simulatedImuData.h and simulatedLighthouseData.h through the
+ * orientation and pose math, in double and in float, and reports the
+ * wall-clock time per call and the deviation of the float results from
+ * double. Absolute times are for the host CPU, not the Teensy, but relative
+ * costs and regressions carry over.
+ *
+ * The estimators of OrientationEstimator.h are compared on the same data.
+ * There is no ground truth for the recording, so the tracking error is the
+ * tilt error on quasi-static samples, where acc is close to 1 g and the
+ * gyro close to 0 and the acc direction is a good reference for up.
+ * Their drift is measured on a synthetic sequence with known orientation
+ * instead, with a biased and noisy gyro.
+ *
+ * Blocking and background imu reads are compared on the HostMpu9250
+ * model, in virtual time: the time per loop() iteration when each one
+ * samples the imu and then spends a fixed time on other work, as the
+ * lighthouse processing and the serial output do, over a bus with added
+ * latency per transaction.
+ *
+ * Polled reads with INT_STATUS read alone first and with the status and
+ * data in one burst, INT_STATUS alone after an empty one, are compared on
+ * the same model: I2C transactions and bus time per sample read, polling
+ * at a few intervals.
+ *
+ * The boot of vrduino.ino, from initImu() to the first processed sample,
+ * is timed on the model with a blank EEPROM, measuring the bias, and
+ * with the calibration saved by that boot, see ImuCalibration.h.
+ *
+ * usage: vrduino_bench [repetitions]
+ */
+
+#include <chrono>
+#include <random>
+#include <EEPROM.h>
+#include "OrientationEstimator.h"
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "OrientationMath.h"
+#include "OrientationTracker.h"
+#include "PoseMath.h"
+#include "simulatedImuData.h"
+#include "simulatedLighthouseData.h"
+
+static const int nImu = nImuSamples / 6;
+static const int nLighthouse = nLighthouseSamples / 8;
+
+/* keeps the optimizer from discarding results */
+static volatile double sink;
+
+/**
+ * calls fn(i) for i in [0, n) repetitions times and prints the mean
+ * time per call in ns
+ */
+template <typename Fn>
+static void bench(const char *name, int n, int repetitions, Fn fn) {
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    for (int i = 0; i < n; i++) {
+      fn(i);
+    }
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+  Serial.printf("  %-30s %10.1f ns/call\n", name, ns / (double(n) * repetitions));
+
+}
+
+/* copies simulated imu sample i into gyr and acc */
+template <typename T>
+static void imuSample(int i, T gyr[3], T acc[3]) {
+  for (int k = 0; k < 3; k++) {
+    gyr[k] = imuData[6*i + k];
+    acc[k] = imuData[6*i + 3 + k];
+  }
+}
+
+/** result of replaying the whole simulated sequence once */
+struct Trajectory {
+  QuaternionT<double> qComp[nImu];
+  double position[nLighthouse][3];
+};
+
+template <typename T>
+static void benchPrecision(const char *name, int repetitions, Trajectory& out) {
+
+  Serial.printf("%s:\n", name);
+
+  T deltaT = T(0.002);
+  T alpha = T(0.99);
+  T gyr[3], acc[3];
+
+  T roll = 0;
+  bench("computeFlatlandRollComp", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    roll = computeFlatlandRollComp(roll, gyr, computeFlatlandRollAcc(acc), deltaT, alpha);
+  });
+  sink = roll;
+
+  bench("computeAccPitch/Roll", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    sink = computeAccPitch(acc) + computeAccRoll(acc);
+  });
+
+  QuaternionT<T> qExact, qPoly;
+  bench("integrateGyrExact", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    integrateGyrExact(qExact, gyr, deltaT);
+  });
+  bench("integrateGyrPoly", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    integrateGyrPoly(qPoly, gyr, deltaT);
+  });
+  sink = qExact.q[0] + qPoly.q[0];
+
+  // raw acc as world acc, the cost does not depend on the tilt
+  QuaternionT<T> qTiltExact, qTilt;
+  bench("correctTiltExact", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    correctTiltExact(qTiltExact, acc, alpha);
+  });
+  bench("correctTilt", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    correctTilt(qTilt, acc, alpha);
+  });
+  sink = qTiltExact.q[0] + qTilt.q[0];
+
+  QuaternionT<T> qGyr;
+  bench("updateQuaternionGyr", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    updateQuaternionGyr(qGyr, gyr, deltaT);
+  });
+  sink = qGyr.q[0];
+
+  QuaternionT<T> qComp;
+  bench("updateQuaternionComp", nImu, repetitions, [&](int i) {
+    imuSample(i, gyr, acc);
+    updateQuaternionComp(qComp, gyr, acc, deltaT, alpha);
+  });
+  sink = qComp.q[0];
+
+  T positionRef[8] = {-42.0, 25.0, 42.0, 25.0, 42.0, -25.0, -42.0, -25.0};
+  uint32_t clockTicks[8];
+  T position2D[8], A[8][8], h[8], R[3][3], position[3] = {0, 0, 0};
+
+  bench("convertTicksTo2DPositions", nLighthouse, repetitions, [&](int i) {
+    for (int k = 0; k < 8; k++) {
+      clockTicks[k] = clockTicksData[8*i + k];
+    }
+    convertTicksTo2DPositions(clockTicks, position2D);
+  });
+  sink = position2D[0];
+
+  bench("pose (ticks -> quaternion)", nLighthouse, repetitions, [&](int i) {
+    for (int k = 0; k < 8; k++) {
+      clockTicks[k] = clockTicksData[8*i + k];
+    }
+    convertTicksTo2DPositions(clockTicks, position2D);
+    formA(position2D, positionRef, A);
+    if (solveForH(A, position2D, h)) {
+      getRtFromH(h, R, position);
+      sink = getQuaternionFromRotationMatrix(R).q[0];
+    }
+  });
+
+  // integrateGyrPoly vs integrateGyrExact over one pass, at the simulated
+  // 500 Hz and at 100 Hz, where fast turns may take the exact fallback
+  for (int step = 1; step <= 5; step += 4) {
+    qExact = qPoly = QuaternionT<T>();
+    double maxAngle = 0;
+    for (int i = 0; i < nImu; i += step) {
+      imuSample(i, gyr, acc);
+      integrateGyrExact(qExact, gyr, deltaT * step);
+      integrateGyrPoly(qPoly, gyr, deltaT * step);
+      maxAngle = fmax(maxAngle, angleBetween(qExact, qPoly));
+    }
+    Serial.printf("  integrateGyrPoly vs Exact at %3d Hz    max %.2e deg, final |q| - 1 = %.1e\n",
+      500 / step, maxAngle, double(qPoly.length()) - 1);
+  }
+
+  // complementary filter with correctTilt vs correctTiltExact over one
+  // pass, for the range of alpha values
+  const T alphas[] = {T(0), T(0.5), T(0.9), T(0.99), T(0.999), T(1)};
+  for (T a : alphas) {
+    qExact = qTilt = QuaternionT<T>();
+    double maxAngle = 0;
+    for (int i = 0; i < nImu; i++) {
+      imuSample(i, gyr, acc);
+      T accWorld[3];
+      integrateGyrPoly(qExact, gyr, deltaT);
+      qExact.rotateVector(acc, accWorld);
+      correctTiltExact(qExact, accWorld, a);
+      integrateGyrPoly(qTilt, gyr, deltaT);
+      qTilt.rotateVector(acc, accWorld);
+      correctTilt(qTilt, accWorld, a);
+      maxAngle = fmax(maxAngle, angleBetween(qExact, qTilt));
+    }
+    Serial.printf("  correctTilt vs Exact, alpha %-5g     max %.2e deg\n",
+      double(a), maxAngle);
+  }
+
+  // one clean pass for the accuracy comparison
+  qComp = QuaternionT<T>();
+  for (int i = 0; i < nImu; i++) {
+    imuSample(i, gyr, acc);
+    updateQuaternionComp(qComp, gyr, acc, deltaT, alpha);
+    for (int k = 0; k < 4; k++) {
+      out.qComp[i].q[k] = qComp.q[k];
+    }
+  }
+  for (int i = 0; i < nLighthouse; i++) {
+    for (int k = 0; k < 8; k++) {
+      clockTicks[k] = clockTicksData[8*i + k];
+    }
+    convertTicksTo2DPositions(clockTicks, position2D);
+    formA(position2D, positionRef, A);
+    if (solveForH(A, position2D, h)) {
+      getRtFromH(h, R, position);
+    }
+    for (int k = 0; k < 3; k++) {
+      out.position[i][k] = position[k];
+    }
+  }
+
+  Serial.println();
+
+}
+
+/* angle in degrees between up in the world frame and acc rotated by q */
+template <typename T>
+static double tiltError(const QuaternionT<T>& q, T acc[3]) {
+  T a[3];
+  q.rotateVector(acc, a);
+  double normN = sqrt(double(a[0])*a[0] + double(a[2])*a[2]);
+  return atan2(normN, double(a[1])) * RAD_TO_DEG;
+}
+
+/* true if the sample is close to rest, |a| within 5% of g and |w| < 30 deg/s */
+template <typename T>
+static bool quasiStatic(T gyr[3], T acc[3]) {
+  double normA = sqrt(sq(acc[0]) + sq(acc[1]) + sq(acc[2]));
+  double normW = sqrt(sq(gyr[0]) + sq(gyr[1]) + sq(gyr[2]));
+  return fabs(normA - 9.80665) < 0.05 * 9.80665 && normW < 30;
+}
+
+template <typename T>
+static void benchEstimators(const char *name, int repetitions) {
+
+  Serial.printf("%s estimators, time per update, tilt error at rest (mean, max),\n"
+    "max difference from the complementary filter:\n", name);
+
+  T deltaT = T(0.002);
+  T alpha = T(0.99);
+  T gyr[3], acc[3];
+
+  QuaternionT<double> qComp[nImu];
+
+  for (int e = 0; e < ESTIMATOR_COUNT; e++) {
+    OrientationEstimatorT<T> estimator(EstimatorType(e), alpha);
+    bench(estimatorName(EstimatorType(e)), nImu, repetitions, [&](int i) {
+      imuSample(i, gyr, acc);
+      estimator.update(gyr, acc, deltaT);
+    });
+    sink = estimator.getQuaternion().q[0];
+
+    // one clean pass for the errors
+    estimator.reset();
+    double meanTilt = 0, maxTilt = 0, maxComp = 0;
+    int nStatic = 0;
+    for (int i = 0; i < nImu; i++) {
+      imuSample(i, gyr, acc);
+      estimator.update(gyr, acc, deltaT);
+      const QuaternionT<T>& q = estimator.getQuaternion();
+      if (e == ESTIMATOR_COMP) {
+        qComp[i] = QuaternionT<double>(q.q[0], q.q[1], q.q[2], q.q[3]);
+      }
+      maxComp = fmax(maxComp, angleBetween(q, qComp[i]));
+      // skip the first second, while the estimate converges from identity
+      if (i >= 500 && quasiStatic(gyr, acc)) {
+        double tilt = tiltError(q, acc);
+        meanTilt += tilt;
+        maxTilt = fmax(maxTilt, tilt);
+        nStatic++;
+      }
+    }
+    Serial.printf("  %-30s %10.3f / %.3f deg, %.2f deg (%d samples at rest)\n", "",
+      meanTilt / nStatic, maxTilt, maxComp, nStatic);
+  }
+
+  Serial.println();
+
+}
+
+/* synthetic imu sequence with known orientation, see makeSynthetic() */
+static const int nSynthetic = 30000;
+static double syntheticGyr[nSynthetic][3], syntheticAcc[nSynthetic][3];
+static QuaternionT<double> syntheticTruth[nSynthetic];
+
+/**
+ * 60 s at 500 Hz of smooth rotation up to 70 deg/s about all axes. The
+ * gyro has a bias of (0.5, -0.3, 0.4) deg/s and noise of 0.1 deg/s, the
+ * acc gravity only with noise of 0.05 m/s^2
+ */
+static void makeSynthetic() {
+
+  std::mt19937 rng(267);
+  std::normal_distribution<double> noise(0, 1);
+  const double bias[3] = {0.5, -0.3, 0.4};
+
+  QuaternionT<double> q;
+  for (int i = 0; i < nSynthetic; i++) {
+    double t = i * 0.002;
+    double w[3] = {
+      60 * sin(TWO_PI * 0.31 * t),
+      45 * sin(TWO_PI * 0.17 * t + 1),
+      70 * sin(TWO_PI * 0.23 * t + 2)
+    };
+    integrateGyrExact(q, w, 0.002);
+    syntheticTruth[i] = q;
+
+    double up[3];
+    expectedUp(q, up);
+    for (int k = 0; k < 3; k++) {
+      syntheticGyr[i][k] = w[k] + bias[k] + 0.1 * noise(rng);
+      syntheticAcc[i][k] = 9.80665 * up[k] + 0.05 * noise(rng);
+    }
+  }
+
+}
+
+/**
+ * tilt error in degrees, the angle between up in the imu frame of the
+ * estimate and of the truth. Yaw is not observable from acc
+ */
+template <typename T>
+static double tiltBetween(const QuaternionT<T>& q, const QuaternionT<double>& truth) {
+  QuaternionT<double> d(q.q[0], q.q[1], q.q[2], q.q[3]);
+  double u[3], v[3];
+  expectedUp(d.normalized(), u);
+  expectedUp(truth, v);
+  double c[3] = {u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0]};
+  return atan2(sqrt(sq(c[0]) + sq(c[1]) + sq(c[2])), u[0]*v[0] + u[1]*v[1] + u[2]*v[2]) * RAD_TO_DEG;
+}
+
+template <typename T>
+static void benchDrift(const char *name) {
+
+  Serial.printf("%s estimators, tilt error with a biased gyro on the synthetic\n"
+    "sequence (mean, max after the first 10 s):\n", name);
+
+  struct Config {
+    EstimatorType type;
+    double alpha;
+    bool mekfBias;
+  };
+  const Config configs[] = {
+    {ESTIMATOR_COMP, 0.99, true},
+    {ESTIMATOR_COMP, 0.999, true},
+    {ESTIMATOR_MADGWICK, 0.99, true},
+    {ESTIMATOR_MAHONY, 0.99, true},
+    {ESTIMATOR_MEKF, 0.99, false},
+    {ESTIMATOR_MEKF, 0.99, true}
+  };
+
+  for (const Config& c : configs) {
+    OrientationEstimatorT<T> estimator(c.type, T(c.alpha));
+    estimator.setMekfBias(c.mekfBias);
+
+    double meanTilt = 0, maxTilt = 0;
+    for (int i = 0; i < nSynthetic; i++) {
+      T gyr[3], acc[3];
+      for (int k = 0; k < 3; k++) {
+        gyr[k] = T(syntheticGyr[i][k]);
+        acc[k] = T(syntheticAcc[i][k]);
+      }
+      estimator.update(gyr, acc, T(0.002));
+      if (i >= 5000) {
+        double tilt = tiltBetween(estimator.getQuaternion(), syntheticTruth[i]);
+        meanTilt += tilt / (nSynthetic - 5000);
+        maxTilt = fmax(maxTilt, tilt);
+      }
+    }
+
+    char label[64];
+    if (c.type == ESTIMATOR_COMP) {
+      snprintf(label, sizeof(label), "%s, alpha %g", estimatorName(c.type), c.alpha);
+    } else if (c.type == ESTIMATOR_MEKF) {
+      snprintf(label, sizeof(label), "%s, %s", estimatorName(c.type), c.mekfBias ? "bias states" : "no bias states");
+    } else {
+      snprintf(label, sizeof(label), "%s", estimatorName(c.type));
+    }
+    Serial.printf("  %-30s %10.3f / %.3f deg\n", label, meanTilt, maxTilt);
+  }
+
+  Serial.println();
+
+}
+
+/**
+ * virtual us per loop() iteration and imu samples processed per s, with
+ * processImu() and then work us of other work per iteration
+ */
+static void loopTime(bool async, uint32_t work, double& loopMicros, double& samplesPerSecond) {
+
+  const int iterations = 2000;
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  if (async) {
+    tracker.initImuAsync();
+  }
+
+  uint64_t start = hostMicros64();
+  for (int i = 0; i < iterations; i++) {
+    tracker.processImu();
+    delayMicroseconds(work);
+  }
+  double elapsed = double(hostMicros64() - start);
+
+  loopMicros = elapsed / iterations;
+  samplesPerSecond = tracker.getImuSamplesProcessed() / elapsed * 1e6;
+
+}
+
+static void benchImuRead() {
+
+  Serial.printf("imu reads at 400 kHz on the MPU9250 model, virtual time per loop\n"
+    "and samples per s, blocking vs background:\n");
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+
+  const uint32_t latencies[] = {0, 100, 300};
+  const uint32_t works[] = {200, 1000};
+  for (uint32_t latency : latencies) {
+    Wire.hostSetLatency(latency);
+    for (uint32_t work : works) {
+      double blockingMicros, blockingRate, asyncMicros, asyncRate;
+      loopTime(false, work, blockingMicros, blockingRate);
+      loopTime(true, work, asyncMicros, asyncRate);
+      Serial.printf("  latency %3u us, work %4u us  %7.1f us %6.1f/s  %7.1f us %6.1f/s\n",
+        (unsigned)latency, (unsigned)work, blockingMicros, blockingRate, asyncMicros, asyncRate);
+    }
+  }
+  Serial.println();
+
+  Wire.hostSetLatency(0);
+  mpu.detach();
+
+}
+
+/**
+ * Wire transactions and virtual us in Imu::readRaw() per sample read,
+ * polling every interval us for a second
+ */
+static void pollCost(bool burst, uint32_t interval, double& transactionsPerSample,
+  double& busMicrosPerSample) {
+
+  Imu imu;
+  imu.setStatusBurst(burst);
+  imu.init();
+
+  ImuSample sample;
+  uint32_t samples = 0;
+  uint64_t busMicros = 0;
+  uint32_t transactions = Wire.hostTransactions();
+  uint64_t end = hostMicros64() + 1000000;
+  while (hostMicros64() < end) {
+    uint64_t start = hostMicros64();
+    samples += imu.readRaw(sample) ? 1 : 0;
+    uint64_t now = hostMicros64();
+    busMicros += now - start;
+    if (now - start < interval) {
+      delayMicroseconds(interval - (now - start));
+    }
+  }
+  transactions = Wire.hostTransactions() - transactions;
+
+  transactionsPerSample = double(transactions) / samples;
+  busMicrosPerSample = double(busMicros) / samples;
+
+}
+
+static void benchImuPoll() {
+
+  Serial.printf("polled imu reads at 400 kHz on the MPU9250 model, transactions and\n"
+    "bus us per sample, INT_STATUS then data vs the 15 byte burst, adaptive:\n");
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+
+  const uint32_t intervals[] = {5000, 1000, 500, 100};
+  for (uint32_t interval : intervals) {
+    double twoStepTransactions, twoStepMicros, burstTransactions, burstMicros;
+    pollCost(false, interval, twoStepTransactions, twoStepMicros);
+    pollCost(true, interval, burstTransactions, burstMicros);
+    Serial.printf("  poll every %4u us  %5.2f %6.1f us  %5.2f %6.1f us\n", (unsigned)interval,
+      twoStepTransactions, twoStepMicros, burstTransactions, burstMicros);
+  }
+  Serial.println();
+
+  mpu.detach();
+
+}
+
+/* virtual us from initImu() to the first processed sample, as setup() boots */
+static uint64_t bootMicros() {
+
+  uint64_t start = hostMicros64();
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  if (!tracker.loadImuCalibration()) {
+    tracker.measureImuBiasVariance();
+    tracker.saveImuCalibration();
+  }
+  while (!tracker.processImu()) {
+    yield();
+  }
+  return hostMicros64() - start;
+
+}
+
+static void benchBoot() {
+
+  Serial.printf("boot to the first processed imu sample on the MPU9250 model:\n");
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+
+  EEPROM.hostErase();
+  double measured = bootMicros() * 1e-6;
+  double stored = bootMicros() * 1e-6;
+  Serial.printf("  bias measured, blank EEPROM  %.3f s\n", measured);
+  Serial.printf("  calibration loaded           %.3f s\n", stored);
+  Serial.println();
+
+  mpu.detach();
+
+}
+
+static Trajectory trajectoryDouble, trajectoryFloat;
+
+int main(int argc, char **argv) {
+
+  int repetitions = (argc > 1) ? atoi(argv[1]) : 200;
+
+  Serial.printf("%d imu samples, %d lighthouse samples, %d repetitions\n\n",
+    nImu, nLighthouse, repetitions);
+
+  benchPrecision<double>("double", repetitions, trajectoryDouble);
+  benchPrecision<float>("float", repetitions, trajectoryFloat);
+  benchEstimators<double>("double", repetitions);
+  benchEstimators<float>("float", repetitions);
+  makeSynthetic();
+  benchDrift<double>("double");
+  benchDrift<float>("float");
+  benchImuRead();
+  benchImuPoll();
+  benchBoot();
+
+  double maxAngle = 0, meanAngle = 0;
+  for (int i = 0; i < nImu; i++) {
+    double angle = angleBetween(trajectoryDouble.qComp[i], trajectoryFloat.qComp[i]);
+    maxAngle = fmax(maxAngle, angle);
+    meanAngle += angle / nImu;
+  }
+
+  double maxDistance = 0;
+  for (int i = 0; i < nLighthouse; i++) {
+    double d = 0;
+    for (int k = 0; k < 3; k++) {
+      d += sq(trajectoryDouble.position[i][k] - trajectoryFloat.position[i][k]);
+    }
+    maxDistance = fmax(maxDistance, sqrt(d));
+  }
+
+  Serial.printf("float vs double:\n");
+  Serial.printf("  updateQuaternionComp orientation error  max %.2e deg, mean %.2e deg\n",
+    maxAngle, meanAngle);
+  Serial.printf("  pose position error                     max %.2e mm\n", maxDistance);
+
+  return 0;
+
+}
@@ -0,0 +1,160 @@
+/**
+ * Host check of the boot: the imu bus started without the fixed 2.75 s
+ * wait, and the boot timeline, see BootTimeline.h
+ *
+ * - booting like setup() of vrduino.ino on the HostMpu9250 model, with a
+ *   calibration in EEPROM: the imu answers at once, the bus is not
+ *   cleared, and every phase is recorded, all in a few ms
+ * - SDA held low by the imu, as after a reset in the middle of a read:
+ *   the bus is cleared, and the imu answers after
+ * - no imu on the bus: cleared after its 100 ms start-up time, recorded
+ *   as recovery
+ * - the ootx phase lasts from the lighthouse start to the first complete
+ *   OOTX frame
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include <EEPROM.h>
+#include "BootTimeline.h"
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "ImuBus.h"
+#include "LighthouseOOTX.h"
+#include "PoseTracker.h"
+
+/* setup() of vrduino.ino, with measureImuBias */
+static void boot(OrientationTracker& tracker) {
+
+  tracker.initImu();
+  BootTimeline::start(BOOT_CALIBRATION);
+  if (!tracker.loadImuCalibration()) {
+    tracker.measureImuBiasVariance();
+    tracker.saveImuCalibration();
+  }
+  BootTimeline::stop(BOOT_CALIBRATION);
+
+}
+
+static bool testBoot() {
+
+  Serial.println("boot:");
+  bool ok = true;
+
+  // a calibration saved by a boot before
+  EEPROM.hostErase();
+  OrientationTracker first(0.99, false);
+  boot(first);
+
+  BootTimeline::reset();
+  uint64_t start = hostMicros64();
+  OrientationTracker tracker(0.99, false);
+  boot(tracker);
+  tracker.processImu();
+  BootTimeline::firstPose();
+  uint64_t took = hostMicros64() - start;
+  BootTimeline::print();
+  Serial.printf("  boot %.1f ms, %.1f ms with the fixed wait before\n",
+    took * 1e-3, (took + 2750000) * 1e-3);
+
+  ok &= check("the imu answers, the bus is not cleared",
+    BootTimeline::done(BOOT_BUS) && !BootTimeline::done(BOOT_BUS_RECOVERY) &&
+    BootTimeline::phaseMicros(BOOT_BUS) < 5000);
+  ok &= check("imu config and calibration are recorded",
+    BootTimeline::done(BOOT_IMU_CONFIG) && BootTimeline::done(BOOT_CALIBRATION) &&
+    BootTimeline::phaseMicros(BOOT_BUS) + BootTimeline::phaseMicros(BOOT_IMU_CONFIG) +
+    BootTimeline::phaseMicros(BOOT_CALIBRATION) <= took);
+  ok &= check("to the first pose in under 10 ms",
+    took < 10000 && BootTimeline::poseMicros() != 0 && !BootTimeline::firstPose());
+
+  return ok;
+
+}
+
+static bool testRecovery(HostMpu9250& mpu) {
+
+  Serial.println("stuck bus:");
+  bool ok = true;
+
+  // the imu holds SDA until clocked 5 times on SCL
+  BootTimeline::reset();
+  hostHoldLow(SDA, SCL, 5);
+  ImuBusI2c bus(HostMpu9250::address);
+  BootTimeline::start(BOOT_BUS);
+  bus.begin();
+  BootTimeline::stop(BOOT_BUS);
+  Serial.printf("  cleared in %.3f ms\n", BootTimeline::phaseMicros(BOOT_BUS_RECOVERY) * 1e-3);
+  ok &= check("SDA held low, the bus is cleared",
+    bus.wasRecovered() && BootTimeline::done(BOOT_BUS_RECOVERY) &&
+    digitalRead(SDA) == HIGH);
+  ok &= check("and the imu answers after", bus.readRegister(0x75) == 0x71);
+  hostHoldLow(SDA, SCL, 0);
+
+  // nothing acks the address
+  BootTimeline::reset();
+  mpu.detach();
+  ImuBusI2c none(HostMpu9250::address);
+  none.begin();
+  ok &= check("no imu: cleared after its 100 ms start-up time",
+    none.wasRecovered() && BootTimeline::phaseMicros(BOOT_BUS_RECOVERY) >= 100000);
+  mpu.attach();
+
+  return ok;
+
+}
+
+/* a bit of sensor0 per sync pulse, 120 per s */
+static void sendBit(LighthouseOOTX& ootx, int bit) {
+  delayMicroseconds(8333);
+  ootx.addBit(bit);
+}
+
+static void sendWord(LighthouseOOTX& ootx, uint16_t word) {
+  for (int i = 15; i >= 0; i--) {
+    sendBit(ootx, (word >> i) & 1);
+  }
+  sendBit(ootx, 1);
+}
+
+static bool testOotx() {
+
+  Serial.println("ootx:");
+  bool ok = true;
+
+  BootTimeline::reset();
+  PoseTracker tracker(0.99, 1, false, VRDUINO_ESTIMATOR);
+  LighthouseOOTX ootx;
+  ok &= check("runs from the lighthouse start",
+    !BootTimeline::done(BOOT_OOTX) && BootTimeline::phaseMicros(BOOT_OOTX) == 0);
+
+  // preamble, a 33 byte payload and its CRC, padded to words
+  for (int i = 0; i < 17; i++) {
+    sendBit(ootx, 0);
+  }
+  sendBit(ootx, 1);
+  sendWord(ootx, 0x2100);
+  for (int i = 0; i < (33 + 4 + 1) / 2; i++) {
+    sendWord(ootx, 0);
+  }
+  BootTimeline::print();
+  ok &= check("to the first complete OOTX frame",
+    ootx.isOOTXInfoAvailable() && BootTimeline::done(BOOT_OOTX) &&
+    BootTimeline::phaseMicros(BOOT_OOTX) >= (18 + 20 * 17) * 8333u);
+
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  bool ok = testBoot();
+  ok &= testRecovery(mpu);
+  mpu.detach();
+  ok &= testOotx();
+
+  Serial.println(ok ? "boot timeline: all passed" : "boot timeline: FAILED");
+  return ok ? 0 : 1;
+
+}
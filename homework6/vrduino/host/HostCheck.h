@@ -0,0 +1,69 @@
+/**
+ * Helpers shared by the host checks
+ *
+ * - check() prints the name of a check and ok or FAILED, and returns its
+ *   result, for ok &= check(...)
+ * - angleBetween() of two orientations, at any scalar type
+ * - the gyro counts the HostMpu9250 model sends for a rate in deg/s, and
+ *   the deg/s Imu converts them back to, at the full scale range of the
+ *   default ImuConfig unless given, e.g. the rows of simulatedImuData.h
+ *   the model replays
+ */
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <Arduino.h>
+#include "Imu.h"
+#include "Quaternion.h"
+#include "simulatedImuData.h"
+
+static inline bool check(const char *name, bool ok) {
+  Serial.printf("  %-52s %s\n", name, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+/**
+ * angle between two orientations in degrees, from the relative rotation
+ * conj(a) * b. Unlike acos(a . b) this resolves angles down to rounding,
+ * also of fixed-point quaternions that are unit length only to ~1e-9
+ */
+template <typename A, typename B>
+static inline double angleBetween(const QuaternionT<A>& a, const QuaternionT<B>& b) {
+  QuaternionT<double> da(a.q[0], a.q[1], a.q[2], a.q[3]);
+  QuaternionT<double> db(b.q[0], b.q[1], b.q[2], b.q[3]);
+  QuaternionT<double> d = da.conjugate() * db;
+  return 2 * atan2(sqrt(sq(d.q[1]) + sq(d.q[2]) + sq(d.q[3])), fabs(d.q[0])) * RAD_TO_DEG;
+}
+
+/* gyro counts of dps at a full scale range, as the model sends them */
+static inline int16_t gyrCount(double dps, int fullScaleDps = ImuConfig().gyrFullScaleDps) {
+  return int16_t(lround(dps / fullScaleDps * 32767.0));
+}
+
+/* deg/s of dps as Imu reads it, its counts times the scale */
+static inline double gyrAsRead(double dps, int fullScaleDps = ImuConfig().gyrFullScaleDps) {
+  return gyrCount(dps, fullScaleDps) * (double(fullScaleDps) / 32767.0);
+}
+
+/* gyro counts of sample i of rows of gyro and acc, replayed in a loop */
+static inline void sampleGyrCounts(uint32_t i, int16_t gyr[3],
+    const float *rows = imuData, int rowCount = nImuSamples / 6,
+    int fullScaleDps = ImuConfig().gyrFullScaleDps) {
+  const float *s = &rows[6 * (i % rowCount)];
+  for (int k = 0; k < 3; k++) {
+    gyr[k] = gyrCount(s[k], fullScaleDps);
+  }
+}
+
+/* deg/s of sample i as Imu reads it, see sampleGyrCounts() */
+static inline void sampleGyr(uint32_t i, Scalar gyr[3],
+    const float *rows = imuData, int rowCount = nImuSamples / 6,
+    int fullScaleDps = ImuConfig().gyrFullScaleDps) {
+  const float *s = &rows[6 * (i % rowCount)];
+  for (int k = 0; k < 3; k++) {
+    gyr[k] = Scalar(gyrAsRead(s[k], fullScaleDps));
+  }
+}
+
+#endif // ifndef HOST_CHECK_H
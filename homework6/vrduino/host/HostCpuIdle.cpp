@@ -0,0 +1,165 @@
+/**
+ * Host check of the idle sleep, see CpuIdle.h, on the HostMpu9250 model
+ * with the interrupt capture
+ *
+ * - sleep() wakes at the next sample of the model, or at the next ms of
+ *   the SysTick without a device
+ * - the bias measurement sleeps between the samples, over half its time
+ * - a loop() like vrduino.ino that sleeps when there is nothing to do
+ *   integrates every sample within 1 ms, one with a delay(5) up to 5 ms
+ *   late
+ * - the simulated imu and lighthouse come at their recorded 500 Hz and
+ *   120 Hz, without blocking loop() in between
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "CpuIdle.h"
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "PoseTracker.h"
+
+/*
+ * loop() of vrduino.ino for ms, sleeping or with a delay(5) after each,
+ * @returns the most us from a sample of the model to its integration
+ */
+static uint64_t run(OrientationTracker& tracker, HostMpu9250& mpu, uint32_t ms, bool sleep) {
+  uint64_t latency = 0;
+  uint32_t end = millis() + ms;
+  while (millis() < end) {
+    uint32_t processed = tracker.getImuSamplesProcessed();
+    bool imuTrack = tracker.processImu();
+    uint32_t n = tracker.getImuSamplesProcessed() - processed;
+    if (n > 0) {
+      // the oldest of the n, each sample 1 ms after the one before
+      uint64_t taken = mpu.getLastSampleTime() - uint64_t(n - 1) * 1000;
+      uint64_t late = hostMicros64() - taken;
+      if (late > latency) {
+        latency = late;
+      }
+    }
+    if (!sleep) {
+      delay(5);
+    } else if (!imuTrack) {
+      CpuIdle::sleep();
+    }
+  }
+  return latency;
+}
+
+static bool testSleep(HostMpu9250& mpu) {
+
+  Serial.println("sleep:");
+  bool ok = true;
+
+  // the model samples at 8 kHz from power on, a sample per 125 us
+  CpuIdle::reset();
+  uint64_t next = mpu.hostNextEvent();
+  CpuIdle::sleep();
+  ok &= check("wakes at the next sample of the imu",
+    hostMicros64() == next && CpuIdle::sleeps() == 1 &&
+    CpuIdle::sleptMicros() > 0 && CpuIdle::sleptMicros() <= 125);
+
+  mpu.detach();
+  delayMicroseconds(300);
+  uint64_t start = hostMicros64();
+  CpuIdle::sleep();
+  ok &= check("at the next ms without a device",
+    hostMicros64() % 1000 == 0 && hostMicros64() - start <= 1000);
+  mpu.attach();
+
+  return ok;
+
+}
+
+static bool testBias() {
+
+  Serial.println("bias:");
+  bool ok = true;
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.initImuInterrupt(IMU_INTERRUPT_PIN);
+  CpuIdle::reset();
+  uint64_t start = hostMicros64();
+  tracker.measureImuBiasVariance();
+  uint64_t took = hostMicros64() - start;
+  double asleep = double(CpuIdle::sleptMicros()) / double(took);
+  Serial.printf("  %.3f s, %.1f%% asleep in %u sleeps\n",
+    took * 1e-6, 100 * asleep, (unsigned)CpuIdle::sleeps());
+  ok &= check("asleep over half of the bias measurement", asleep > 0.5);
+
+  return ok;
+
+}
+
+static bool testLatency(HostMpu9250& mpu) {
+
+  Serial.println("latency:");
+  bool ok = true;
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.initImuInterrupt(IMU_INTERRUPT_PIN);
+  run(tracker, mpu, 100, true);
+
+  CpuIdle::reset();
+  uint64_t start = hostMicros64();
+  uint64_t sleeping = run(tracker, mpu, 1000, true);
+  double asleep = double(CpuIdle::sleptMicros()) / double(hostMicros64() - start);
+  uint64_t delayed = run(tracker, mpu, 1000, false);
+  Serial.printf("  sample to estimator: %.3f ms sleeping, %.3f ms with delay(5), %.1f%% asleep\n",
+    sleeping * 1e-3, delayed * 1e-3, 100 * asleep);
+  ok &= check("within 1 ms when sleeping", sleeping < 1000 && asleep > 0.5);
+  ok &= check("over 4 ms with a delay(5)", delayed > 4000);
+  ok &= check("no samples missed", tracker.getImuCapture().getMissed() == 0);
+
+  return ok;
+
+}
+
+static bool testSimulation() {
+
+  Serial.println("simulation:");
+  bool ok = true;
+
+  OrientationTracker imu(0.99, true);
+  PoseTracker lighthouse(0.99, 1, true);
+  int imuSamples = 0;
+  int lighthouseFrames = 0;
+  int loops = 0;
+  uint32_t end = millis() + 1000;
+  while (millis() < end) {
+    bool imuTrack = imu.processImu();
+    int hmTrack = lighthouse.processLighthouse();
+    imuSamples += imuTrack ? 1 : 0;
+    lighthouseFrames += hmTrack > -2 ? 1 : 0;
+    loops++;
+    if (!imuTrack && hmTrack == -2) {
+      CpuIdle::sleep();
+    }
+  }
+  Serial.printf("  per s: %d imu samples, %d lighthouse frames in %d loops\n",
+    imuSamples, lighthouseFrames, loops);
+  ok &= check("the imu at 500 Hz", imuSamples >= 499 && imuSamples <= 501);
+  ok &= check("the lighthouse at 120 Hz", lighthouseFrames >= 119 && lighthouseFrames <= 121);
+  ok &= check("loop() goes on in between", loops > imuSamples);
+
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  bool ok = testSleep(mpu);
+  ok &= testBias();
+  ok &= testLatency(mpu);
+  mpu.detach();
+  ok &= testSimulation();
+
+  Serial.println(ok ? "cpu idle: all passed" : "cpu idle: FAILED");
+  return ok ? 0 : 1;
+
+}
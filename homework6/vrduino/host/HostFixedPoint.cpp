@@ -0,0 +1,249 @@
+/**
+ * Host check of the fixed-point orientation pipeline
+ *
+ * - sweeps the FixedPoint.h kernels against libm
+ * - replays simulatedImuData.h through OrientationMathFixed.h and through
+ *   the double path of OrientationMath.h, fed with the same gyro/acc
+ *   counts, and reports how far the fixed-point estimates drift from double
+ * - times both paths (host CPU, relative costs only)
+ *
+ * Exits with 1 if a kernel error or the drift is out of bounds, so it runs
+ * as a test.
+ *
+ * usage: vrduino_fixed_point [passes over the simulated data]
+ */
+
+#include <chrono>
+#include "HostCheck.h"
+#include "OrientationMath.h"
+#include "OrientationMathFixed.h"
+#include "simulatedImuData.h"
+
+static const int nImu = nImuSamples / 6;
+
+/* deg/s and m/s^2 per raw count, as configured in Imu::init() */
+static const double gyrCountScale = 2000.0 / 32767.0;
+static const double accCountScale = 9.80665 * 16.0 / 32767.0;
+
+/* keeps the optimizer from discarding results */
+static volatile double sink;
+
+/* one simulated sample as counts and as the equivalent physical values */
+struct Sample {
+  int32_t gyrFixed[3];  // Q24.8 counts
+  int32_t accFixed[3];  // counts
+  double gyr[3];
+  double acc[3];
+};
+
+static Sample samples[nImu];
+
+static void loadSamples() {
+
+  for (int i = 0; i < nImu; i++) {
+    Sample& s = samples[i];
+    for (int k = 0; k < 3; k++) {
+      s.gyrFixed[k] = (int32_t)lround(imuData[6*i + k] / gyrCountScale * 256.0);
+      s.accFixed[k] = (int32_t)lround(imuData[6*i + 3 + k] / accCountScale);
+      s.gyr[k] = s.gyrFixed[k] * gyrCountScale / 256.0;
+      s.acc[k] = s.accFixed[k] * accCountScale;
+    }
+  }
+
+}
+
+/* difference of two angles in degrees, modulo 360 */
+static double angleDifference(double a, double b) {
+  double d = fabs(fmod(a - b, 360.0));
+  return fmin(d, 360.0 - d);
+}
+
+static bool check(const char *name, double value, double bound, const char *unit) {
+  bool ok = value <= bound;
+  Serial.printf("  %-36s %.2e %s (bound %.0e) %s\n", name, value, unit, bound,
+    ok ? "" : "FAILED");
+  return ok;
+}
+
+
+static bool testKernels() {
+
+  Serial.printf("kernels vs libm:\n");
+
+  double errSin = 0, errCos = 0;
+  for (int i = -100000; i <= 100000; i++) {
+    double x = HALF_PI * i / 100000.0;
+    q30_t s, c;
+    q30SinCos(toQ30(x), s, c);
+    errSin = fmax(errSin, fabs(fromQ30(s) - sin(fromQ30(toQ30(x)))));
+    errCos = fmax(errCos, fabs(fromQ30(c) - cos(fromQ30(toQ30(x)))));
+  }
+
+  double errAtan2 = 0;
+  for (int i = 0; i < 100000; i++) {
+    double a = TWO_PI * i / 100000.0;
+    for (double r = 3.0; r < 3e9; r *= 31.0) {
+      int32_t y = (int32_t)lround(r * sin(a) * 0.7);
+      int32_t x = (int32_t)lround(r * cos(a) * 0.7);
+      if (x == 0 && y == 0) continue;
+      errAtan2 = fmax(errAtan2, angleDifference(bamToDeg(fixedAtan2(y, x)), atan2(y, x) * RAD_TO_DEG));
+    }
+  }
+
+  double errSqrt = 0;
+  uint64_t x = 1;
+  for (int i = 0; i < 100000; i++) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t v = x >> (i % 64);
+    uint64_t r = isqrt64(v);
+    bool exact = r * r <= v && (r + 1) * (r + 1) > v;
+    errSqrt = fmax(errSqrt, exact ? 0.0 : 1.0);
+  }
+
+  bool ok = true;
+  ok &= check("q30SinCos sin", errSin, 4e-9, "");
+  ok &= check("q30SinCos cos", errCos, 4e-9, "");
+  ok &= check("fixedAtan2", errAtan2, 2e-7, "deg");
+  ok &= check("isqrt64 (0: exact)", errSqrt, 0, "");
+  Serial.println();
+  return ok;
+
+}
+
+
+static bool testDrift(int passes) {
+
+  Serial.printf("drift of fixed point vs double, %d passes = %.0f s:\n",
+    passes, passes * nImu * 0.002);
+
+  const double deltaT = 0.002, alpha = 0.99;
+  const uint32_t deltaTFixed = 2000;
+  const q30_t alphaFixed = toQ30(alpha);
+  const FixedGyrScale scale = fixedGyrScale(2000.0);
+
+  QuaternionT<double> qGyr, qComp;
+  double rollGyr = 0, rollComp = 0;
+  QuaternionQ30 qGyrFixed, qCompFixed;
+  bam_t rollGyrFixed = 0, rollCompFixed = 0;
+
+  double maxGyr = 0, maxComp = 0, meanComp = 0;
+  double maxRollGyr = 0, maxRollComp = 0, maxRollAcc = 0, maxPitch = 0;
+
+  for (int p = 0; p < passes; p++) {
+    for (int i = 0; i < nImu; i++) {
+      Sample& s = samples[i];
+
+      updateQuaternionGyr(qGyr, s.gyr, deltaT);
+      updateQuaternionComp(qComp, s.gyr, s.acc, deltaT, alpha);
+      double rollAcc = computeFlatlandRollAcc(s.acc);
+      rollGyr = computeFlatlandRollGyr(rollGyr, s.gyr, deltaT);
+      rollComp = computeFlatlandRollComp(rollComp, s.gyr, rollAcc, deltaT, alpha);
+
+      updateQuaternionGyrFixed(qGyrFixed, s.gyrFixed, deltaTFixed, scale);
+      updateQuaternionCompFixed(qCompFixed, s.gyrFixed, s.accFixed, deltaTFixed, scale, alphaFixed);
+      bam_t rollAccFixed = computeFlatlandRollAccFixed(s.accFixed);
+      rollGyrFixed = computeFlatlandRollGyrFixed(rollGyrFixed, s.gyrFixed, deltaTFixed, scale);
+      rollCompFixed = computeFlatlandRollCompFixed(rollCompFixed, s.gyrFixed, rollAccFixed,
+        deltaTFixed, scale, alphaFixed);
+
+      double comp = angleBetween(qComp, qCompFixed.toQuaternion<double>());
+      maxComp = fmax(maxComp, comp);
+      meanComp += comp / (double(passes) * nImu);
+      maxGyr = fmax(maxGyr, angleBetween(qGyr, qGyrFixed.toQuaternion<double>()));
+      maxRollAcc = fmax(maxRollAcc, angleDifference(bamToDeg(rollAccFixed), rollAcc));
+      maxRollGyr = fmax(maxRollGyr, angleDifference(bamToDeg(rollGyrFixed), rollGyr));
+      maxRollComp = fmax(maxRollComp, angleDifference(bamToDeg(rollCompFixed), rollComp));
+      maxPitch = fmax(maxPitch, angleDifference(bamToDeg(computeAccPitchFixed(s.accFixed)), computeAccPitch(s.acc)));
+    }
+  }
+
+  Serial.printf("  final gyro-only orientation difference %.2e deg\n",
+    angleBetween(qGyr, qGyrFixed.toQuaternion<double>()));
+  Serial.printf("  mean complementary orientation difference %.2e deg\n", meanComp);
+
+  bool ok = true;
+  ok &= check("updateQuaternionGyrFixed max", maxGyr, 2e-3, "deg");
+  ok &= check("updateQuaternionCompFixed max", maxComp, 1e-3, "deg");
+  ok &= check("computeFlatlandRollGyrFixed max", maxRollGyr, 5e-4, "deg");
+  ok &= check("computeFlatlandRollAccFixed max", maxRollAcc, 1e-6, "deg");
+  ok &= check("computeFlatlandRollCompFixed max", maxRollComp, 1e-5, "deg");
+  ok &= check("computeAccPitchFixed max", maxPitch, 1e-5, "deg");
+  Serial.println();
+  return ok;
+
+}
+
+
+/* mean time per call of fn(sample) over all samples, in ns */
+template <typename Fn>
+static double timePerSample(int repetitions, Fn fn) {
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    for (int i = 0; i < nImu; i++) {
+      fn(samples[i]);
+    }
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count() /
+    (double(nImu) * repetitions);
+
+}
+
+static void benchPaths(int repetitions) {
+
+  Serial.printf("host time per call, double / fixed:\n");
+
+  const FixedGyrScale scale = fixedGyrScale(2000.0);
+  const q30_t alphaFixed = toQ30(0.99);
+
+  QuaternionT<double> q;
+  QuaternionQ30 qFixed;
+  double roll = 0;
+  bam_t rollFixed = 0;
+
+  double gyrDouble = timePerSample(repetitions, [&](Sample& s) {
+    updateQuaternionGyr(q, s.gyr, 0.002);
+  });
+  double gyrFixed = timePerSample(repetitions, [&](Sample& s) {
+    updateQuaternionGyrFixed(qFixed, s.gyrFixed, 2000, scale);
+  });
+  Serial.printf("  %-30s %8.1f / %8.1f ns\n", "updateQuaternionGyr", gyrDouble, gyrFixed);
+
+  double compDouble = timePerSample(repetitions, [&](Sample& s) {
+    updateQuaternionComp(q, s.gyr, s.acc, 0.002, 0.99);
+  });
+  double compFixed = timePerSample(repetitions, [&](Sample& s) {
+    updateQuaternionCompFixed(qFixed, s.gyrFixed, s.accFixed, 2000, scale, alphaFixed);
+  });
+  Serial.printf("  %-30s %8.1f / %8.1f ns\n", "updateQuaternionComp", compDouble, compFixed);
+
+  double rollDouble = timePerSample(repetitions, [&](Sample& s) {
+    roll = computeFlatlandRollComp(roll, s.gyr, computeFlatlandRollAcc(s.acc), 0.002, 0.99);
+  });
+  double rollFixedNs = timePerSample(repetitions, [&](Sample& s) {
+    rollFixed = computeFlatlandRollCompFixed(rollFixed, s.gyrFixed,
+      computeFlatlandRollAccFixed(s.accFixed), 2000, scale, alphaFixed);
+  });
+  Serial.printf("  %-30s %8.1f / %8.1f ns\n", "computeFlatlandRollComp", rollDouble, rollFixedNs);
+
+  sink = q.q[0] + qFixed.q[0] + roll + rollFixed;
+  Serial.println();
+
+}
+
+
+int main(int argc, char **argv) {
+
+  int passes = (argc > 1) ? atoi(argv[1]) : 20;
+
+  loadSamples();
+
+  bool ok = testKernels();
+  ok &= testDrift(passes);
+  benchPaths(20);
+
+  Serial.println(ok ? "fixed point: all passed" : "fixed point: FAILED");
+  return ok ? 0 : 1;
+
+}
@@ -0,0 +1,151 @@
+/**
+ * Host check of the background imu reads, see I2cAsync.h
+ *
+ * - a read started with Imu::startReadAsync() returns at once, runs on
+ *   the I2C0 register model while the caller waits, calls its callback
+ *   and delivers the counts of the HostMpu9250 model
+ * - a sample is only delivered once, a read without new data is not fresh
+ * - OrientationTracker after initImuAsync() with a loop() that spends
+ *   300 us per iteration: every sample is processed once, and
+ *   processImu() itself takes no time on the bus
+ * - a read of a missing device ends with a NACK, and fails cleanly
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "OrientationTracker.h"
+#include "simulatedImuData.h"
+
+static int callbacks;
+static bool callbackOk;
+
+static void onRead(bool ok) {
+  callbacks++;
+  callbackOk = ok;
+}
+
+/* waits for the end of the read, as loop() would by doing other work */
+static void waitRead(const Imu& imu) {
+  while (imu.isReadAsyncBusy()) {
+    yield();
+  }
+}
+
+static bool testRead(HostMpu9250& mpu) {
+
+  Serial.println("read:");
+  bool ok = true;
+
+  Imu imu = Imu();
+  imu.init();
+
+  // start right after a sample, so it is the newest until the read ends
+  uint32_t taken = mpu.getSamplesTaken();
+  while (mpu.getSamplesTaken() == taken) {
+    yield();
+  }
+
+  callbacks = 0;
+  uint32_t start = micros();
+  uint64_t startTicks = TickClock::now();
+  ok &= check("startReadAsync starts a read", imu.startReadAsync(onRead));
+  ok &= check("and returns without waiting for the bus",
+    micros() == start && imu.isReadAsyncBusy());
+  ok &= check("a second read is refused while it runs", !imu.startReadAsync());
+
+  waitRead(imu);
+  uint32_t elapsed = micros() - start;
+  Serial.printf("  15 byte read took %u us on the bus\n", (unsigned)elapsed);
+  // 18 bytes incl. the two addresses and the register, 9 bits each at 400 kHz
+  ok &= check("the read takes its bytes on the bus", elapsed >= 18 * 9 * 1000 / 400);
+  ok &= check("the callback ran once, with success", callbacks == 1 && callbackOk);
+
+  ImuSample sample;
+  ok &= check("finishReadAsync delivers a fresh sample", imu.finishReadAsync(sample));
+  int16_t gyr[3];
+  sampleGyrCounts(mpu.getSamplesTaken() - 1, gyr);
+  ok &= check("with the counts of the model",
+    sample.gyr[0] == gyr[0] && sample.gyr[1] == gyr[1] && sample.gyr[2] == gyr[2]);
+  ok &= check("stamped at the start of the read", sample.ticks == startTicks);
+  ok &= check("only once", !imu.finishReadAsync(sample));
+
+  // INT_STATUS was read, nothing new until the next sample
+  imu.startReadAsync();
+  waitRead(imu);
+  ok &= check("a read before the next sample is not fresh",
+    mpu.getSamplesTaken() - 1 == taken && !imu.finishReadAsync(sample));
+
+  return ok;
+
+}
+
+static bool testTracker(HostMpu9250& mpu) {
+
+  Serial.println("tracker, 1 kHz imu, 300 us loop:");
+  bool ok = true;
+  const int iterations = 1000;
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.initImuAsync();
+
+  uint32_t first = mpu.getSamplesTaken();
+  uint32_t inProcessImu = 0;
+  for (int i = 0; i < iterations; i++) {
+    uint32_t start = micros();
+    tracker.processImu();
+    inProcessImu += micros() - start;
+    delayMicroseconds(300);
+  }
+  uint32_t taken = mpu.getSamplesTaken() - first;
+  uint32_t processed = tracker.getImuSamplesProcessed();
+  Serial.printf("  %u of %u samples, %u us in processImu()\n",
+    (unsigned)processed, (unsigned)taken, (unsigned)inProcessImu);
+
+  // the newest sample may still be on its way
+  ok &= check("every sample is processed once",
+    processed <= taken && processed + 1 >= taken);
+  ok &= check("processImu() does not wait for the bus", inProcessImu == 0);
+
+  return ok;
+
+}
+
+static bool testNack(HostMpu9250& mpu) {
+
+  Serial.println("nack:");
+  bool ok = true;
+
+  Imu imu = Imu();
+  imu.init();
+  mpu.detach();
+
+  callbacks = 0;
+  ok &= check("a read of a missing device starts", imu.startReadAsync(onRead));
+  waitRead(imu);
+  ImuSample sample;
+  ok &= check("and fails in the callback", callbacks == 1 && !callbackOk);
+  ok &= check("without a sample", !imu.finishReadAsync(sample));
+  ok &= check("the bus is free for the next read", imu.startReadAsync());
+  waitRead(imu);
+
+  mpu.attach();
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+
+  bool ok = testRead(mpu);
+  ok &= testTracker(mpu);
+  ok &= testNack(mpu);
+
+  Serial.println(ok ? "imu async: all passed" : "imu async: FAILED");
+  return ok ? 0 : 1;
+
+}
@@ -0,0 +1,198 @@
+/**
+ * Host check of the imu register buses, see ImuBus.h
+ *
+ * - the unchanged Imu driver straight on a HostMpu9250 stepped through a
+ *   scripted sample table, see HostImuBus.h: no virtual time passes, and
+ *   read() returns each scripted sample once. Polled once per sample, a
+ *   sample is one 15 byte burst, polled faster an empty poll reads 1 byte
+ * - the same driver over I2C and over SPI on one model: the same counts,
+ *   with a sample read 20x faster over SPI, and writes at 1 MHz
+ * - on SPI, I2C_IF_DIS stays set through the FIFO setup, and the FIFO
+ *   reads the same frames
+ * - OrientationTracker on raw counts: the bias and variance of a script
+ *   alternating between two gyro rates come out exact, and the bias is
+ *   subtracted in counts
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostImuBus.h"
+#include "HostMpu9250.h"
+#include "ImuCapture.h"
+#include "OrientationTracker.h"
+
+static const uint8_t csPin = 10;
+
+static bool testScripted() {
+
+  Serial.println("scripted register model:");
+  bool ok = true;
+
+  // gyro deg/s, acc m/s^2
+  static const float script[3 * 6] = {
+    100, -200, 300, 0, 0, 9.80665f,
+    -5, 5, 0, 1, 2, 3,
+    0, 0, 1999, -9.80665f, 0, 0
+  };
+  HostMpu9250 model(IMU_INTERRUPT_PIN);
+  model.setSamples(script, 3);
+  HostRegisterBus bus(&model);
+
+  uint32_t start = micros();
+  Imu imu;
+  imu.setBus(&bus);
+  imu.init();
+  ok &= check("init takes no virtual time", micros() == start);
+  ok &= check("and configures the model", model.reg(0x1B) == 0x18 && model.reg(0x1C) == 0x18);
+  ok &= check("no sample before the first event", !imu.read());
+
+  bool samples = true;
+  for (int i = 0; i < 3; i++) {
+    model.hostEvent();
+    samples &= imu.read() && !imu.read();
+    const float *s = &script[6 * i];
+    samples &= fabs(double(imu.gyrX) - s[0]) < 0.1 && fabs(double(imu.gyrY) - s[1]) < 0.1 &&
+      fabs(double(imu.gyrZ) - s[2]) < 0.1 && fabs(double(imu.accZ) - s[5]) < 0.01;
+  }
+  ok &= check("read() returns each scripted sample once", samples);
+  Serial.printf("  %u register accesses\n", (unsigned)bus.getAccesses());
+
+  // polled once per sample, then 4 times, past the polls that adapt
+  ImuSample sample;
+  uint32_t bytes[2];
+  for (int polls = 1; polls <= 4; polls += 3) {
+    for (int i = 0; i < 20; i++) {
+      if (i == 10) {
+        bytes[polls / 4] = bus.getBytesRead();
+      }
+      model.hostEvent();
+      for (int k = 0; k < polls; k++) {
+        imu.readRaw(sample);
+      }
+    }
+    bytes[polls / 4] = (bus.getBytesRead() - bytes[polls / 4]) / 10;
+  }
+  Serial.printf("  %u bytes read per sample polled once, %u polled 4 times\n",
+    (unsigned)bytes[0], (unsigned)bytes[1]);
+  ok &= check("the burst once per sample, 1 byte per empty poll",
+    bytes[0] == 15 && bytes[1] == 1 + 14 + 3);
+
+  return ok;
+
+}
+
+/* us the call takes on the virtual clock */
+template <typename Fn>
+static uint32_t elapsed(Fn fn) {
+  uint32_t start = micros();
+  fn();
+  return micros() - start;
+}
+
+static bool testLinks(HostMpu9250& mpu) {
+
+  Serial.println("I2C vs SPI:");
+  bool ok = true;
+
+  ImuBusI2c i2c(HostMpu9250::address);
+  ImuBusSpi spi(csPin);
+  Imu imuI2c;
+  Imu imuSpi;
+  imuI2c.setBus(&i2c);
+  imuSpi.setBus(&spi);
+  imuI2c.init();
+  imuSpi.init();
+
+  ok &= check("WHO_AM_I over SPI", spi.readRegister(0x75) == 0x71);
+  ok &= check("I2C_IF_DIS set on SPI", (mpu.reg(0x6A) & 0x10) != 0);
+
+  // right after a sample, so both read the same one
+  ImuSample a, b;
+  uint32_t taken = mpu.getSamplesTaken();
+  while (mpu.getSamplesTaken() == taken) {
+    yield();
+  }
+  uint32_t i2cMicros = elapsed([&] { imuI2c.readSample(a); });
+  uint32_t spiMicros = elapsed([&] { imuSpi.readSample(b); });
+  Serial.printf("  14 data bytes: I2C %u us, SPI %u us\n", (unsigned)i2cMicros, (unsigned)spiMicros);
+  ok &= check("the same counts on both links",
+    memcmp(a.acc, b.acc, sizeof(a.acc)) == 0 && memcmp(a.gyr, b.gyr, sizeof(a.gyr)) == 0);
+  ok &= check("SPI reads a sample 20x faster", spiMicros * 20 <= i2cMicros);
+
+  // 2 bytes at 1 MHz
+  uint32_t writeMicros = elapsed([&] { spi.writeRegister(0x38, 0x00); });
+  ok &= check("SPI writes at 1 MHz", writeMicros == 16);
+
+  // the FIFO over SPI
+  imuSpi.enableFifo(true);
+  ok &= check("I2C_IF_DIS kept with the FIFO on", mpu.reg(0x6A) == 0x50);
+  delay(10);
+  ImuSample samples[Imu::fifoMaxFrames];
+  int n = imuSpi.readFifo(samples, Imu::fifoMaxFrames);
+  imuI2c.readSample(a);
+  ok &= check("FIFO over SPI reads 10 frames, the last is the newest",
+    n == 10 && memcmp(samples[n - 1].gyr, a.gyr, sizeof(a.gyr)) == 0);
+  imuSpi.enableFifo(false);
+
+  return ok;
+
+}
+
+static bool testCounts(HostMpu9250& mpu) {
+
+  Serial.println("raw counts:");
+  bool ok = true;
+
+  // at rest, the gyro x alternates between two rates
+  static const float script[2 * 6] = {
+    1.0f, 0, 0, 0, 0, 9.80665f,
+    2.0f, 0, 0, 0, 0, 9.80665f
+  };
+  mpu.setSamples(script, 2);
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.measureImuBiasVariance();
+
+  double scale = 2000.0 / 32767.0;
+  long c1 = lround(1.0 / scale);
+  long c2 = lround(2.0 / scale);
+  double bias = (c1 + c2) / 2.0 * scale;
+  double variance = sq((c2 - c1) / 2.0 * scale);
+  Serial.printf("  gyro x bias %.6f deg/s, variance %.6f (deg/s)^2\n",
+    double(tracker.getGyrBias()[0]), double(tracker.getGyrVariance()[0]));
+  ok &= check("gyro bias is the mean of the counts",
+    fabs(double(tracker.getGyrBias()[0]) - bias) < 1e-12 && tracker.getGyrBias()[1] == 0);
+  ok &= check("and the variance exact",
+    fabs(double(tracker.getGyrVariance()[0]) - variance) < 1e-12 * variance &&
+    tracker.getGyrVariance()[1] == 0);
+
+  // a sample minus the bias is half the step, to a 1/256 count
+  tracker.processImu();
+  delay(1);
+  tracker.processImu();
+  double half = (c2 - c1) / 2.0 * scale;
+  double gyr = fabs(double(tracker.getGyr()[0]));
+  ok &= check("processImu() subtracts the bias in counts", fabs(gyr - half) < scale / 256);
+
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+int main() {
+
+  bool ok = testScripted();
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  mpu.attachSpi(csPin);
+  ok &= testLinks(mpu);
+  ok &= testCounts(mpu);
+  mpu.detach();
+
+  Serial.println(ok ? "imu bus: all passed" : "imu bus: FAILED");
+  return ok ? 0 : 1;
+
+}
@@ -0,0 +1,50 @@
+/**
+ * ImuBus straight on a host register model
+ *
+ * Reads and writes go to the HostI2CDevice as register accesses, without
+ * a bus shim in between, so they take no virtual time and need no
+ * timed device: a test can step a model, e.g. a HostMpu9250 replaying a
+ * scripted sample table with setSamples(), event by event, and run the
+ * unchanged Imu driver on it.
+ */
+
+#ifndef HOST_IMU_BUS_H
+#define HOST_IMU_BUS_H
+
+#include "ImuBus.h"
+#include "Wire.h"
+
+class HostRegisterBus : public ImuBus {
+public:
+
+  explicit HostRegisterBus(HostI2CDevice *device) : device(device), accesses(0), bytesRead(0) {}
+
+  virtual void begin() {}
+
+  virtual void readRegisters(uint8_t reg, uint8_t *data, int n) {
+    device->i2cWrite(&reg, 1);
+    device->i2cRead(data, n);
+    accesses++;
+    bytesRead += n;
+  }
+
+  virtual void writeRegister(uint8_t reg, uint8_t value) {
+    uint8_t data[2] = {reg, value};
+    device->i2cWrite(data, 2);
+    accesses++;
+  }
+
+  /* number of register reads and writes so far */
+  uint32_t getAccesses() const { return accesses; }
+
+  /* number of register bytes read so far */
+  uint32_t getBytesRead() const { return bytesRead; }
+
+private:
+
+  HostI2CDevice *device;
+  uint32_t accesses;
+  uint32_t bytesRead;
+};
+
+#endif // ifndef HOST_IMU_BUS_H
@@ -0,0 +1,402 @@
+/**
+ * Host check of the imu calibration kept in EEPROM, see ImuCalibration.h
+ *
+ * - the record: nothing loads from a blank EEPROM, a saved one loads back
+ *   the same, a flipped bit or another version is rejected, and saving
+ *   it again writes no byte
+ * - booting like setup() of vrduino.ino on the HostMpu9250 model: the
+ *   first boot measures the bias and saves it, the next loads it, over a
+ *   second sooner, with the same bias. A calibration of other full scale
+ *   ranges is not loaded
+ * - Welford's running variance: exact on a large offset, where the
+ *   squared sum in float loses it, the same merged from two halves, or
+ *   from windows of integer sums, and kept when limited
+ * - the online refresh: at rest with a new gyro bias, the bias follows
+ *   within a quarter second, with no EEPROM write until the save task
+ *   of vrduino.ino runs, and is saved, while turning or shaking
+ *   nothing changes. A bias over 1 deg/s off only follows when measured
+ *   again, with every sample tracked meanwhile
+ * - the die temperature: read with the samples, also from the FIFO. A
+ *   warm-up at rest fits the drift of the gyro bias over it, the bias
+ *   then follows the temperature while turning, and the next boot loads
+ *   the fit, so a cold start is right while turning from the start
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include <EEPROM.h>
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "ImuCalibration.h"
+#include "OrientationTracker.h"
+
+static bool testRecord() {
+
+  Serial.println("record:");
+  bool ok = true;
+
+  EEPROM.hostErase();
+  ImuCalibration loaded;
+  ok &= check("nothing loads from a blank EEPROM", !loaded.load());
+
+  ImuCalibration saved;
+  for (int i = 0; i < 3; i++) {
+    saved.gyrBias[i] = 0.1f * (i + 1);
+    saved.gyrVariance[i] = 0.01f;
+    saved.accBias[i] = -0.2f * i;
+    saved.accVariance[i] = 0.002f;
+    saved.gyrScale[i] = 0.061f;
+    saved.accScale[i] = 0.0048f;
+  }
+  saved.save();
+  ok &= check("a saved record loads back the same",
+    loaded.load() && memcmp(&loaded, &saved, sizeof(saved)) == 0);
+
+  uint32_t writes = EEPROM.hostWrites();
+  saved.save();
+  ok &= check("saving it again writes no byte", EEPROM.hostWrites() == writes);
+
+  // a bit of the payload flipped, e.g. by a write cut short
+  int address = IMU_CALIBRATION_EEPROM_ADDRESS + 20;
+  EEPROM.write(address, EEPROM.read(address) ^ 0x04);
+  ok &= check("a flipped bit is rejected", !loaded.load());
+  saved.save();
+
+  // another layout version, with a valid CRC
+  uint8_t record[ImuCalibration::recordBytes];
+  for (int i = 0; i < ImuCalibration::recordBytes; i++) {
+    record[i] = EEPROM.read(IMU_CALIBRATION_EEPROM_ADDRESS + i);
+  }
+  record[4] = ImuCalibration::version + 1;
+  uint32_t crc = ImuCalibration::crc32(record, ImuCalibration::recordBytes - 4);
+  memcpy(&record[ImuCalibration::recordBytes - 4], &crc, 4);
+  for (int i = 0; i < ImuCalibration::recordBytes; i++) {
+    EEPROM.write(IMU_CALIBRATION_EEPROM_ADDRESS + i, record[i]);
+  }
+  ok &= check("another version is rejected", !loaded.load());
+
+  return ok;
+
+}
+
+static bool testWelford() {
+
+  Serial.println("running variance:");
+  bool ok = true;
+
+  // a gyro axis at a bias of 30000 counts, +-1 count of noise
+  Welford welford;
+  float sum = 0;
+  float squaredSum = 0;
+  const int n = 1000;
+  for (int i = 0; i < n; i++) {
+    double x = 30000 + (i % 2 ? 1 : -1);
+    welford.add(x);
+    sum += float(x);
+    squaredSum += float(x * x);
+  }
+  float naive = squaredSum / n - (sum / n) * (sum / n);
+  Serial.printf("  variance 1: %.6f, %.6f from the squared sum in float\n",
+    welford.variance(), double(naive));
+  ok &= check("exact on a large offset", welford.getMean() == 30000 && welford.variance() == 1);
+
+  Welford first;
+  Welford second;
+  for (int i = 0; i < n; i++) {
+    (i < n / 4 ? first : second).add(30000 + (i % 2 ? 1 : -1) + i * 0.01);
+  }
+  first.merge(second);
+  Welford whole;
+  for (int i = 0; i < n; i++) {
+    whole.add(30000 + (i % 2 ? 1 : -1) + i * 0.01);
+  }
+  ok &= check("the same merged from two halves",
+    first.count() == n && fabs(first.getMean() - whole.getMean()) < 1e-9 &&
+    fabs(first.variance() - whole.variance()) < 1e-9);
+
+  whole.limit(100);
+  ok &= check("and kept when limited",
+    whole.count() == 100 && fabs(first.getMean() - whole.getMean()) < 1e-9 &&
+    fabs(first.variance() - whole.variance()) < 1e-9);
+
+  // windows of 50 samples summed in integers, near full scale
+  ImuMoments bySample;
+  ImuMoments byWindow;
+  ImuWindowSums window;
+  for (int i = 0; i < n; i++) {
+    ImuSample sample = {};
+    for (int j = 0; j < 3; j++) {
+      sample.gyr[j] = int16_t(32000 - 100 * j + (i % 2 ? 1 : -1) * (i % 5));
+      sample.acc[j] = int16_t(-32000 + i % (7 + j));
+    }
+    sample.temp = int16_t(i / 10);
+    bySample.add(sample);
+    window.add(sample);
+    if (window.count() == 50) {
+      byWindow.merge(window);
+      window.reset();
+    }
+  }
+  bool same = byWindow.count() == n &&
+    fabs(byWindow.tempMean() - bySample.tempMean()) < 1e-9;
+  for (int j = 0; j < 3; j++) {
+    double mean[2], variance[2];
+    bySample.gyrMeanVariance(j, mean[0], variance[0]);
+    byWindow.gyrMeanVariance(j, mean[1], variance[1]);
+    same &= fabs(mean[0] - mean[1]) < 1e-9 && fabs(variance[0] - variance[1]) < 1e-9;
+    bySample.accMeanVariance(j, mean[0], variance[0]);
+    byWindow.accMeanVariance(j, mean[1], variance[1]);
+    same &= fabs(mean[0] - mean[1]) < 1e-9 && fabs(variance[0] - variance[1]) < 1e-9;
+  }
+  ok &= check("the same from windows of integer sums", same);
+
+  return ok;
+
+}
+
+/* setup() of vrduino.ino, returns the virtual us it took */
+static uint64_t boot(OrientationTracker& tracker) {
+
+  uint64_t start = hostMicros64();
+  tracker.initImu();
+  if (!tracker.loadImuCalibration()) {
+    tracker.measureImuBiasVariance();
+    tracker.saveImuCalibration();
+  }
+  return hostMicros64() - start;
+
+}
+
+static bool testBoot(HostMpu9250& mpu) {
+
+  Serial.println("boot:");
+  bool ok = true;
+
+  static const float rest[6] = {0.5f, -0.25f, 1.0f, 0, 0, 9.80665f};
+  mpu.setSamples(rest, 1);
+  EEPROM.hostErase();
+
+  OrientationTracker first(0.99, false);
+  uint64_t measured = boot(first);
+  ImuCalibration saved;
+  bool bias = saved.load();
+  for (int i = 0; i < 3; i++) {
+    bias &= fabs(saved.gyrBias[i] - gyrAsRead(rest[i])) < 1e-6;
+  }
+  ok &= check("the first boot measures the bias and saves it", bias);
+
+  OrientationTracker next(0.99, false);
+  uint64_t loaded = boot(next);
+  Serial.printf("  boot %.3f s measuring, %.3f s loading the calibration\n",
+    measured * 1e-6, loaded * 1e-6);
+  ok &= check("the next boot loads it, a second sooner",
+    loaded + 990000 < measured && next.getImuSamplesProcessed() == 0);
+  bias = true;
+  for (int i = 0; i < 3; i++) {
+    bias &= fabs(double(next.getGyrBias()[i] - first.getGyrBias()[i])) < 1e-6;
+  }
+  ok &= check("with the same bias", bias);
+
+  // measured at other full scale ranges
+  saved.gyrScale[0] *= 2;
+  saved.save();
+  OrientationTracker other(0.99, false);
+  other.initImu();
+  ok &= check("a calibration of other ranges is not loaded", !other.loadImuCalibration());
+
+  return ok;
+
+}
+
+/* processImu() every ms, and the save task of vrduino.ino unless held */
+static void track(OrientationTracker& tracker, int ms, bool save = true) {
+  for (int i = 0; i < ms; i++) {
+    delay(1);
+    tracker.processImu();
+    if (save && tracker.isImuCalibrationSavePending()) {
+      tracker.saveImuCalibration();
+    }
+  }
+}
+
+static bool testRefresh(HostMpu9250& mpu) {
+
+  Serial.println("refresh:");
+  bool ok = true;
+
+  static const float rest[6] = {0.5f, -0.25f, 1.0f, 0, 0, 9.80665f};
+  mpu.setSamples(rest, 1);
+  EEPROM.hostErase();
+  OrientationTracker tracker(0.99, false);
+  boot(tracker);
+
+  // turning at 30 deg/s about y, and shaking
+  static const float turning[6] = {0.5f, 30.0f, 1.0f, 0, 0, 9.80665f};
+  static const float shaking[2 * 6] = {
+    20.0f, -0.25f, 1.0f, 0, 0, 9.80665f,
+    -20.0f, -0.25f, 1.0f, 0, 0, 9.80665f
+  };
+  uint32_t writes = EEPROM.hostWrites();
+  mpu.setSamples(turning, 1);
+  track(tracker, 1500);
+  mpu.setSamples(shaking, 2);
+  track(tracker, 1500);
+  ok &= check("turning or shaking, nothing changes",
+    tracker.getImuCalibrationRefreshes() == 0 && EEPROM.hostWrites() == writes &&
+    fabs(double(tracker.getGyrBias()[1]) - gyrAsRead(rest[1])) < 1e-6);
+
+  // the bias drifted, e.g. the board warmed up
+  static const float drifted[6] = {0.8f, -0.25f, 1.0f, 0, 0, 9.80665f};
+  mpu.setSamples(drifted, 1);
+  track(tracker, 400, false);
+  Serial.printf("  %u refreshes, gyro x bias %.4f deg/s\n",
+    (unsigned)tracker.getImuCalibrationRefreshes(), double(tracker.getGyrBias()[0]));
+  ok &= check("at rest, the bias follows within a quarter second",
+    tracker.getImuCalibrationRefreshes() >= 1 &&
+    fabs(double(tracker.getGyrBias()[0]) - gyrAsRead(drifted[0])) < 1e-6);
+  ok &= check("with no EEPROM write in the imu path",
+    tracker.isImuCalibrationSavePending() && EEPROM.hostWrites() == writes);
+  tracker.saveImuCalibration();
+  ImuCalibration saved;
+  ok &= check("and is saved by the save task", saved.load() &&
+    !tracker.isImuCalibrationSavePending() &&
+    fabs(saved.gyrBias[0] - gyrAsRead(drifted[0])) < 1e-6);
+
+  // staying at rest on the same bias, no more writes
+  writes = EEPROM.hostWrites();
+  track(tracker, 2500);
+  ok &= check("an unchanged bias is not saved again", EEPROM.hostWrites() == writes);
+
+  // 3 deg/s off, e.g. a cold start on a calibration of a warm board
+  static const float off[6] = {3.8f, -0.25f, 1.0f, 0, 0, 9.80665f};
+  mpu.setSamples(off, 1);
+  uint64_t start = hostMicros64();
+  track(tracker, 1500);
+  uint64_t tracking = hostMicros64() - start;
+  ok &= check("over 1 deg/s off, the bias does not follow",
+    fabs(double(tracker.getGyrBias()[0]) - gyrAsRead(drifted[0])) < 1e-6);
+
+  // each sample tracked as it comes, in the time as without
+  uint32_t processed = tracker.getImuSamplesProcessed();
+  start = hostMicros64();
+  tracker.recalibrateImu();
+  track(tracker, 1500);
+  uint64_t recalibrating = hostMicros64() - start;
+  Serial.printf("  %u samples in %.3f s, %.3f s without measuring\n",
+    (unsigned)(tracker.getImuSamplesProcessed() - processed),
+    recalibrating * 1e-6, tracking * 1e-6);
+  ok &= check("measured again, it does, without a stall",
+    fabs(double(tracker.getGyrBias()[0]) - gyrAsRead(off[0])) < 1e-6 &&
+    tracker.getImuSamplesProcessed() - processed == 1500 &&
+    recalibrating < tracking + 1000);
+  ok &= check("and is saved", saved.load() &&
+    fabs(saved.gyrBias[0] - gyrAsRead(off[0])) < 1e-6);
+
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+/* warms the model at rest from celsius on by degrees, in 100 ms steps */
+static void warm(HostMpu9250& mpu, OrientationTracker& tracker, float& celsius, float degrees) {
+  for (int i = 0; i < int(degrees * 20 + 0.5f); i++) {
+    celsius += 0.05f;
+    mpu.setTemperature(celsius);
+    track(tracker, 100);
+  }
+}
+
+static bool testTemperature(HostMpu9250& mpu) {
+
+  Serial.println("temperature:");
+  bool ok = true;
+
+  static const float rest[6] = {0.5f, -0.25f, 1.0f, 0, 0, 9.80665f};
+  static const float turning[6] = {0.5f, 30.0f, 1.0f, 0, 0, 9.80665f};
+  static const float drift[3] = {0.04f, -0.03f, 0.02f};
+  mpu.setSamples(rest, 1);
+  float celsius = 25;
+  mpu.setTemperature(celsius);
+
+  Imu imu;
+  imu.init();
+  delay(2);
+  imu.read();
+  ok &= check("read with the samples", fabs(double(imu.temperature) - celsius) < 0.01);
+  imu.enableFifo(true);
+  delay(5);
+  ImuSample frames[8];
+  int n = imu.readFifo(frames, 8);
+  ok &= check("and from the FIFO", n > 0 && fabs(Imu::tempCelsius(frames[n - 1].temp) - celsius) < 0.01);
+  imu.enableFifo(false);
+
+  // a cold first boot, then warming up at rest by 10 degrees C
+  EEPROM.hostErase();
+  mpu.setGyrTempDrift(drift[0], drift[1], drift[2]);
+  OrientationTracker tracker(0.99, false);
+  boot(tracker);
+  warm(mpu, tracker, celsius, 10);
+  const ImuTempModel& model = tracker.getImuTempModel();
+  Serial.printf("  slope %.4f %.4f %.4f deg/s per degree C, over %d windows\n",
+    model.slope(0), model.slope(1), model.slope(2), model.count());
+  bool fit = model.valid();
+  for (int i = 0; i < 3; i++) {
+    fit &= fabs(model.slope(i) - drift[i]) < 0.05 * fabs(drift[i]);
+  }
+  ok &= check("a warm-up at rest fits the drift", fit);
+
+  // turning while warming up by 10 more
+  mpu.setSamples(turning, 1);
+  uint32_t refreshes = tracker.getImuCalibrationRefreshes();
+  warm(mpu, tracker, celsius, 10);
+  double off = 0;
+  for (int i = 0; i < 3; i += 2) {
+    double bias = rest[i] + drift[i] * (celsius - 21);
+    off = fmax(off, fabs(double(tracker.getGyrBias()[i]) - bias));
+  }
+  Serial.printf("  at %.1f degrees C, %.4f deg/s off, %.4f without the fit\n",
+    celsius, off, fabs(drift[0]) * 10);
+  ok &= check("the bias follows it while turning",
+    tracker.getImuCalibrationRefreshes() == refreshes && off < 0.03);
+
+  ImuCalibration saved;
+  ok &= check("the fit is saved", saved.load() && saved.gyrTempWindows > 0 &&
+    fabs(saved.gyrTempSlope[0] - drift[0]) < 0.05 * fabs(drift[0]));
+
+  // cold again, and turning from the start
+  celsius = 25;
+  mpu.setTemperature(celsius);
+  OrientationTracker next(0.99, false);
+  boot(next);
+  track(next, 100);
+  off = 0;
+  for (int i = 0; i < 3; i += 2) {
+    double bias = rest[i] + drift[i] * (celsius - 21);
+    off = fmax(off, fabs(double(next.getGyrBias()[i]) - bias));
+  }
+  ok &= check("the next boot loads it, right when cold",
+    next.getImuTempModel().valid() && off < 0.03);
+
+  mpu.setGyrTempDrift(0, 0, 0);
+  mpu.setTemperature(21);
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+int main() {
+
+  bool ok = testRecord();
+  ok &= testWelford();
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  ok &= testBoot(mpu);
+  ok &= testRefresh(mpu);
+  ok &= testTemperature(mpu);
+  mpu.detach();
+
+  Serial.println(ok ? "imu calibration: all passed" : "imu calibration: FAILED");
+  return ok ? 0 : 1;
+
+}
@@ -0,0 +1,190 @@
+/**
+ * Host check of the interrupt-driven imu sampling, see ImuCapture.h
+ *
+ * - SpscQueue order, wrap-around and the full queue
+ * - OrientationTracker on the HostMpu9250 model at 1 kHz, with a loop()
+ *   like vrduino.ino that spends 5 ms per iteration: polling integrates a
+ *   fraction of the samples, the interrupt capture every one of them,
+ *   with the sample times as deltaT, so its gyro quaternion matches an
+ *   offline integration of all samples
+ * - the dropped counter when loop() stalls longer than the queue, and the
+ *   missed counter when data ready interrupts are held off
+ * - mask() holds only the ISR off and serves the held edge at unmask()
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "OrientationTracker.h"
+#include "simulatedImuData.h"
+
+static const uint8_t intPin = IMU_INTERRUPT_PIN;
+
+static bool testQueue() {
+
+  Serial.println("queue:");
+  bool ok = true;
+
+  SpscQueue<int, 8> queue;
+  int value = -1;
+  ok &= check("empty queue pops nothing", !queue.pop(value) && queue.size() == 0);
+
+  // keep 3 items queued so the indices wrap the buffer several times
+  bool ordered = queue.push(0) && queue.push(1);
+  for (int i = 0; i < 40; i++) {
+    ordered &= queue.push(i + 2);
+    ordered &= queue.pop(value) && value == i;
+  }
+  ok &= check("items come out in order across wrap-arounds", ordered);
+
+  queue.clear();
+  int pushed = 0;
+  for (int i = 0; i < 10; i++) {
+    pushed += queue.push(i) ? 1 : 0;
+  }
+  ok &= check("a full queue takes all 8 slots, then refuses", pushed == 8 && queue.size() == 8);
+  ok &= check("and keeps the oldest items", queue.pop(value) && value == 0);
+
+  return ok;
+
+}
+
+static bool testDrain(HostMpu9250& mpu) {
+
+  Serial.println("drain, 1 kHz imu, 5 ms loop:");
+  bool ok = true;
+  const int iterations = 400;
+
+  // polling, one sample per loop
+  {
+    OrientationTracker tracker(0.99, false);
+    tracker.initImu();
+    uint32_t taken = mpu.getSamplesTaken();
+    for (int i = 0; i < iterations; i++) {
+      tracker.processImu();
+      delay(5);
+    }
+    uint32_t processed = tracker.getImuSamplesProcessed();
+    taken = mpu.getSamplesTaken() - taken;
+    Serial.printf("  polling: %u of %u samples\n", (unsigned)processed, (unsigned)taken);
+    ok &= check("polling loses most samples", processed < taken / 4);
+  }
+
+  // interrupt capture
+  {
+    OrientationTracker tracker(0.99, false);
+    tracker.initImu();
+    // right after a sample, so no edge lands in the INT_ENABLE write
+    uint32_t first = mpu.getSamplesTaken();
+    while (mpu.getSamplesTaken() == first) {
+      yield();
+    }
+    tracker.initImuInterrupt(intPin);
+    const ImuCapture& capture = tracker.getImuCapture();
+    first = mpu.getSamplesTaken();
+    for (int i = 0; i < iterations; i++) {
+      tracker.processImu();
+      delay(5);
+    }
+    tracker.processImu();
+    uint32_t taken = mpu.getSamplesTaken() - first;
+    uint32_t processed = tracker.getImuSamplesProcessed();
+    Serial.printf("  interrupt: %u of %u samples, %u dropped, %u missed\n",
+      (unsigned)processed, (unsigned)taken, (unsigned)capture.getDropped(),
+      (unsigned)capture.getMissed());
+    ok &= check("every sample is captured and processed",
+      capture.getCaptured() == taken && processed == taken);
+    ok &= check("none dropped or missed", capture.getDropped() == 0 && capture.getMissed() == 0);
+
+    // the first sample only starts the clock, the rest are 1 ms apart
+    Quaternion reference;
+    Scalar gyr[3];
+    for (uint32_t i = 1; i < taken; i++) {
+      sampleGyr(first + i, gyr);
+      updateQuaternionGyr(reference, gyr, Scalar(0.001));
+    }
+    double error = angleBetween(reference, tracker.getQuaternionGyr());
+    Serial.printf("  gyro quaternion vs offline integration: %.2e deg\n", error);
+    ok &= check("gyro quaternion integrates all samples at 1 ms", error < 1e-3);
+  }
+
+  return ok;
+
+}
+
+static bool testLosses(HostMpu9250& mpu) {
+
+  Serial.println("losses:");
+  bool ok = true;
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.initImuInterrupt(intPin);
+  const ImuCapture& capture = tracker.getImuCapture();
+
+  // loop() stalls for 100 samples, the queue holds the first 64
+  delay(100);
+  Serial.printf("  stall: %u captured, %u dropped\n", (unsigned)capture.getCaptured(),
+    (unsigned)capture.getDropped());
+  ok &= check("a 100 ms stall drops the samples beyond the queue",
+    capture.getCaptured() >= 100 &&
+    capture.getDropped() == capture.getCaptured() - IMU_QUEUE_LENGTH);
+  tracker.processImu();
+  ok &= check("the queued samples are all processed",
+    tracker.getImuSamplesProcessed() == IMU_QUEUE_LENGTH && capture.queued() == 0);
+
+  // hold the data ready interrupt off for 10 ms, as a long ISR would
+  uint8_t off[2] = {0x38, 0x00};
+  uint8_t on[2] = {0x38, 0x01};
+  mpu.i2cWrite(off, 2);
+  delay(10);
+  mpu.i2cWrite(on, 2);
+  delay(5);
+  Serial.printf("  %u missed\n", (unsigned)capture.getMissed());
+  ok &= check("a 10 ms gap counts 10 missed samples", capture.getMissed() == 10);
+
+  return ok;
+
+}
+
+static bool testMask() {
+
+  Serial.println("mask:");
+  bool ok = true;
+
+  Imu imu;
+  imu.init();
+  ImuCapture capture;
+  capture.begin(&imu, intPin);
+  delay(5);
+
+  // 3 edges while masked, the pending one is served at unmask()
+  uint32_t captured = capture.getCaptured();
+  capture.mask();
+  delay(3);
+  ok &= check("no sample captured while masked", capture.getCaptured() == captured);
+  capture.unmask();
+  ok &= check("the held edge is served at unmask", capture.getCaptured() == captured + 1);
+  delay(5);
+  ok &= check("and the two before it count as missed", capture.getMissed() == 2);
+  capture.end();
+
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(intPin);
+  mpu.attach();
+
+  bool ok = testQueue();
+  ok &= testDrain(mpu);
+  ok &= testLosses(mpu);
+  ok &= testMask();
+
+  Serial.println(ok ? "imu capture: all passed" : "imu capture: FAILED");
+  return ok ? 0 : 1;
+
+}
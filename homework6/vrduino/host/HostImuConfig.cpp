@@ -0,0 +1,234 @@
+/**
+ * Host check of the output data rate, filters and ranges of the imu, see
+ * ImuConfig, on the HostMpu9250 model
+ *
+ * - the default configuration writes the registers init() always wrote:
+ *   1 kHz, 184 Hz and 218 Hz bandwidth, 2000 deg/s and 16 g
+ * - a sample rate divider of 1 stamps the FIFO samples 2 ms apart
+ * - 250 deg/s and 2 g resolve 8 times finer, and a range between the
+ *   supported ones is rounded down
+ * - the 8 kHz gyro mode over SPI: FIFO samples 125 us apart, and
+ *   OrientationTracker steps the estimator once per 8 samples with their
+ *   rotation pre-integrated, exactly the per-sample integration of a fast
+ *   coning motion, which sampling at 1 kHz misses by over 0.05 degrees
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "OrientationTracker.h"
+#include "simulatedImuData.h"
+
+static const uint8_t csPin = 10;
+
+/* a coning motion, the gyro rate turning around z at 50 Hz, at 8 kHz */
+static const int coningSamples = 160;
+static const double coningDps = 1000;
+static float coning[6 * coningSamples];
+
+static bool testDefault(HostMpu9250& mpu) {
+
+  Serial.println("default:");
+  bool ok = true;
+
+  Imu imu;
+  imu.init();
+  ok &= check("1 kHz, 184 Hz gyro and 218 Hz acc bandwidth",
+    mpu.reg(0x1A) == 0x01 && mpu.reg(0x19) == 0 && mpu.reg(0x1D) == 0x01 &&
+    imu.samplePeriodMicros == 1000);
+  ok &= check("2000 deg/s and 16 g",
+    mpu.reg(0x1B) == 0x18 && mpu.reg(0x1C) == 0x18 &&
+    imu.getConfig().gyrFullScaleDps == 2000 && imu.getConfig().accFullScaleG == 16);
+
+  return ok;
+
+}
+
+static bool testDivider(HostMpu9250& mpu) {
+
+  Serial.println("sample rate divider:");
+  bool ok = true;
+
+  ImuConfig config;
+  config.sampleRateDivider = 1;
+  Imu imu;
+  imu.setConfig(config);
+  imu.init();
+  imu.enableFifo(true);
+  delay(20);
+  ImuSample samples[Imu::fifoMaxFrames];
+  int n = imu.readFifo(samples, Imu::fifoMaxFrames);
+  imu.enableFifo(false);
+
+  bool apart = n > 0;
+  for (int i = 1; i < n; i++) {
+    apart &= samples[i].ticks - samples[i - 1].ticks == 2000 * TickClock::ticksPerMicro;
+  }
+  Serial.printf("  %d samples in 20 ms\n", n);
+  ok &= check("SMPLRT_DIV 1 samples at 500 Hz", mpu.reg(0x19) == 1 && n == 10);
+  ok &= check("stamped 2 ms apart", apart);
+
+  return ok;
+
+}
+
+static bool testRanges(HostMpu9250& mpu) {
+
+  Serial.println("ranges:");
+  bool ok = true;
+
+  ImuConfig config;
+  config.gyrFullScaleDps = 250;
+  config.accFullScaleG = 2;
+  Imu imu;
+  imu.setConfig(config);
+  imu.init();
+  ok &= check("250 deg/s and 2 g", mpu.reg(0x1B) == 0x00 && mpu.reg(0x1C) == 0x00);
+  Imu full;
+  full.init();
+  ok &= check("8 times finer scales",
+    fabs(double(full.gyrScale[0]) / double(imu.gyrScale[0]) - 8) < 1e-9 &&
+    fabs(double(full.accScale[0]) / double(imu.accScale[0]) - 8) < 1e-9);
+
+  // one sample of 100.3 deg/s, read at 250 deg/s
+  imu.init();
+  static const float row[6] = {100.3f, 0, 0, 0, 0, 9.80665f};
+  mpu.setSamples(row, 1);
+  delay(2);
+  ImuSample sample;
+  imu.readSample(sample);
+  double rate = sample.gyr[0] * double(imu.gyrScale[0]);
+  mpu.setSamples(imuData, nImuSamples / 6);
+  Serial.printf("  100.3 deg/s reads %.4f deg/s\n", rate);
+  ok &= check("within half a count of 0.0076 deg/s",
+    fabs(rate - 100.3) <= 0.5 * double(imu.gyrScale[0]) + 1e-6);
+
+  config.gyrFullScaleDps = 300;
+  config.accFullScaleG = 3;
+  imu.setConfig(config);
+  bool down = imu.getConfig().gyrFullScaleDps == 250 && imu.getConfig().accFullScaleG == 2;
+  config.gyrFullScaleDps = 5000;
+  config.accFullScaleG = 20;
+  imu.setConfig(config);
+  ok &= check("a range between the supported ones rounds down",
+    down && imu.getConfig().gyrFullScaleDps == 2000 && imu.getConfig().accFullScaleG == 16);
+
+  return ok;
+
+}
+
+static bool test8kHz(HostMpu9250& mpu) {
+
+  Serial.println("8 kHz over SPI:");
+  bool ok = true;
+
+  ImuConfig config;
+  config.gyrDlpf = IMU_GYR_DLPF_250HZ_8KHZ;
+  ImuBusSpi spi(csPin);
+
+  Imu imu;
+  imu.setBus(&spi);
+  imu.setConfig(config);
+  imu.init();
+  imu.enableFifo(true);
+  delay(2);
+  ImuSample samples[Imu::fifoMaxFrames];
+  int n = imu.readFifo(samples, Imu::fifoMaxFrames);
+  imu.enableFifo(false);
+  bool apart = n > 0;
+  for (int i = 1; i < n; i++) {
+    apart &= samples[i].ticks - samples[i - 1].ticks == 6000;
+  }
+  Serial.printf("  %d samples in 2 ms\n", n);
+  ok &= check("DLPF_CFG 0 samples at 8 kHz", mpu.reg(0x1A) == 0 && n == 16);
+  ok &= check("stamped 6000 ticks apart", apart && imu.samplePeriodTicks == 6000);
+
+  // the estimator once per ms, on 8 samples each
+  for (int i = 0; i < coningSamples; i++) {
+    double phase = 2 * M_PI * i / coningSamples;
+    float *s = &coning[6 * i];
+    s[0] = float(coningDps * cos(phase));
+    s[1] = float(coningDps * sin(phase));
+    s[2] = 0;
+    s[3] = 0;
+    s[4] = 9.80665f;
+    s[5] = 0;
+  }
+  mpu.setSamples(coning, coningSamples);
+  uint32_t origin = mpu.getSamplesTaken();
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu(config, &spi);
+  tracker.initImuFifo();
+  tracker.setImuStepSamples(8);
+  uint32_t first = mpu.getSamplesTaken() - origin;
+  int steps = 0;
+  for (int i = 0; i < 200; i++) {
+    steps += tracker.processImu() ? 1 : 0;
+    delay(1);
+  }
+  uint32_t processed = tracker.getImuSamplesProcessed();
+  uint32_t pending = mpu.getFifoCount() / Imu::fifoFrameBytes;
+  uint32_t taken = mpu.getSamplesTaken() - origin - first;
+  Serial.printf("  %u of %u samples in %d steps, %u pending\n",
+    (unsigned)processed, (unsigned)taken, steps, (unsigned)pending);
+  ok &= check("every sample is processed", processed + pending == taken);
+  ok &= check("a step of 8 samples per ms", steps >= 195 && processed / 8 >= uint32_t(steps));
+
+  // the first sample only starts the clock, the rest are 125 us apart,
+  // up to the last complete step
+  uint32_t stepped = processed / 8 * 8;
+  Quaternion reference;
+  for (uint32_t i = 1; i < stepped; i++) {
+    Scalar gyr[3];
+    sampleGyr(first + i, gyr, coning, coningSamples);
+    updateQuaternionGyr(reference, gyr, Scalar(125e-6));
+  }
+  double error = angleBetween(reference, tracker.getQuaternionGyr());
+  Serial.printf("  pre-integrated steps vs per sample: %.2e deg\n", error);
+  ok &= check("the steps integrate every sample", error < 1e-4);
+
+  // the same motion sampled at 1 kHz
+  Quaternion fast, slow, mean;
+  for (int ms = 1; ms <= 200; ms++) {
+    Scalar sum[3] = {0, 0, 0};
+    for (int k = 1; k <= 8; k++) {
+      Scalar gyr[3];
+      sampleGyr(8 * (ms - 1) + k, gyr, coning, coningSamples);
+      updateQuaternionGyr(fast, gyr, Scalar(125e-6));
+      for (int j = 0; j < 3; j++) {
+        sum[j] += gyr[j] / 8;
+      }
+    }
+    Scalar gyr[3];
+    sampleGyr(8 * ms, gyr, coning, coningSamples);
+    updateQuaternionGyr(slow, gyr, Scalar(0.001));
+    updateQuaternionGyr(mean, sum, Scalar(0.001));
+  }
+  double slowError = angleBetween(fast, slow);
+  double meanError = angleBetween(fast, mean);
+  Serial.printf("  after 200 ms, 1 kHz samples off by %.3f deg, 1 kHz mean rates by %.2e deg\n",
+    slowError, meanError);
+  ok &= check("sampling at 1 kHz misses over 0.05 deg", slowError > 0.05);
+  ok &= check("pre-integrating beats the mean rate of a step", error < meanError);
+
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  mpu.attachSpi(csPin);
+  bool ok = testDefault(mpu);
+  ok &= testDivider(mpu);
+  ok &= testRanges(mpu);
+  ok &= test8kHz(mpu);
+  mpu.detach();
+
+  Serial.println(ok ? "imu config: all passed" : "imu config: FAILED");
+  return ok ? 0 : 1;
+
+}
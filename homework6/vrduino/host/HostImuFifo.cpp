@@ -0,0 +1,170 @@
+/**
+ * Host check of the FIFO batch reads of the imu, see Imu::readFifo()
+ *
+ * - frames and reconstructed sample times of a batch against the
+ *   HostMpu9250 model
+ * - OrientationTracker in FIFO mode with a loop() like vrduino.ino that
+ *   spends 5 ms per iteration: every sample is integrated at 1 ms, so
+ *   the gyro quaternion matches an offline integration, with a fraction
+ *   of the I2C transactions per sample of polling, under half
+ * - an overflowed FIFO is reset and counted, and reading resumes
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "OrientationTracker.h"
+#include "simulatedImuData.h"
+
+static bool testBatch(HostMpu9250& mpu) {
+
+  Serial.println("batch:");
+  bool ok = true;
+
+  Imu imu = Imu();
+  imu.init();
+
+  // right after a sample, so none arrives while the FIFO is switched on
+  uint32_t taken = mpu.getSamplesTaken();
+  while (mpu.getSamplesTaken() == taken) {
+    yield();
+  }
+  imu.enableFifo(true);
+  uint32_t first = mpu.getSamplesTaken();
+
+  delay(10);
+  ok &= check("10 ms fill 10 frames of 12 bytes", mpu.getFifoCount() == 120);
+
+  // the burst takes ~3 ms at 400 kHz, the model keeps sampling meanwhile
+  ImuSample samples[Imu::fifoMaxFrames];
+  int n = imu.readFifo(samples, Imu::fifoMaxFrames);
+  ok &= check("readFifo returns all 10", n == 10);
+
+  bool frames = true;
+  bool times = true;
+  for (int i = 0; i < n; i++) {
+    int16_t gyr[3];
+    sampleGyrCounts(first + i, gyr);
+    frames &= samples[i].gyr[0] == gyr[0] && samples[i].gyr[1] == gyr[1] && samples[i].gyr[2] == gyr[2];
+    if (i > 0) {
+      times &= samples[i].ticks - samples[i - 1].ticks == imu.samplePeriodTicks;
+    }
+  }
+  // the model attached at time 0 takes sample i at (i + 1) ms, the
+  // TickClock started later
+  uint64_t origin = hostMicros64() * TickClock::ticksPerMicro - TickClock::now();
+  int64_t error = int64_t(samples[n - 1].ticks + origin - uint64_t(first + n) * imu.samplePeriodTicks);
+  ok &= check("frames in order, as the model took them", frames);
+  ok &= check("sample times 1 ms apart, within a period of the truth",
+    times && llabs(error) < int64_t(imu.samplePeriodTicks));
+
+  // the next batch continues the sample clock
+  uint64_t last = samples[n - 1].ticks;
+  n = imu.readFifo(samples, Imu::fifoMaxFrames);
+  ok &= check("the next batch continues 1 ms after the last",
+    n > 0 && samples[0].ticks - last == imu.samplePeriodTicks);
+
+  imu.enableFifo(false);
+  return ok;
+
+}
+
+static bool testTracker(HostMpu9250& mpu) {
+
+  Serial.println("tracker, 1 kHz imu, 5 ms loop:");
+  bool ok = true;
+  const int iterations = 400;
+
+  // transactions per sample when polling
+  double pollingPerSample;
+  {
+    OrientationTracker tracker(0.99, false);
+    tracker.initImu();
+    uint32_t transactions = Wire.hostTransactions();
+    for (int i = 0; i < iterations; i++) {
+      tracker.processImu();
+      delay(5);
+    }
+    transactions = Wire.hostTransactions() - transactions;
+    pollingPerSample = double(transactions) / tracker.getImuSamplesProcessed();
+    Serial.printf("  polling: %u samples, %.2f transactions per sample\n",
+      (unsigned)tracker.getImuSamplesProcessed(), pollingPerSample);
+  }
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.initImuFifo();
+  // samples may already have arrived while the FIFO was switched on
+  uint32_t first = mpu.getSamplesTaken() - mpu.getFifoCount() / Imu::fifoFrameBytes;
+  uint32_t transactions = Wire.hostTransactions();
+  for (int i = 0; i < iterations; i++) {
+    tracker.processImu();
+    delay(5);
+  }
+  transactions = Wire.hostTransactions() - transactions;
+  uint32_t processed = tracker.getImuSamplesProcessed();
+  uint32_t pending = mpu.getFifoCount() / Imu::fifoFrameBytes;
+  uint32_t taken = mpu.getSamplesTaken() - first;
+  double fifoPerSample = double(transactions) / processed;
+  Serial.printf("  fifo: %u of %u samples, %u pending, %.2f transactions per sample\n",
+    (unsigned)processed, (unsigned)taken, (unsigned)pending, fifoPerSample);
+
+  ok &= check("every sample is processed", processed + pending == taken);
+  ok &= check("no overflows", tracker.getImuFifoOverflows() == 0);
+  ok &= check("under half the transactions per sample of polling",
+    fifoPerSample * 2 < pollingPerSample);
+
+  // the first sample only starts the clock, the rest are 1 ms apart
+  Quaternion reference;
+  for (uint32_t i = 1; i < processed; i++) {
+    Scalar gyr[3];
+    sampleGyr(first + i, gyr);
+    updateQuaternionGyr(reference, gyr, Scalar(0.001));
+  }
+  double error = angleBetween(reference, tracker.getQuaternionGyr());
+  Serial.printf("  gyro quaternion vs offline integration: %.2e deg\n", error);
+  ok &= check("gyro quaternion integrates all samples at 1 ms", error < 1e-3);
+
+  return ok;
+
+}
+
+static bool testOverflow(HostMpu9250& mpu) {
+
+  Serial.println("overflow:");
+  bool ok = true;
+
+  Imu imu = Imu();
+  imu.init();
+  imu.enableFifo(true);
+
+  // 60 frames do not fit into 512 bytes
+  delay(60);
+  ImuSample samples[Imu::fifoMaxFrames];
+  int n = imu.readFifo(samples, Imu::fifoMaxFrames);
+  ok &= check("an overflowed FIFO returns nothing and is counted",
+    n == 0 && imu.fifoOverflows == 1 && mpu.getFifoCount() == 0);
+
+  delay(5);
+  n = imu.readFifo(samples, Imu::fifoMaxFrames);
+  ok &= check("reading resumes after the reset", n >= 5 && imu.fifoOverflows == 1);
+
+  imu.enableFifo(false);
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+
+  bool ok = testBatch(mpu);
+  ok &= testTracker(mpu);
+  ok &= testOverflow(mpu);
+
+  Serial.println(ok ? "imu fifo: all passed" : "imu fifo: FAILED");
+  return ok ? 0 : 1;
+
+}
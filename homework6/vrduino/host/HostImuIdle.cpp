@@ -0,0 +1,205 @@
+/**
+ * Host check of the lower imu rate while still, see
+ * OrientationTracker::setImuIdleRate(), on the HostMpu9250 model with the
+ * interrupt capture and a loop() like vrduino.ino, and polled
+ *
+ * - still for 0.5 s: the imu samples at 100 Hz, the estimator steps 10
+ *   times a second, and the ISR reads a tenth of the I2C transactions
+ *   per second of the full rate, without counting missed samples
+ * - the counters report the samples and estimator steps skipped, as the
+ *   model took them
+ * - the first sample in motion restores 1 kHz, the next sample is 1 ms
+ *   later, and the estimator steps with it at once
+ * - off by default, and kept at 1 kHz while the bias is measured again
+ * - polled like the imu task of vrduino.ino, the freed bus time reported
+ *   is what the reads saved against the full rate, measured on the
+ *   virtual clock: some when polled every 1 ms, as the empty polls are
+ *   shorter, and 90% when polled at the sample period of the idle rate
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "OrientationTracker.h"
+#include "simulatedImuData.h"
+
+/* gyro deg/s and acc m/s^2 of an imu on a desk, and turning */
+static const float still[6] = {0.2f, -0.1f, 0.1f, 0.05f, 9.8f, -0.1f};
+static const float turning[6] = {0, 100, 0, 0.05f, 9.8f, -0.1f};
+
+/* loop() of vrduino.ino for ms, @returns the estimator steps meanwhile */
+static uint32_t run(OrientationTracker& tracker, uint32_t ms) {
+  uint32_t steps = tracker.getImuEstimatorSteps();
+  uint32_t end = millis() + ms;
+  while (millis() < end) {
+    tracker.processImu();
+    delay(5);
+  }
+  return tracker.getImuEstimatorSteps() - steps;
+}
+
+static bool testIdle(HostMpu9250& mpu) {
+
+  Serial.println("still:");
+  bool ok = true;
+
+  mpu.setSamples(still, 1);
+
+  // the full rate, for reference
+  OrientationTracker full(0.99, false);
+  full.initImu();
+  full.initImuInterrupt(IMU_INTERRUPT_PIN);
+  run(full, 1000);
+  uint32_t transactions = Wire.hostTransactions();
+  uint32_t taken = mpu.getSamplesTaken();
+  uint32_t fullSteps = run(full, 1000);
+  uint32_t fullTransactions = Wire.hostTransactions() - transactions;
+  uint32_t fullTaken = mpu.getSamplesTaken() - taken;
+  ok &= check("off by default", !full.isImuIdle() && fullTaken >= 999);
+
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  tracker.initImuInterrupt(IMU_INTERRUPT_PIN);
+  tracker.setImuIdleRate(true);
+  run(tracker, 1000);
+  ok &= check("idle after 0.5 s still",
+    tracker.isImuIdle() && tracker.getImuIdleEntries() == 1 && mpu.reg(0x19) == 9);
+
+  transactions = Wire.hostTransactions();
+  taken = mpu.getSamplesTaken();
+  uint32_t idleSteps = run(tracker, 1000);
+  uint32_t idleTransactions = Wire.hostTransactions() - transactions;
+  uint32_t idleTaken = mpu.getSamplesTaken() - taken;
+  Serial.printf("  per s: %u samples, %u steps, %u transactions, %u %u %u at 1 kHz\n",
+    (unsigned)idleTaken, (unsigned)idleSteps, (unsigned)idleTransactions,
+    (unsigned)fullTaken, (unsigned)fullSteps, (unsigned)fullTransactions);
+  ok &= check("100 Hz, an estimator step per 10 samples",
+    idleTaken >= 99 && idleTaken <= 101 && idleSteps >= 9 && idleSteps <= 11);
+  ok &= check("a tenth of the transactions of 1 kHz", idleTransactions * 9 < fullTransactions);
+  ok &= check("no samples counted as missed", tracker.getImuCapture().getMissed() == 0);
+
+  // the model took a sample per 10 ms since the start of the idle period
+  double idleMicros = double(tracker.getImuIdleMicros());
+  uint32_t skipped = tracker.getImuSamplesSkipped();
+  uint32_t expected = uint32_t(idleMicros / 1000) - tracker.getImuIdleSamples();
+  Serial.printf("  idle %.3f s: %u samples, %u skipped, %u steps skipped\n",
+    idleMicros * 1e-6, (unsigned)tracker.getImuIdleSamples(), (unsigned)skipped,
+    (unsigned)tracker.getImuStepsSkipped());
+  Serial.printf("  freed %.1f ms of bus, %.1f ms of estimator at %.1f us\n",
+    tracker.getImuBusMicrosFreed() * 1e-3,
+    tracker.getImuStepsSkipped() * tracker.getImuEstimatorMicros() * 1e-3,
+    tracker.getImuEstimatorMicros());
+  ok &= check("the skipped samples and steps are counted",
+    idleMicros > 1.4e6 && skipped + 1 >= expected && skipped <= expected + 1 &&
+    tracker.getImuStepsSkipped() * 1e3 > 0.85 * idleMicros &&
+    tracker.getImuBusMicrosFreed() > 0);
+
+  // motion: the first sample at 100 Hz wakes it
+  Quaternion before = tracker.getQuaternionGyr();
+  mpu.setSamples(turning, 1);
+  taken = mpu.getSamplesTaken();
+  while (mpu.getSamplesTaken() == taken) {
+    yield();
+  }
+  uint32_t steps = tracker.getImuEstimatorSteps();
+  bool stepped = tracker.processImu();
+  ok &= check("the first sample in motion restores 1 kHz",
+    !tracker.isImuIdle() && mpu.reg(0x19) == 0 &&
+    mpu.hostNextEvent() == mpu.getLastSampleTime() + 1000);
+  Quaternion after = tracker.getQuaternionGyr();
+  ok &= check("and steps the estimator with it",
+    stepped && tracker.getImuEstimatorSteps() == steps + 1 &&
+    (before.q[0] != after.q[0] || before.q[2] != after.q[2]));
+
+  run(tracker, 100);
+  ok &= check("no samples counted as missed on the way back",
+    tracker.getImuCapture().getMissed() == 0 && !tracker.isImuIdle());
+
+  // recalibrateImu() wants its samples at 1 kHz
+  mpu.setSamples(still, 1);
+  tracker.setImuCalibrationRefresh(true);
+  tracker.recalibrateImu();
+  run(tracker, 800);
+  ok &= check("at 1 kHz while the bias is measured again", !tracker.isImuIdle());
+
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+/**
+ * the imu task of vrduino.ino polling for ms, every 1 ms or at the sample
+ * period of the imu
+ * @returns us the reads took on the bus, the only virtual time they take
+ */
+static uint64_t poll(OrientationTracker& tracker, uint32_t ms, bool follow) {
+  uint64_t bus = 0;
+  uint64_t end = hostMicros64() + uint64_t(ms) * 1000;
+  while (hostMicros64() < end) {
+    uint64_t start = hostMicros64();
+    tracker.processImu();
+    uint64_t now = hostMicros64();
+    bus += now - start;
+    uint32_t period = follow ? tracker.getImuSamplePeriodMicros() : 1000;
+    if (now - start < period) {
+      delayMicroseconds(uint32_t(period - (now - start)));
+    }
+  }
+  return bus;
+}
+
+static bool testPolling(HostMpu9250& mpu) {
+
+  Serial.println("polling:");
+  bool ok = true;
+
+  mpu.setSamples(still, 1);
+
+  // the full rate, for reference
+  OrientationTracker full(0.99, false);
+  full.initImu();
+  poll(full, 1000, false);
+  uint64_t fullBus = poll(full, 1000, false);
+
+  // idle, polled at 1 ms and at the 10 ms of the idle rate
+  uint64_t bus[2];
+  uint64_t freed[2];
+  for (int follow = 0; follow < 2; follow++) {
+    OrientationTracker tracker(0.99, false);
+    tracker.initImu();
+    tracker.setImuIdleRate(true);
+    poll(tracker, 1000, follow);
+    ok &= check(follow ? "idle, polled at the idle rate" : "idle, polled every 1 ms", tracker.isImuIdle());
+    uint64_t before = tracker.getImuBusMicrosFreed();
+    bus[follow] = poll(tracker, 1000, follow);
+    freed[follow] = tracker.getImuBusMicrosFreed() - before;
+  }
+  Serial.printf("  bus per s: %.1f ms at 1 kHz, idle %.1f ms polled every 1 ms, %.1f ms at 100 Hz\n",
+    fullBus * 1e-3, bus[0] * 1e-3, bus[1] * 1e-3);
+  Serial.printf("  freed per s: %.1f ms and %.1f ms reported\n", freed[0] * 1e-3, freed[1] * 1e-3);
+  bool measured = true;
+  for (int follow = 0; follow < 2; follow++) {
+    double saved = double(fullBus) - double(bus[follow]);
+    measured &= fabs(double(freed[follow]) - saved) < 0.05 * fullBus;
+  }
+  ok &= check("the freed bus time is what the reads saved", measured);
+  ok &= check("a tenth of the bus time at the idle rate", bus[1] * 9 < fullBus);
+
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  bool ok = testIdle(mpu);
+  ok &= testPolling(mpu);
+  mpu.detach();
+
+  Serial.println(ok ? "imu idle: all passed" : "imu idle: FAILED");
+  return ok ? 0 : 1;
+
+}
@@ -0,0 +1,208 @@
+/**
+ * Host check of the AK8963 magnetometer behind the auxiliary I2C master
+ * of the imu, see Imu::enableMagnetometer()
+ *
+ * - setup through SLV4 on the HostMpu9250 model: the master is on, the
+ *   bypass off, the AK8963 measures at 100 Hz, and the sensitivity
+ *   adjustment goes into the scales
+ * - polled reads carry the field in uT along the imu axes, a new
+ *   measurement every 10 samples, in the same transactions per sample
+ *   as without the magnetometer, over I2C and over SPI
+ * - a magnetometer that does not answer is left off, with the bypass
+ * - OrientationTracker with a gyro bias on the yaw axis: the yaw of
+ *   every estimator drifts without the magnetometer, and stays within
+ *   a degree or two with it
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostImuBus.h"
+#include "HostMpu9250.h"
+#include "ImuCapture.h"
+#include "OrientationTracker.h"
+
+static const uint8_t csPin = 10;
+
+/* field in uT along the imu axes, horizontal along x and z when level */
+static const float field[3] = {20.0f, -40.0f, 5.0f};
+
+/**
+ * polls readRaw() back to back for a second, each read is shorter than a
+ * sample period, so none is missed
+ * @param [out] transactionsPerRead - Wire transactions per poll and per
+ *   sample read: back to back the polls read INT_STATUS alone, and each
+ *   sample its data, see Imu::setStatusBurst()
+ * @param [out] near - true if all measurements are within a count of field
+ * @returns number of samples with a new magnetometer measurement
+ */
+static int pollMag(Imu& imu, double& transactionsPerRead, bool& near) {
+
+  ImuSample sample;
+  int polls = 0;
+  int samples = 0;
+  int measurements = 0;
+  near = true;
+  uint32_t transactions = Wire.hostTransactions();
+  uint32_t start = micros();
+  while (micros() - start < 1000000) {
+    polls++;
+    bool read = imu.readRaw(sample);
+    samples += read ? 1 : 0;
+    if (read && sample.magReady) {
+      measurements++;
+      for (int k = 0; k < 3; k++) {
+        near &= fabs(sample.mag[k] * double(imu.magScale[k]) - field[k]) <= double(imu.magScale[k]);
+      }
+    }
+  }
+  transactionsPerRead = double(Wire.hostTransactions() - transactions) / (polls + samples);
+  return measurements;
+
+}
+
+static bool testSetup(HostMpu9250& mpu) {
+
+  Serial.println("setup:");
+  bool ok = true;
+
+  Imu imu;
+  imu.init();
+  double plainPerRead;
+  bool near;
+  pollMag(imu, plainPerRead, near);
+
+  uint32_t start = micros();
+  ok &= check("the AK8963 answers", imu.enableMagnetometer(true) && imu.hasMagnetometer());
+  Serial.printf("  setup takes %u us\n", (unsigned)(micros() - start));
+  ok &= check("the master is on and the bypass off",
+    (mpu.reg(0x6A) & 0x20) != 0 && (mpu.reg(0x37) & 0x02) == 0);
+  ok &= check("continuous measurement at 100 Hz in 16 bit", mpu.magReg(0x0A) == 0x16);
+  ok &= check("SLV0 mirrors ST1 to ST2", mpu.reg(0x25) == 0x8C && mpu.reg(0x26) == 0x02 &&
+    mpu.reg(0x27) == 0x88);
+  // imu x is AK8963 y
+  double adjustment = (mpu.magReg(0x11) - 128) / 256.0 + 1;
+  ok &= check("the sensitivity adjustment is in the scales",
+    fabs(double(imu.magScale[0]) - 4912.0 / 32767.0 * adjustment) < 1e-6);
+
+  Serial.println("reads:");
+  double magPerRead;
+  uint32_t taken = mpu.getMagSamplesTaken();
+  int measurements = pollMag(imu, magPerRead, near);
+  taken = mpu.getMagSamplesTaken() - taken;
+  Serial.printf("  I2C: %d of %u measurements, %.2f transactions per poll and sample, %.2f without\n",
+    measurements, (unsigned)taken, magPerRead, plainPerRead);
+  ok &= check("every measurement is read once, at 100 Hz",
+    abs(measurements - (int)taken) <= 1 && measurements >= 99 && measurements <= 101);
+  ok &= check("the field along the imu axes, in uT", near);
+  ok &= check("no transactions added", magPerRead == plainPerRead);
+
+  // past a measurement, and the samples after it
+  for (int i = 0; i < 25; i++) {
+    delay(1);
+    imu.read();
+  }
+  ok &= check("read() converts the field, and keeps it in between",
+    fabs(double(imu.magX) - field[0]) < 0.2 && fabs(double(imu.magY) - field[1]) < 0.2 &&
+    fabs(double(imu.magZ) - field[2]) < 0.2);
+
+  // the same over SPI, the bypass never reached the AK8963 there
+  mpu.attachSpi(csPin);
+  ImuBusSpi spi(csPin);
+  Imu imuSpi;
+  imuSpi.setBus(&spi);
+  imuSpi.init();
+  ok &= check("the AK8963 answers over SPI", imuSpi.enableMagnetometer(true));
+  ok &= check("with I2C_IF_DIS kept", mpu.reg(0x6A) == 0x30);
+  double spiPerRead;
+  measurements = pollMag(imuSpi, spiPerRead, near);
+  ok &= check("and the field reads the same", measurements >= 99 && near);
+
+  ok &= check("turned off, the bypass is back", imuSpi.enableMagnetometer(false) &&
+    !imuSpi.hasMagnetometer() && mpu.reg(0x6A) == 0x10 && mpu.reg(0x37) == 0x02);
+  SPI.hostAttachDevice(csPin, nullptr);
+
+  return ok;
+
+}
+
+static bool testMissing() {
+
+  Serial.println("no answer:");
+  bool ok = true;
+
+  // the model runs no samples straight on the register bus, so the
+  // master never ends a transfer
+  HostMpu9250 model(IMU_INTERRUPT_PIN);
+  HostRegisterBus bus(&model);
+  Imu imu;
+  imu.setBus(&bus);
+  imu.init();
+  ok &= check("enableMagnetometer() fails", !imu.enableMagnetometer(true));
+  ok &= check("and leaves it off, with the bypass",
+    !imu.hasMagnetometer() && (model.reg(0x6A) & 0x20) == 0 && model.reg(0x37) == 0x02);
+
+  return ok;
+
+}
+
+/* world heading of the imu x axis, degrees about up */
+static double yawOf(const Quaternion& q) {
+  Scalar x[3] = {1, 0, 0};
+  Scalar w[3];
+  q.rotateVector(x, w);
+  return atan2(-double(w[2]), double(w[0])) * RAD_TO_DEG;
+}
+
+/* yaw after 20000 polls at rest, 1 ms of other work apart, with a 1 deg/s yaw rate left */
+static double yawDrift(EstimatorType type, double magFilterAlpha) {
+
+  OrientationTracker tracker(0.99, false, type);
+  tracker.initImu();
+  tracker.initImuMagnetometer(magFilterAlpha);
+  for (int i = 0; i < 20000; i++) {
+    delay(1);
+    tracker.processImu();
+  }
+  return yawOf(tracker.getQuaternionComp());
+
+}
+
+static bool testYaw(HostMpu9250& mpu) {
+
+  Serial.println("yaw, 1 deg/s of gyro bias about up:");
+  bool ok = true;
+
+  // level, the gyro reads a yaw rate the bias does not remove
+  static const float script[6] = {0, 1.0f, 0, 0, 9.80665f, 0};
+  mpu.setSamples(script, 1);
+
+  for (int type = 0; type < ESTIMATOR_COUNT; type++) {
+    double without = yawDrift(EstimatorType(type), 1.0);
+    double with = yawDrift(EstimatorType(type), 0.99);
+    Serial.printf("  %-8s without %6.2f deg, with the magnetometer %5.2f deg\n",
+      estimatorName(EstimatorType(type)), without, with);
+    ok &= check("drifts without, held with the magnetometer",
+      fabs(without) > 15 && fabs(with) < 2);
+  }
+
+  mpu.setSamples(imuData, nImuSamples / 6);
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.setMagField(field[0], field[1], field[2]);
+  mpu.attach();
+  bool ok = testSetup(mpu);
+  ok &= testYaw(mpu);
+  mpu.detach();
+
+  ok &= testMissing();
+
+  Serial.println(ok ? "imu magnetometer: all passed" : "imu magnetometer: FAILED");
+  return ok ? 0 : 1;
+
+}
@@ -0,0 +1,371 @@
+/**
+ * Host model of the MPU9250, see HostMpu9250.h
+ */
+
+#include "HostMpu9250.h"
+#include "simulatedImuData.h"
+
+#define SMPLRT_DIV   0x19
+#define CONFIG       0x1A
+#define GYRO_CONFIG  0x1B
+#define ACCEL_CONFIG 0x1C
+#define FIFO_EN      0x23
+#define I2C_SLV0_ADDR 0x25
+#define I2C_SLV0_REG  0x26
+#define I2C_SLV0_CTRL 0x27
+#define I2C_SLV4_ADDR 0x31
+#define I2C_SLV4_REG  0x32
+#define I2C_SLV4_DO   0x33
+#define I2C_SLV4_CTRL 0x34
+#define I2C_SLV4_DI   0x35
+#define I2C_MST_STATUS 0x36
+#define INT_PIN_CFG  0x37
+#define INT_ENABLE   0x38
+#define INT_STATUS   0x3A
+#define ACCEL_XOUT_H 0x3B
+#define EXT_SENS_DATA_00 0x49
+#define USER_CTRL    0x6A
+#define FIFO_COUNTH  0x72
+#define FIFO_COUNTL  0x73
+#define FIFO_R_W     0x74
+#define WHO_AM_I     0x75
+
+/* the AK8963 */
+#define AK8963_ADDRESS 0x0C
+#define AK8963_WIA   0x00
+#define AK8963_ST1   0x02
+#define AK8963_HXL   0x03
+#define AK8963_ST2   0x09
+#define AK8963_CNTL1 0x0A
+#define AK8963_ASAX  0x10
+
+HostMpu9250::HostMpu9250(uint8_t intPinIn) :
+  intPin(intPinIn),
+  regs(),
+  pointer(0),
+  csPin(-1),
+  spiAddressNext(false),
+  spiReading(false),
+  samples(imuData),
+  nSamples(nImuSamples / 6),
+  sampleIndex(0),
+  fifo(),
+  fifoHead(0),
+  fifoCount(0),
+  samplesTaken(0),
+  lastSampleTime(0),
+  ak(),
+  magField{20.0f, -40.0f, 5.0f},
+  magSamplesTaken(0),
+  lastMagSampleTime(0),
+  temperature(21.0f),
+  gyrTempDrift{0, 0, 0}
+{
+  regs[WHO_AM_I] = 0x71;
+  ak[AK8963_WIA] = 0x48;
+  // sensitivity adjustments, (ASA - 128) / 256 + 1
+  ak[AK8963_ASAX] = 176;
+  ak[AK8963_ASAX + 1] = 178;
+  ak[AK8963_ASAX + 2] = 166;
+}
+
+void HostMpu9250::attach() {
+  samplesTaken = 0;
+  lastSampleTime = hostMicros64();
+  magSamplesTaken = 0;
+  lastMagSampleTime = lastSampleTime;
+  Wire.attachDevice(address, this);
+  hostAttachTimedDevice(this);
+}
+
+void HostMpu9250::attachSpi(uint8_t csPinIn) {
+  csPin = csPinIn;
+  SPI.hostAttachDevice(csPinIn, this);
+}
+
+void HostMpu9250::detach() {
+  Wire.attachDevice(address, nullptr);
+  if (csPin >= 0) {
+    SPI.hostAttachDevice(csPin, nullptr);
+    csPin = -1;
+  }
+  hostDetachTimedDevice(this);
+}
+
+void HostMpu9250::setSamples(const float *data, int n) {
+  samples = data;
+  nSamples = n;
+  sampleIndex = 0;
+}
+
+void HostMpu9250::setMagField(float x, float y, float z) {
+  magField[0] = x;
+  magField[1] = y;
+  magField[2] = z;
+}
+
+void HostMpu9250::setGyrTempDrift(float x, float y, float z) {
+  gyrTempDrift[0] = x;
+  gyrTempDrift[1] = y;
+  gyrTempDrift[2] = z;
+}
+
+uint32_t HostMpu9250::samplePeriod() const {
+  // DLPF_CFG 0 and 7 sample the gyro at 8 kHz, SMPLRT_DIV does not apply
+  uint8_t dlpf = regs[CONFIG] & 7;
+  if (dlpf == 0 || dlpf == 7) {
+    return 125;
+  }
+  return 1000u * (1u + regs[SMPLRT_DIV]);
+}
+
+void HostMpu9250::i2cWrite(const uint8_t *data, int n) {
+  if (n < 1) {
+    return;
+  }
+  pointer = data[0] & 0x7F;
+  for (int i = 1; i < n; i++) {
+    if (pointer == USER_CTRL && (data[i] & 0x04)) {
+      // FIFO_RST, self-clearing
+      fifoHead = 0;
+      fifoCount = 0;
+      regs[pointer] = data[i] & ~0x04;
+    } else if (pointer == FIFO_R_W) {
+      pushFifo(data[i]);
+      continue;
+    } else {
+      regs[pointer] = data[i];
+    }
+    pointer = (pointer + 1) & 0x7F;
+  }
+}
+
+int HostMpu9250::i2cRead(uint8_t *data, int n) {
+  bool clearStatus = (regs[INT_PIN_CFG] & 0x10) != 0;
+  bool clearMasterStatus = false;
+  for (int i = 0; i < n; i++) {
+    if (pointer == INT_STATUS) {
+      clearStatus = true;
+    }
+    if (pointer == I2C_MST_STATUS) {
+      clearMasterStatus = true;
+    }
+    if (pointer == FIFO_R_W) {
+      // pops without moving the pointer, an empty FIFO reads 0xFF
+      if (fifoCount > 0) {
+        data[i] = fifo[fifoHead];
+        fifoHead = (fifoHead + 1) % 512;
+        fifoCount--;
+      } else {
+        data[i] = 0xFF;
+      }
+      continue;
+    }
+    if (pointer == FIFO_COUNTH) {
+      data[i] = (uint8_t)(fifoCount >> 8);
+    } else if (pointer == FIFO_COUNTL) {
+      data[i] = (uint8_t)(fifoCount & 0xFF);
+    } else {
+      data[i] = regs[pointer];
+    }
+    pointer = (pointer + 1) & 0x7F;
+  }
+  if (clearStatus) {
+    regs[INT_STATUS] &= ~0x01;
+  }
+  if (clearMasterStatus) {
+    regs[I2C_MST_STATUS] = 0;
+  }
+  return n;
+}
+
+void HostMpu9250::spiSelect() {
+  spiAddressNext = true;
+}
+
+uint8_t HostMpu9250::spiTransfer(uint8_t mosi) {
+  if (spiAddressNext) {
+    spiAddressNext = false;
+    spiReading = (mosi & 0x80) != 0;
+    pointer = mosi & 0x7F;
+    return 0;
+  }
+  if (spiReading) {
+    uint8_t value;
+    i2cRead(&value, 1);
+    return value;
+  }
+  // a register write, at the pointer as it advanced
+  uint8_t data[2] = {pointer, mosi};
+  i2cWrite(data, 2);
+  return 0;
+}
+
+uint64_t HostMpu9250::hostNextEvent() {
+  return lastSampleTime + samplePeriod();
+}
+
+void HostMpu9250::hostEvent() {
+  lastSampleTime += samplePeriod();
+  takeSample();
+  takeMagSample();
+  if (regs[USER_CTRL] & 0x20) {
+    runAuxMaster();
+  }
+  if (regs[USER_CTRL] & 0x40) {
+    writeFifo();
+  }
+  regs[INT_STATUS] |= 0x01;
+  if (regs[INT_ENABLE] & 0x01) {
+    hostRaiseInterrupt(intPin);
+  }
+}
+
+/* big endian 16 bit count of value at full scale range, saturated */
+static void putCount(uint8_t *r, double value, double fullScale) {
+  long count = lround(value / fullScale * 32767.0);
+  if (count > 32767) {
+    count = 32767;
+  } else if (count < -32768) {
+    count = -32768;
+  }
+  r[0] = (uint8_t)((count >> 8) & 0xFF);
+  r[1] = (uint8_t)(count & 0xFF);
+}
+
+void HostMpu9250::takeSample() {
+
+  const float *s = &samples[6 * sampleIndex];
+  sampleIndex = (sampleIndex + 1) % nSamples;
+  samplesTaken++;
+
+  // FS_SEL bits 4:3, 250 dps and 2 g times 2^FS_SEL
+  double gyrFullScale = 250.0 * (1 << ((regs[GYRO_CONFIG] >> 3) & 3));
+  double accFullScale = 9.80665 * 2.0 * (1 << ((regs[ACCEL_CONFIG] >> 3) & 3));
+
+  uint8_t *r = &regs[ACCEL_XOUT_H];
+  for (int i = 0; i < 3; i++) {
+    putCount(&r[2 * i], s[3 + i], accFullScale);
+    putCount(&r[8 + 2 * i], s[i] + gyrTempDrift[i] * (temperature - 21.0), gyrFullScale);
+  }
+  // temperature, 333.87 counts per degree C from 21
+  putCount(&r[6], (temperature - 21.0) * 333.87, 32767.0);
+
+}
+
+void HostMpu9250::pushFifo(uint8_t value) {
+  if (fifoCount == 512) {
+    // overwrite the oldest byte
+    fifoHead = (fifoHead + 1) % 512;
+    fifoCount--;
+    regs[INT_STATUS] |= 0x10;
+  }
+  fifo[(fifoHead + fifoCount) % 512] = value;
+  fifoCount++;
+}
+
+void HostMpu9250::writeFifo() {
+
+  // 16 bit outputs in register order, with their FIFO_EN bits:
+  // acc x, y, z (bit 3), temperature (7), gyro x (6), y (5), z (4)
+  static const uint8_t bits[7] = {0x08, 0x08, 0x08, 0x80, 0x40, 0x20, 0x10};
+  uint8_t enabled = regs[FIFO_EN];
+  int bytes = 0;
+  for (int i = 0; i < 7; i++) {
+    if (enabled & bits[i]) {
+      bytes += 2;
+    }
+  }
+
+  if ((regs[CONFIG] & 0x40) && fifoCount + bytes > 512) {
+    // FIFO_MODE: drop new samples when full
+    regs[INT_STATUS] |= 0x10;
+    return;
+  }
+
+  for (int i = 0; i < 7; i++) {
+    if (enabled & bits[i]) {
+      pushFifo(regs[ACCEL_XOUT_H + 2 * i]);
+      pushFifo(regs[ACCEL_XOUT_H + 2 * i + 1]);
+    }
+  }
+
+}
+
+void HostMpu9250::runAuxMaster() {
+
+  if (regs[I2C_SLV4_CTRL] & 0x80) {
+    uint8_t slaveAddress = regs[I2C_SLV4_ADDR];
+    if ((slaveAddress & 0x7F) != AK8963_ADDRESS) {
+      regs[I2C_MST_STATUS] |= 0x10;
+    } else if (slaveAddress & 0x80) {
+      regs[I2C_SLV4_DI] = readMag(regs[I2C_SLV4_REG]);
+    } else {
+      writeMag(regs[I2C_SLV4_REG], regs[I2C_SLV4_DO]);
+    }
+    // a single transfer, SLV4_EN clears itself
+    regs[I2C_SLV4_CTRL] &= ~0x80;
+    regs[I2C_MST_STATUS] |= 0x40;
+  }
+
+  uint8_t ctrl = regs[I2C_SLV0_CTRL];
+  uint8_t slaveAddress = regs[I2C_SLV0_ADDR];
+  if ((ctrl & 0x80) && slaveAddress == (0x80 | AK8963_ADDRESS)) {
+    int n = ctrl & 0x0F;
+    for (int i = 0; i < n && EXT_SENS_DATA_00 + i < 0x61; i++) {
+      regs[EXT_SENS_DATA_00 + i] = readMag(regs[I2C_SLV0_REG] + i);
+    }
+  }
+
+}
+
+uint8_t HostMpu9250::readMag(uint8_t r) {
+  r &= 0x1F;
+  uint8_t value = ak[r];
+  if (r == AK8963_ST2) {
+    // reading ST2 ends the read of a measurement
+    ak[AK8963_ST1] &= ~0x01;
+  }
+  return value;
+}
+
+void HostMpu9250::writeMag(uint8_t r, uint8_t value) {
+  if ((r & 0x1F) == AK8963_CNTL1) {
+    ak[AK8963_CNTL1] = value;
+  }
+}
+
+void HostMpu9250::takeMagSample() {
+
+  // MODE bits 3:0, continuous measurement 1 at 8 Hz and 2 at 100 Hz
+  uint8_t mode = ak[AK8963_CNTL1] & 0x0F;
+  uint32_t period;
+  if (mode == 0x02) {
+    period = 125000;
+  } else if (mode == 0x06) {
+    period = 10000;
+  } else {
+    lastMagSampleTime = lastSampleTime;
+    return;
+  }
+  if (lastSampleTime < lastMagSampleTime + period) {
+    return;
+  }
+  lastMagSampleTime += period;
+  magSamplesTaken++;
+
+  // 0.15 uT per count in 16 bit output, BIT 4 of CNTL1, divided by the
+  // sensitivity adjustment the driver multiplies with
+  double uTPerCount = (ak[AK8963_CNTL1] & 0x10) ? 4912.0 / 32767.0 : 4 * 4912.0 / 32767.0;
+  double field[3] = {magField[1], magField[0], -magField[2]};
+  for (int i = 0; i < 3; i++) {
+    double adjustment = (ak[AK8963_ASAX + i] - 128) / 256.0 + 1;
+    long count = lround(field[i] / (uTPerCount * adjustment));
+    ak[AK8963_HXL + 2 * i] = (uint8_t)(count & 0xFF);
+    ak[AK8963_HXL + 2 * i + 1] = (uint8_t)((count >> 8) & 0xFF);
+  }
+  // BITM in ST2 mirrors the output width
+  ak[AK8963_ST2] = ak[AK8963_CNTL1] & 0x10;
+  ak[AK8963_ST1] |= 0x01;
+
+}
@@ -0,0 +1,174 @@
+/**
+ * Host model of the MPU9250 gyro and accelerometer
+ *
+ * Answers on the I2C bus like the real chip for the registers Imu uses:
+ * a register file with auto-incrementing reads and writes, WHO_AM_I, and
+ * the data registers 0x3B-0x48. Attached with attachSpi(), it answers on
+ * the SPI bus as well, with the same registers: the first byte of a frame
+ * is the register, bit 7 set for a read, then the data bytes. As a HostTimedDevice it takes a new
+ * sample every sample period of the virtual clock, 1 kHz / (1 +
+ * SMPLRT_DIV) as with the DLPF on, or 8 kHz with DLPF_CFG 0 or 7 in
+ * CONFIG, FCHOICE_B is not modeled, and then
+ * - sets the data ready bit of INT_STATUS, cleared by reading INT_STATUS,
+ *   or by any read with INT_ANYRD_2CLEAR set in INT_PIN_CFG
+ * - pulses the INT pin, i.e. calls hostRaiseInterrupt(), if RAW_RDY_EN
+ *   is set in INT_ENABLE
+ *
+ * With FIFO_EN in USER_CTRL set, each sample also appends the outputs
+ * selected in the FIFO_EN register to the 512 byte FIFO, in register
+ * order. FIFO_COUNTH/L read the fill level, and reads of FIFO_R_W pop
+ * bytes without advancing the register pointer. A full FIFO overwrites
+ * its oldest bytes and sets FIFO_OFLOW_INT in INT_STATUS, unless
+ * FIFO_MODE in CONFIG is set, then new samples are not written.
+ * FIFO_RST in USER_CTRL clears it.
+ *
+ * The AK8963 magnetometer sits behind the auxiliary I2C master, at 0x0C,
+ * with WIA, ST1, the little endian data, ST2, CNTL1 and the sensitivity
+ * adjustment ASA. With I2C_MST_EN in USER_CTRL set, each sample first
+ * runs an enabled SLV4 transfer, one byte read into SLV4_DI or written
+ * from SLV4_DO, setting SLV4_DONE, or SLV4_NACK for another address, in
+ * I2C_MST_STATUS, cleared by reading it. Then an enabled SLV0 read
+ * copies its bytes into EXT_SENS_DATA from 0x49. In the continuous
+ * modes of CNTL1, 8 Hz and 100 Hz, the AK8963 measures the field set
+ * with setMagField() and sets DRDY in ST1 until ST2 is read. It is not
+ * on the bus of the Teensy, the bypass is not modeled.
+ *
+ * The samples are the gyro (deg/s) and acc (m/s^2) rows of
+ * simulatedImuData.h by default, converted to counts at the full scale
+ * ranges set in GYRO_CONFIG and ACCEL_CONFIG, and replayed in a loop.
+ * TEMP_OUT is the die temperature set with setTemperature(), 21 degrees C
+ * by default, and the gyro drifts from the samples by the degrees per
+ * second per degree C set with setGyrTempDrift() away from 21.
+ */
+
+#ifndef HOST_MPU9250_H
+#define HOST_MPU9250_H
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "Wire.h"
+
+class HostMpu9250 : public HostI2CDevice, public HostSpiDevice, public HostTimedDevice {
+public:
+
+  static const int address = 0x68;
+
+  /**
+   * @param [in] intPin - Teensy pin the INT line is wired to
+   */
+  explicit HostMpu9250(uint8_t intPin);
+
+  /* attaches the model to Wire and to the virtual clock */
+  void attach();
+
+  /* attaches the model to SPI as well, at a chip select pin */
+  void attachSpi(uint8_t csPin);
+
+  /* detaches the model from the buses and the clock */
+  void detach();
+
+  /**
+   * replaces the sample data
+   * @param [in] data - rows of gyro x, y, z in deg/s and acc x, y, z in m/s^2
+   * @param [in] nSamples - number of rows
+   */
+  void setSamples(const float *data, int nSamples);
+
+  /**
+   * sets the field the magnetometer measures, in uT along the imu axes,
+   * i.e. AK8963 x along imu y, y along imu x and z against imu z
+   */
+  void setMagField(float x, float y, float z);
+
+  /* sets the die temperature, in degrees C */
+  void setTemperature(float celsius) { temperature = celsius; }
+
+  /* sets the gyro drift, deg/s per degree C above 21, order x, y, z */
+  void setGyrTempDrift(float x, float y, float z);
+
+  /* number of magnetometer measurements taken since attach() */
+  uint32_t getMagSamplesTaken() const { return magSamplesTaken; }
+
+  /* AK8963 register access for tests */
+  uint8_t magReg(int r) const { return ak[r & 0x1F]; }
+
+  /* number of samples taken since attach() */
+  uint32_t getSamplesTaken() const { return samplesTaken; }
+
+  /* virtual time of the latest sample in us */
+  uint64_t getLastSampleTime() const { return lastSampleTime; }
+
+  /* bytes in the FIFO */
+  int getFifoCount() const { return fifoCount; }
+
+  /* register access for tests */
+  uint8_t reg(int r) const { return regs[r & 0x7F]; }
+
+  // HostI2CDevice
+  virtual void i2cWrite(const uint8_t *data, int n);
+  virtual int i2cRead(uint8_t *data, int n);
+
+  // HostSpiDevice
+  virtual void spiSelect();
+  virtual uint8_t spiTransfer(uint8_t mosi);
+  virtual void spiDeselect() {}
+
+  // HostTimedDevice
+  virtual uint64_t hostNextEvent();
+  virtual void hostEvent();
+
+private:
+
+  /* sample period in us from SMPLRT_DIV */
+  uint32_t samplePeriod() const;
+
+  /* loads the next sample into the data registers */
+  void takeSample();
+
+  /* appends the enabled outputs to the FIFO */
+  void writeFifo();
+
+  void pushFifo(uint8_t value);
+
+  /* the SLV4 and SLV0 transfers of the auxiliary I2C master */
+  void runAuxMaster();
+
+  /* AK8963 register access through the auxiliary master */
+  uint8_t readMag(uint8_t r);
+  void writeMag(uint8_t r, uint8_t value);
+
+  /* a new AK8963 measurement, if its mode has one due */
+  void takeMagSample();
+
+  uint8_t intPin;
+  uint8_t regs[128];
+  uint8_t pointer;
+
+  /* SPI chip select, and the state of the frame */
+  int csPin;
+  bool spiAddressNext;
+  bool spiReading;
+
+  const float *samples;
+  int nSamples;
+  int sampleIndex;
+
+  uint8_t fifo[512];
+  int fifoHead;
+  int fifoCount;
+
+  uint32_t samplesTaken;
+  uint64_t lastSampleTime;
+
+  /* AK8963 registers, field in uT along the imu axes, and measurements */
+  uint8_t ak[0x20];
+  float magField[3];
+  uint32_t magSamplesTaken;
+  uint64_t lastMagSampleTime;
+
+  /* die temperature in degrees C, and the gyro drift per degree */
+  float temperature;
+  float gyrTempDrift[3];
+};
+
+#endif // ifndef HOST_MPU9250_H
@@ -0,0 +1,135 @@
+/**
+ * Host check of the cycles per stage, see Profiler.h, built with
+ * VRDUINO_PROFILE on the steady_clock backend
+ *
+ * - min, max, mean and the log2 histogram of known runs, none before
+ *   begin()
+ * - every stage is recorded where it runs: the imu reads and the
+ *   orientation steps on the HostMpu9250 model, a lighthouse edge through
+ *   ftm0_isr(), readTimings() per poll, and the pose stages per solve of
+ *   the simulated lighthouse
+ * - the host times are ns of the PC, each stage's histogram holds all its
+ *   runs
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "PoseTracker.h"
+#include "Profiler.h"
+
+static bool testTable() {
+
+  Serial.println("table:");
+  bool ok = true;
+
+  Profiler::record(PROFILE_SERIAL, 100);
+  ok &= check("nothing recorded before begin()", Profiler::count(PROFILE_SERIAL) == 0);
+
+  Profiler::begin();
+  static const uint32_t runs[5] = {0, 1, 1000, 1023, 1024};
+  for (int i = 0; i < 5; i++) {
+    Profiler::record(PROFILE_SERIAL, runs[i]);
+  }
+  ok &= check("min, max and mean",
+    Profiler::count(PROFILE_SERIAL) == 5 && Profiler::minCycles(PROFILE_SERIAL) == 0 &&
+    Profiler::maxCycles(PROFILE_SERIAL) == 1024 &&
+    fabs(Profiler::meanCycles(PROFILE_SERIAL) - 609.6) < 1e-9);
+  ok &= check("bin k holds 2^k to 2^(k+1) - 1 cycles",
+    Profiler::histogram(PROFILE_SERIAL, 0) == 2 && Profiler::histogram(PROFILE_SERIAL, 9) == 2 &&
+    Profiler::histogram(PROFILE_SERIAL, 10) == 1);
+  Profiler::record(PROFILE_SERIAL, 0xFFFFFFFF);
+  ok &= check("the top bin holds the longest",
+    Profiler::histogram(PROFILE_SERIAL, Profiler::histogramBins - 1) == 1);
+
+  Profiler::reset();
+  ok &= check("reset() forgets all runs", Profiler::count(PROFILE_SERIAL) == 0);
+
+  return ok;
+
+}
+
+static bool testStages() {
+
+  Serial.println("stages:");
+  bool ok = true;
+
+  // the imu polled, on the model
+  OrientationTracker tracker(0.99, false);
+  tracker.initImu();
+  Profiler::reset();
+  uint32_t processed = tracker.getImuSamplesProcessed();
+  uint32_t steps = tracker.getImuEstimatorSteps();
+  for (int i = 0; i < 100; i++) {
+    tracker.processImu();
+    delay(1);
+  }
+  uint32_t reads = Profiler::count(PROFILE_IMU_READ);
+  processed = tracker.getImuSamplesProcessed() - processed;
+  Serial.printf("  %u imu reads, %u orientation steps\n",
+    (unsigned)reads, (unsigned)Profiler::count(PROFILE_ORIENTATION));
+  // the first sample only starts the clock of deltaT
+  ok &= check("an imu read per sample, an orientation per step",
+    reads >= processed && reads <= processed + 1 &&
+    Profiler::count(PROFILE_ORIENTATION) == tracker.getImuEstimatorSteps() - steps &&
+    Profiler::count(PROFILE_ORIENTATION) >= 99);
+
+  // a photodiode edge on pin 6, FTM0 channel 4, and polls for timings
+  PoseTracker lighthouse(0.99, 1, false);
+  FTM0_C4V = FTM0_CNT;
+  FTM0_C4SC |= FTM_CSC_CHF;
+  ftm0_isr();
+  for (int i = 0; i < 3; i++) {
+    lighthouse.processLighthouse();
+  }
+  ok &= check("the capture callback from ftm0_isr()", Profiler::count(PROFILE_LIGHTHOUSE_CAPTURE) == 1);
+  ok &= check("readTimings() per poll", Profiler::count(PROFILE_LIGHTHOUSE_READ) == 3);
+
+  // the pose of the simulated lighthouse
+  PoseTracker pose(0.99, 1, true);
+  int solves = 0;
+  while (solves < 50) {
+    if (pose.processLighthouse() > -2) {
+      solves++;
+    }
+    delay(1);
+  }
+  ok &= check("the pose stages per solve",
+    Profiler::count(PROFILE_TICKS_TO_2D) == 50 && Profiler::count(PROFILE_SOLVE_H) == 50 &&
+    Profiler::count(PROFILE_RT_FROM_H) <= 50 && Profiler::count(PROFILE_RT_FROM_H) > 0);
+
+  Profiler::print();
+
+  bool timed = Profiler::cyclesPerMicro() == 1000;
+  for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+    ProfileStage stage = ProfileStage(i);
+    uint32_t binned = 0;
+    for (int bin = 0; bin < Profiler::histogramBins; bin++) {
+      binned += Profiler::histogram(stage, bin);
+    }
+    timed &= binned == Profiler::count(stage);
+    if (Profiler::count(stage) > 0) {
+      timed &= Profiler::minCycles(stage) <= Profiler::meanCycles(stage) &&
+        Profiler::meanCycles(stage) <= Profiler::maxCycles(stage);
+    }
+  }
+  ok &= check("ns of the PC, every run in the histogram",
+    timed && Profiler::maxCycles(PROFILE_SOLVE_H) > 0);
+
+  return ok;
+
+}
+
+int main() {
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  bool ok = testTable();
+  ok &= testStages();
+  mpu.detach();
+
+  Serial.println(ok ? "profiler: all passed" : "profiler: FAILED");
+  return ok ? 0 : 1;
+
+}
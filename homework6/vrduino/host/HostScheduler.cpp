@@ -0,0 +1,274 @@
+/**
+ * Host check of the cooperative scheduler of vrduino.ino, see Scheduler.h,
+ * on the virtual clock
+ *
+ * - a periodic task runs once per period, within its deadline, and the
+ *   core sleeps in between
+ * - of the tasks released together, the lowest priority value runs
+ *   first, and of equal priority the earliest deadline
+ * - an event task runs once per event, and not while disabled. One that
+ *   comes after runOnce() found nothing is seen by CpuIdle::sleepUnless()
+ *   instead of slept through
+ * - a task of 3 ms holds a 1 ms task off: its missed deadlines and
+ *   skipped periods, and the run time, are counted
+ * - the tasks of vrduino.ino on the HostMpu9250 model with the interrupt
+ *   capture and the simulated lighthouse: every imu sample integrated on
+ *   time, the lighthouse solved 120 times a second and the telemetry at
+ *   its rate. The imu task polls at the sample period of the imu, also
+ *   at its idle rate while still
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "CpuIdle.h"
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "PoseTracker.h"
+#include "Scheduler.h"
+
+/* the order the tasks ran in, as their letters */
+static char order[16];
+static int orderCount = 0;
+
+static void ran(char c) {
+  if (orderCount < int(sizeof(order)) - 1) {
+    order[orderCount++] = c;
+    order[orderCount] = 0;
+  }
+}
+
+static void taskA() { ran('a'); }
+static void taskB() { ran('b'); }
+static void taskC() { ran('c'); }
+static void taskLong() { delayMicroseconds(3000); }
+static void taskNothing() {}
+
+static bool event = false;
+static void eventTask() { event = false; ran('e'); }
+static bool eventReady() { return event; }
+
+/* the scheduler of run(), for the check of CpuIdle::sleepUnless() */
+static Scheduler *running = nullptr;
+static bool released() { return running->hasReleased(); }
+
+/* runOnce() or sleep for ms, like loop() of vrduino.ino */
+static void run(Scheduler& scheduler, uint32_t ms) {
+  running = &scheduler;
+  uint32_t end = millis() + ms;
+  while (millis() < end) {
+    if (!scheduler.runOnce()) {
+      CpuIdle::sleepUnless(released);
+    }
+  }
+}
+
+static bool testPeriodic() {
+
+  Serial.println("periodic:");
+  bool ok = true;
+
+  Scheduler scheduler;
+  int task = scheduler.addPeriodic("a", taskNothing, 1000, 1000, 0);
+  CpuIdle::reset();
+  uint64_t start = hostMicros64();
+  run(scheduler, 1000);
+  const Scheduler::Task& t = scheduler.getTask(task);
+  double asleep = double(CpuIdle::sleptMicros()) / double(hostMicros64() - start);
+  Serial.printf("  %u runs, %u missed, %.1f%% asleep\n",
+    (unsigned)t.runs, (unsigned)t.missed, 100 * asleep);
+  ok &= check("once per ms, within its deadline",
+    t.runs >= 999 && t.runs <= 1001 && t.missed == 0);
+  ok &= check("asleep in between", asleep > 0.9);
+
+  scheduler.setPeriod(task, 10000);
+  run(scheduler, 1);
+  scheduler.resetCounters();
+  run(scheduler, 1000);
+  ok &= check("at 100 Hz after setPeriod", t.runs >= 99 && t.runs <= 101 && t.missed == 0);
+
+  return ok;
+
+}
+
+static bool testOrder() {
+
+  Serial.println("order:");
+  bool ok = true;
+
+  // all released at once
+  Scheduler scheduler;
+  scheduler.addPeriodic("c", taskC, 1000, 1000, 2);
+  scheduler.addPeriodic("b", taskB, 1000, 900, 1);
+  scheduler.addPeriodic("a", taskA, 1000, 500, 1);
+  orderCount = 0;
+  while (scheduler.runOnce()) {
+  }
+  Serial.printf("  ran %s\n", order);
+  ok &= check("lowest priority value first, then earliest deadline",
+    strcmp(order, "abc") == 0);
+
+  // an event
+  scheduler.addEvent("e", eventTask, eventReady, 1000, 0);
+  orderCount = 0;
+  delay(1);
+  event = true;
+  while (scheduler.runOnce()) {
+  }
+  ok &= check("an event of priority 0 runs before the periodic ones",
+    strcmp(order, "eabc") == 0);
+  orderCount = 0;
+  run(scheduler, 5);
+  ok &= check("and once per event", strchr(order, 'e') == nullptr);
+
+  scheduler.setEnabled(3, false);
+  event = true;
+  orderCount = 0;
+  run(scheduler, 2);
+  bool held = strchr(order, 'e') == nullptr;
+  scheduler.setEnabled(3, true);
+  orderCount = 0;
+  scheduler.runOnce();
+  ok &= check("not while disabled", held && order[0] == 'e' && !event);
+
+  // an event after runOnce() found nothing, as from an ISR before the sleep
+  while (scheduler.runOnce()) {
+  }
+  running = &scheduler;
+  event = true;
+  uint64_t before = hostMicros64();
+  uint32_t sleeps = CpuIdle::sleeps();
+  bool slept = CpuIdle::sleepUnless(released);
+  ok &= check("an event before the sleep keeps the core awake",
+    !slept && CpuIdle::sleeps() == sleeps && hostMicros64() == before);
+  orderCount = 0;
+  scheduler.runOnce();
+  ok &= check("and runs next", order[0] == 'e' && !event);
+
+  return ok;
+
+}
+
+static bool testMissed() {
+
+  Serial.println("missed:");
+  bool ok = true;
+
+  Scheduler scheduler;
+  int fast = scheduler.addPeriodic("fast", taskNothing, 1000, 1000, 0);
+  int slow = scheduler.addPeriodic("slow", taskLong, 10000, 10000, 1);
+  run(scheduler, 1000);
+  scheduler.print();
+  const Scheduler::Task& f = scheduler.getTask(fast);
+  const Scheduler::Task& s = scheduler.getTask(slow);
+  ok &= check("a 3 ms task runs at 100 Hz within its deadline",
+    s.runs >= 99 && s.runs <= 101 && s.missed == 0);
+  ok &= check("the 1 ms task skips 2 periods behind each",
+    f.skipped >= 2 * (s.runs - 1) && f.skipped <= 2 * s.runs);
+  ok &= check("each skipped period is a missed deadline", f.missed == f.skipped);
+  ok &= check("run time 3 ms mean and max",
+    fabs(scheduler.meanRunMicros(slow) - 3000) < 1 &&
+    fabs(scheduler.maxRunMicros(slow) - 3000) < 1 && scheduler.maxRunMicros(fast) < 1);
+
+  return ok;
+
+}
+
+/* the tasks of vrduino.ino, counting instead of printing */
+static PoseTracker *tracker;
+static bool imuTrack = false;
+static int hmTrack = -2;
+static int imuPrints = 0;
+static int lighthouseSolves = 0;
+static int lighthousePrints = 0;
+
+static int imuTaskIndex = -1;
+static uint32_t imuPeriod = 0;
+static Scheduler *sketchScheduler;
+
+static void imuTask() {
+  imuTrack |= tracker->processImu();
+  uint32_t period = tracker->getImuSamplePeriodMicros();
+  if (period != imuPeriod) {
+    imuPeriod = period;
+    sketchScheduler->setPeriod(imuTaskIndex, imuPeriod);
+  }
+}
+static void lighthouseTask() { hmTrack = tracker->processLighthouse(); lighthouseSolves++; }
+static bool lighthouseReady() { return tracker->isLighthouseReady(); }
+static void imuTelemetryTask() { imuPrints += imuTrack ? 1 : 0; imuTrack = false; }
+static void lighthouseTelemetryTask() { lighthousePrints += hmTrack == 1 ? 1 : 0; hmTrack = -2; }
+
+static bool testSketch(HostMpu9250& mpu) {
+
+  Serial.println("sketch:");
+  bool ok = true;
+
+  PoseTracker pose(0.99, 1, true);
+  tracker = &pose;
+  pose.initImu();
+  pose.initImuInterrupt(IMU_INTERRUPT_PIN);
+
+  Scheduler scheduler;
+  sketchScheduler = &scheduler;
+  imuPeriod = pose.getImuSamplePeriodMicros();
+  imuTaskIndex = scheduler.addPeriodic("imu", imuTask, imuPeriod, imuPeriod, 0);
+  int imu = imuTaskIndex;
+  int lighthouse = scheduler.addEvent("lighthouse", lighthouseTask, lighthouseReady, 8333, 1);
+  scheduler.addPeriodic("qc", imuTelemetryTask, 10000, 10000, 3);
+  scheduler.addPeriodic("hm", lighthouseTelemetryTask, 50000, 50000, 3);
+  run(scheduler, 100);
+
+  scheduler.resetCounters();
+  lighthouseSolves = imuPrints = lighthousePrints = 0;
+  uint32_t processed = pose.getImuSamplesProcessed();
+  run(scheduler, 1000);
+  uint32_t samples = pose.getImuSamplesProcessed() - processed;
+  scheduler.print();
+  Serial.printf("  per s: %u imu samples, %d lighthouse solves, %d QC %d lighthouse prints\n",
+    (unsigned)samples, lighthouseSolves, imuPrints, lighthousePrints);
+  ok &= check("every imu sample, within 1 ms",
+    samples >= 999 && samples <= 1001 && scheduler.getTask(imu).missed == 0 &&
+    pose.getImuCapture().getMissed() == 0);
+  ok &= check("the lighthouse solved at 120 Hz",
+    lighthouseSolves >= 119 && lighthouseSolves <= 121 &&
+    scheduler.getTask(lighthouse).missed == 0);
+  ok &= check("telemetry at 100 Hz and 20 Hz",
+    imuPrints >= 99 && imuPrints <= 101 && lighthousePrints >= 19 && lighthousePrints <= 21);
+
+  // still, the imu samples at 100 Hz, and the task polls it at that rate
+  static const float still[6] = {0, 0, 0, 0, 0, 9.80665f};
+  static const float turning[6] = {0, 30.0f, 0, 0, 0, 9.80665f};
+  mpu.setSamples(still, 1);
+  pose.setImuIdleRate(true);
+  run(scheduler, 1000);
+  scheduler.resetCounters();
+  run(scheduler, 1000);
+  uint32_t idleRuns = scheduler.getTask(imu).runs;
+  mpu.setSamples(turning, 1);
+  run(scheduler, 20);
+  Serial.printf("  still: %u imu task runs per s\n", (unsigned)idleRuns);
+  ok &= check("the imu task follows the idle rate of the imu",
+    idleRuns >= 99 && idleRuns <= 101);
+  ok &= check("and its full rate again on motion",
+    !pose.isImuIdle() && imuPeriod == pose.getImuSamplePeriodMicros() && imuPeriod == 1000);
+  mpu.setSamples(imuData, nImuSamples / 6);
+
+  return ok;
+
+}
+
+int main() {
+
+  bool ok = testPeriodic();
+  ok &= testOrder();
+  ok &= testMissed();
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+  ok &= testSketch(mpu);
+  mpu.detach();
+
+  Serial.println(ok ? "scheduler: all passed" : "scheduler: FAILED");
+  return ok ? 0 : 1;
+
+}
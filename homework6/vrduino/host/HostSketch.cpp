@@ -0,0 +1,37 @@
+/**
+ * Host sketch runner
+ *
+ * Runs vrduino.ino on the host: setup() once, then loop() for the number of
+ * iterations given on the command line (default 1000). Serial output goes
+ * to stdout, and time advances only through delay()/delayMicroseconds(),
+ * the CpuIdle::sleepUnless() of an idle loop() and bus transactions. The imu is the HostMpu9250 model, replaying
+ * simulatedImuData.h at 1 kHz, on I2C, and on SPI if IMU_SPI_CS_PIN is
+ * defined.
+ */
+
+#include <Arduino.h>
+#include "HostMpu9250.h"
+#include "ImuBus.h"
+#include "ImuCapture.h"
+
+void setup();
+void loop();
+
+int main(int argc, char **argv) {
+
+  long iterations = (argc > 1) ? atol(argv[1]) : 1000;
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  mpu.attach();
+#if defined(IMU_SPI_CS_PIN)
+  mpu.attachSpi(IMU_SPI_CS_PIN);
+#endif
+
+  setup();
+  for (long i = 0; i < iterations; i++) {
+    loop();
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,20 @@
+/**
+ * Host test runner
+ *
+ * Runs the same test suites the sketch runs on the VRduino when `test` is
+ * set in vrduino.ino, and reports the result through the exit code so the
+ * suites can be driven by ctest.
+ */
+
+#include "TestOrientation.h"
+#include "TestPose.h"
+
+int main() {
+
+  bool success = testMain();
+  success = testPoseMain() && success;
+
+  Serial.printf("\n%s\n", success ? "ALL TESTS PASSED" : "TESTS FAILED");
+  return success ? 0 : 1;
+
+}
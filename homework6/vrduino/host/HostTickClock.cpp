@@ -0,0 +1,162 @@
+/**
+ * Host check of the shared 64-bit tick clock, see TickClock.h
+ *
+ * - FTM0 on the virtual clock: now() counts 48 ticks per us, one by one
+ *   across the 16-bit wraps, and past the 71 minute wrap of micros()
+ * - an overflow the ISR has not counted yet, with the interrupt held
+ *   off, is taken from TOF, and counted once when the ISR runs
+ * - begin() again keeps the count
+ * - a lighthouse capture of InputCapture is the low 32 bits of the same
+ *   ticks, also right before a wrap the ISR sees together with it
+ * - ImuCapture stamps each sample at the data ready edge of the
+ *   HostMpu9250 model, exactly a sample period of ticks apart
+ *
+ * Exits with 1 if a check fails, so it runs as a test.
+ */
+
+#include "HostCheck.h"
+#include "HostMpu9250.h"
+#include "ImuCapture.h"
+#include "InputCapture.h"
+#include "TickClock.h"
+
+/* ticks of the virtual clock, from the same origin as now() */
+static uint64_t origin = 0;
+
+static uint64_t virtualTicks() {
+  return hostMicros64() * TickClock::ticksPerMicro - origin;
+}
+
+static bool testClock() {
+
+  Serial.println("clock:");
+  bool ok = true;
+
+  delay(3);
+  TickClock::begin();
+  origin = hostMicros64() * TickClock::ticksPerMicro;
+  ok &= check("starts at 0", TickClock::now() == 0);
+
+  // 1 us steps across ~100 wraps
+  bool steps = true;
+  uint64_t previous = TickClock::now();
+  for (int i = 0; i < 140000; i++) {
+    yield();
+    uint64_t now = TickClock::now();
+    steps &= now - previous == TickClock::ticksPerMicro && now == virtualTicks();
+    previous = now;
+  }
+  ok &= check("48 ticks per us, across the 16-bit wraps", steps);
+
+  // held off, e.g. masked or a higher priority ISR runs
+  while (FTM0_CNT < 0xF000) {
+    yield();
+  }
+  attachInterruptVector(IRQ_FTM0, nullptr);
+  delayMicroseconds(200);
+  ok &= check("an overflow not yet counted is taken from TOF",
+    (FTM0_SC & FTM_SC_TOF) != 0 && TickClock::now() == virtualTicks());
+  attachInterruptVector(IRQ_FTM0, ftm0_isr);
+  ftm0_isr();
+  ok &= check("and counted once by the ISR",
+    (FTM0_SC & FTM_SC_TOF) == 0 && TickClock::now() == virtualTicks());
+
+  uint64_t before = TickClock::now();
+  TickClock::begin();
+  ok &= check("begin() again keeps the count", TickClock::now() == before);
+
+  uint32_t start = micros();
+  hostAdvanceMicros(1ull << 32);
+  Serial.printf("  after %.1f minutes, micros() %u -> %u\n",
+    double(hostMicros64()) / 60e6, (unsigned)start, (unsigned)micros());
+  ok &= check("monotonic past the micros() wrap",
+    TickClock::now() == virtualTicks() && TickClock::now() > before);
+
+  return ok;
+
+}
+
+static bool testLighthouse() {
+
+  Serial.println("lighthouse captures:");
+  bool ok = true;
+
+  InputCapture capture;
+  ok &= check("InputCapture on pin 6, FTM0 channel 4", capture.begin(6));
+
+  // an edge now, as FTM0 latches it
+  delay(7);
+  uint64_t edge = TickClock::now();
+  FTM0_C4V = FTM0_CNT;
+  FTM0_C4SC |= FTM_CSC_CHF;
+  ftm0_isr();
+  uint32_t value = 0;
+  ok &= check("the capture is the low 32 bits of now()",
+    capture.read(&value) == 1 && TickClock::extend(value) == edge);
+
+  // an edge right before a wrap, the ISR runs after it with both flags
+  while (FTM0_CNT < 0x10000 - TickClock::ticksPerMicro) {
+    yield();
+  }
+  attachInterruptVector(IRQ_FTM0, nullptr);
+  edge = TickClock::now();
+  FTM0_C4V = FTM0_CNT;
+  FTM0_C4SC |= FTM_CSC_CHF;
+  yield();
+  attachInterruptVector(IRQ_FTM0, ftm0_isr);
+  ftm0_isr();
+  ok &= check("also when the ISR sees a wrap after the edge",
+    capture.read(&value) == 1 && TickClock::extend(value) == edge);
+
+  return ok;
+
+}
+
+static bool testImu() {
+
+  Serial.println("imu samples:");
+  bool ok = true;
+
+  HostMpu9250 mpu(IMU_INTERRUPT_PIN);
+  // the model samples from when it is attached, at 8 kHz after power up
+  // and every 1 ms once configured, on the same grid
+  uint64_t attached = virtualTicks();
+  mpu.attach();
+
+  Imu imu;
+  imu.init();
+  ImuCapture capture;
+  capture.begin(&imu, IMU_INTERRUPT_PIN);
+  delay(50);
+  capture.end();
+
+  ImuSample sample;
+  int n = 0;
+  bool edges = true;
+  bool apart = true;
+  uint64_t previous = 0;
+  while (capture.pop(sample)) {
+    edges &= (sample.ticks - attached) % (125 * TickClock::ticksPerMicro) == 0;
+    apart &= n == 0 || sample.ticks - previous == imu.samplePeriodTicks;
+    previous = sample.ticks;
+    n++;
+  }
+  Serial.printf("  %d samples\n", n);
+  ok &= check("stamped at the data ready edge", n >= 45 && edges);
+  ok &= check("a sample period of ticks apart", apart);
+
+  mpu.detach();
+  return ok;
+
+}
+
+int main() {
+
+  bool ok = testClock();
+  ok &= testLighthouse();
+  ok &= testImu();
+
+  Serial.println(ok ? "tick clock: all passed" : "tick clock: FAILED");
+  return ok ? 0 : 1;
+
+}
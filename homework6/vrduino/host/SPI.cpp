@@ -0,0 +1,59 @@
+/**
+ * Host stand-in for the SPI library, see SPI.h
+ */
+
+#include "SPI.h"
+
+SPIClass SPI;
+
+SPIClass::SPIClass() :
+  devices(),
+  selected(nullptr),
+  clock(4000000),
+  pendingNanos(0),
+  frames(0)
+{
+}
+
+void SPIClass::hostAttachDevice(uint8_t csPin, HostSpiDevice *device) {
+  if (csPin >= CORE_NUM_DIGITAL) {
+    return;
+  }
+  if (devices[csPin] == selected) {
+    selected = nullptr;
+  }
+  devices[csPin] = device;
+  hostWatchPin(csPin, device != nullptr ? chipSelect : nullptr);
+}
+
+void SPIClass::chipSelect(uint8_t pin, uint8_t value) {
+  HostSpiDevice *device = SPI.devices[pin];
+  if (value == LOW && SPI.selected != device) {
+    SPI.selected = device;
+    SPI.frames++;
+    device->spiSelect();
+  } else if (value == HIGH && SPI.selected == device) {
+    SPI.selected = nullptr;
+    device->spiDeselect();
+  }
+}
+
+void SPIClass::busTime(size_t nBytes) {
+  pendingNanos += (8 * (uint64_t)nBytes * 1000000000) / clock;
+  hostAdvanceMicros(pendingNanos / 1000);
+  pendingNanos %= 1000;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  uint8_t in = (selected != nullptr) ? selected->spiTransfer(data) : 0xFF;
+  busTime(1);
+  return in;
+}
+
+void SPIClass::transfer(void *buf, size_t count) {
+  uint8_t *bytes = (uint8_t *)buf;
+  for (size_t i = 0; i < count; i++) {
+    bytes[i] = (selected != nullptr) ? selected->spiTransfer(bytes[i]) : 0xFF;
+  }
+  busTime(count);
+}
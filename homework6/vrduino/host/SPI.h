@@ -0,0 +1,107 @@
+/**
+ * Host stand-in for the SPI library
+ *
+ * Transfers go to the HostSpiDevice model whose chip select pin was
+ * driven LOW with digitalWrite(), one byte at a time, full duplex. Without
+ * a selected device, transfers read 0xFF, like an undriven MISO line with
+ * a pull-up.
+ *
+ * Each transfer advances the virtual clock by 8 bits per byte at the clock
+ * of the SPISettings passed to beginTransaction(), carrying the fractions
+ * of a microsecond over, as at 20 MHz a byte takes only 0.4 us.
+ */
+
+#ifndef SPI_H
+#define SPI_H
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+/**
+ * model of a slave device on the host SPI bus
+ */
+class HostSpiDevice {
+public:
+
+  virtual ~HostSpiDevice() {}
+
+  /* chip select went LOW, a new frame starts */
+  virtual void spiSelect() = 0;
+
+  /**
+   * one byte of the frame
+   * @param [in] mosi - byte sent by the master
+   * @returns byte sent back on MISO
+   */
+  virtual uint8_t spiTransfer(uint8_t mosi) = 0;
+
+  /* chip select went HIGH */
+  virtual void spiDeselect() = 0;
+};
+
+
+class SPISettings {
+public:
+
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) :
+    clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+
+  SPISettings() : SPISettings(4000000, MSBFIRST, SPI_MODE0) {}
+
+  uint32_t clock;
+  uint8_t bitOrder;
+  uint8_t dataMode;
+};
+
+
+class SPIClass {
+public:
+
+  SPIClass();
+
+  void begin() {}
+
+  void beginTransaction(const SPISettings& settings) { clock = settings.clock; }
+
+  void endTransaction() {}
+
+  uint8_t transfer(uint8_t data);
+
+  /* sends the bytes of buf, and replaces them with the bytes received */
+  void transfer(void *buf, size_t count);
+
+  /* host only: attach a device model to a chip select pin (nullptr detaches) */
+  void hostAttachDevice(uint8_t csPin, HostSpiDevice *device);
+
+  /* host only: number of frames, i.e. chip selects, so far */
+  uint32_t hostFrames() const { return frames; }
+
+private:
+
+  /* advances the virtual clock by the time of nBytes */
+  void busTime(size_t nBytes);
+
+  /* watches the chip select pins */
+  static void chipSelect(uint8_t pin, uint8_t value);
+
+  HostSpiDevice *devices[CORE_NUM_DIGITAL];
+  HostSpiDevice *selected;
+
+  uint32_t clock;
+
+  /* ns of bus time not yet on the virtual clock */
+  uint64_t pendingNanos;
+
+  uint32_t frames;
+};
+
+extern SPIClass SPI;
+
+#endif // ifndef SPI_H
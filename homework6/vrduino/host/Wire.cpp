@@ -0,0 +1,259 @@
+/**
+ * Host stand-in for the Wire (I2C master) library, see Wire.h
+ */
+
+#include "Wire.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire() :
+  devices(),
+  clock(100000),
+  latency(0),
+  transactions(0),
+  txAddress(0),
+  txBuffer(),
+  txLength(0),
+  rxBuffer(),
+  rxIndex(0),
+  rxLength(0)
+{
+}
+
+void TwoWire::attachDevice(int address, HostI2CDevice *device) {
+  devices[address & 0x7F] = device;
+}
+
+void TwoWire::busTime(int nBytes) {
+  transactions++;
+  uint64_t bits = 9 * (uint64_t)nBytes + 2;
+  hostAdvanceMicros((bits * 1000000 + clock / 2) / clock + latency);
+}
+
+void TwoWire::beginTransmission(int address) {
+  txAddress = address & 0x7F;
+  txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  if (txLength >= BUFFER_LENGTH) {
+    return 0;
+  }
+  txBuffer[txLength++] = data;
+  return 1;
+}
+
+uint8_t TwoWire::endTransmission(int sendStop) {
+  (void)sendStop;
+  HostI2CDevice *device = devices[txAddress];
+  if (device == nullptr) {
+    // address not acknowledged
+    busTime(1);
+    return 2;
+  }
+  device->i2cWrite(txBuffer, txLength);
+  busTime(1 + txLength);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity, int sendStop) {
+  (void)sendStop;
+  rxIndex = 0;
+  rxLength = 0;
+
+  HostI2CDevice *device = devices[address & 0x7F];
+  if (device == nullptr) {
+    busTime(1);
+    return 0;
+  }
+  if (quantity > BUFFER_LENGTH) {
+    quantity = BUFFER_LENGTH;
+  }
+  // the device answers with the data at the start of the read
+  int n = device->i2cRead(rxBuffer, quantity);
+  busTime(1 + n);
+  rxLength = n;
+  return (uint8_t)rxLength;
+}
+
+int TwoWire::available() {
+  return rxLength - rxIndex;
+}
+
+int TwoWire::read() {
+  if (rxIndex >= rxLength) {
+    return -1;
+  }
+  return rxBuffer[rxIndex++];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// I2C0 register model, see Arduino.h
+
+/*
+ * Master mode only, in the sequences I2cAsync issues: setting MST sends a
+ * START, a write of D in TX mode sends a byte, RSTA a repeated START, a
+ * read of D in RX mode returns the received byte and receives the next,
+ * and clearing MST sends a STOP. Each byte takes its 9 bits on the bus,
+ * an address byte also the latency of Wire, then sets TCF and IICIF,
+ * RXAK if nobody answered, and raises IRQ_I2C0 if IICIE is set.
+ *
+ * The bytes written to a device are collected and passed to its
+ * i2cWrite() at the repeated START or STOP, the bytes read come from
+ * i2cRead() one at a time.
+ */
+class HostI2c0 : public HostTimedDevice {
+public:
+
+  HostI2c0() :
+    c1(0), s(0), other(), dataOut(0), dataIn(0), addressNext(false),
+    receiving(false), transferring(false), doneTime(0), device(nullptr),
+    reading(false), tx(), txLength(0), attached(false)
+  {
+  }
+
+  uint8_t read(int reg) {
+    switch (reg) {
+      case 2: return c1;
+      case 3: return s;
+      case 4: {
+        uint8_t value = dataIn;
+        if ((c1 & I2C_C1_MST) && !(c1 & I2C_C1_TX) && reading) {
+          startByte(false, true);
+        }
+        return value;
+      }
+      default: return other[reg];
+    }
+  }
+
+  void write(int reg, uint8_t value) {
+    switch (reg) {
+      case 2: writeC1(value); break;
+      case 3: s &= ~(value & (I2C_S_IICIF | I2C_S_ARBL)); break;
+      case 4:
+        dataOut = value;
+        if ((c1 & I2C_C1_MST) && (c1 & I2C_C1_TX)) {
+          startByte(addressNext, false);
+        }
+        break;
+      default: other[reg] = value; break;
+    }
+  }
+
+  virtual uint64_t hostNextEvent() {
+    return transferring ? doneTime : UINT64_MAX;
+  }
+
+  virtual void hostEvent() {
+
+    transferring = false;
+    bool ack = false;
+
+    if (receiving) {
+      if (device == nullptr || device->i2cRead(&dataIn, 1) != 1) {
+        dataIn = 0xFF;
+      }
+      ack = true;
+    } else if (addressNext) {
+      addressNext = false;
+      device = Wire.hostDevice(dataOut >> 1);
+      reading = (dataOut & 1) != 0;
+      ack = device != nullptr;
+      Wire.hostCountTransaction();
+    } else if (device != nullptr && !reading) {
+      if (txLength < (int)sizeof(tx)) {
+        tx[txLength++] = dataOut;
+      }
+      ack = true;
+    }
+
+    s = (s & ~I2C_S_RXAK) | (ack ? 0 : I2C_S_RXAK) | I2C_S_TCF | I2C_S_IICIF;
+    if (c1 & I2C_C1_IICIE) {
+      hostRaiseIrq(IRQ_I2C0);
+    }
+
+  }
+
+private:
+
+  void writeC1(uint8_t value) {
+    uint8_t old = c1;
+    c1 = value & ~I2C_C1_RSTA;
+    if (!(old & I2C_C1_MST) && (value & I2C_C1_MST)) {
+      // START
+      s |= I2C_S_BUSY;
+      addressNext = true;
+      device = nullptr;
+      txLength = 0;
+    } else if ((old & I2C_C1_MST) && !(value & I2C_C1_MST)) {
+      // STOP, a receive still running is cut off
+      flush();
+      transferring = false;
+      device = nullptr;
+      s &= ~I2C_S_BUSY;
+    } else if ((old & I2C_C1_MST) && (value & I2C_C1_RSTA)) {
+      flush();
+      addressNext = true;
+    }
+  }
+
+  /* passes the bytes written so far to the device */
+  void flush() {
+    if (device != nullptr && !reading && txLength > 0) {
+      device->i2cWrite(tx, txLength);
+    }
+    txLength = 0;
+  }
+
+  void startByte(bool address, bool receive) {
+    if (!attached) {
+      hostAttachTimedDevice(this);
+      attached = true;
+    }
+    uint32_t clock = Wire.hostClock();
+    s &= ~I2C_S_TCF;
+    receiving = receive;
+    transferring = true;
+    doneTime = hostMicros64() + (9 * 1000000ull + clock / 2) / clock +
+      (address ? Wire.hostLatency() : 0);
+  }
+
+  uint8_t c1;
+  uint8_t s;
+  uint8_t other[7];
+
+  uint8_t dataOut;
+  uint8_t dataIn;
+
+  /* the next byte sent is an address */
+  bool addressNext;
+  bool receiving;
+
+  bool transferring;
+  uint64_t doneTime;
+
+  /* addressed device, and the direction */
+  HostI2CDevice *device;
+  bool reading;
+
+  uint8_t tx[64];
+  int txLength;
+
+  bool attached;
+};
+
+static HostI2c0 i2c0;
+
+HostI2cRegister hostI2c0[7] = {
+  HostI2cRegister(0), HostI2cRegister(1), HostI2cRegister(2), HostI2cRegister(3),
+  HostI2cRegister(4), HostI2cRegister(5), HostI2cRegister(6)
+};
+
+uint8_t hostI2c0Read(int reg) {
+  return i2c0.read(reg);
+}
+
+void hostI2c0Write(int reg, uint8_t value) {
+  i2c0.write(reg, value);
+}
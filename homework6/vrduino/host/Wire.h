@@ -0,0 +1,119 @@
+/**
+ * Host stand-in for the Wire (I2C master) library
+ *
+ * Transactions are routed to HostI2CDevice models attached to a 7 bit
+ * address. Reads from an address without a device return no bytes, and
+ * Wire.read() then returns -1, just like an unanswered bus on the Teensy.
+ *
+ * Each transaction advances the virtual clock by its time on the bus, 9
+ * bits per byte including the address, plus start and stop, at the rate
+ * set with setClock(). Polling loops therefore see time pass, and device
+ * events in between, as on the Teensy. Inside an interrupt handler raised
+ * by a device model the clock advances too, but runs no further events.
+ * hostSetLatency() adds a fixed delay to each transaction, e.g. for a
+ * slave stretching the clock, or for a slower link in a bench.
+ *
+ * The same devices also answer the I2C0 register model of Arduino.h, byte
+ * by byte, for the interrupt driven transfers of I2cAsync.
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "Arduino.h"
+
+/**
+ * model of a slave device on the host I2C bus
+ */
+class HostI2CDevice {
+public:
+
+  virtual ~HostI2CDevice() {}
+
+  /**
+   * called at the end of a write transaction
+   * @param [in] data - bytes written by the master, usually the register
+   *   address followed by the register values
+   * @param [in] n - number of bytes
+   */
+  virtual void i2cWrite(const uint8_t *data, int n) = 0;
+
+  /**
+   * called for a read request
+   * @param [out] data - bytes to return to the master
+   * @param [in] n - number of bytes requested
+   * @returns number of bytes provided
+   */
+  virtual int i2cRead(uint8_t *data, int n) = 0;
+};
+
+
+class TwoWire {
+public:
+
+  TwoWire();
+
+  void begin() {}
+
+  void setClock(uint32_t frequency) { clock = frequency; }
+
+  void beginTransmission(int address);
+
+  size_t write(uint8_t data);
+
+  uint8_t endTransmission(int sendStop = 1);
+
+  uint8_t requestFrom(int address, int quantity, int sendStop = 1);
+
+  int available();
+
+  int read();
+
+  /* host only: attach a device model at a 7 bit address (nullptr detaches) */
+  void attachDevice(int address, HostI2CDevice *device);
+
+  /* host only: device model at a 7 bit address, nullptr if none */
+  HostI2CDevice *hostDevice(int address) const { return devices[address & 0x7F]; }
+
+  /* host only: number of bus transactions, writes and reads, so far */
+  uint32_t hostTransactions() const { return transactions; }
+
+  /* host only: counts a transaction run by the I2C0 register model */
+  void hostCountTransaction() { transactions++; }
+
+  /* host only: SCL frequency in Hz */
+  uint32_t hostClock() const { return clock; }
+
+  /* host only: extra time per transaction in us, 0 by default */
+  void hostSetLatency(uint32_t us) { latency = us; }
+  uint32_t hostLatency() const { return latency; }
+
+private:
+
+  static const int BUFFER_LENGTH = 32;
+
+  /* counts a transaction, and advances the virtual clock by the bus time
+   * of nBytes incl. the address */
+  void busTime(int nBytes);
+
+  HostI2CDevice *devices[128];
+
+  /* SCL frequency in Hz, 100 kHz after begin() like the Teensy */
+  uint32_t clock;
+
+  uint32_t latency;
+
+  uint32_t transactions;
+
+  int txAddress;
+  uint8_t txBuffer[BUFFER_LENGTH];
+  int txLength;
+
+  uint8_t rxBuffer[BUFFER_LENGTH];
+  int rxIndex;
+  int rxLength;
+};
+
+extern TwoWire Wire;
+
+#endif // ifndef WIRE_H
@@ -21,11 +21,20 @@
 #include "TestPose.h"
 #include "PoseTracker.h"
 #include "InputCapture.h"
+#include "BootTimeline.h"
+#include "CpuIdle.h"
+#include "Scheduler.h"
+#include "Profiler.h"
 
 //complementary filter value [0,1].
 //1: ignore acc tilt, 0: use all acc tilt
 double alphaImuFilter = 0.99;
 
+//quaternion orientation estimator, see OrientationEstimator.h
+//ESTIMATOR_COMP, ESTIMATOR_MADGWICK, ESTIMATOR_MAHONY or ESTIMATOR_MEKF.
+//'e' on the serial port switches to the next one
+EstimatorType estimatorType = VRDUINO_ESTIMATOR;
+
 //get simulated lighthouse timings (to test without physical lighthouse)
 bool simulateLighthouse = true;
 
@@ -39,109 +48,209 @@ const int B = 1;
 const int C = 2;
 int baseStationMode = B;
 
-//if true, measure the imu bias on start
+//if true, sample the imu from its data ready interrupt instead of polling
+//it once per loop, so no sample is lost. Needs the MPU9250 INT line wired
+//to IMU_INTERRUPT_PIN, see ImuCapture.h
+bool imuInterrupt = false;
+
+//if true (and imuInterrupt is false), read the imu in batches from its
+//FIFO, with ~1 I2C transaction per sample instead of 4 when polling
+bool imuFifo = false;
+
+//if true (and neither of the above), read the imu in the background on the
+//I2C interrupt, overlapped with the lighthouse work and the serial output
+bool imuAsync = false;
+
+//if true, read the AK8963 magnetometer through the imu, in the same burst
+//as the gyro and acc, and correct the yaw drift with it
+bool imuMagnetometer = false;
+
+//if true, sample the imu at 100 Hz and step the estimator 10 times a
+//second while it is still, back to the full rate at the first motion.
+//'i' prints the time and the bus and cpu time freed
+bool imuIdleRate = true;
+
+//if true, load the imu bias saved in EEPROM on start, or measure it and
+//save it if there is none, see ImuCalibration.h. It then follows the imu
+//whenever it is at rest, 'b' measures it again
 bool measureImuBias = true;
 
 //if measureImuBias is false, set the imu bias to the following
 double imuBias[3] = {0, 0, 0};
 
-PoseTracker tracker(alphaImuFilter, baseStationMode, simulateLighthouse);
+//rates in Hz of the imu quaternion (QC) and of the lighthouse lines
+//(BS NP PS QH PD) on the serial port, each printed only if new. 's'
+//prints the run time and missed deadlines of each task, see Scheduler.h
+int telemetryImuHz = 200;
+int telemetryLighthouseHz = 120;
 
-void setup() {
+PoseTracker tracker(alphaImuFilter, baseStationMode, simulateLighthouse, estimatorType);
 
-  Serial.begin(115200);
-  if (test) {
+//the tasks of loop(), most urgent first: the imu at its sample rate, the
+//lighthouse on new sweep data, commands when bytes arrive, telemetry, and
+//the calibration refreshed at rest saved to EEPROM
+Scheduler scheduler;
 
-    delay(1000);
-    testPoseMain();
-    return;
+//results of the imu and lighthouse tasks not printed yet
+bool imuTrack = false;
+int hmTrack = -2;
 
-  }
+void commandTask() {
 
-  tracker.initImu();
+  int byteRead = Serial.read();
+  int desiredMode  = byteRead - 48;
 
-  if (measureImuBias) {
+  if (desiredMode >= 0 && desiredMode <= 2) {
 
-    tracker.measureImuBiasVariance();
+    tracker.setMode(desiredMode);
 
-  } else {
+  } else if (byteRead == 'r') {
 
-    tracker.setImuBias(imuBias);
+    //reset orientation tracking
+    tracker.resetOrientation();
+
+  } else if (byteRead == 'b') {
+
+    //remeasure bias from the next second at rest, tracking goes on
+    tracker.recalibrateImu();
+
+  } else if (byteRead == 'e') {
+
+    //switch to the next orientation estimator
+    int next = (tracker.getEstimator() + 1) % ESTIMATOR_COUNT;
+    tracker.setEstimator(EstimatorType(next));
+
+  } else if (byteRead == 't') {
+
+    //print the boot timeline, see BootTimeline.h
+    BootTimeline::print();
+
+  } else if (byteRead == 's') {
+
+    //print the counters of the tasks, see Scheduler.h
+    scheduler.print();
+
+#if defined(VRDUINO_PROFILE)
+  } else if (byteRead == 'p') {
+
+    //print the cycles of each stage, see Profiler.h, and start over
+    Profiler::print();
+    Profiler::reset();
+#endif
+
+  } else if (byteRead == 'i') {
+
+    //print the time the imu was idle, the samples and estimator steps it
+    //skipped, and the bus time measured against the full rate and the
+    //cpu time of the steps freed
+    uint32_t samples = tracker.getImuSamplesSkipped();
+    uint32_t steps = tracker.getImuStepsSkipped();
+    Serial.printf("ID %.1f s in %lu, skipped %lu samples %lu steps, freed bus %.1f ms cpu %.1f ms\n",
+      tracker.getImuIdleMicros() * 1e-6, (unsigned long)tracker.getImuIdleEntries(),
+      (unsigned long)samples, (unsigned long)steps,
+      tracker.getImuBusMicrosFreed() * 1e-3,
+      steps * tracker.getImuEstimatorMicros() * 1e-3);
+
+    //and the time the core slept in loop(), see CpuIdle.h
+    Serial.printf("SL %.1f%% asleep in %lu sleeps\n",
+      100.0 * CpuIdle::sleptMicros() / micros(), (unsigned long)CpuIdle::sleeps());
 
   }
 
 }
 
-void loop() {
+bool commandReady() {
+  return Serial.available() > 0;
+}
 
-  if (test) {
+//the imu task, polled at the sample period of the imu
+int imuTaskIndex = -1;
+uint32_t imuPeriod = 0;
 
-    return;
+void imuTask() {
+
+  imuTrack |= tracker.processImu();
 
+  //follow the imu rate, e.g. lowered while still, see setImuIdleRate()
+  uint32_t period = tracker.getImuSamplePeriodMicros();
+  if (period != imuPeriod) {
+    imuPeriod = period;
+    scheduler.setPeriod(imuTaskIndex, imuPeriod);
   }
 
-  if (Serial.available()) {
+}
 
-    int byteRead = Serial.read();
-    int desiredMode  = byteRead - 48;
+void lighthouseTask() {
+  hmTrack = tracker.processLighthouse();
+}
 
-    if (desiredMode >= 0 && desiredMode <= 2) {
+bool lighthouseReady() {
+  return tracker.isLighthouseReady();
+}
 
-      tracker.setMode(desiredMode);
+void calibrationSaveTask() {
+  tracker.saveImuCalibration();
+}
 
-    } else if (byteRead == 'r') {
+bool calibrationSaveReady() {
+  return tracker.isImuCalibrationSavePending();
+}
 
-      //reset orientation tracking
-      tracker.resetOrientation();
+void imuTelemetryTask() {
 
-    } else if (byteRead == 'b') {
+  if (!imuTrack) {
+    return;
+  }
+  imuTrack = false;
 
-      //remeasure bias
-      tracker.measureImuBiasVariance();
+  PROFILE_SCOPE(PROFILE_SERIAL);
 
-    }
+  //print quaternion from imu
+  const Quaternion& quaternionComp = tracker.getQuaternionComp();
+  Serial.printf("QC %.3f %.3f %.3f %.3f\n",
+    quaternionComp.q[0], quaternionComp.q[1],
+    quaternionComp.q[2], quaternionComp.q[3]);
 
+  //time from power up to here, once
+  if (BootTimeline::firstPose()) {
+    BootTimeline::print();
   }
 
+}
 
-  //variables determining the success of imu and lighthouse tracking
-  bool imuTrack = false;
-  int hmTrack = 1;
-//    int hmTrack = -2;
+void lighthouseTelemetryTask() {
 
+  if (hmTrack == -2) {
+    return;
+  }
 
-  imuTrack = tracker.processImu();
-  hmTrack = tracker.processLighthouse();
+  PROFILE_SCOPE(PROFILE_SERIAL);
 
   //get values from tracker
   double pitch = tracker.getBaseStationPitch();
   double roll = tracker.getBaseStationRoll();
   int mode = tracker.getBaseStationMode();
   const unsigned long * numPulseDetections = tracker.getNumPulseDetections();
-  const double * position = tracker.getPosition();
-  const double * position2D = tracker.getPosition2D();
-  const Quaternion& quaternionComp = tracker.getQuaternionComp();
+  const Scalar * position = tracker.getPosition();
+  const Scalar * position2D = tracker.getPosition2D();
   const Quaternion& quaternionHm = tracker.getQuaternionHm();
 
-  if (hmTrack > -2) {
-    // base station data available
+  // base station data available
 
-    //print base station data
-    Serial.printf("BS ");
-    Serial.printf("%.3f %.3f %d\n", pitch, roll, mode);
-
-    // print num sweep pulse detections for each axis of each photodiode
-    // order is sensor0x, sensor0y, ... sensor3x, sensor3y
-    // should normally be 1 1 1 1 1 1 1 1
-    // could be more than 2 if there are inter-reflections,
-    // or 0 if there are occlusions
-    Serial.printf("NP ");
-    for (int i = 0; i < 8; i++) {
-      Serial.printf("%lu ", numPulseDetections[i]);
-    }
-    Serial.println();
+  //print base station data
+  Serial.printf("BS ");
+  Serial.printf("%.3f %.3f %d\n", pitch, roll, mode);
 
+  // print num sweep pulse detections for each axis of each photodiode
+  // order is sensor0x, sensor0y, ... sensor3x, sensor3y
+  // should normally be 1 1 1 1 1 1 1 1
+  // could be more than 2 if there are inter-reflections,
+  // or 0 if there are occlusions
+  Serial.printf("NP ");
+  for (int i = 0; i < 8; i++) {
+    Serial.printf("%lu ", numPulseDetections[i]);
   }
+  Serial.println();
 
   if (hmTrack == 1 ) {
 
@@ -163,15 +272,102 @@ void loop() {
 
   }
 
-  if (imuTrack == 1) {
+  hmTrack = -2;
 
-  //print quaternion from imu
-    Serial.printf("QC %.3f %.3f %.3f %.3f\n",
-      quaternionComp.q[0], quaternionComp.q[1],
-      quaternionComp.q[2], quaternionComp.q[3]);
+}
+
+void setup() {
+
+  Serial.begin(115200);
+
+#if defined(VRDUINO_PROFILE)
+  Profiler::begin();
+#endif
+
+  if (test) {
+
+    delay(1000);
+    testPoseMain();
+    return;
+
+  }
+
+  tracker.initImu();
+
+  if (imuMagnetometer && !tracker.initImuMagnetometer()) {
+
+    Serial.println("no magnetometer, yaw drifts");
+
+  }
+
+  if (imuInterrupt) {
+
+    tracker.initImuInterrupt(IMU_INTERRUPT_PIN);
+
+  } else if (imuFifo) {
+
+    tracker.initImuFifo();
+
+  } else if (imuAsync) {
+
+    tracker.initImuAsync();
+
+  }
+
+  BootTimeline::start(BOOT_CALIBRATION);
+
+  if (measureImuBias) {
+
+    if (!tracker.loadImuCalibration()) {
+
+      tracker.measureImuBiasVariance();
+      tracker.saveImuCalibration();
+
+    }
+
+  } else {
+
+    tracker.setImuBias(imuBias);
+
+  }
+
+  BootTimeline::stop(BOOT_CALIBRATION);
+
+  tracker.setImuIdleRate(imuIdleRate);
+
+  //priority 0 runs first, deadlines in us from the release
+  imuPeriod = tracker.getImuSamplePeriodMicros();
+  imuTaskIndex = scheduler.addPeriodic("imu", imuTask, imuPeriod, imuPeriod, 0);
+  scheduler.addEvent("lighthouse", lighthouseTask, lighthouseReady, 8333, 1);
+  scheduler.addEvent("command", commandTask, commandReady, 20000, 2);
+  scheduler.addPeriodic("qc", imuTelemetryTask, 1000000 / telemetryImuHz,
+    1000000 / telemetryImuHz, 3);
+  scheduler.addPeriodic("hm", lighthouseTelemetryTask, 1000000 / telemetryLighthouseHz,
+    1000000 / telemetryLighthouseHz, 3);
+  //the EEPROM write of a refreshed calibration, last, whenever it is free
+  scheduler.addEvent("eeprom", calibrationSaveTask, calibrationSaveReady, 1000000, 4);
+
+}
+
+//the check of CpuIdle::sleepUnless(), with interrupts masked
+bool schedulerReleased() {
+  return scheduler.hasReleased();
+}
+
+void loop() {
+
+  if (test) {
+
+    return;
 
   }
 
-  delay(5);
+  //nothing released until the next interrupt: an imu sample, a
+  //photodiode edge on FTM0, a USB packet, or the 1 ms SysTick at the latest.
+  //Checked again with interrupts masked, so one that came since runOnce()
+  //wakes the core at once instead of at the next SysTick
+  if (!scheduler.runOnce()) {
+    CpuIdle::sleepUnless(schedulerReleased);
+  }
 
 }